@@ -6,14 +6,33 @@
 //  See header file for description.
 //
 
+#include <chrono>
+#include <time.h>
+#include <unordered_map>
 #include "ExamplesMenuLayer.h"
 #include "BasicRUBELayer.h"
 #include "rubestuff/b2dJson.h"
+#include "rubestuff/b2dJsonTiles.h"
+#include "rubestuff/b2dJsonFileView.h"
+#include "rubestuff/b2dJsonHotReload.h"
+#include "rubestuff/b2dJsonFileWatcher.h"
+#include "Box2DReplay.h"
+#include "Box2DWorldHash.h"
+#include "RUBEInputRecording.h"
+#include "Box2DContactEvents.h"
+#include "RUBECollisionMatrix.h"
+#include "Box2DIterationController.h"
+#include "Box2DActivationManager.h"
+#include "RUBEWorldScheduler.h"
 #include "QueryCallbacks.h"
 
 using namespace std;
 USING_NS_CC;
 
+// the callbacks a world has until it is given others, defined in b2ContactManager.cpp
+extern b2ContactFilter b2_defaultFilter;
+extern b2ContactListener b2_defaultListener;
+
 BasicRUBELayer::BasicRUBELayer()
 {
     m_world = NULL;
@@ -21,6 +40,26 @@ BasicRUBELayer::BasicRUBELayer()
     m_mouseJoint = NULL;
     m_mouseJointGroundBody = NULL;
     m_mouseJointTouch = NULL;
+    m_tileStreamer = NULL;
+    m_hotReload = NULL;
+    m_fileWatcher = NULL;
+    m_replayRecorder = NULL;
+    m_worldHash = NULL;
+    m_stepCount = 0;
+    m_inputRecording = NULL;
+    m_inputBatch = 0;
+    m_replayingInput = false;
+    m_contactEvents = NULL;
+    m_collisionMatrix = NULL;
+    m_contactCountTotal = 0;
+    m_contactCountPeak = 0;
+    m_iterationController = NULL;
+    m_activationManager = NULL;
+    m_worldScheduled = false;
+#if RUBE_FRAME_PROFILER
+    m_profilerLabel = NULL;
+    m_profilerLabelFrames = 0;
+#endif
 }
 
 BasicRUBELayer::~BasicRUBELayer()
@@ -57,6 +96,9 @@ bool BasicRUBELayer::init()
     setPosition( initialWorldOffset() );
     setScale( initialWorldScale() );
     
+    // the profiler has to be made on the main thread, before anything is timed
+    RUBE_PROFILE_INIT();
+    
     // load the world from RUBE .json file (this will also call afterLoadProcessing)
     loadWorld(this);
     
@@ -69,10 +111,10 @@ void BasicRUBELayer::onEnter()
     Layer::onEnter();
 
     auto listener = EventListenerTouchAllAtOnce::create();
-    listener->onTouchesBegan = CC_CALLBACK_2(BasicRUBELayer::onTouchesBegan, this);
-    listener->onTouchesMoved = CC_CALLBACK_2(BasicRUBELayer::onTouchesMoved, this);
-    listener->onTouchesEnded = CC_CALLBACK_2(BasicRUBELayer::onTouchesEnded, this);
-	listener->onTouchesCancelled = CC_CALLBACK_2(BasicRUBELayer::onTouchesCancelled, this);
+    listener->onTouchesBegan = CC_CALLBACK_2(BasicRUBELayer::touchesBegan, this);
+    listener->onTouchesMoved = CC_CALLBACK_2(BasicRUBELayer::touchesMoved, this);
+    listener->onTouchesEnded = CC_CALLBACK_2(BasicRUBELayer::touchesEnded, this);
+	listener->onTouchesCancelled = CC_CALLBACK_2(BasicRUBELayer::touchesCancelled, this);
 	
     
     _eventDispatcher->addEventListenerWithSceneGraphPriority(listener, this); 
@@ -89,6 +131,12 @@ Layer* BasicRUBELayer::setupMenuLayer()
    
 	 
     m_menuLayer = Menu::create(backItem,reloadItem,NULL);
+    if ( recordInput() )
+        m_menuLayer->addChild( MenuItemFont::create("Replay", CC_CALLBACK_1(BasicRUBELayer::replayRecordedInput, this)) );
+#if RUBE_FRAME_PROFILER
+    m_menuLayer->addChild( MenuItemFont::create("Stats", CC_CALLBACK_1(BasicRUBELayer::toggleProfilerOverlay, this)) );
+    m_menuLayer->addChild( MenuItemFont::create("Save profile", CC_CALLBACK_1(BasicRUBELayer::saveProfile, this)) );
+#endif
     m_menuLayer->alignItemsHorizontally();
     
     updateAfterOrientationChange();
@@ -106,6 +154,54 @@ void BasicRUBELayer::goBack(Object* sender)
     unscheduleUpdate();
 	Director::getInstance()->replaceScene(ExamplesMenuLayer::scene());
 }
+
+
+// Clearing the layer saves the touches recorded since the world was loaded, and then
+// they are played back from the start. The world is left as the replay finished, and
+// is not recorded any more until it is loaded again with Reload.
+void BasicRUBELayer::replayRecordedInput(Object* sender)
+{
+    clear();
+    replayInput( getInputRecordingFilename() );
+}
+  
+#if RUBE_FRAME_PROFILER
+// The label goes in the scene just under the menu, so it stays in place when the view
+// is moved and zoomed (it can't go in the menu itself, which only takes MenuItems).
+// This is only for this demo project, you can remove this in your own app.
+void BasicRUBELayer::toggleProfilerOverlay(Object* sender)
+{
+    if ( !m_profilerLabel ) {
+        Node* parent = m_menuLayer->getParent();
+        if ( !parent )
+            return;
+        m_profilerLabel = LabelTTF::create("", "Courier", 12);
+        m_profilerLabel->setAnchorPoint( Point::Point(0.5f,1) );
+        parent->addChild(m_profilerLabel);
+        m_profilerLabelFrames = 0;
+        updateAfterOrientationChange();
+    }
+    else {
+        m_profilerLabel->getParent()->removeChild(m_profilerLabel, true);
+        m_profilerLabel = NULL;
+    }
+}
+
+
+// The files go in the writable path, named after the scene file.
+// This is only for this demo project, you can remove this in your own app.
+void BasicRUBELayer::saveProfile(Object* sender)
+{
+    string path = FileUtils::getInstance()->getWritablePath() + getFilename();
+    string errMsg;
+    RUBEFrameProfiler* profiler = RUBEFrameProfiler::getInstance();
+    if ( profiler->writeCSV(path + ".profile.csv", errMsg) && profiler->writeChromeTrace(path + ".trace.json", errMsg) )
+        CCLOG("Saved %d frames of timings to %s.profile.csv and %s.trace.json", profiler->getFrameCount(), path.c_str(), path.c_str());
+    else
+        CCLOG("%s", errMsg.c_str());
+}
+#endif
+
   
 // Repositions the menu child layer after the device orientation changes.
 // This is only for this demo project, you can remove this in your own app.
@@ -113,6 +209,10 @@ void BasicRUBELayer::updateAfterOrientationChange()
 {
     Size s = Director::getInstance()->getWinSize();
     m_menuLayer->setPosition( Point::Point(s.width/2,s.height-20) );
+#if RUBE_FRAME_PROFILER
+    if ( m_profilerLabel )
+        m_profilerLabel->setPosition( Point::Point(s.width/2,s.height-40) );
+#endif
 }
 
 
@@ -151,6 +251,16 @@ float BasicRUBELayer::initialWorldScale()
     return s.height / 10; //screen will be 10 physics units high
 }
 
+
+// Override this in subclasses to give the index file written by b2dJsonTiles::splitWorld,
+// eg. "bigLevel.tiles.json". The file from getFilename should then be the base file
+// ("bigLevel.json") which has the world settings, and the tiles will be added to that
+// world as they come into view. An empty string means no tiles are used.
+string BasicRUBELayer::getTileIndexFilename()
+{
+    return "";
+}
+
 // Attempts to load the world from the .json file given by getFilename.
 // If successful, the method afterLoadProcessing will also be called,
 // to allow subclasses to do something extra while the b2dJson information
@@ -161,6 +271,17 @@ void BasicRUBELayer::loadWorld(Object* sender)
     // and also whatever is done in the afterLoadProcessing method.
     clear();
     
+    // Recording the touches also needs the random numbers to come out the same
+    // when the session is replayed (replayInput sets the seed itself).
+    if ( recordInput() && !m_replayingInput ) {
+        m_inputRecording = new RUBEInputRecording();
+        m_inputRecording->sceneFilename = getFilename();
+        m_inputRecording->windowWidth = Director::getInstance()->getWinSize().width;
+        m_inputRecording->windowHeight = Director::getInstance()->getWinSize().height;
+        m_inputRecording->randomSeed = (unsigned int)time(NULL);
+        srand(m_inputRecording->randomSeed);
+    }
+    
     // Get the name of the .json file to load, eg. "jointTypes.json"
     string filename = getFilename();
     
@@ -177,12 +298,31 @@ void BasicRUBELayer::loadWorld(Object* sender)
     // about what happened.
     b2dJson json;
     std::string errMsg;
-    long *fileSize = new long(0);
-    unsigned char* fileData = FileUtils::getInstance()->getFileData(fullpath.c_str(), "r", fileSize);
-	long fileSizeValue = *fileSize;
-    std::string jsonContent;
-    jsonContent.assign(reinterpret_cast<const char*>(fileData), fileSizeValue);
-    m_world = json.readFromString(jsonContent, errMsg);
+    
+    // The file is mapped into memory (or read into one buffer where that isn't
+    // possible) and parsed right where it is, so there is never more than one copy
+    // of the text around. It is released again as soon as the world is made.
+    b2dJsonFileView file;
+    if ( file.open(fullpath, errMsg) ) {
+        if ( watchFileForChanges() ) {
+            // this keeps the parsed scene, to compare with when the file changes
+            m_hotReload = new b2dJsonHotReload();
+            m_world = m_hotReload->load(file.data(), file.size(), json, errMsg);
+        }
+        else
+            m_world = json.readFromMemory(file.data(), file.size(), errMsg);
+        file.close();
+    }
+    else {
+        // Not a plain file, eg. on Android the resources are inside the .apk
+        long fileSize = 0;
+        unsigned char* fileData = FileUtils::getInstance()->getFileData(fullpath.c_str(), "rb", &fileSize);
+        if ( fileData ) {
+            errMsg = "";
+            m_world = json.readFromMemory(reinterpret_cast<const char*>(fileData), fileSize, errMsg);
+            delete [] fileData;
+        }
+    }
     
     if ( m_world ) {
         CCLOG("Loaded JSON ok");
@@ -198,12 +338,85 @@ void BasicRUBELayer::loadWorld(Object* sender)
         // set the debug draw to show fixtures, and let the world know about it
         m_debugDraw->SetFlags( b2Draw::e_shapeBit | b2Draw::e_jointBit );
         m_world->SetDebugDraw(m_debugDraw);
+        
+        // This needs to be here before afterLoadProcessing, so that subclasses can change
+        // its settings there
+        if ( useContactEvents() ) {
+            m_contactEvents = new Box2DContactEvents();
+            m_world->SetContactListener(m_contactEvents);
+            m_world->SetDestructionListener(m_contactEvents);
+            if ( m_hotReload )
+                m_hotReload->setDestructionListener(m_contactEvents);
+        }
+        
+        setupCollisionMatrix(&json);
+        setupIterationController(&json);
 
         // This body is needed if we want to use a mouse joint to drag things around.
         b2BodyDef bd;
         m_mouseJointGroundBody = m_world->CreateBody( &bd );
         
+        // Start loading the tiles of a large level in the background, if there are any.
+        // Nothing from the tiles is in the world yet at this point, they will only
+        // start appearing once update is called.
+        string tileIndexFilename = getTileIndexFilename();
+        if ( tileIndexFilename != "" ) {
+            string tileIndexPath = FileUtils::getInstance()->fullPathForFilename(tileIndexFilename.c_str());
+            m_tileStreamer = new b2dJsonTileStreamer(m_world);
+            m_tileStreamer->setListener(this);
+            if ( ! m_tileStreamer->open(tileIndexPath, errMsg) ) {
+                CCLOG("%s", errMsg.c_str());
+                delete m_tileStreamer;
+                m_tileStreamer = NULL;
+            }
+        }
+        
+        // The manager is made before afterLoadProcessing so that subclasses can change its
+        // settings there, but the bodies are only gathered up afterwards, leaving out any
+        // that afterLoadProcessing switched off (eg. prefab templates)
+        setupActivationManager(&json);
+        
         afterLoadProcessing(&json);
+        
+        if ( m_contactEvents )
+            tagContactFixtures(&json);
+        
+        if ( m_activationManager )
+            m_activationManager->build(m_world);
+        
+        if ( m_hotReload ) {
+            m_fileWatcher = new b2dJsonFileWatcher();
+            if ( m_fileWatcher->watch(fullpath, errMsg) )
+                CCLOG("Watching %s for changes", fullpath.c_str());
+            else {
+                CCLOG("%s", errMsg.c_str());
+                delete m_fileWatcher;
+                m_fileWatcher = NULL;
+            }
+        }
+        
+        // Start recording after everything from the scene has been made, so that the
+        // bodies are numbered the same way as when the scene is loaded to play it back.
+        if ( recordReplay() ) {
+            m_replayRecorder = new Box2DReplayRecorder();
+            m_replayRecorder->begin(m_world);
+        }
+        
+        if ( hashEachStep() || m_inputRecording || m_replayingInput ) {
+            m_worldHash = new Box2DWorldHash();
+            setWorldHashOrder(&json);
+        }
+        
+        // Recording and replaying the touches need the steps to happen at the same
+        // points between the touches as each other, so they are kept in update.
+        if ( stepInParallel() && !m_inputRecording && !m_replayingInput ) {
+            if ( contactCallbacksAreThreadSafe() ) {
+                RUBEWorldScheduler::getInstance()->addLayer(this);
+                m_worldScheduled = true;
+            }
+            else
+                CCLOG("The world has a contact listener or filter of its own, so it will not be stepped in parallel");
+        }
     }
     else
         CCLOG(errMsg.c_str()); //if this warning bothers you, turn off "Typecheck calls to printf/scanf" in the project build settings
@@ -218,29 +431,563 @@ void BasicRUBELayer::afterLoadProcessing(b2dJson* json)
     
 }
 
+// Override this in subclasses to return true, and the scene file will be watched for
+// changes while the game is running. When the scene is exported from RUBE again, only
+// the bodies, joints and images that are different are changed in the world, and
+// everything else carries on as it was (see b2dJsonHotReload.h for details).
+bool BasicRUBELayer::watchFileForChanges()
+{
+    return false;
+}
+
+
+// Override this in subclasses to update anything that was set up from the b2dJson
+// information in afterLoadProcessing, eg. pointers to named bodies, which may have
+// been destroyed and made again if they were changed in the scene.
+void BasicRUBELayer::afterHotReload(b2dJson* json, const b2dJsonReloadInfo& info)
+{
+    
+}
+
+
+// Override this in subclasses to return true, and the position and angle of every
+// body will be recorded after each step. The recording can be taken with getReplayRecorder
+// before the layer is cleared, and played back by a RUBELayer with the same scene.
+bool BasicRUBELayer::recordReplay()
+{
+    return false;
+}
+
+
+// Override this in subclasses to return true, and every touch will be recorded along
+// with the step it arrived at. When the layer is cleared (eg. by leaving the scene
+// or reloading) the touches are saved to the file given by getInputRecordingFilename.
+bool BasicRUBELayer::recordInput()
+{
+    return false;
+}
+
+
+// The default is the scene file name with .input added, in the writable folder
+string BasicRUBELayer::getInputRecordingFilename()
+{
+    return FileUtils::getInstance()->getWritablePath() + getFilename() + ".input";
+}
+
+
+// Loads the world again and plays a recorded session through it, without waiting
+// for the display between steps. The steps are the same fixed length as usual and
+// the touches go to the same methods as they did at the time, so if everything is
+// deterministic the world will end up exactly as it did when the session was
+// recorded, which is checked with the hash of every step. This also makes a handy
+// benchmark, since the time taken for the whole session is logged.
+bool BasicRUBELayer::replayInput(const std::string& filename)
+{
+    RUBEInputRecording recording;
+    string errMsg;
+    if ( ! recording.load(filename, errMsg) ) {
+        CCLOG("%s", errMsg.c_str());
+        return false;
+    }
+    if ( recording.sceneFilename != getFilename() ) {
+        CCLOG("Input recording is for %s, not %s", recording.sceneFilename.c_str(), getFilename().c_str());
+        return false;
+    }
+    Size s = Director::getInstance()->getWinSize();
+    if ( s.width != recording.windowWidth || s.height != recording.windowHeight )
+        CCLOG("Input was recorded with a %.0fx%.0f window, the touches will not land in the same places", recording.windowWidth, recording.windowHeight);
+    
+    // start from the same view and random numbers as the recording did
+    setPosition( initialWorldOffset() );
+    setScale( initialWorldScale() );
+    srand(recording.randomSeed);
+    m_replayingInput = true;
+    loadWorld(this);
+    m_replayingInput = false;
+    if ( !m_world )
+        return false;
+    
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    
+    // The layers keep pointers to the touches they are following, so each touch
+    // needs to stay the same object from when it begins until it ends.
+    map<int, Touch*> activeTouches;
+    vector<Touch*> batch;
+    int e = 0;
+    int numEvents = (int)recording.events.size();
+    for (int step = 0; step < recording.stepCount; step++) {
+        while ( e < numEvents && recording.events[e].step <= step ) {
+            int batchIndex = recording.events[e].batch;
+            int phase = recording.events[e].phase;
+            batch.clear();
+            for ( ; e < numEvents && recording.events[e].batch == batchIndex; e++) {
+                const RUBEInputEvent& ev = recording.events[e];
+                Touch*& touch = activeTouches[ev.touchId];
+                if ( !touch )
+                    touch = new Touch();
+                touch->setTouchInfo(ev.touchId, ev.x, ev.y);
+                batch.push_back(touch);
+            }
+            dispatchTouches(phase, batch, NULL);
+            
+            if ( phase == IP_ENDED || phase == IP_CANCELLED ) {
+                for (int i = 0; i < (int)batch.size(); i++) {
+                    activeTouches.erase(batch[i]->getID());
+                    batch[i]->release();
+                }
+            }
+        }
+        update(1/60.0f);
+    }
+    
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    
+    bool same = m_worldHash && m_stepCount == recording.stepCount && m_worldHash->getRunningHash() == recording.runningHash;
+    
+    // touches still held when the recording stopped are let go, so the layer is not left holding them
+    batch.clear();
+    for (map<int, Touch*>::iterator it = activeTouches.begin(); it != activeTouches.end(); ++it)
+        batch.push_back(it->second);
+    if ( !batch.empty() )
+        dispatchTouches(IP_CANCELLED, batch, NULL);
+    for (int i = 0; i < (int)batch.size(); i++)
+        batch[i]->release();
+    
+    CCLOG("Replayed %d steps and %d touches in %.1f ms (%.3f ms per step), %s", m_stepCount, numEvents,
+          elapsed.count(), elapsed.count() / b2Max(m_stepCount, 1), same ? "same as recorded" : "DIFFERENT from recording");
+    return same;
+}
+
+
+// Override this in subclasses to return true, and a hash of the world will be logged
+// after every step. Two runs that log different hashes for the same step have gone
+// different ways, and getWorldHash can then be used to find out which bodies differ.
+// Bodies destroyed by anything other than RUBELayer::removeBodyFromWorld must be
+// taken out of the hash first, and this does not work together with tile streaming.
+bool BasicRUBELayer::hashEachStep()
+{
+    return false;
+}
+
+
+// Override this in subclasses to return true, and the world will be given a
+// Box2DContactEvents as its contact listener. Tag the fixtures of interest in
+// tagContactFixtures, and take the events out after calling this class' update.
+bool BasicRUBELayer::useContactEvents()
+{
+    return false;
+}
+
+
+// Override this in subclasses to return true, and the world will be stepped at the same
+// time as the worlds of other layers that do the same, on another core. Nothing called
+// by Box2D during the step can touch anything outside the world, so this is ignored
+// when the world has a contact listener or filter of your own instead of the ones set
+// up by this class (use Box2DContactEvents to find the contacts). Recording or replaying
+// the touches always steps the world in update instead.
+bool BasicRUBELayer::stepInParallel()
+{
+    return false;
+}
+
+
+// True when the contact listener and filter of the world are the ones set up in
+// loadWorld (or the Box2D defaults), which don't touch anything outside the world
+// while it is being stepped. Checked after afterLoadProcessing, so a subclass
+// that installs its own there will have its world stepped in update.
+bool BasicRUBELayer::contactCallbacksAreThreadSafe()
+{
+    const b2ContactManager& contactManager = m_world->GetContactManager();
+    
+    b2ContactListener* listener = contactManager.m_contactListener;
+    if ( listener != &b2_defaultListener && (!m_contactEvents || listener != m_contactEvents) )
+        return false;
+    
+    b2ContactFilter* filter = contactManager.m_contactFilter;
+    if ( filter != &b2_defaultFilter && (!m_collisionMatrix || filter != m_collisionMatrix) )
+        return false;
+    
+    return true;
+}
+
+
+// Override this in subclasses to return true, and the dynamic and kinematic bodies far
+// from the view will be switched off until the view comes near them again. Bodies
+// destroyed by anything other than RUBELayer::removeBodyFromWorld must be taken out
+// of the manager first, and this does not work together with tile streaming or hot
+// reloading, which make and destroy bodies on their own.
+bool BasicRUBELayer::manageBodyActivation()
+{
+    return false;
+}
+
+
+// The bodies and joints are hashed in the order of the scene file, which is the same
+// every time the scene is loaded. The mouse joint ground body is not in the file, so
+// it goes at the end (it never moves anyway).
+void BasicRUBELayer::setWorldHashOrder(b2dJson* json)
+{
+    vector<b2Body*> bodies;
+    vector<b2Joint*> joints;
+    json->getAllBodiesInFileOrder(bodies);
+    json->getAllJointsInCreationOrder(joints);
+    m_worldHash->setOrder(bodies, joints);
+    m_worldHash->addBody(m_mouseJointGroundBody);
+}
+
+
+// The number of solver iterations is changed from step to step to keep the time taken
+// by each step inside a budget. The limits and the budget can be set for each scene
+// with custom properties of the world (the defaults are used for any not given):
+//   int minVelocityIterations (4), maxVelocityIterations (8)
+//   int minPositionIterations (2), maxPositionIterations (3)
+//   float physicsBudgetMs (4)
+// When the steps need to come out the same every time (for hashing or recording the
+// touches) the timing can't be allowed to affect them, so the maximums are always used.
+void BasicRUBELayer::setupIterationController(b2dJson* json)
+{
+    if ( !m_iterationController )
+        m_iterationController = new Box2DIterationController();
+    m_iterationController->setLimits( json->getCustomInt(m_world, "minVelocityIterations", 4),
+                                      json->getCustomInt(m_world, "maxVelocityIterations", 8),
+                                      json->getCustomInt(m_world, "minPositionIterations", 2),
+                                      json->getCustomInt(m_world, "maxPositionIterations", 3) );
+    m_iterationController->setBudget( json->getCustomFloat(m_world, "physicsBudgetMs", 4) );
+    m_iterationController->setAdaptive( !(hashEachStep() || m_inputRecording || m_replayingInput) );
+}
+
+
+// The settings for switching off bodies far from the view can be given for each scene
+// with custom properties of the world (the defaults are used for any not given):
+//   float activationMargin (5), activationCellSize (10)
+//   int activationBudget (50)
+void BasicRUBELayer::setupActivationManager(b2dJson* json)
+{
+    if ( !manageBodyActivation() )
+        return;
+    if ( m_tileStreamer || m_hotReload ) {
+        CCLOG("Body activation is not managed together with tile streaming or hot reloading");
+        return;
+    }
+    m_activationManager = new Box2DActivationManager();
+    m_activationManager->setMargin( json->getCustomFloat(m_world, "activationMargin", 5) );
+    m_activationManager->setCellSize( json->getCustomFloat(m_world, "activationCellSize", 10) );
+    m_activationManager->setWorkBudget( json->getCustomInt(m_world, "activationBudget", 50) );
+}
+
+
+// Override this in subclasses to give the fixtures their contact event tags (eg. with
+// tagFixtures). It is called after afterLoadProcessing when useContactEvents returns
+// true, and again after each hot reload, when all the tags have been cleared first.
+void BasicRUBELayer::tagContactFixtures(b2dJson* json)
+{
+    
+}
+
+
+// Sets the contact event tags of all the fixtures in one go. A fixture with a custom
+// string property called "contactTag" is looked up by the value of that, otherwise
+// by its name in the scene. Fixtures that don't match any of the names are left as
+// they are. Use this in tagContactFixtures.
+int BasicRUBELayer::tagFixtures(b2dJson* json, const RUBEContactTag* tags, int count)
+{
+    if ( !m_contactEvents )
+        return 0;
+    
+    unordered_map<string, int> tagsByName;
+    for (int i = 0; i < count; i++)
+        tagsByName[tags[i].name] = tags[i].tag;
+    
+    int numTagged = 0;
+    for (b2Body* b = m_world->GetBodyList(); b; b = b->GetNext()) {
+        for (b2Fixture* f = b->GetFixtureList(); f; f = f->GetNext()) {
+            string name = json->getCustomString(f, "contactTag", "");
+            if ( name.empty() )
+                name = json->getFixtureName(f);
+            unordered_map<string, int>::iterator it = tagsByName.find(name);
+            if ( it != tagsByName.end() ) {
+                m_contactEvents->setTag(f, it->second);
+                numTagged++;
+            }
+        }
+    }
+    return numTagged;
+}
+
+
+// If the world has a custom string property called "collisionMatrix", the fixtures are
+// sorted into groups by their "collisionGroup" property and only the groups that the
+// matrix pairs up will collide. Pairs of fixtures that can't collide are never given a
+// contact by Box2D, which is much cheaper than ignoring them in a contact listener.
+void BasicRUBELayer::setupCollisionMatrix(b2dJson* json)
+{
+    if ( m_collisionMatrix ) {
+        m_collisionMatrix->uninstall(m_world);
+        delete m_collisionMatrix;
+        m_collisionMatrix = NULL;
+    }
+    
+    string errMsg;
+    m_collisionMatrix = new RUBECollisionMatrix();
+    if ( m_collisionMatrix->load(json, m_world, errMsg) )
+        CCLOG("Collision matrix has %d groups, using %s", m_collisionMatrix->getGroupCount(),
+              m_collisionMatrix->usesFilterBits() ? "filter bits" : "contact filter");
+    else {
+        if ( !errMsg.empty() )
+            CCLOG("%s", errMsg.c_str());
+        delete m_collisionMatrix;
+        m_collisionMatrix = NULL;
+    }
+}
+
+
+// Applies the scene file to the world again if it has changed since it was loaded.
+// If the file can't be parsed (eg. it was only partly written) the world is left as
+// it is, and the next change will be tried again.
+void BasicRUBELayer::checkForHotReload()
+{
+    if ( !m_fileWatcher || !m_fileWatcher->hasChanged() )
+        return;
+    
+    string fullpath = FileUtils::getInstance()->fullPathForFilename(getFilename().c_str());
+    
+    b2dJson json;
+    b2dJsonReloadInfo info;
+    std::string errMsg;
+    b2dJsonFileView file;
+    if ( ! file.open(fullpath, errMsg) || ! m_hotReload->reload(m_world, file.data(), file.size(), json, info, errMsg) ) {
+        CCLOG("Hot reload failed: %s", errMsg.c_str());
+        return;
+    }
+    file.close();
+    
+    forgetMouseJointIfDestroyed();
+    
+    // some bodies and joints may have been made again, so the order starts over
+    if ( m_worldHash )
+        setWorldHashOrder(&json);
+    
+    // the matrix or the groups of the fixtures may have been changed
+    setupCollisionMatrix(&json);
+    
+    // Changed bodies get new fixtures, and the tags of the old ones were forgotten
+    // when they were destroyed. Starting over also picks up any names that changed.
+    if ( m_contactEvents ) {
+        m_contactEvents->clearTags();
+        tagContactFixtures(&json);
+    }
+    
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    afterHotReload(&json, info);
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    
+    CCLOG("Hot reload took %.1f ms (world %.1f ms, layer %.1f ms)", info.milliseconds + elapsed.count(), info.milliseconds, elapsed.count());
+    CCLOG("  bodies: %d kept, %d updated, %d created, %d destroyed", info.bodiesKept, info.bodiesUpdated, info.bodiesCreated, info.bodiesDestroyed);
+    CCLOG("  joints: %d kept, %d created, %d destroyed", info.jointsKept, info.jointsCreated, info.jointsDestroyed);
+}
+
+
 // This method should undo anything that was done by the loadWorld and afterLoadProcessing
 // methods, and return to a state where loadWorld can safely be called again.
 void BasicRUBELayer::clear()
 {
+    if ( m_worldScheduled ) {
+        RUBEWorldScheduler::getInstance()->removeLayer(this);
+        m_worldScheduled = false;
+    }
+    
+    // stop the loader thread before the world goes away
+    if ( m_tileStreamer ) {
+        delete m_tileStreamer;
+        m_tileStreamer = NULL;
+    }
+    
+    if ( m_fileWatcher ) {
+        delete m_fileWatcher;
+        m_fileWatcher = NULL;
+    }
+    if ( m_hotReload ) {
+        delete m_hotReload;
+        m_hotReload = NULL;
+    }
+    
+    if ( m_replayRecorder ) {
+        CCLOG("Replay: %d frames, %.1f bytes per frame, %.3f ms per frame", m_replayRecorder->getFrameCount(),
+              m_replayRecorder->getBytesPerFrame(), m_replayRecorder->getMillisecondsPerFrame());
+        delete m_replayRecorder;
+        m_replayRecorder = NULL;
+    }
+    
+    if ( m_inputRecording ) {
+        m_inputRecording->stepCount = m_stepCount;
+        if ( m_worldHash )
+            m_inputRecording->runningHash = m_worldHash->getRunningHash();
+        string filename = getInputRecordingFilename();
+        string errMsg;
+        if ( m_inputRecording->save(filename, errMsg) )
+            CCLOG("Saved %d touches over %d steps to %s", (int)m_inputRecording->events.size(), m_stepCount, filename.c_str());
+        else
+            CCLOG("%s", errMsg.c_str());
+        delete m_inputRecording;
+        m_inputRecording = NULL;
+    }
+    
+    if ( m_worldHash ) {
+        CCLOG("Hash of all %d steps: %016llx", m_worldHash->getStepCount(), m_worldHash->getRunningHash());
+        delete m_worldHash;
+        m_worldHash = NULL;
+    }
+    
     if ( m_world ) {
+        if ( m_stepCount > 0 )
+            CCLOG("Contacts: %.1f per step on average, %d at most", m_contactCountTotal / (double)m_stepCount, m_contactCountPeak);
+        if ( m_iterationController && m_iterationController->getStepCount() > 0 )
+            CCLOG("Solver: %.1f velocity and %.1f position iterations on average, %d of %d steps over the %.1f ms budget",
+                  m_iterationController->getAverageVelocityIterations(), m_iterationController->getAveragePositionIterations(),
+                  m_iterationController->getOverrunCount(), m_iterationController->getStepCount(), m_iterationController->getBudget());
+        if ( m_activationManager )
+            CCLOG("Activation: %d of %d managed bodies active", m_activationManager->getActiveBodyCount(), m_activationManager->getManagedBodyCount());
         CCLOG("Deleting Box2D world");
         delete m_world;
     }
     
+    if ( m_collisionMatrix ) {
+        delete m_collisionMatrix;
+        m_collisionMatrix = NULL;
+    }
+    
+    if ( m_iterationController ) {
+        delete m_iterationController;
+        m_iterationController = NULL;
+    }
+    
+    if ( m_activationManager ) {
+        delete m_activationManager;
+        m_activationManager = NULL;
+    }
+    
+    if ( m_contactEvents ) {
+        delete m_contactEvents;
+        m_contactEvents = NULL;
+    }
+    
     if ( m_debugDraw )
         delete m_debugDraw;
     
     m_world = NULL;
     m_mouseJoint = NULL;
     m_mouseJointGroundBody = NULL;
+    m_mouseJointTouch = NULL;
+    m_stepCount = 0;
+    m_inputBatch = 0;
+    m_contactCountTotal = 0;
+    m_contactCountPeak = 0;
 }
 
 
-// Standard Cocos2d method, just step the physics world with fixed time step length
+// Standard Cocos2d method, just step the physics world with fixed time step length.
+// When the world is stepped by the RUBEWorldScheduler this has already been done
+// by the time the layer is updated.
 void BasicRUBELayer::update(float dt)
 {
-    if ( m_world )
-        m_world->Step(1/60.0, 8, 3);
+    if ( m_world && !m_worldScheduled ) {
+        RUBE_PROFILE_SCOPE(PS_PHYSICS);
+        beforeStep();
+        stepWorld();
+        afterStep();
+    }
+    
+#if RUBE_FRAME_PROFILER
+    // twice a second is often enough to read it
+    if ( m_profilerLabel && ++m_profilerLabelFrames >= 30 ) {
+        m_profilerLabel->setString( RUBEFrameProfiler::getInstance()->getSummary() );
+        m_profilerLabelFrames = 0;
+    }
+#endif
+}
+
+
+// Everything that has to be done to the world before it is stepped
+void BasicRUBELayer::beforeStep()
+{
+    checkForHotReload();
+    updateTileStreaming();
+    if ( m_activationManager )
+        m_activationManager->update( getVisibleRegion() );
+}
+
+
+// This is the only part that can be called from another thread (see RUBEWorldScheduler.h)
+void BasicRUBELayer::stepWorld()
+{
+    RUBE_PROFILE_SCOPE(PS_STEP);
+    m_iterationController->step(m_world, 1/60.0);
+    RUBE_PROFILE_WORLD_STEP(m_world);
+}
+
+
+// Everything that looks at the world after it has been stepped
+void BasicRUBELayer::afterStep()
+{
+    m_stepCount++;
+    m_contactCountTotal += m_world->GetContactCount();
+    m_contactCountPeak = b2Max(m_contactCountPeak, m_world->GetContactCount());
+    if ( m_replayRecorder )
+        m_replayRecorder->recordFrame(m_world);
+    if ( m_worldHash ) {
+        b2WorldHashValue hash = m_worldHash->step();
+        if ( hashEachStep() )
+            CCLOG("Step %d hash %016llx", m_worldHash->getStepCount(), hash);
+    }
+    if ( m_contactEvents ) {
+        int dropped = m_contactEvents->takeDroppedCount();
+        if ( dropped > 0 )
+            CCLOG("Contact event queue is full, %d events were dropped", dropped);
+    }
+}
+
+
+// Works out the visible part of the world from the layer position and scale, by
+// converting the corners of the screen.
+b2AABB BasicRUBELayer::getVisibleRegion()
+{
+    Size s = Director::getInstance()->getWinSize();
+    b2Vec2 corner1 = screenToWorld( Point::Point(0,0) );
+    b2Vec2 corner2 = screenToWorld( Point::Point(s.width,s.height) );
+    b2AABB visibleRegion;
+    visibleRegion.lowerBound = b2Min(corner1, corner2);
+    visibleRegion.upperBound = b2Max(corner1, corner2);
+    return visibleRegion;
+}
+
+
+// Lets the tile streamer know which part of the world is on screen. This must not
+// be done during the world step, because tiles that have gone out of view will
+// have their bodies destroyed here.
+void BasicRUBELayer::updateTileStreaming()
+{
+    if ( !m_tileStreamer )
+        return;
+    
+    if ( m_tileStreamer->update( getVisibleRegion() ) > 0 )
+        forgetMouseJointIfDestroyed();
+}
+
+
+// The mouse joint is destroyed along with the body it was dragging, and the
+// only way to find out is to look for it in the world.
+void BasicRUBELayer::forgetMouseJointIfDestroyed()
+{
+    if ( !m_mouseJoint )
+        return;
+    
+    b2Joint* j = m_world->GetJointList();
+    while ( j && j != m_mouseJoint )
+        j = j->GetNext();
+    if ( !j ) {
+        m_mouseJoint = NULL;
+        m_mouseJointTouch = NULL;
+    }
 }
 
 
@@ -249,6 +996,8 @@ void BasicRUBELayer::draw()
 {
     if ( !m_world )
         return;
+    
+    RUBE_PROFILE_SCOPE(PS_DRAW);
  
     // debug draw display will be on top of anything else
     Layer::draw();
@@ -342,6 +1091,62 @@ void BasicRUBELayer::onTouchesBegan(const std::vector<Touch*>& touches, Event* e
 }
 
 
+// Called by the touch listener. The touches are recorded first if recordInput is
+// true, and then go to the usual touch methods.
+void BasicRUBELayer::touchesBegan(const std::vector<Touch*>& touches, Event* event)
+{
+    recordTouches(IP_BEGAN, touches);
+    onTouchesBegan(touches, event);
+}
+
+void BasicRUBELayer::touchesMoved(const std::vector<Touch*>& touches, Event* event)
+{
+    recordTouches(IP_MOVED, touches);
+    onTouchesMoved(touches, event);
+}
+
+void BasicRUBELayer::touchesEnded(const std::vector<Touch*>& touches, Event* event)
+{
+    recordTouches(IP_ENDED, touches);
+    onTouchesEnded(touches, event);
+}
+
+void BasicRUBELayer::touchesCancelled(const std::vector<Touch*>& touches, Event* event)
+{
+    recordTouches(IP_CANCELLED, touches);
+    onTouchesCancelled(touches, event);
+}
+
+void BasicRUBELayer::recordTouches(int phase, const std::vector<Touch*>& touches)
+{
+    if ( !m_inputRecording || !m_world )
+        return;
+    
+    for (int i = 0; i < (int)touches.size(); i++) {
+        Point pos = touches[i]->getLocationInView();
+        RUBEInputEvent e;
+        e.step = m_stepCount;
+        e.batch = m_inputBatch;
+        e.phase = phase;
+        e.touchId = touches[i]->getID();
+        e.x = pos.x;
+        e.y = pos.y;
+        m_inputRecording->events.push_back(e);
+    }
+    m_inputBatch++;
+}
+
+void BasicRUBELayer::dispatchTouches(int phase, const std::vector<Touch*>& touches, Event* event)
+{
+    switch ( phase ) {
+    case IP_BEGAN:      onTouchesBegan(touches, event); break;
+    case IP_MOVED:      onTouchesMoved(touches, event); break;
+    case IP_ENDED:      onTouchesEnded(touches, event); break;
+    case IP_CANCELLED:  onTouchesCancelled(touches, event); break;
+    }
+}
+
+
 // Standard Cocos2d method
 void BasicRUBELayer::onTouchesMoved(const std::vector<Touch*>& touches, Event* event)
 {
@@ -34,13 +34,32 @@
 #include "cocos2d.h"
 #include <Box2D/Box2D.h>
 #include "Box2DDebugDraw.h"
+#include "RUBEFrameProfiler.h"
+#include "rubestuff/b2dJsonTiles.h"
 
 #ifndef BASIC_RUBE_LAYER
 #define BASIC_RUBE_LAYER
 
 class b2dJson;
+class b2dJsonHotReload;
+class b2dJsonFileWatcher;
+struct b2dJsonReloadInfo;
+class Box2DReplayRecorder;
+class Box2DWorldHash;
+class RUBEInputRecording;
+class Box2DContactEvents;
+class RUBECollisionMatrix;
+class Box2DIterationController;
+class Box2DActivationManager;
 
-class BasicRUBELayer : public cocos2d::Layer
+// A fixture name (or "contactTag" custom property value) and the tag that
+// fixtures with it are given, for BasicRUBELayer::tagFixtures
+struct RUBEContactTag {
+    const char* name;
+    int tag;
+};
+
+class BasicRUBELayer : public cocos2d::Layer, public b2dJsonTileListener
 {
 protected:
     b2World* m_world;                       // the physics world
@@ -48,8 +67,28 @@ protected:
     b2MouseJoint* m_mouseJoint;             // used when dragging bodies around
     b2Body* m_mouseJointGroundBody;         // the other body for the mouse joint (static, no fixtures)
     cocos2d::Touch* m_mouseJointTouch;    // keep track of which touch started the mouse joint
+    b2dJsonTileStreamer* m_tileStreamer;    // adds and removes parts of a large level around the view, NULL if not used
+    b2dJsonHotReload* m_hotReload;          // remembers the loaded scene to compare with when the file changes, NULL if not used
+    b2dJsonFileWatcher* m_fileWatcher;      // tells when the scene file has been exported again
+    Box2DReplayRecorder* m_replayRecorder;  // records how the bodies move for replays, NULL if not used
+    Box2DWorldHash* m_worldHash;            // hashes the world after each step to compare runs, NULL if not used
+    int m_stepCount;                        // steps since the world was loaded
+    RUBEInputRecording* m_inputRecording;   // the touches so far, NULL if not recording them
+    int m_inputBatch;                       // counts the calls from the touch listener, to group the recorded touches
+    bool m_replayingInput;                  // true while replayInput is loading the world
+    Box2DContactEvents* m_contactEvents;    // what touched what during the step, NULL if not used
+    RUBECollisionMatrix* m_collisionMatrix; // which groups of fixtures collide, NULL if the scene does not have one
+    long long m_contactCountTotal;          // the contacts in the world added up over every step, to log the average
+    int m_contactCountPeak;
+    Box2DIterationController* m_iterationController;   // chooses the solver iterations for each step
+    Box2DActivationManager* m_activationManager;        // switches off the bodies far from the view, NULL if not used
+    bool m_worldScheduled;                              // true if the RUBEWorldScheduler steps the world instead of update
 
     cocos2d::Menu* m_menuLayer;           // only for this demo project, you can remove this in your own app
+#if RUBE_FRAME_PROFILER
+    cocos2d::LabelTTF* m_profilerLabel;     // shows the timings of the last several seconds, NULL until the Stats button is pressed
+    int m_profilerLabelFrames;              // frames since the label was last changed
+#endif
         
 public:
     BasicRUBELayer();
@@ -62,21 +101,64 @@ public:
     virtual cocos2d::Layer* setupMenuLayer();                 // only for this demo project, you can remove this in your own app
     void goBack(Object* sender);                                              // only for this demo project, you can remove this in your own app
     void updateAfterOrientationChange();                        // only for this demo project (repositions the menu), you can remove this in your own app
+    void replayRecordedInput(Object* sender);                   // saves the touches so far and plays them back, for the menu when recordInput is true
+#if RUBE_FRAME_PROFILER
+    void toggleProfilerOverlay(Object* sender);                 // shows or hides the frame timings under the menu
+    void saveProfile(Object* sender);                           // writes the frame timings as CSV and Chrome trace files
+#endif
     
     virtual std::string getFilename();                          // override this in subclasses to specify which .json file to load
     virtual cocos2d::CCPoint initialWorldOffset();              // override this in subclasses to set the inital view position
     virtual float initialWorldScale();                          // override this in subclasses to set the initial view scale
+    virtual std::string getTileIndexFilename();                 // override this in subclasses to stream in the tiles of a large level (see b2dJsonTiles.h)
     
     virtual void loadWorld(Object* sender);                                   // attempts to load the world from the .json file given by getFilename
     virtual void afterLoadProcessing(b2dJson* json);            // override this in a subclass to do something else after loading the world (before discarding the JSON info)
+    virtual bool watchFileForChanges();                         // override this in subclasses to apply changes to the scene file while running, without reloading everything
+    virtual void afterHotReload(b2dJson* json, const b2dJsonReloadInfo& info); // override this in a subclass to refresh anything taken from the JSON info in afterLoadProcessing
+    void setWorldHashOrder(b2dJson* json);                      // hashes the bodies and joints in the order of the scene file
+    void setupCollisionMatrix(b2dJson* json);                   // sets the collision filters from the custom properties in the scene (see RUBECollisionMatrix.h)
+    RUBECollisionMatrix* getCollisionMatrix() { return m_collisionMatrix; }  // NULL if the scene does not have a collisionMatrix property
+    void setupIterationController(b2dJson* json);               // reads the solver iteration limits and time budget from the scene (see Box2DIterationController.h)
+    Box2DIterationController* getIterationController() { return m_iterationController; }
+    virtual bool manageBodyActivation();                        // override this in subclasses to switch off the bodies far from the view (see Box2DActivationManager.h)
+    void setupActivationManager(b2dJson* json);                 // reads the margin, cell size and work budget from the scene
+    Box2DActivationManager* getActivationManager() { return m_activationManager; }  // NULL if manageBodyActivation is false
+    virtual bool stepInParallel();                              // override this in subclasses to step the world on another core, together with other layers (see RUBEWorldScheduler.h)
+    bool contactCallbacksAreThreadSafe();                       // false if the world has a contact listener or filter that was not set up by this class
+    void checkForHotReload();                                   // called every frame to apply changes to the scene file if watchFileForChanges is true
+    virtual bool recordReplay();                                // override this in subclasses to record the movement of the bodies (see Box2DReplay.h)
+    Box2DReplayRecorder* getReplayRecorder() { return m_replayRecorder; }  // the recording so far, NULL if recordReplay is false
+    virtual bool hashEachStep();                                // override this in subclasses to log a hash of the world after every step (see Box2DWorldHash.h)
+    Box2DWorldHash* getWorldHash() { return m_worldHash; }      // NULL if hashEachStep and recordInput are false
+    virtual bool recordInput();                                 // override this in subclasses to record the touches, for replayInput to play them again later
+    virtual std::string getInputRecordingFilename();            // where the touches are saved when the layer is cleared
+    bool replayInput(const std::string& filename);              // reloads the world and runs through a recorded session as fast as possible, returns true if it came out the same
+    virtual bool useContactEvents();                            // override this in subclasses to record the contacts during each step (see Box2DContactEvents.h)
+    Box2DContactEvents* getContactEvents() { return m_contactEvents; }  // NULL if useContactEvents is false
+    virtual void tagContactFixtures(b2dJson* json);             // override this in subclasses to give fixtures their contact event tags, after loading and after each hot reload
+    int tagFixtures(b2dJson* json, const RUBEContactTag* tags, int count); // gives fixtures their contact event tags by name, returns how many were tagged
     virtual void clear();                                       // undoes everything done by loadWorld and afterLoadProcessing, so that they can be safely called again
 
     virtual b2Vec2 screenToWorld(cocos2d::Point screenPos);   // converts a position in screen pixels to a location in the physics world
     virtual cocos2d::Point worldToScreen(b2Vec2 worldPos);    // converts a location in the physics world to a position in screen pixels
 
     virtual void update(float dt);                              // standard Cocos2d layer method
+    void beforeStep();                                          // update calls these three in turn, unless the RUBEWorldScheduler
+    void stepWorld();                                           //     does it for all the layers at once
+    void afterStep();
+    virtual b2AABB getVisibleRegion();                          // the part of the physics world that is on screen
+    virtual void updateTileStreaming();                         // loads and unloads tiles around the visible part of the world
+    void forgetMouseJointIfDestroyed();                         // after bodies have been destroyed by something other than the touch methods
     virtual void draw();                                        // standard Cocos2d layer method
     
+    void touchesBegan(const std::vector<cocos2d::Touch*>& touches, cocos2d::Event* event);       // the touch listener calls these, to record the
+    void touchesMoved(const std::vector<cocos2d::Touch*>& touches, cocos2d::Event* event);       //     touches before passing them on to the
+    void touchesEnded(const std::vector<cocos2d::Touch*>& touches, cocos2d::Event* event);       //     methods below
+    void touchesCancelled(const std::vector<cocos2d::Touch*>& touches, cocos2d::Event* event);
+    void recordTouches(int phase, const std::vector<cocos2d::Touch*>& touches);
+    void dispatchTouches(int phase, const std::vector<cocos2d::Touch*>& touches, cocos2d::Event* event);
+    
     virtual void onTouchesBegan(const std::vector<cocos2d::Touch*>& touches, cocos2d::Event* event);
     virtual void onTouchesMoved(const std::vector<cocos2d::Touch*>& touches, cocos2d::Event* event);
     virtual void onTouchesEnded(const std::vector<cocos2d::Touch*>& touches, cocos2d::Event* event);
@@ -0,0 +1,317 @@
+//
+//  Box2DActivationManager
+//
+//  See header file for description.
+//
+
+#include <cmath>
+#include <algorithm>
+#include "Box2DActivationManager.h"
+
+using namespace std;
+
+static long long cellKey(int x, int y)
+{
+    return ((long long)x << 32) ^ (unsigned int)y;
+}
+
+static bool overlaps(const b2AABB& a, const b2AABB& b)
+{
+    return a.lowerBound.x <= b.upperBound.x && b.lowerBound.x <= a.upperBound.x &&
+           a.lowerBound.y <= b.upperBound.y && b.lowerBound.y <= a.upperBound.y;
+}
+
+static b2AABB expanded(const b2AABB& aabb, float margin)
+{
+    b2AABB result;
+    result.lowerBound = aabb.lowerBound - b2Vec2(margin, margin);
+    result.upperBound = aabb.upperBound + b2Vec2(margin, margin);
+    return result;
+}
+
+static int findRoot(vector<int>& parents, int i)
+{
+    while ( parents[i] != i ) {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+Box2DActivationManager::Box2DActivationManager()
+{
+    m_cellSize = 10;
+    m_margin = 5;
+    m_workBudget = 50;
+    m_nextActiveCheck = 0;
+    m_occupiedMinX = m_occupiedMinY = 0;
+    m_occupiedMaxX = m_occupiedMaxY = -1;
+    m_managedBodyCount = 0;
+    m_activeBodyCount = 0;
+}
+
+// Every body that is dynamic or kinematic and currently active is put in a
+// group with any others it is joined to. They all start out switched on, and
+// the first few updates switch off the ones out of view, a budget's worth at
+// a time.
+void Box2DActivationManager::build(b2World* world)
+{
+    m_groups.clear();
+    m_groupOfBody.clear();
+    m_cells.clear();
+    m_activeGroups.clear();
+    m_activationQueue.clear();
+    m_nextActiveCheck = 0;
+
+    vector<b2Body*> bodies;
+    unordered_map<b2Body*, int> indexOfBody;
+    for (b2Body* body = world->GetBodyList(); body; body = body->GetNext()) {
+        if ( body->GetType() == b2_staticBody || !body->IsActive() )
+            continue;
+        indexOfBody[body] = (int)bodies.size();
+        bodies.push_back(body);
+    }
+
+    vector<int> parents(bodies.size());
+    for (int i = 0; i < (int)parents.size(); i++)
+        parents[i] = i;
+    for (b2Joint* joint = world->GetJointList(); joint; joint = joint->GetNext()) {
+        unordered_map<b2Body*, int>::iterator itA = indexOfBody.find(joint->GetBodyA());
+        unordered_map<b2Body*, int>::iterator itB = indexOfBody.find(joint->GetBodyB());
+        if ( itA == indexOfBody.end() || itB == indexOfBody.end() )
+            continue; // joined to a static body, which is always there anyway
+        parents[findRoot(parents, itA->second)] = findRoot(parents, itB->second);
+    }
+
+    unordered_map<int, int> groupOfRoot;
+    for (int i = 0; i < (int)bodies.size(); i++) {
+        int root = findRoot(parents, i);
+        unordered_map<int, int>::iterator it = groupOfRoot.find(root);
+        int groupIndex;
+        if ( it == groupOfRoot.end() ) {
+            groupIndex = (int)m_groups.size();
+            groupOfRoot[root] = groupIndex;
+            Group group;
+            group.active = true;
+            group.queued = false;
+            group.activeIndex = (int)m_activeGroups.size();
+            m_groups.push_back(group);
+            m_activeGroups.push_back(groupIndex);
+        }
+        else
+            groupIndex = it->second;
+        m_groups[groupIndex].bodies.push_back(bodies[i]);
+        m_groupOfBody[bodies[i]] = groupIndex;
+    }
+
+    for (int i = 0; i < (int)m_groups.size(); i++)
+        computeBounds(m_groups[i]);
+
+    m_managedBodyCount = (int)bodies.size();
+    m_activeBodyCount = m_managedBodyCount;
+}
+
+void Box2DActivationManager::computeBounds(Group& group)
+{
+    bool first = true;
+    for (int i = 0; i < (int)group.bodies.size(); i++) {
+        b2Body* body = group.bodies[i];
+        const b2Transform& xf = body->GetTransform();
+        // the fixture AABBs are not kept up to date for inactive bodies, so work them out from the shapes
+        for (b2Fixture* fixture = body->GetFixtureList(); fixture; fixture = fixture->GetNext()) {
+            b2Shape* shape = fixture->GetShape();
+            for (int child = 0; child < shape->GetChildCount(); child++) {
+                b2AABB aabb;
+                shape->ComputeAABB(&aabb, xf, child);
+                if ( first )
+                    group.bounds = aabb;
+                else
+                    group.bounds.Combine(aabb);
+                first = false;
+            }
+        }
+        if ( !body->GetFixtureList() ) {
+            b2AABB aabb;
+            aabb.lowerBound = aabb.upperBound = body->GetPosition();
+            if ( first )
+                group.bounds = aabb;
+            else
+                group.bounds.Combine(aabb);
+            first = false;
+        }
+    }
+}
+
+void Box2DActivationManager::cellRange(const b2AABB& aabb, int& minX, int& minY, int& maxX, int& maxY) const
+{
+    minX = (int)floorf(aabb.lowerBound.x / m_cellSize);
+    minY = (int)floorf(aabb.lowerBound.y / m_cellSize);
+    maxX = (int)floorf(aabb.upperBound.x / m_cellSize);
+    maxY = (int)floorf(aabb.upperBound.y / m_cellSize);
+}
+
+void Box2DActivationManager::addToCells(int groupIndex)
+{
+    int minX, minY, maxX, maxY;
+    cellRange(m_groups[groupIndex].bounds, minX, minY, maxX, maxY);
+    // the occupied range only grows while there is anything in the grid, and starts again when it empties
+    if ( m_cells.empty() ) {
+        m_occupiedMinX = minX;
+        m_occupiedMinY = minY;
+        m_occupiedMaxX = maxX;
+        m_occupiedMaxY = maxY;
+    }
+    else {
+        m_occupiedMinX = b2Min(m_occupiedMinX, minX);
+        m_occupiedMinY = b2Min(m_occupiedMinY, minY);
+        m_occupiedMaxX = b2Max(m_occupiedMaxX, maxX);
+        m_occupiedMaxY = b2Max(m_occupiedMaxY, maxY);
+    }
+    for (int x = minX; x <= maxX; x++)
+        for (int y = minY; y <= maxY; y++)
+            m_cells[cellKey(x, y)].push_back(groupIndex);
+}
+
+void Box2DActivationManager::removeFromCells(int groupIndex)
+{
+    int minX, minY, maxX, maxY;
+    cellRange(m_groups[groupIndex].bounds, minX, minY, maxX, maxY);
+    for (int x = minX; x <= maxX; x++) {
+        for (int y = minY; y <= maxY; y++) {
+            unordered_map<long long, vector<int> >::iterator it = m_cells.find(cellKey(x, y));
+            if ( it == m_cells.end() )
+                continue;
+            vector<int>& cell = it->second;
+            cell.erase(std::remove(cell.begin(), cell.end(), groupIndex), cell.end());
+            if ( cell.empty() )
+                m_cells.erase(it);
+        }
+    }
+}
+
+void Box2DActivationManager::activate(int groupIndex)
+{
+    Group& group = m_groups[groupIndex];
+    removeFromCells(groupIndex);
+    for (int i = 0; i < (int)group.bodies.size(); i++)
+        group.bodies[i]->SetActive(true);
+    group.active = true;
+    group.queued = false;
+    group.activeIndex = (int)m_activeGroups.size();
+    m_activeGroups.push_back(groupIndex);
+    m_activeBodyCount += (int)group.bodies.size();
+}
+
+void Box2DActivationManager::deactivate(int groupIndex)
+{
+    Group& group = m_groups[groupIndex];
+    for (int i = 0; i < (int)group.bodies.size(); i++)
+        group.bodies[i]->SetActive(false);
+    group.active = false;
+    m_activeBodyCount -= (int)group.bodies.size();
+
+    int last = m_activeGroups.back();
+    m_activeGroups[group.activeIndex] = last;
+    m_groups[last].activeIndex = group.activeIndex;
+    m_activeGroups.pop_back();
+    group.activeIndex = -1;
+
+    addToCells(groupIndex);
+}
+
+void Box2DActivationManager::queueOverlapping(const vector<int>& cell, const b2AABB& nearView)
+{
+    for (int i = 0; i < (int)cell.size(); i++) {
+        Group& group = m_groups[cell[i]];
+        if ( !group.queued && overlaps(group.bounds, nearView) ) {
+            group.queued = true;
+            m_activationQueue.push_back(cell[i]);
+        }
+    }
+}
+
+void Box2DActivationManager::update(const b2AABB& view)
+{
+    b2AABB nearView = expanded(view, m_margin);
+    b2AABB farView = expanded(view, 2 * m_margin);
+    int bodiesLeft = m_workBudget;
+
+    // switched off groups can't move, so only the cells around the view can have any to switch on
+    if ( !m_cells.empty() ) {
+        // clamped as floats, so a view far bigger than the level can't overflow the cell numbers
+        int minX = (int)b2Clamp(floorf(nearView.lowerBound.x / m_cellSize), (float)m_occupiedMinX, (float)m_occupiedMaxX + 1);
+        int minY = (int)b2Clamp(floorf(nearView.lowerBound.y / m_cellSize), (float)m_occupiedMinY, (float)m_occupiedMaxY + 1);
+        int maxX = (int)b2Clamp(floorf(nearView.upperBound.x / m_cellSize), (float)m_occupiedMinX - 1, (float)m_occupiedMaxX);
+        int maxY = (int)b2Clamp(floorf(nearView.upperBound.y / m_cellSize), (float)m_occupiedMinY - 1, (float)m_occupiedMaxY);
+        long long cellsInView = (minX > maxX || minY > maxY) ? 0 : (long long)(maxX - minX + 1) * (maxY - minY + 1);
+        if ( cellsInView > (long long)m_cells.size() ) {
+            for (unordered_map<long long, vector<int> >::iterator it = m_cells.begin(); it != m_cells.end(); ++it)
+                queueOverlapping(it->second, nearView);
+        }
+        else if ( cellsInView > 0 ) {
+            for (int x = minX; x <= maxX; x++) {
+                for (int y = minY; y <= maxY; y++) {
+                    unordered_map<long long, vector<int> >::iterator it = m_cells.find(cellKey(x, y));
+                    if ( it != m_cells.end() )
+                        queueOverlapping(it->second, nearView);
+                }
+            }
+        }
+    }
+
+    // switching on comes first, since those are the ones about to be seen
+    int done = 0;
+    while ( done < (int)m_activationQueue.size() && bodiesLeft > 0 ) {
+        int groupIndex = m_activationQueue[done++];
+        bodiesLeft -= (int)m_groups[groupIndex].bodies.size();
+        activate(groupIndex);
+    }
+    m_activationQueue.erase(m_activationQueue.begin(), m_activationQueue.begin() + done);
+
+    // take turns checking the switched on groups for any that have gone too far away
+    int checks = b2Min(m_workBudget, (int)m_activeGroups.size());
+    for (int i = 0; i < checks && bodiesLeft > 0; i++) {
+        if ( m_nextActiveCheck >= (int)m_activeGroups.size() )
+            m_nextActiveCheck = 0;
+        int groupIndex = m_activeGroups[m_nextActiveCheck];
+        Group& group = m_groups[groupIndex];
+        computeBounds(group);
+        if ( !group.bodies.empty() && !overlaps(group.bounds, farView) ) {
+            bodiesLeft -= (int)group.bodies.size();
+            deactivate(groupIndex); // the last one is moved into this place, so it is checked next
+        }
+        else
+            m_nextActiveCheck++;
+    }
+}
+
+void Box2DActivationManager::removeBody(b2Body* body)
+{
+    unordered_map<b2Body*, int>::iterator it = m_groupOfBody.find(body);
+    if ( it == m_groupOfBody.end() )
+        return;
+    int groupIndex = it->second;
+    m_groupOfBody.erase(it);
+
+    Group& group = m_groups[groupIndex];
+    if ( !group.active )
+        removeFromCells(groupIndex);
+    group.bodies.erase(std::remove(group.bodies.begin(), group.bodies.end(), body), group.bodies.end());
+    m_managedBodyCount--;
+    if ( group.active )
+        m_activeBodyCount--;
+    else if ( !group.bodies.empty() ) {
+        computeBounds(group);
+        addToCells(groupIndex);
+    }
+    // an empty group is left where it is and never matches anything again
+}
+
+void Box2DActivationManager::activateAll()
+{
+    for (int i = 0; i < (int)m_groups.size(); i++) {
+        if ( !m_groups[i].active )
+            activate(i);
+    }
+    m_activationQueue.clear();
+}
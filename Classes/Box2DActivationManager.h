@@ -0,0 +1,99 @@
+//
+//  Box2DActivationManager
+//
+//  Switches off the bodies that are far away from the view, so that a big
+//  level costs about the same to step as the part of it on screen. Bodies
+//  that are not active are left out of the broadphase and the solver
+//  completely, and carry on from where they were when switched on again.
+//
+//  Only dynamic and kinematic bodies are managed. Static bodies cost very
+//  little and are often very large (eg. the ground of the whole level), so
+//  they are always left on. Bodies joined to each other are put in a group
+//  and switched on and off together, so a joint is never left with one of
+//  its bodies missing. Bodies that are already inactive when build is
+//  called (eg. prefab templates in RUBELayer) are not managed at all, and
+//  neither are bodies made after that.
+//
+//  Each update is given the visible part of the world:
+//   - groups with their fixtures inside the view plus the margin are
+//     switched on
+//   - groups that have gone further away than twice the margin are
+//     switched off
+//  In between, they are left as they were, so that a body near the
+//  edge does not flick on and off.
+//
+//  Groups that are switched off can't move, so they are kept in a grid of
+//  cells and only the cells around the view are looked at to find the ones
+//  to switch on. That search stops at the cells that have anything in them,
+//  and when the view covers more cells than that it goes through the
+//  occupied cells instead, so zooming far out does not cost more. Groups that are switched on may have moved, so some of them
+//  are checked on every update, taking turns. Changing a body's active state
+//  creates or destroys its broadphase proxies, which is not cheap, so the
+//  number of groups checked and the number of bodies switched on or off in
+//  one update are both limited by the work budget. Anything left over waits
+//  for the next update, which is fine as long as the margin is big enough
+//  to cover a few frames of movement.
+//
+//  Bodies destroyed by anything else must be taken out with removeBody
+//  first.
+//
+
+#ifndef BOX2DACTIVATIONMANAGER_H
+#define BOX2DACTIVATIONMANAGER_H
+
+#include <vector>
+#include <unordered_map>
+#include <Box2D/Box2D.h>
+
+class Box2DActivationManager
+{
+protected:
+    struct Group {
+        std::vector<b2Body*> bodies;
+        b2AABB bounds;                  // all the fixtures of all the bodies, as of the last check
+        bool active;
+        bool queued;                    // waiting to be switched on
+        int activeIndex;                // place in m_activeGroups while active
+    };
+
+    float m_cellSize;
+    float m_margin;
+    int m_workBudget;
+
+    std::vector<Group> m_groups;
+    std::unordered_map<b2Body*, int> m_groupOfBody;
+    std::unordered_map<long long, std::vector<int> > m_cells;  // the groups switched off, by the cells their bounds overlap
+    int m_occupiedMinX, m_occupiedMinY;                         // every cell in m_cells is inside these, so the search
+    int m_occupiedMaxX, m_occupiedMaxY;                         // around the view can stop at them when zoomed far out
+    std::vector<int> m_activeGroups;
+    int m_nextActiveCheck;                                      // round robin through m_activeGroups
+    std::vector<int> m_activationQueue;
+
+    int m_managedBodyCount;
+    int m_activeBodyCount;
+
+    void computeBounds(Group& group);
+    void activate(int groupIndex);
+    void deactivate(int groupIndex);
+    void addToCells(int groupIndex);
+    void removeFromCells(int groupIndex);
+    void cellRange(const b2AABB& aabb, int& minX, int& minY, int& maxX, int& maxY) const;
+    void queueOverlapping(const std::vector<int>& cell, const b2AABB& nearView);
+
+public:
+    Box2DActivationManager();
+
+    void setMargin(float margin) { m_margin = margin; }             // in physics units, around the view
+    void setCellSize(float cellSize) { m_cellSize = cellSize; }     // set this before build
+    void setWorkBudget(int budget) { m_workBudget = budget; }       // groups checked, and bodies switched, per update
+
+    void build(b2World* world);
+    void update(const b2AABB& view);
+    void removeBody(b2Body* body);
+    void activateAll();                                             // eg. before saving the world
+
+    int getManagedBodyCount() const { return m_managedBodyCount; }
+    int getActiveBodyCount() const { return m_activeBodyCount; }
+};
+
+#endif /* BOX2DACTIVATIONMANAGER_H */
@@ -0,0 +1,148 @@
+//
+//  Box2DBodyPool
+//
+//  See header file for description.
+//
+
+#include "Box2DBodyPool.h"
+#include <algorithm>
+
+using namespace std;
+
+Box2DBodyPool::Box2DBodyPool()
+{
+}
+
+Box2DBodyPool::~Box2DBodyPool()
+{
+    clear();
+}
+
+// The bodies belong to the world, and usually go with it
+void Box2DBodyPool::clear()
+{
+    for (map<string, Box2DPrefab*>::iterator it = m_prefabs.begin(); it != m_prefabs.end(); ++it)
+        delete it->second;
+    m_prefabs.clear();
+    m_spawnedBodyPrefabs.clear();
+}
+
+Box2DPrefab* Box2DBodyPool::registerPrefab(std::string name, b2Body* templateBody)
+{
+    Box2DPrefab*& prefab = m_prefabs[name];
+    if ( !prefab )
+        prefab = new Box2DPrefab;
+    prefab->name = name;
+    prefab->templateBody = templateBody;
+    prefab->hits = 0;
+    prefab->misses = 0;
+    templateBody->SetActive(false);
+    return prefab;
+}
+
+Box2DPrefab* Box2DBodyPool::getPrefab(const std::string& name)
+{
+    map<string, Box2DPrefab*>::iterator it = m_prefabs.find(name);
+    return it == m_prefabs.end() ? NULL : it->second;
+}
+
+Box2DPrefab* Box2DBodyPool::getPrefabOfBody(b2Body* body)
+{
+    map<b2Body*, Box2DPrefab*>::iterator it = m_spawnedBodyPrefabs.find(body);
+    return it == m_spawnedBodyPrefabs.end() ? NULL : it->second;
+}
+
+// Makes a copy of the template body with the same fixtures. The copy is inactive,
+// so it is not put into the broadphase until it is given its real position.
+b2Body* Box2DBodyPool::createCopy(b2Body* templateBody)
+{
+    b2Body* t = templateBody;
+    
+    b2BodyDef bd;
+    bd.type = t->GetType();
+    bd.position = t->GetPosition();
+    bd.angle = t->GetAngle();
+    bd.linearDamping = t->GetLinearDamping();
+    bd.angularDamping = t->GetAngularDamping();
+    bd.gravityScale = t->GetGravityScale();
+    bd.allowSleep = t->IsSleepingAllowed();
+    bd.fixedRotation = t->IsFixedRotation();
+    bd.bullet = t->IsBullet();
+    bd.userData = t->GetUserData();
+    bd.active = false;
+    b2Body* body = t->GetWorld()->CreateBody(&bd);
+    
+    for (b2Fixture* f = t->GetFixtureList(); f; f = f->GetNext()) {
+        b2FixtureDef fd;
+        fd.shape = f->GetShape(); // CreateFixture makes its own copy of the shape
+        fd.density = f->GetDensity();
+        fd.friction = f->GetFriction();
+        fd.restitution = f->GetRestitution();
+        fd.isSensor = f->IsSensor();
+        fd.filter = f->GetFilterData();
+        fd.userData = f->GetUserData();
+        body->CreateFixture(&fd);
+    }
+    
+    // the mass may have been set directly in RUBE instead of coming from the fixtures
+    if ( t->GetType() == b2_dynamicBody ) {
+        b2MassData massData;
+        t->GetMassData(&massData);
+        body->SetMassData(&massData);
+    }
+    
+    return body;
+}
+
+// Gives out a copy of the prefab at the given place and speed, reusing a parked one
+// if there is one. The transform is set while the body is still inactive, so it
+// only goes into the broadphase once, at the new position.
+b2Body* Box2DBodyPool::spawnBody(Box2DPrefab* prefab, b2Vec2 position, float angle, b2Vec2 velocity, float angularVelocity, bool* madeNewCopy)
+{
+    b2Body* body;
+    bool isNew = prefab->parkedBodies.empty();
+    if ( !isNew ) {
+        body = prefab->parkedBodies.back();
+        prefab->parkedBodies.pop_back();
+        prefab->hits++;
+    }
+    else {
+        body = createCopy(prefab->templateBody);
+        m_spawnedBodyPrefabs[body] = prefab;
+        prefab->misses++;
+    }
+    if ( madeNewCopy )
+        *madeNewCopy = isNew;
+    
+    body->SetTransform(position, angle);
+    body->SetLinearVelocity(velocity);
+    body->SetAngularVelocity(angularVelocity);
+    body->SetActive(true);
+    body->SetAwake(true);
+    
+    return body;
+}
+
+// Must not be called during the world step, as it changes the broadphase
+bool Box2DBodyPool::parkBody(b2Body* body)
+{
+    Box2DPrefab* prefab = getPrefabOfBody(body);
+    if ( !prefab )
+        return false;
+    
+    if ( body->IsActive() ) { //not already parked
+        body->SetActive(false);
+        prefab->parkedBodies.push_back(body);
+    }
+    return true;
+}
+
+void Box2DBodyPool::forgetBody(b2Body* body)
+{
+    map<b2Body*, Box2DPrefab*>::iterator it = m_spawnedBodyPrefabs.find(body);
+    if ( it == m_spawnedBodyPrefabs.end() )
+        return;
+    vector<b2Body*>& parked = it->second->parkedBodies;
+    parked.erase( std::remove(parked.begin(), parked.end(), body), parked.end() );
+    m_spawnedBodyPrefabs.erase(it);
+}
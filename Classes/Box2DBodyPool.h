@@ -0,0 +1,61 @@
+//
+//  Box2DBodyPool
+//
+//  Keeps copies of template bodies (prefabs) for reuse, eg. bullets or
+//  debris that are spawned and got rid of many times a minute. Copies
+//  that are no longer needed are parked rather than destroyed: made
+//  inactive, so they are not in the broadphase or the contact list, and
+//  given out again by the next spawn with a new transform and velocity.
+//  Only the body and its fixtures are copied, not joints.
+//
+//  This only deals with the physics. RUBELayer uses it for its prefabs
+//  and looks after their images itself, and rubebench drives it on its
+//  own to time the churn of bodies with and without parking them.
+//
+//  A template body is taken out of the simulation when it is registered
+//  and is only used to make copies. Spawned bodies (parked or not) that
+//  are destroyed by anything else must be taken out with forgetBody
+//  first.
+//
+
+#ifndef BOX2DBODYPOOL_H
+#define BOX2DBODYPOOL_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <Box2D/Box2D.h>
+
+struct Box2DPrefab {
+    std::string name;
+    b2Body* templateBody;                       // inactive, only used to make copies
+    std::vector<b2Body*> parkedBodies;          // copies not in use at the moment
+    int hits;                                   // spawns that reused a parked copy
+    int misses;                                 // spawns that had to make a new copy
+};
+
+class Box2DBodyPool
+{
+protected:
+    std::map<std::string, Box2DPrefab*> m_prefabs;          // by name
+    std::map<b2Body*, Box2DPrefab*> m_spawnedBodyPrefabs;   // which prefab each spawned body (in use or parked) is a copy of
+
+public:
+    Box2DBodyPool();
+    ~Box2DBodyPool();
+
+    void clear();                                           // forgets all the prefabs, without destroying any bodies
+
+    Box2DPrefab* registerPrefab(std::string name, b2Body* templateBody); // makes the body a template to spawn copies of
+    Box2DPrefab* getPrefab(const std::string& name);        // NULL if there is no such prefab
+    Box2DPrefab* getPrefabOfBody(b2Body* body);             // the prefab a spawned body is a copy of, or NULL for any other body
+    const std::map<std::string, Box2DPrefab*>& getPrefabs() const { return m_prefabs; }
+
+    b2Body* spawnBody(Box2DPrefab* prefab, b2Vec2 position, float angle, b2Vec2 velocity, float angularVelocity, bool* madeNewCopy = NULL);
+    bool parkBody(b2Body* body);                            // returns false if the body did not come from spawnBody
+    void forgetBody(b2Body* body);                          // call before destroying a spawned body some other way
+
+    static b2Body* createCopy(b2Body* templateBody);        // a new inactive body with the same settings and fixtures
+};
+
+#endif // BOX2DBODYPOOL_H
@@ -0,0 +1,113 @@
+//
+//  Box2DContactDispatcher
+//
+//  Calls a member function of the game for each contact event, chosen by
+//  looking up the event type and the two fixture tags in a table, instead
+//  of going through a chain of matchTags comparisons. The table is made
+//  once from a list of rules written in the code:
+//
+//      typedef Box2DContactDispatcher<MyLayer> MyDispatcher;
+//      static const MyDispatcher::Rule rules[] = {
+//          { CE_BEGIN, TAG_BALL, TAG_GUTTER, &MyLayer::ballHitGutter },
+//          { CE_END,   TAG_FOOT, CE_ANY_TAG, &MyLayer::footLeftGround },
+//      };
+//      static const MyDispatcher dispatcher(rules, sizeof(rules) / sizeof(rules[0]), TAG_MAX);
+//      dispatcher.dispatch(this, m_contactEvents);
+//
+//  The rules work both ways around, and the handler is always given the
+//  event with fixture A being the one with the first tag of the rule. A
+//  rule with CE_ANY_TAG as the second tag covers every other tag that is
+//  not given a rule of its own (including fixtures with no tag, which is
+//  tag zero). Events with no rule are just taken out and ignored.
+//
+//  The tags must be from zero up to (but not including) the tag count
+//  given to the constructor, so the table has one slot for every pair.
+//
+
+#ifndef BOX2DCONTACTDISPATCHER_H
+#define BOX2DCONTACTDISPATCHER_H
+
+#include <vector>
+#include "Box2DContactEvents.h"
+
+template <class T>
+class Box2DContactDispatcher
+{
+public:
+    typedef void (T::*Handler)(Box2DContactEvent& e);
+
+    struct Rule {
+        int type;               // one of _contactEventType
+        int tagA;
+        int tagB;               // or CE_ANY_TAG
+        Handler handler;
+    };
+
+protected:
+    struct Slot {
+        Handler handler;
+        bool swap;              // true if the event has the tags the other way around to the rule
+        bool wildcard;          // true if this was filled by a CE_ANY_TAG rule, so another rule can replace it
+    };
+
+    int m_tagCount;
+    std::vector<Slot> m_slots;  // type, then tag A, then tag B
+
+    Slot& slot(int type, int tagA, int tagB) { return m_slots[(type * m_tagCount + tagA) * m_tagCount + tagB]; }
+
+    void set(int type, int tagA, int tagB, Handler handler, bool swap, bool wildcard)
+    {
+        Slot& s = slot(type, tagA, tagB);
+        if ( s.handler && !s.wildcard && wildcard )
+            return;
+        s.handler = handler;
+        s.swap = swap;
+        s.wildcard = wildcard;
+    }
+
+public:
+    Box2DContactDispatcher(const Rule* rules, int ruleCount, int tagCount)
+    {
+        m_tagCount = tagCount;
+        Slot empty = { NULL, false, false };
+        m_slots.assign(3 * tagCount * tagCount, empty);
+        for (int i = 0; i < ruleCount; i++) {
+            const Rule& r = rules[i];
+            for (int tagB = 0; tagB < tagCount; tagB++) {
+                if ( r.tagB != CE_ANY_TAG && r.tagB != tagB )
+                    continue;
+                bool wildcard = r.tagB == CE_ANY_TAG;
+                set(r.type, r.tagA, tagB, r.handler, false, wildcard);
+                if ( tagB != r.tagA )
+                    set(r.type, tagB, r.tagA, r.handler, true, wildcard);
+            }
+        }
+    }
+
+    bool hasHandler(int type, int tagA, int tagB) const
+    {
+        return m_slots[(type * m_tagCount + tagA) * m_tagCount + tagB].handler != NULL;
+    }
+
+    // Takes every event out of the queue and calls the handler for it, if there is one.
+    // Returns the number of events that were handled.
+    int dispatch(T* target, Box2DContactEvents* events) const
+    {
+        int handled = 0;
+        Box2DContactEvent e;
+        while ( events->popEvent(e) ) {
+            if ( e.tagA < 0 || e.tagA >= m_tagCount || e.tagB < 0 || e.tagB >= m_tagCount )
+                continue;
+            const Slot& s = m_slots[(e.type * m_tagCount + e.tagA) * m_tagCount + e.tagB];
+            if ( !s.handler )
+                continue;
+            if ( s.swap )
+                e.swapFixtures();
+            (target->*(s.handler))(e);
+            handled++;
+        }
+        return handled;
+    }
+};
+
+#endif /* BOX2DCONTACTDISPATCHER_H */
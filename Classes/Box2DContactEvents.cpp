@@ -0,0 +1,155 @@
+//
+//  Box2DContactEvents
+//
+//  See header file for description.
+//
+
+#include "Box2DContactEvents.h"
+
+using namespace std;
+
+bool Box2DContactEvent::matchTags(int tag1, int tag2)
+{
+    if ( (tag1 == CE_ANY_TAG || tagA == tag1) && (tag2 == CE_ANY_TAG || tagB == tag2) )
+        return true;
+    if ( (tag1 == CE_ANY_TAG || tagB == tag1) && (tag2 == CE_ANY_TAG || tagA == tag2) ) {
+        swapFixtures();
+        return true;
+    }
+    return false;
+}
+
+void Box2DContactEvent::swapFixtures()
+{
+    b2Fixture* f = fixtureA; fixtureA = fixtureB; fixtureB = f;
+    void* ud = userDataA; userDataA = userDataB; userDataB = ud;
+    short t = tagA; tagA = tagB; tagB = t;
+    normal = -normal;
+}
+
+
+
+
+Box2DContactEvents::Box2DContactEvents(int capacity)
+{
+    unsigned int size = 16;
+    while ( size < (unsigned int)capacity )
+        size *= 2;
+    m_events.resize(size);
+    m_mask = size - 1;
+    m_head = 0;
+    m_tail = 0;
+    m_droppedCount = 0;
+    m_impactThreshold = 0;
+}
+
+void Box2DContactEvents::setTag(b2Fixture* fixture, int tag)
+{
+    if ( tag == 0 )
+        m_tags.erase(fixture);
+    else
+        m_tags[fixture] = tag;
+}
+
+void Box2DContactEvents::clearTags()
+{
+    m_tags.clear();
+}
+
+int Box2DContactEvents::getTagOrZero(b2Fixture* fixture) const
+{
+    unordered_map<b2Fixture*, int>::const_iterator it = m_tags.find(fixture);
+    return it == m_tags.end() ? 0 : it->second;
+}
+
+// Only the recording thread writes m_head, and only the reading thread writes
+// m_tail. Each one publishes its own index with a release store after it is
+// finished with the slot, and reads the other's with an acquire load, so a
+// slot is never written and read at the same time.
+void Box2DContactEvents::record(b2Contact* contact, int type, float approachSpeed, float impulse)
+{
+    b2Fixture* fA = contact->GetFixtureA();
+    b2Fixture* fB = contact->GetFixtureB();
+    int tagA = getTagOrZero(fA);
+    int tagB = getTagOrZero(fB);
+    if ( tagA == 0 && tagB == 0 )
+        return;
+
+    unsigned int head = m_head.load(memory_order_relaxed);
+    if ( head - m_tail.load(memory_order_acquire) > m_mask ) {
+        m_droppedCount++;
+        return;
+    }
+
+    Box2DContactEvent& e = m_events[head & m_mask];
+    e.fixtureA = fA;
+    e.fixtureB = fB;
+    e.userDataA = fA->GetUserData();
+    e.userDataB = fB->GetUserData();
+    e.tagA = (short)tagA;
+    e.tagB = (short)tagB;
+    e.type = type;
+    e.normal.SetZero();
+    e.approachSpeed = approachSpeed;
+    e.impulse = impulse;
+    if ( type != CE_END && contact->GetManifold()->pointCount > 0 ) {
+        b2WorldManifold worldManifold;
+        contact->GetWorldManifold(&worldManifold);
+        e.normal = worldManifold.normal;
+        if ( type == CE_BEGIN ) {
+            // the step has not solved anything yet, so these are the velocities they hit with
+            b2Vec2 p = worldManifold.points[0];
+            b2Vec2 vA = fA->GetBody()->GetLinearVelocityFromWorldPoint(p);
+            b2Vec2 vB = fB->GetBody()->GetLinearVelocityFromWorldPoint(p);
+            e.approachSpeed = b2Dot(vA - vB, worldManifold.normal);
+        }
+    }
+
+    m_head.store(head + 1, memory_order_release);
+}
+
+bool Box2DContactEvents::popEvent(Box2DContactEvent& e)
+{
+    unsigned int tail = m_tail.load(memory_order_relaxed);
+    if ( tail == m_head.load(memory_order_acquire) )
+        return false;
+    e = m_events[tail & m_mask];
+    m_tail.store(tail + 1, memory_order_release);
+    return true;
+}
+
+void Box2DContactEvents::discardEvents()
+{
+    m_tail.store(m_head.load(memory_order_acquire), memory_order_release);
+}
+
+int Box2DContactEvents::getPendingCount() const
+{
+    return (int)(m_head.load(memory_order_acquire) - m_tail.load(memory_order_acquire));
+}
+
+void Box2DContactEvents::BeginContact(b2Contact* contact)
+{
+    record(contact, CE_BEGIN, 0, 0);
+}
+
+void Box2DContactEvents::EndContact(b2Contact* contact)
+{
+    record(contact, CE_END, 0, 0);
+}
+
+void Box2DContactEvents::PostSolve(b2Contact* contact, const b2ContactImpulse* impulse)
+{
+    if ( m_impactThreshold <= 0 )
+        return;
+    float largest = 0;
+    for (int i = 0; i < impulse->count; i++)
+        largest = b2Max(largest, impulse->normalImpulses[i]);
+    if ( largest >= m_impactThreshold )
+        record(contact, CE_IMPACT, 0, largest);
+}
+
+void Box2DContactEvents::SayGoodbye(b2Fixture* fixture)
+{
+    m_tags.erase(fixture);
+}
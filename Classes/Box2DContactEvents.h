@@ -0,0 +1,111 @@
+//
+//  Box2DContactEvents
+//
+//  A contact listener that writes down what happened during the step,
+//  so the game can deal with it after the step has finished, when it is
+//  safe to change the world. This saves every game from having to make
+//  its own listener with flags and sets to pass things along (and the
+//  flags could only hold one thing each per step).
+//
+//  Give the fixtures you are interested in a tag with setTag. Contacts
+//  where at least one of the fixtures has a tag are recorded, everything
+//  else is ignored. After the step, take the events out with popEvent,
+//  and use matchTags to pick out the ones you want:
+//
+//      Box2DContactEvent e;
+//      while ( events->popEvent(e) ) {
+//          if ( e.type == CE_BEGIN && e.matchTags(TAG_BALL, TAG_GUTTER) )
+//              resetBall();
+//      }
+//
+//  The events are kept in a ring buffer that is allocated up front, so
+//  recording them never allocates. If the buffer fills up before it is
+//  emptied the newest events are dropped, and getDroppedCount says how
+//  many. One thread may record (the one that steps the world) while one
+//  other thread takes the events out, without any locking, so this also
+//  works when the physics runs on a thread of its own. The tags are only
+//  read while stepping, so they should be set between steps.
+//
+//  Each event holds a copy of the user data of both fixtures, as well as
+//  the fixture pointers. When bodies are destroyed, Box2D ends their
+//  contacts and a CE_END event is recorded, so by the time this is taken
+//  out the fixtures may be gone - only compare the fixture pointers of
+//  CE_END events, don't use them. The tags of destroyed fixtures are
+//  forgotten automatically if this is also the destruction listener of
+//  the world (b2World::DestroyFixture does not tell the listener, so use
+//  setTag(fixture, 0) before calling that).
+//
+
+#ifndef BOX2DCONTACTEVENTS_H
+#define BOX2DCONTACTEVENTS_H
+
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+#include <Box2D/Box2D.h>
+
+#define CE_ANY_TAG -1
+
+enum _contactEventType {
+    CE_BEGIN,               // the fixtures started touching
+    CE_END,                 // the fixtures stopped touching (or one of them was destroyed)
+    CE_IMPACT               // the fixtures pushed on each other harder than the impact threshold
+};
+
+struct Box2DContactEvent {
+    b2Fixture* fixtureA;
+    b2Fixture* fixtureB;
+    void* userDataA;        // the user data of the fixtures when the event was recorded
+    void* userDataB;
+    short tagA;
+    short tagB;
+    int type;               // one of _contactEventType
+    b2Vec2 normal;          // points from A to B, zero for sensors and CE_END
+    float approachSpeed;    // CE_BEGIN only: how fast A and B were moving toward each other along the normal
+    float impulse;          // CE_IMPACT only: the largest normal impulse of the step
+
+    // True if the tags are tag1 and tag2 in either order. If they are the other way
+    // around, A and B are swapped so that A is always the one with tag1.
+    bool matchTags(int tag1, int tag2);
+    void swapFixtures();    // swaps everything about A and B, and reverses the normal
+};
+
+class Box2DContactEvents : public b2ContactListener, public b2DestructionListener
+{
+protected:
+    std::vector<Box2DContactEvent> m_events;    // the ring, the size is a power of two
+    unsigned int m_mask;
+    std::atomic<unsigned int> m_head;           // where the next event will be written, only changed by the recording thread
+    std::atomic<unsigned int> m_tail;           // where the next event will be read, only changed by the reading thread
+    std::atomic<int> m_droppedCount;
+    std::unordered_map<b2Fixture*, int> m_tags;
+    float m_impactThreshold;                    // zero to not record any impacts
+
+    int getTagOrZero(b2Fixture* fixture) const;
+    void record(b2Contact* contact, int type, float approachSpeed, float impulse);
+
+public:
+    Box2DContactEvents(int capacity = 1024);
+
+    void setTag(b2Fixture* fixture, int tag);   // a tag of zero means the fixture is not interesting
+    int getTag(b2Fixture* fixture) const { return getTagOrZero(fixture); }
+    void clearTags();
+    void setImpactThreshold(float impulse) { m_impactThreshold = impulse; }
+
+    bool popEvent(Box2DContactEvent& e);        // false when there are no more events
+    void discardEvents();                       // only call this when nothing is recording
+    int getPendingCount() const;
+    int getDroppedCount() const { return m_droppedCount; }
+    int takeDroppedCount() { return m_droppedCount.exchange(0); }
+
+    // b2ContactListener
+    virtual void BeginContact(b2Contact* contact);
+    virtual void EndContact(b2Contact* contact);
+    virtual void PostSolve(b2Contact* contact, const b2ContactImpulse* impulse);
+
+    // b2DestructionListener
+    virtual void SayGoodbye(b2Joint* joint) {}
+    virtual void SayGoodbye(b2Fixture* fixture);
+};
+
+#endif /* BOX2DCONTACTEVENTS_H */
@@ -0,0 +1,117 @@
+//
+//  Box2DIterationController
+//
+//  See header file for description.
+//
+
+#include <chrono>
+#include "Box2DIterationController.h"
+
+static const float SMOOTHING = 0.1f;        // how much of each new step time goes into the average
+static const float HEADROOM = 0.8f;         // only add an iteration if the step would still be this far under budget
+static const int STEPS_BETWEEN_CHANGES = 10;
+
+Box2DIterationController::Box2DIterationController()
+{
+    m_budget = 4;
+    m_adaptive = true;
+    setLimits(4, 8, 2, 3);
+    resetTelemetry();
+}
+
+void Box2DIterationController::setLimits(int minVelocityIterations, int maxVelocityIterations, int minPositionIterations, int maxPositionIterations)
+{
+    m_minVelocityIterations = b2Max(1, minVelocityIterations);
+    m_maxVelocityIterations = b2Max(m_minVelocityIterations, maxVelocityIterations);
+    m_minPositionIterations = b2Max(1, minPositionIterations);
+    m_maxPositionIterations = b2Max(m_minPositionIterations, maxPositionIterations);
+
+    // start out as accurate as allowed, and cut back if that is too slow
+    m_velocityIterations = m_maxVelocityIterations;
+    m_positionIterations = m_maxPositionIterations;
+    m_stepsSinceChange = 0;
+}
+
+void Box2DIterationController::setBudget(float milliseconds)
+{
+    m_budget = milliseconds;
+}
+
+void Box2DIterationController::setAdaptive(bool adaptive)
+{
+    m_adaptive = adaptive;
+    if ( !adaptive ) {
+        m_velocityIterations = m_maxVelocityIterations;
+        m_positionIterations = m_maxPositionIterations;
+    }
+}
+
+float Box2DIterationController::step(b2World* world, float timeStep)
+{
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    world->Step(timeStep, m_velocityIterations, m_positionIterations);
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+
+    m_lastTime = elapsed.count();
+    m_averageTime = m_stepCount == 0 ? m_lastTime : m_averageTime + (m_lastTime - m_averageTime) * SMOOTHING;
+    m_stepCount++;
+    if ( m_lastTime > m_budget )
+        m_overrunCount++;
+    m_velocityIterationsTotal += m_velocityIterations;
+    m_positionIterationsTotal += m_positionIterations;
+
+    if ( m_adaptive )
+        adjust();
+    return m_lastTime;
+}
+
+// The whole step is assumed to take time in proportion to the total number of
+// iterations. It doesn't really (finding the contacts takes the same time either
+// way), but that only makes this more careful about adding iterations.
+void Box2DIterationController::adjust()
+{
+    if ( ++m_stepsSinceChange < STEPS_BETWEEN_CHANGES )
+        return;
+
+    int iterations = m_velocityIterations + m_positionIterations;
+    if ( m_averageTime > m_budget ) {
+        if ( m_positionIterations > m_minPositionIterations )
+            m_positionIterations--;
+        else if ( m_velocityIterations > m_minVelocityIterations )
+            m_velocityIterations--;
+        else
+            return;
+    }
+    else if ( m_averageTime * (iterations + 1) / iterations < m_budget * HEADROOM ) {
+        if ( m_velocityIterations < m_maxVelocityIterations )
+            m_velocityIterations++;
+        else if ( m_positionIterations < m_maxPositionIterations )
+            m_positionIterations++;
+        else
+            return;
+    }
+    else
+        return;
+
+    m_stepsSinceChange = 0;
+}
+
+float Box2DIterationController::getAverageVelocityIterations() const
+{
+    return m_stepCount ? (float)(m_velocityIterationsTotal / m_stepCount) : 0;
+}
+
+float Box2DIterationController::getAveragePositionIterations() const
+{
+    return m_stepCount ? (float)(m_positionIterationsTotal / m_stepCount) : 0;
+}
+
+void Box2DIterationController::resetTelemetry()
+{
+    m_lastTime = 0;
+    m_averageTime = 0;
+    m_stepCount = 0;
+    m_overrunCount = 0;
+    m_velocityIterationsTotal = 0;
+    m_positionIterationsTotal = 0;
+}
@@ -0,0 +1,73 @@
+//
+//  Box2DIterationController
+//
+//  Steps the world with as many velocity and position iterations as fit
+//  in a time budget for each step. More iterations make joints and stacks
+//  of bodies more accurate, but the solver time goes up with them, so a
+//  busy scene on a slow device can use fewer to keep the frame rate up.
+//
+//  The time of each step is measured and smoothed over the last several
+//  steps. When it is over the budget, iterations are taken away one at a
+//  time, position iterations first since they matter less. When there is
+//  plenty of room under the budget they are given back, velocity first.
+//  The counts always stay inside the limits given with setLimits, and
+//  after each change there is a pause so the smoothed time can catch up.
+//
+//  With setAdaptive(false) the maximum counts are always used, which is
+//  needed when the steps must come out the same every time (eg. recording
+//  touches to replay them) because the timing never repeats exactly.
+//
+//  The counts chosen and the number of steps that went over the budget
+//  are kept, to see how a scene is doing.
+//
+
+#ifndef BOX2DITERATIONCONTROLLER_H
+#define BOX2DITERATIONCONTROLLER_H
+
+#include <Box2D/Box2D.h>
+
+class Box2DIterationController
+{
+protected:
+    int m_minVelocityIterations;
+    int m_maxVelocityIterations;
+    int m_minPositionIterations;
+    int m_maxPositionIterations;
+    float m_budget;                     // milliseconds for each step
+    bool m_adaptive;
+
+    int m_velocityIterations;           // what the next step will use
+    int m_positionIterations;
+    float m_lastTime;                   // milliseconds taken by the last step
+    float m_averageTime;                // smoothed over the last several steps
+    int m_stepsSinceChange;
+
+    int m_stepCount;
+    int m_overrunCount;                 // steps that took longer than the budget
+    double m_velocityIterationsTotal;   // for the averages
+    double m_positionIterationsTotal;
+
+    void adjust();
+
+public:
+    Box2DIterationController();
+
+    void setLimits(int minVelocityIterations, int maxVelocityIterations, int minPositionIterations, int maxPositionIterations);
+    void setBudget(float milliseconds);
+    void setAdaptive(bool adaptive);
+
+    float step(b2World* world, float timeStep);    // returns the time taken in milliseconds
+
+    int getVelocityIterations() const { return m_velocityIterations; }
+    int getPositionIterations() const { return m_positionIterations; }
+    float getBudget() const { return m_budget; }
+    float getLastTime() const { return m_lastTime; }
+    float getAverageTime() const { return m_averageTime; }
+    int getStepCount() const { return m_stepCount; }
+    int getOverrunCount() const { return m_overrunCount; }
+    float getAverageVelocityIterations() const;
+    float getAveragePositionIterations() const;
+    void resetTelemetry();
+};
+
+#endif /* BOX2DITERATIONCONTROLLER_H */
@@ -0,0 +1,232 @@
+//
+//  Box2DKinematicAnimator
+//
+//  See header file for description.
+//
+
+#include <cmath>
+#include "Box2DKinematicAnimator.h"
+
+using namespace std;
+
+void Box2DKinematicAnimator::makeKinematic(b2Body* body)
+{
+    if ( body->GetType() == b2_staticBody )
+        body->SetType(b2_kinematicBody);
+}
+
+// The velocity that gets the body from where it is now to the target in one step.
+// Returns whether the body is active, to be passed back in as wasActive next time.
+bool Box2DKinematicAnimator::moveTowards(b2Body* body, float targetX, float targetY, float timeStep, bool wasActive)
+{
+    if ( !body->IsActive() ) {
+        // so that it doesn't set off with an old velocity if it is switched on before the next step
+        if ( wasActive ) {
+            body->SetLinearVelocity( b2Vec2(0,0) );
+            body->SetAngularVelocity( 0 );
+        }
+        return false;
+    }
+    if ( !wasActive ) {
+        // the target has moved on without it, so it jumps there instead of rushing to catch up
+        body->SetTransform( b2Vec2(targetX, targetY), body->GetAngle() );
+        body->SetLinearVelocity( b2Vec2(0,0) );
+        body->SetAngularVelocity( 0 );
+        return true;
+    }
+    b2Vec2 pos = body->GetPosition();
+    body->SetLinearVelocity( b2Vec2( (targetX - pos.x) / timeStep, (targetY - pos.y) / timeStep ) );
+    body->SetAngularVelocity( 0 );
+    return true;
+}
+
+void Box2DKinematicAnimator::addOscillator(b2Body* body, b2Vec2 center, float speedH, float speedV, float width, float height, float phaseH, float phaseV)
+{
+    makeKinematic(body);
+    m_oscBodies.push_back(body);
+    m_oscCenterX.push_back(center.x);
+    m_oscCenterY.push_back(center.y);
+    m_oscPhaseH.push_back(phaseH);
+    m_oscPhaseV.push_back(phaseV);
+    m_oscSpeedH.push_back(speedH);
+    m_oscSpeedV.push_back(speedV);
+    m_oscWidth.push_back(width);
+    m_oscHeight.push_back(height);
+    m_oscTargetX.push_back(center.x);
+    m_oscTargetY.push_back(center.y);
+    m_oscWasActive.push_back(body->IsActive());
+}
+
+// The path goes from the last point back to the first. Returns false if there
+// are not enough points to go anywhere.
+bool Box2DKinematicAnimator::addPath(b2Body* body, const b2Vec2* points, int pointCount, float speed, float startDistance)
+{
+    if ( pointCount < 2 )
+        return false;
+
+    float length = 0;
+    for (int i = 0; i < pointCount; i++)
+        length += b2Distance( points[i], points[(i + 1) % pointCount] );
+    if ( length <= 0 )
+        return false;
+
+    makeKinematic(body);
+    m_pathBodies.push_back(body);
+    m_pathFirstPoint.push_back((int)m_pointX.size());
+    m_pathPointCount.push_back(pointCount);
+    m_pathSpeed.push_back(speed);
+    m_pathLength.push_back(length);
+    m_pathDistance.push_back( fmodf(startDistance, length) );
+    m_pathSegment.push_back(0);
+    m_pathWasActive.push_back(body->IsActive());
+
+    float distance = 0;
+    for (int i = 0; i < pointCount; i++) {
+        m_pointX.push_back(points[i].x);
+        m_pointY.push_back(points[i].y);
+        m_pointDistance.push_back(distance);
+        distance += b2Distance( points[i], points[(i + 1) % pointCount] );
+    }
+    return true;
+}
+
+void Box2DKinematicAnimator::step(float timeStep)
+{
+    // all the oscillator targets first, with nothing in the loop but arithmetic on the arrays
+    int count = (int)m_oscBodies.size();
+    float* phaseH = count ? &m_oscPhaseH[0] : NULL;
+    float* phaseV = count ? &m_oscPhaseV[0] : NULL;
+    const float* speedH = count ? &m_oscSpeedH[0] : NULL;
+    const float* speedV = count ? &m_oscSpeedV[0] : NULL;
+    const float* centerX = count ? &m_oscCenterX[0] : NULL;
+    const float* centerY = count ? &m_oscCenterY[0] : NULL;
+    const float* width = count ? &m_oscWidth[0] : NULL;
+    const float* height = count ? &m_oscHeight[0] : NULL;
+    float* targetX = count ? &m_oscTargetX[0] : NULL;
+    float* targetY = count ? &m_oscTargetY[0] : NULL;
+    for (int i = 0; i < count; i++) {
+        phaseH[i] += speedH[i];
+        phaseV[i] += speedV[i];
+        targetX[i] = centerX[i] + width[i] * sinf(phaseH[i]);
+        targetY[i] = centerY[i] + height[i] * sinf(phaseV[i]);
+    }
+    for (int i = 0; i < count; i++)
+        m_oscWasActive[i] = moveTowards(m_oscBodies[i], targetX[i], targetY[i], timeStep, m_oscWasActive[i]);
+
+    for (int i = 0; i < (int)m_pathBodies.size(); i++) {
+        float length = m_pathLength[i];
+        float distance = fmodf(m_pathDistance[i] + m_pathSpeed[i] * timeStep, length);
+        if ( distance < 0 )
+            distance += length;
+        m_pathDistance[i] = distance;
+
+        // find the segment the distance is on, starting from the one it was on last time
+        int first = m_pathFirstPoint[i];
+        int n = m_pathPointCount[i];
+        int segment = m_pathSegment[i];
+        for (int tries = 0; tries < n; tries++) {
+            float segmentEnd = segment + 1 < n ? m_pointDistance[first + segment + 1] : length;
+            if ( distance >= m_pointDistance[first + segment] && distance < segmentEnd )
+                break;
+            segment = m_pathSpeed[i] >= 0 ? (segment + 1) % n : (segment + n - 1) % n;
+        }
+        m_pathSegment[i] = segment;
+
+        int a = first + segment;
+        int b = first + (segment + 1) % n;
+        float segmentLength = (segment + 1 < n ? m_pointDistance[b] : length) - m_pointDistance[a];
+        float t = segmentLength > 0 ? (distance - m_pointDistance[a]) / segmentLength : 0;
+        m_pathWasActive[i] = moveTowards( m_pathBodies[i],
+                                          m_pointX[a] + t * (m_pointX[b] - m_pointX[a]),
+                                          m_pointY[a] + t * (m_pointY[b] - m_pointY[a]), timeStep, m_pathWasActive[i] );
+    }
+}
+
+// The last one is moved into the place of the one taken out, in every array
+void Box2DKinematicAnimator::removeOscillator(int index)
+{
+    int last = (int)m_oscBodies.size() - 1;
+    m_oscBodies[index] = m_oscBodies[last];     m_oscBodies.pop_back();
+    m_oscCenterX[index] = m_oscCenterX[last];   m_oscCenterX.pop_back();
+    m_oscCenterY[index] = m_oscCenterY[last];   m_oscCenterY.pop_back();
+    m_oscPhaseH[index] = m_oscPhaseH[last];     m_oscPhaseH.pop_back();
+    m_oscPhaseV[index] = m_oscPhaseV[last];     m_oscPhaseV.pop_back();
+    m_oscSpeedH[index] = m_oscSpeedH[last];     m_oscSpeedH.pop_back();
+    m_oscSpeedV[index] = m_oscSpeedV[last];     m_oscSpeedV.pop_back();
+    m_oscWidth[index] = m_oscWidth[last];       m_oscWidth.pop_back();
+    m_oscHeight[index] = m_oscHeight[last];     m_oscHeight.pop_back();
+    m_oscTargetX[index] = m_oscTargetX[last];   m_oscTargetX.pop_back();
+    m_oscTargetY[index] = m_oscTargetY[last];   m_oscTargetY.pop_back();
+    m_oscWasActive[index] = m_oscWasActive[last]; m_oscWasActive.pop_back();
+}
+
+// The points of the paths after this one are moved down to fill the gap
+void Box2DKinematicAnimator::removePath(int index)
+{
+    int first = m_pathFirstPoint[index];
+    int n = m_pathPointCount[index];
+    m_pointX.erase(m_pointX.begin() + first, m_pointX.begin() + first + n);
+    m_pointY.erase(m_pointY.begin() + first, m_pointY.begin() + first + n);
+    m_pointDistance.erase(m_pointDistance.begin() + first, m_pointDistance.begin() + first + n);
+    for (int i = 0; i < (int)m_pathFirstPoint.size(); i++) {
+        if ( m_pathFirstPoint[i] > first )
+            m_pathFirstPoint[i] -= n;
+    }
+
+    m_pathBodies.erase(m_pathBodies.begin() + index);
+    m_pathFirstPoint.erase(m_pathFirstPoint.begin() + index);
+    m_pathPointCount.erase(m_pathPointCount.begin() + index);
+    m_pathSpeed.erase(m_pathSpeed.begin() + index);
+    m_pathLength.erase(m_pathLength.begin() + index);
+    m_pathDistance.erase(m_pathDistance.begin() + index);
+    m_pathSegment.erase(m_pathSegment.begin() + index);
+    m_pathWasActive.erase(m_pathWasActive.begin() + index);
+}
+
+// Takes out every animation of the body, and leaves it where it is. Returns false
+// if it didn't have any. The body is not looked at, so it can already be destroyed.
+bool Box2DKinematicAnimator::removeBody(b2Body* body)
+{
+    bool found = false;
+    for (int i = (int)m_oscBodies.size() - 1; i >= 0; i--) {
+        if ( m_oscBodies[i] == body ) {
+            removeOscillator(i);
+            found = true;
+        }
+    }
+    for (int i = (int)m_pathBodies.size() - 1; i >= 0; i--) {
+        if ( m_pathBodies[i] == body ) {
+            removePath(i);
+            found = true;
+        }
+    }
+    return found;
+}
+
+void Box2DKinematicAnimator::clear()
+{
+    m_oscBodies.clear();
+    m_oscCenterX.clear();
+    m_oscCenterY.clear();
+    m_oscPhaseH.clear();
+    m_oscPhaseV.clear();
+    m_oscSpeedH.clear();
+    m_oscSpeedV.clear();
+    m_oscWidth.clear();
+    m_oscHeight.clear();
+    m_oscTargetX.clear();
+    m_oscTargetY.clear();
+    m_oscWasActive.clear();
+
+    m_pathBodies.clear();
+    m_pathFirstPoint.clear();
+    m_pathPointCount.clear();
+    m_pathSpeed.clear();
+    m_pathLength.clear();
+    m_pathDistance.clear();
+    m_pathSegment.clear();
+    m_pathWasActive.clear();
+    m_pointX.clear();
+    m_pointY.clear();
+    m_pointDistance.clear();
+}
@@ -0,0 +1,89 @@
+//
+//  Box2DKinematicAnimator
+//
+//  Moves bodies along scripted paths by giving them the velocity that
+//  will take them to the next point during the coming step, instead of
+//  putting them there with SetTransform. A body moved with SetTransform
+//  jumps from one place to the next, so it pushes things instead of
+//  carrying them, its contacts are found again from scratch every step,
+//  and its broadphase proxy is moved outside the step. A kinematic body
+//  moving with a velocity does none of that, and things standing on it
+//  ride along properly. Static bodies are changed to kinematic when they
+//  are added.
+//
+//  There are two kinds of animation:
+//   - oscillators wobble around a center point with a sine wave in each
+//     direction (the phase goes up by the speed every step)
+//   - paths go around a closed loop of points at a constant speed, in
+//     physics units per second
+//
+//  The settings and the state of all the animations are kept together
+//  in plain arrays, one for each value, so that the targets for all of
+//  them are worked out in one loop through memory before any of the
+//  bodies are touched.
+//
+//  Call step just before each world step, with the same time step. The
+//  velocity is worked out from where the body actually is, so it never
+//  drifts away from where it should be. Bodies that are not active (see
+//  Box2DActivationManager.h) are skipped, with their velocity zeroed.
+//  When one is switched on again it is put straight at its target with
+//  SetTransform. Otherwise it would cover all of the ground it missed in
+//  one step, fast enough to knock anything in the way flying.
+//
+//  Bodies destroyed by anything else must be taken out with removeBody.
+//
+
+#ifndef BOX2DKINEMATICANIMATOR_H
+#define BOX2DKINEMATICANIMATOR_H
+
+#include <vector>
+#include <Box2D/Box2D.h>
+
+class Box2DKinematicAnimator
+{
+protected:
+    // oscillators
+    std::vector<b2Body*> m_oscBodies;
+    std::vector<float> m_oscCenterX;
+    std::vector<float> m_oscCenterY;
+    std::vector<float> m_oscPhaseH;
+    std::vector<float> m_oscPhaseV;
+    std::vector<float> m_oscSpeedH;         // radians per step
+    std::vector<float> m_oscSpeedV;
+    std::vector<float> m_oscWidth;
+    std::vector<float> m_oscHeight;
+    std::vector<float> m_oscTargetX;        // worked out for all of them before setting any velocities
+    std::vector<float> m_oscTargetY;
+    std::vector<bool> m_oscWasActive;       // at the last step, to see when the body is switched back on
+
+    // paths, with the points of all of them one after another in m_pointX/Y
+    std::vector<b2Body*> m_pathBodies;
+    std::vector<int> m_pathFirstPoint;
+    std::vector<int> m_pathPointCount;
+    std::vector<float> m_pathSpeed;         // units per second
+    std::vector<float> m_pathLength;        // all the way around
+    std::vector<float> m_pathDistance;      // how far around it is
+    std::vector<int> m_pathSegment;         // the segment it is on, so the search starts from there
+    std::vector<bool> m_pathWasActive;
+    std::vector<float> m_pointX;
+    std::vector<float> m_pointY;
+    std::vector<float> m_pointDistance;     // from the first point of the path, along the way
+
+    void makeKinematic(b2Body* body);
+    bool moveTowards(b2Body* body, float targetX, float targetY, float timeStep, bool wasActive);
+    void removeOscillator(int index);
+    void removePath(int index);
+
+public:
+    void addOscillator(b2Body* body, b2Vec2 center, float speedH, float speedV, float width, float height, float phaseH = 0, float phaseV = 0);
+    bool addPath(b2Body* body, const b2Vec2* points, int pointCount, float speed, float startDistance = 0);
+
+    void step(float timeStep);
+    bool removeBody(b2Body* body);
+    void clear();
+
+    int getOscillatorCount() const { return (int)m_oscBodies.size(); }
+    int getPathCount() const { return (int)m_pathBodies.size(); }
+};
+
+#endif /* BOX2DKINEMATICANIMATOR_H */
@@ -0,0 +1,378 @@
+//
+//  Box2DReplay
+//
+//  See header file for description.
+//
+
+#include <math.h>
+#include <string.h>
+#include <chrono>
+#include "Box2DReplay.h"
+
+static const unsigned char REPLAY_VERSION = 1;
+
+enum _replayFlags {
+    RF_KEYFRAME = 1
+};
+
+enum _replayValueBits {
+    RV_X        = 1,
+    RV_Y        = 2,
+    RV_ANGLE    = 4
+};
+
+static inline unsigned long long zigzag(long long v)
+{
+    return ((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63);
+}
+
+static inline long long unzigzag(unsigned long long v)
+{
+    return (long long)(v >> 1) ^ -(long long)(v & 1);
+}
+
+static inline void writeVarint(std::vector<unsigned char>& data, unsigned long long v)
+{
+    while ( v >= 0x80 ) {
+        data.push_back( (unsigned char)(v | 0x80) );
+        v >>= 7;
+    }
+    data.push_back( (unsigned char)v );
+}
+
+static inline bool readVarint(const std::vector<unsigned char>& data, size_t& offset, unsigned long long& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if ( offset >= data.size() )
+            return false;
+        unsigned char b = data[offset++];
+        v |= (unsigned long long)(b & 0x7F) << shift;
+        if ( !(b & 0x80) )
+            return true;
+    }
+    return false;
+}
+
+static inline long long quantize(float v, float step)
+{
+    return (long long)floor(v / step + 0.5);
+}
+
+
+
+
+Box2DReplayRecorder::Box2DReplayRecorder(float positionStep, float angleStep, int keyframeInterval)
+{
+    m_positionStep = positionStep;
+    m_angleStep = angleStep;
+    m_keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+    m_frameCount = 0;
+    m_totalMilliseconds = 0;
+}
+
+void Box2DReplayRecorder::begin(b2World* world)
+{
+    m_data.clear();
+    m_bodyIds.clear();
+    m_bodies.clear();
+    m_frameCount = 0;
+    m_totalMilliseconds = 0;
+
+    m_data.push_back('B');
+    m_data.push_back('2');
+    m_data.push_back('R');
+    m_data.push_back('P');
+    m_data.push_back(REPLAY_VERSION);
+    unsigned char buf[4];
+    memcpy(buf, &m_positionStep, 4);
+    m_data.insert(m_data.end(), buf, buf + 4);
+    memcpy(buf, &m_angleStep, 4);
+    m_data.insert(m_data.end(), buf, buf + 4);
+
+    for (b2Body* body = world->GetBodyList(); body; body = body->GetNext()) {
+        _bodyState s = { 0, 0, 0, -1, false };
+        m_bodyIds[body] = (int)m_bodies.size();
+        m_bodies.push_back(s);
+    }
+}
+
+void Box2DReplayRecorder::recordFrame(b2World* world)
+{
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    int frame = m_frameCount;
+    bool keyframe = (frame % m_keyframeInterval) == 0;
+
+    // The bodies are written to a separate buffer first, because the ones that
+    // have gone are only known after going through the whole list.
+    std::vector<unsigned char>& records = m_frameRecords;
+    records.clear();
+    int numRecords = 0;
+    int previousId = -1;
+
+    for (b2Body* body = world->GetBodyList(); body; body = body->GetNext()) {
+        int id;
+        std::unordered_map<b2Body*, int>::iterator it = m_bodyIds.find(body);
+        if ( it != m_bodyIds.end() )
+            id = it->second;
+        else {
+            _bodyState s = { 0, 0, 0, -1, false };
+            id = (int)m_bodies.size();
+            m_bodyIds[body] = id;
+            m_bodies.push_back(s);
+        }
+
+        _bodyState& s = m_bodies[id];
+        s.lastSeenFrame = frame;
+
+        const b2Vec2& position = body->GetPosition();
+        long long x = quantize(position.x, m_positionStep);
+        long long y = quantize(position.y, m_positionStep);
+        long long angle = quantize(body->GetAngle(), m_angleStep);
+
+        // keyframes and new bodies start from zero
+        bool fromZero = keyframe || !s.present;
+        long long baseX = fromZero ? 0 : s.x;
+        long long baseY = fromZero ? 0 : s.y;
+        long long baseAngle = fromZero ? 0 : s.angle;
+
+        int mask = 0;
+        if ( x != baseX )         mask |= RV_X;
+        if ( y != baseY )         mask |= RV_Y;
+        if ( angle != baseAngle ) mask |= RV_ANGLE;
+
+        if ( !fromZero && mask == 0 )
+            continue;
+
+        writeVarint(records, (zigzag(id - previousId - 1) << 3) | mask);
+        if ( mask & RV_X )     writeVarint(records, zigzag(x - baseX));
+        if ( mask & RV_Y )     writeVarint(records, zigzag(y - baseY));
+        if ( mask & RV_ANGLE ) writeVarint(records, zigzag(angle - baseAngle));
+        previousId = id;
+        numRecords++;
+
+        s.x = x;
+        s.y = y;
+        s.angle = angle;
+        s.present = true;
+    }
+
+    // Anything present last frame but not this frame has been destroyed. A keyframe
+    // does not need to say so, because only the bodies in it are present after it.
+    std::vector<int>& removed = m_frameRemoved;
+    removed.clear();
+    for (int id = 0; id < (int)m_bodies.size(); id++) {
+        _bodyState& s = m_bodies[id];
+        if ( s.present && s.lastSeenFrame != frame ) {
+            s.present = false;
+            if ( !keyframe )
+                removed.push_back(id);
+        }
+    }
+    if ( !removed.empty() ) {
+        // the destroyed bodies can't be looked up by pointer any more
+        for (std::unordered_map<b2Body*, int>::iterator it = m_bodyIds.begin(); it != m_bodyIds.end(); ) {
+            if ( m_bodies[it->second].lastSeenFrame != frame )
+                it = m_bodyIds.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    m_data.push_back( keyframe ? RF_KEYFRAME : 0 );
+    writeVarint(m_data, removed.size());
+    previousId = -1;
+    for (int i = 0; i < (int)removed.size(); i++) {
+        writeVarint(m_data, zigzag(removed[i] - previousId - 1));
+        previousId = removed[i];
+    }
+    writeVarint(m_data, numRecords);
+    m_data.insert(m_data.end(), records.begin(), records.end());
+
+    m_frameCount++;
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    m_totalMilliseconds += elapsed.count();
+}
+
+float Box2DReplayRecorder::getBytesPerFrame() const
+{
+    if ( m_frameCount == 0 )
+        return 0;
+    return m_data.size() / (float)m_frameCount;
+}
+
+float Box2DReplayRecorder::getMillisecondsPerFrame() const
+{
+    if ( m_frameCount == 0 )
+        return 0;
+    return (float)(m_totalMilliseconds / m_frameCount);
+}
+
+
+
+
+Box2DReplayPlayer::Box2DReplayPlayer()
+{
+    m_positionStep = 1;
+    m_angleStep = 1;
+    m_currentFrame = -1;
+}
+
+// Goes through the whole recording once to find where each frame starts
+bool Box2DReplayPlayer::open(const std::vector<unsigned char>& data)
+{
+    m_data = data;
+    m_frameOffsets.clear();
+    m_keyframes.clear();
+    m_bodies.clear();
+    m_currentFrame = -1;
+
+    if ( m_data.size() < 13 || memcmp(&m_data[0], "B2RP", 4) != 0 || m_data[4] != REPLAY_VERSION )
+        return false;
+    memcpy(&m_positionStep, &m_data[5], 4);
+    memcpy(&m_angleStep, &m_data[9], 4);
+
+    size_t offset = 13;
+    while ( offset < m_data.size() ) {
+        size_t frameStart = offset;
+        bool isKeyframe;
+        if ( ! decodeFrame(offset, isKeyframe) ) {
+            m_frameOffsets.clear();
+            m_keyframes.clear();
+            return false;
+        }
+        if ( isKeyframe )
+            m_keyframes.push_back( (int)m_frameOffsets.size() );
+        m_frameOffsets.push_back(frameStart);
+    }
+
+    m_bodies.clear();
+    if ( m_keyframes.empty() || m_keyframes[0] != 0 ) {
+        m_frameOffsets.clear();
+        m_keyframes.clear();
+        return false;
+    }
+    return true;
+}
+
+bool Box2DReplayPlayer::decodeFrame(size_t& offset, bool& isKeyframe)
+{
+    if ( offset >= m_data.size() )
+        return false;
+    isKeyframe = (m_data[offset++] & RF_KEYFRAME) != 0;
+
+    if ( isKeyframe ) {
+        for (int id = 0; id < (int)m_bodies.size(); id++) {
+            _bodyState& s = m_bodies[id];
+            s.x = s.y = s.angle = 0;
+            s.present = false;
+        }
+    }
+
+    unsigned long long count, v;
+    if ( ! readVarint(m_data, offset, count) )
+        return false;
+    long long previousId = -1;
+    for (unsigned long long i = 0; i < count; i++) {
+        if ( ! readVarint(m_data, offset, v) )
+            return false;
+        long long id = previousId + 1 + unzigzag(v);
+        if ( id < 0 || id >= (long long)m_bodies.size() )
+            return false;
+        _bodyState& s = m_bodies[id];
+        s.x = s.y = s.angle = 0;
+        s.present = false;
+        previousId = id;
+    }
+
+    if ( ! readVarint(m_data, offset, count) )
+        return false;
+    previousId = -1;
+    for (unsigned long long i = 0; i < count; i++) {
+        if ( ! readVarint(m_data, offset, v) )
+            return false;
+        int mask = (int)(v & 7);
+        long long id = previousId + 1 + unzigzag(v >> 3);
+        if ( id < 0 || id > 0x7FFFFFFF )
+            return false;
+        if ( id >= (long long)m_bodies.size() ) {
+            _bodyState s = { 0, 0, 0, false };
+            m_bodies.resize(id + 1, s);
+        }
+
+        _bodyState& s = m_bodies[id];
+        if ( !s.present )
+            s.x = s.y = s.angle = 0;
+        if ( mask & RV_X ) {
+            if ( ! readVarint(m_data, offset, v) )
+                return false;
+            s.x += unzigzag(v);
+        }
+        if ( mask & RV_Y ) {
+            if ( ! readVarint(m_data, offset, v) )
+                return false;
+            s.y += unzigzag(v);
+        }
+        if ( mask & RV_ANGLE ) {
+            if ( ! readVarint(m_data, offset, v) )
+                return false;
+            s.angle += unzigzag(v);
+        }
+        s.present = true;
+        previousId = id;
+    }
+
+    return true;
+}
+
+bool Box2DReplayPlayer::nextFrame()
+{
+    if ( m_currentFrame + 1 >= (int)m_frameOffsets.size() )
+        return false;
+
+    m_currentFrame++;
+    size_t offset = m_frameOffsets[m_currentFrame];
+    bool isKeyframe;
+    return decodeFrame(offset, isKeyframe);
+}
+
+bool Box2DReplayPlayer::seek(int frame)
+{
+    if ( frame < 0 || frame >= (int)m_frameOffsets.size() )
+        return false;
+
+    // nothing to do if the frame is a little way ahead of the current one
+    int startFrame = m_keyframes[0];
+    for (int i = 0; i < (int)m_keyframes.size() && m_keyframes[i] <= frame; i++)
+        startFrame = m_keyframes[i];
+    if ( m_currentFrame >= startFrame && m_currentFrame <= frame )
+        startFrame = m_currentFrame + 1;
+
+    m_currentFrame = startFrame - 1;
+    while ( m_currentFrame < frame ) {
+        if ( ! nextFrame() )
+            return false;
+    }
+    return true;
+}
+
+bool Box2DReplayPlayer::isPresent(int id) const
+{
+    return id >= 0 && id < (int)m_bodies.size() && m_bodies[id].present;
+}
+
+b2Vec2 Box2DReplayPlayer::getPosition(int id) const
+{
+    if ( !isPresent(id) )
+        return b2Vec2(0, 0);
+    return b2Vec2(m_bodies[id].x * m_positionStep, m_bodies[id].y * m_positionStep);
+}
+
+float Box2DReplayPlayer::getAngle(int id) const
+{
+    if ( !isPresent(id) )
+        return 0;
+    return m_bodies[id].angle * m_angleStep;
+}
@@ -0,0 +1,105 @@
+//
+//  Box2DReplay
+//
+//  Records how the bodies of a world move, compactly enough to keep a
+//  whole game session for replays or to send to spectators, and plays
+//  it back without stepping the physics.
+//
+//  Positions and angles are rounded to a fixed step (1mm and 0.03 degrees
+//  by default), and a body is only written in a frame when one of these
+//  rounded values has changed. Only the values that changed are written,
+//  as the difference from the last value written for that body, so a body
+//  moving at a steady speed costs a few bytes and a resting body nothing.
+//  Every so often a keyframe holds all the bodies, so that playback can
+//  jump to any point without decoding from the start.
+//
+//  Bodies are numbered in the order of the world's body list when the
+//  recording begins, and bodies created after that get the next numbers.
+//  For playback, load the same scene again and number the bodies the same
+//  way before anything else is created (RUBELayer::playReplay does this).
+//
+//  Stream format, all integers as variable length (7 bits per byte):
+//      header      "B2RP", version byte, position step, angle step (raw floats)
+//      frame       flags byte (1 = keyframe), number of bodies removed,
+//                  their ids, number of bodies written, then for each body
+//                  (id gap << 3 | which of x,y,angle follow), and the values
+//  Ids are written as the signed difference from the previous id, values
+//  as the signed difference from the body's previous value (from zero in
+//  a keyframe), both zigzag encoded so that small negatives stay small.
+//
+
+#ifndef BOX2DREPLAY_H
+#define BOX2DREPLAY_H
+
+#include <vector>
+#include <unordered_map>
+#include <Box2D/Box2D.h>
+
+class Box2DReplayRecorder
+{
+protected:
+    struct _bodyState {
+        long long x, y, angle;              // the last values written, in steps
+        int lastSeenFrame;
+        bool present;
+    };
+
+    float m_positionStep;
+    float m_angleStep;
+    int m_keyframeInterval;
+
+    std::vector<unsigned char> m_data;
+    std::unordered_map<b2Body*, int> m_bodyIds;
+    std::vector<_bodyState> m_bodies;       // indexed by id
+    std::vector<unsigned char> m_frameRecords;  // reused each frame, for the bodies written
+    std::vector<int> m_frameRemoved;        // reused each frame, for the ids of destroyed bodies
+    int m_frameCount;
+    double m_totalMilliseconds;             // time spent in recordFrame
+
+public:
+    Box2DReplayRecorder(float positionStep = 0.001f, float angleStep = 0.0005f, int keyframeInterval = 120);
+
+    void begin(b2World* world);             // numbers the bodies and starts a new recording
+    void recordFrame(b2World* world);       // call after each step
+
+    const std::vector<unsigned char>& getData() const { return m_data; }
+    int getFrameCount() const { return m_frameCount; }
+    float getBytesPerFrame() const;
+    float getMillisecondsPerFrame() const;
+};
+
+class Box2DReplayPlayer
+{
+protected:
+    struct _bodyState {
+        long long x, y, angle;
+        bool present;
+    };
+
+    std::vector<unsigned char> m_data;
+    float m_positionStep;
+    float m_angleStep;
+    std::vector<size_t> m_frameOffsets;     // where each frame starts in m_data
+    std::vector<int> m_keyframes;           // frame numbers of the keyframes, in order
+    std::vector<_bodyState> m_bodies;       // indexed by id
+    int m_currentFrame;                     // -1 before the first frame
+
+    bool decodeFrame(size_t& offset, bool& isKeyframe);
+
+public:
+    Box2DReplayPlayer();
+
+    bool open(const std::vector<unsigned char>& data);  // returns false if the data is not a complete recording
+
+    bool nextFrame();                       // returns false after the last frame
+    bool seek(int frame);                   // decodes from the keyframe before the given frame
+    int getCurrentFrame() const { return m_currentFrame; }
+    int getFrameCount() const { return (int)m_frameOffsets.size(); }
+
+    int getBodyCount() const { return (int)m_bodies.size(); }   // highest id seen so far, plus one
+    bool isPresent(int id) const;
+    b2Vec2 getPosition(int id) const;
+    float getAngle(int id) const;
+};
+
+#endif /* BOX2DREPLAY_H */
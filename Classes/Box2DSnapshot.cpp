@@ -0,0 +1,455 @@
+//
+//  Box2DSnapshot
+//
+//  See header file for description.
+//
+
+#include <string.h>
+#include <unordered_map>
+#include "Box2DSnapshot.h"
+
+// The snapshot is just these structs one after another. Pointers are kept
+// to check that the world still has the same things in it when restoring.
+
+struct _snapshotHeader {
+    int32 version;                          // also pads the header out to 16 bytes, see restore
+    int32 bodyCount;
+    int32 jointCount;
+    int32 contactCount;
+};
+
+enum _snapshotBodyFlags {
+    SBF_AWAKE   = 1,
+    SBF_ACTIVE  = 2
+};
+
+struct _snapshotBody {
+    b2Body* body;
+    b2Vec2 position;
+    float32 angle;
+    b2Vec2 linearVelocity;
+    float32 angularVelocity;
+    int32 flags;
+};
+
+enum _snapshotJointFlags {
+    SJF_MOTOR   = 1,
+    SJF_LIMIT   = 2
+};
+
+struct _snapshotJoint {
+    b2Joint* joint;
+    int32 flags;
+    float32 values[5];                      // depends on the joint type, see captureJoint
+};
+
+struct _snapshotContact {
+    b2Fixture* fixtureA;
+    b2Fixture* fixtureB;
+    int32 childIndexA;
+    int32 childIndexB;
+    int32 enabled;
+    float32 friction;
+    float32 restitution;
+    float32 tangentSpeed;
+    b2Manifold manifold;
+};
+
+static void captureJoint(b2Joint* joint, _snapshotJoint& s)
+{
+    s.joint = joint;
+    s.flags = 0;
+    memset(s.values, 0, sizeof(s.values));
+
+    switch ( joint->GetType() ) {
+    case e_revoluteJoint: {
+            b2RevoluteJoint* j = (b2RevoluteJoint*)joint;
+            s.flags = (j->IsMotorEnabled() ? SJF_MOTOR : 0) | (j->IsLimitEnabled() ? SJF_LIMIT : 0);
+            s.values[0] = j->GetMotorSpeed();
+            s.values[1] = j->GetMaxMotorTorque();
+            s.values[2] = j->GetLowerLimit();
+            s.values[3] = j->GetUpperLimit();
+        }
+        break;
+    case e_prismaticJoint: {
+            b2PrismaticJoint* j = (b2PrismaticJoint*)joint;
+            s.flags = (j->IsMotorEnabled() ? SJF_MOTOR : 0) | (j->IsLimitEnabled() ? SJF_LIMIT : 0);
+            s.values[0] = j->GetMotorSpeed();
+            s.values[1] = j->GetMaxMotorForce();
+            s.values[2] = j->GetLowerLimit();
+            s.values[3] = j->GetUpperLimit();
+        }
+        break;
+    case e_wheelJoint: {
+            b2WheelJoint* j = (b2WheelJoint*)joint;
+            s.flags = j->IsMotorEnabled() ? SJF_MOTOR : 0;
+            s.values[0] = j->GetMotorSpeed();
+            s.values[1] = j->GetMaxMotorTorque();
+            s.values[2] = j->GetSpringFrequencyHz();
+            s.values[3] = j->GetSpringDampingRatio();
+        }
+        break;
+    case e_distanceJoint: {
+            b2DistanceJoint* j = (b2DistanceJoint*)joint;
+            s.values[0] = j->GetLength();
+            s.values[1] = j->GetFrequency();
+            s.values[2] = j->GetDampingRatio();
+        }
+        break;
+    case e_weldJoint: {
+            b2WeldJoint* j = (b2WeldJoint*)joint;
+            s.values[0] = j->GetFrequency();
+            s.values[1] = j->GetDampingRatio();
+        }
+        break;
+    case e_mouseJoint: {
+            b2MouseJoint* j = (b2MouseJoint*)joint;
+            s.values[0] = j->GetTarget().x;
+            s.values[1] = j->GetTarget().y;
+            s.values[2] = j->GetMaxForce();
+            s.values[3] = j->GetFrequency();
+            s.values[4] = j->GetDampingRatio();
+        }
+        break;
+    case e_frictionJoint: {
+            b2FrictionJoint* j = (b2FrictionJoint*)joint;
+            s.values[0] = j->GetMaxForce();
+            s.values[1] = j->GetMaxTorque();
+        }
+        break;
+    case e_ropeJoint: {
+            b2RopeJoint* j = (b2RopeJoint*)joint;
+            s.values[0] = j->GetMaxLength();
+        }
+        break;
+    case e_motorJoint: {
+            b2MotorJoint* j = (b2MotorJoint*)joint;
+            s.values[0] = j->GetLinearOffset().x;
+            s.values[1] = j->GetLinearOffset().y;
+            s.values[2] = j->GetAngularOffset();
+            s.values[3] = j->GetMaxForce();
+            s.values[4] = j->GetMaxTorque();
+        }
+        break;
+    default:
+        break; //pulley and gear joints have nothing that changes
+    }
+}
+
+static void restoreJoint(const _snapshotJoint& s)
+{
+    b2Joint* joint = s.joint;
+
+    switch ( joint->GetType() ) {
+    case e_revoluteJoint: {
+            b2RevoluteJoint* j = (b2RevoluteJoint*)joint;
+            j->EnableMotor( (s.flags & SJF_MOTOR) != 0 );
+            j->EnableLimit( (s.flags & SJF_LIMIT) != 0 );
+            j->SetMotorSpeed( s.values[0] );
+            j->SetMaxMotorTorque( s.values[1] );
+            j->SetLimits( s.values[2], s.values[3] );
+        }
+        break;
+    case e_prismaticJoint: {
+            b2PrismaticJoint* j = (b2PrismaticJoint*)joint;
+            j->EnableMotor( (s.flags & SJF_MOTOR) != 0 );
+            j->EnableLimit( (s.flags & SJF_LIMIT) != 0 );
+            j->SetMotorSpeed( s.values[0] );
+            j->SetMaxMotorForce( s.values[1] );
+            j->SetLimits( s.values[2], s.values[3] );
+        }
+        break;
+    case e_wheelJoint: {
+            b2WheelJoint* j = (b2WheelJoint*)joint;
+            j->EnableMotor( (s.flags & SJF_MOTOR) != 0 );
+            j->SetMotorSpeed( s.values[0] );
+            j->SetMaxMotorTorque( s.values[1] );
+            j->SetSpringFrequencyHz( s.values[2] );
+            j->SetSpringDampingRatio( s.values[3] );
+        }
+        break;
+    case e_distanceJoint: {
+            b2DistanceJoint* j = (b2DistanceJoint*)joint;
+            j->SetLength( s.values[0] );
+            j->SetFrequency( s.values[1] );
+            j->SetDampingRatio( s.values[2] );
+        }
+        break;
+    case e_weldJoint: {
+            b2WeldJoint* j = (b2WeldJoint*)joint;
+            j->SetFrequency( s.values[0] );
+            j->SetDampingRatio( s.values[1] );
+        }
+        break;
+    case e_mouseJoint: {
+            b2MouseJoint* j = (b2MouseJoint*)joint;
+            j->SetTarget( b2Vec2(s.values[0], s.values[1]) );
+            j->SetMaxForce( s.values[2] );
+            j->SetFrequency( s.values[3] );
+            j->SetDampingRatio( s.values[4] );
+        }
+        break;
+    case e_frictionJoint: {
+            b2FrictionJoint* j = (b2FrictionJoint*)joint;
+            j->SetMaxForce( s.values[0] );
+            j->SetMaxTorque( s.values[1] );
+        }
+        break;
+    case e_ropeJoint: {
+            b2RopeJoint* j = (b2RopeJoint*)joint;
+            j->SetMaxLength( s.values[0] );
+        }
+        break;
+    case e_motorJoint: {
+            b2MotorJoint* j = (b2MotorJoint*)joint;
+            j->SetLinearOffset( b2Vec2(s.values[0], s.values[1]) );
+            j->SetAngularOffset( s.values[2] );
+            j->SetMaxForce( s.values[3] );
+            j->SetMaxTorque( s.values[4] );
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static inline bool sameContact(b2Contact* contact, const _snapshotContact& s)
+{
+    return contact->GetFixtureA() == s.fixtureA && contact->GetFixtureB() == s.fixtureB &&
+           contact->GetChildIndexA() == s.childIndexA && contact->GetChildIndexB() == s.childIndexB;
+}
+
+// Identifies a contact, to look up the snapshot records that are out of order
+struct _contactKey {
+    b2Fixture* fixtureA;
+    b2Fixture* fixtureB;
+    int32 childIndexA;
+    int32 childIndexB;
+
+    bool operator==(const _contactKey& other) const {
+        return fixtureA == other.fixtureA && fixtureB == other.fixtureB &&
+               childIndexA == other.childIndexA && childIndexB == other.childIndexB;
+    }
+};
+
+struct _contactKeyHash {
+    size_t operator()(const _contactKey& k) const {
+        size_t h = std::hash<b2Fixture*>()(k.fixtureA);
+        h = h * 31 + std::hash<b2Fixture*>()(k.fixtureB);
+        return h * 31 + (size_t)(k.childIndexA * 65536 + k.childIndexB);
+    }
+};
+
+static void restoreContact(b2Contact* contact, const _snapshotContact& s)
+{
+    *contact->GetManifold() = s.manifold;
+    contact->SetEnabled( s.enabled != 0 );
+    contact->SetFriction( s.friction );
+    contact->SetRestitution( s.restitution );
+    contact->SetTangentSpeed( s.tangentSpeed );
+}
+
+
+
+
+void Box2DSnapshot::capture(b2World* world)
+{
+    _snapshotHeader header;
+    header.version = 1;
+    header.bodyCount = world->GetBodyCount();
+    header.jointCount = world->GetJointCount();
+    header.contactCount = world->GetContactCount();
+
+    // the vector keeps its capacity, so once a snapshot has been taken this
+    // only allocates if the world has grown
+    m_data.resize( sizeof(_snapshotHeader) +
+                   header.bodyCount * sizeof(_snapshotBody) +
+                   header.jointCount * sizeof(_snapshotJoint) +
+                   header.contactCount * sizeof(_snapshotContact) );
+    unsigned char* p = &m_data[0];
+
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+
+    for (b2Body* body = world->GetBodyList(); body; body = body->GetNext()) {
+        _snapshotBody s;
+        s.body = body;
+        s.position = body->GetPosition();
+        s.angle = body->GetAngle();
+        s.linearVelocity = body->GetLinearVelocity();
+        s.angularVelocity = body->GetAngularVelocity();
+        s.flags = (body->IsAwake() ? SBF_AWAKE : 0) | (body->IsActive() ? SBF_ACTIVE : 0);
+        memcpy(p, &s, sizeof(s));
+        p += sizeof(s);
+    }
+
+    for (b2Joint* joint = world->GetJointList(); joint; joint = joint->GetNext()) {
+        _snapshotJoint s;
+        captureJoint(joint, s);
+        memcpy(p, &s, sizeof(s));
+        p += sizeof(s);
+    }
+
+    for (b2Contact* contact = world->GetContactList(); contact; contact = contact->GetNext()) {
+        _snapshotContact s;
+        s.fixtureA = contact->GetFixtureA();
+        s.fixtureB = contact->GetFixtureB();
+        s.childIndexA = contact->GetChildIndexA();
+        s.childIndexB = contact->GetChildIndexB();
+        s.enabled = contact->IsEnabled() ? 1 : 0;
+        s.friction = contact->GetFriction();
+        s.restitution = contact->GetRestitution();
+        s.tangentSpeed = contact->GetTangentSpeed();
+        s.manifold = *contact->GetManifold();
+        memcpy(p, &s, sizeof(s));
+        p += sizeof(s);
+    }
+}
+
+bool Box2DSnapshot::restore(b2World* world, Box2DSnapshotRestoreInfo* info) const
+{
+    if ( m_data.empty() || world->IsLocked() )
+        return false;
+
+    _snapshotHeader header;
+    memcpy(&header, &m_data[0], sizeof(header));
+    if ( header.version != 1 || header.bodyCount != world->GetBodyCount() || header.jointCount != world->GetJointCount() )
+        return false;
+
+    // the records are read in place: the vector's storage is suitably aligned,
+    // and the header and every record are a multiple of the pointer size
+    const _snapshotBody* bodies = (const _snapshotBody*)(&m_data[0] + sizeof(header));
+    const _snapshotJoint* joints = (const _snapshotJoint*)(bodies + header.bodyCount);
+    const _snapshotContact* contacts = (const _snapshotContact*)(joints + header.jointCount);
+
+    // check everything before changing anything
+    int i = 0;
+    for (b2Body* body = world->GetBodyList(); body; body = body->GetNext(), i++) {
+        if ( bodies[i].body != body )
+            return false;
+    }
+    i = 0;
+    for (b2Joint* joint = world->GetJointList(); joint; joint = joint->GetNext(), i++) {
+        if ( joints[i].joint != joint )
+            return false;
+    }
+
+    // The joints go first because most of their setters wake both bodies, and
+    // then the bodies put the awake flags back to how they were
+    for (i = 0; i < header.jointCount; i++)
+        restoreJoint(joints[i]);
+
+    for (i = 0; i < header.bodyCount; i++) {
+        const _snapshotBody& s = bodies[i];
+        b2Body* body = s.body;
+
+        bool active = (s.flags & SBF_ACTIVE) != 0;
+        if ( body->IsActive() != active )
+            body->SetActive(active);
+
+        // moving a body has to update the broadphase, so only do it when necessary
+        if ( !(body->GetPosition() == s.position) || body->GetAngle() != s.angle )
+            body->SetTransform(s.position, s.angle);
+
+        if ( body->GetType() == b2_staticBody )
+            continue;
+
+        if ( s.flags & SBF_AWAKE ) {
+            body->SetAwake(true);
+            body->SetLinearVelocity(s.linearVelocity);
+            body->SetAngularVelocity(s.angularVelocity);
+        }
+        else
+            body->SetAwake(false); //sleeping bodies have no velocity anyway
+    }
+
+    // Contacts are usually still in the same order, so they can be matched up
+    // one by one. Once they don't match, the rest of the snapshot is put into
+    // a hash map (only once) to look each one up. A contact that did not exist
+    // when the snapshot was taken is reset to how Box2D starts a new contact.
+    std::unordered_map<_contactKey, int, _contactKeyHash> lookup;
+    bool inOrder = true;
+    int next = 0;
+    int restored = 0;
+    int reset = 0;
+    for (b2Contact* contact = world->GetContactList(); contact; contact = contact->GetNext()) {
+        const _snapshotContact* found = NULL;
+        if ( inOrder && next < header.contactCount && sameContact(contact, contacts[next]) )
+            found = &contacts[next++];
+        else {
+            if ( inOrder ) {
+                inOrder = false;
+                lookup.reserve(header.contactCount - next);
+                for (int c = next; c < header.contactCount; c++) {
+                    _contactKey key = { contacts[c].fixtureA, contacts[c].fixtureB, contacts[c].childIndexA, contacts[c].childIndexB };
+                    lookup[key] = c;
+                }
+            }
+            _contactKey key = { contact->GetFixtureA(), contact->GetFixtureB(), contact->GetChildIndexA(), contact->GetChildIndexB() };
+            std::unordered_map<_contactKey, int, _contactKeyHash>::const_iterator it = lookup.find(key);
+            if ( it != lookup.end() )
+                found = &contacts[it->second];
+        }
+
+        if ( found ) {
+            restoreContact(contact, *found);
+            restored++;
+        }
+        else {
+            contact->GetManifold()->pointCount = 0;
+            contact->SetEnabled(true);
+            contact->ResetFriction();
+            contact->ResetRestitution();
+            contact->SetTangentSpeed(0);
+            reset++;
+        }
+    }
+
+    // each snapshot contact can only be found by one contact of the world
+    if ( info ) {
+        info->contactsRestored = restored;
+        info->contactsReset = reset;
+        info->contactsMissing = header.contactCount - restored;
+    }
+
+    return true;
+}
+
+
+
+
+Box2DSnapshotRing::Box2DSnapshotRing(int capacity)
+{
+    m_snapshots.resize( capacity > 0 ? capacity : 1 );
+    m_newest = -1;
+    m_count = 0;
+}
+
+void Box2DSnapshotRing::push(b2World* world)
+{
+    m_newest = (m_newest + 1) % (int)m_snapshots.size();
+    m_snapshots[m_newest].capture(world);
+    if ( m_count < (int)m_snapshots.size() )
+        m_count++;
+}
+
+bool Box2DSnapshotRing::rewind(b2World* world, int steps, Box2DSnapshotRestoreInfo* info)
+{
+    if ( steps < 0 || steps >= m_count )
+        return false;
+
+    int capacity = (int)m_snapshots.size();
+    int index = (m_newest - steps + capacity) % capacity;
+    if ( ! m_snapshots[index].restore(world, info) )
+        return false;
+
+    m_newest = index;
+    m_count -= steps;
+    return true;
+}
+
+void Box2DSnapshotRing::clear()
+{
+    m_newest = -1;
+    m_count = 0;
+}
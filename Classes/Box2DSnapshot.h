@@ -0,0 +1,83 @@
+//
+//  Box2DSnapshot
+//
+//  Captures the state of everything that moves in a Box2D world into a
+//  compact binary block, and puts it back again later. This is much
+//  faster than saving the world with b2dJson, because nothing is created
+//  or destroyed - it only works for the same world, with the same bodies
+//  and joints as when the snapshot was taken. It is meant for things like
+//  checkpoints and rewinding, not for saving to disk.
+//
+//  What is kept:
+//      bodies      position, angle, velocities, awake and active
+//      joints      motor, limit and spring settings, mouse joint target
+//      contacts    friction, restitution, tangent speed, enabled, and the
+//                  manifold including the impulses used for warm starting
+//
+//  The values above are put back as they were captured. Most of the joint
+//  setters wake both bodies of the joint, so the joints are done first and
+//  the awake flags of the bodies after them, which leaves a body that was
+//  asleep in the snapshot asleep. Bodies that are already where they should
+//  be are not moved. Some things that Box2D keeps to itself cannot be
+//  restored: the sleep timers of bodies (a body that was asleep before the
+//  restore starts counting again from zero), the accumulated impulses of
+//  joints, and contacts that have ended since the snapshot (these start
+//  again without warm starting when the bodies touch).
+//  Box2D also recalculates the center of mass from the position, which can
+//  differ in the last bit for bodies whose center is not at their origin.
+//  So after a restore the simulation follows the original run closely, but
+//  is not guaranteed to repeat it exactly. Pass a Box2DSnapshotRestoreInfo
+//  to restore to find out how many contacts did not match, eg. to tell an
+//  exact rewind from an approximate one.
+//
+//  Box2DSnapshotRing keeps the most recent snapshots for rewinding, reusing
+//  the same memory over and over once it is full.
+//
+
+#ifndef BOX2DSNAPSHOT_H
+#define BOX2DSNAPSHOT_H
+
+#include <vector>
+#include <Box2D/Box2D.h>
+
+// How the contacts of the world compared with those in the snapshot
+struct Box2DSnapshotRestoreInfo {
+    int contactsRestored;                   // in both, set back to how they were
+    int contactsReset;                      // only in the world, reset to how Box2D starts a new contact
+    int contactsMissing;                    // only in the snapshot, these can't be made again
+
+    bool contactsMatched() const { return contactsReset == 0 && contactsMissing == 0; }
+};
+
+class Box2DSnapshot
+{
+protected:
+    std::vector<unsigned char> m_data;      // header, then bodies, joints and contacts
+
+public:
+    void capture(b2World* world);
+    bool restore(b2World* world, Box2DSnapshotRestoreInfo* info = NULL) const; // returns false (and does nothing) if the bodies or joints have changed
+
+    bool isEmpty() const { return m_data.empty(); }
+    size_t getSize() const { return m_data.size(); }
+};
+
+class Box2DSnapshotRing
+{
+protected:
+    std::vector<Box2DSnapshot> m_snapshots;
+    int m_newest;                           // index of the most recent snapshot
+    int m_count;                            // number of snapshots held, up to the capacity
+
+public:
+    Box2DSnapshotRing(int capacity);
+
+    void push(b2World* world);              // captures the world, replacing the oldest snapshot if full
+    bool rewind(b2World* world, int steps, Box2DSnapshotRestoreInfo* info = NULL); // restores the snapshot from this many pushes ago (0 is the most recent), and forgets the newer ones
+    void clear();
+
+    int getCount() const { return m_count; }
+    int getCapacity() const { return (int)m_snapshots.size(); }
+};
+
+#endif /* BOX2DSNAPSHOT_H */
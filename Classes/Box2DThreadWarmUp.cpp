@@ -0,0 +1,31 @@
+//
+//  Box2DThreadWarmUp
+//
+//  See header file for description.
+//
+
+#include <Box2D/Box2D.h>
+#include "Box2DThreadWarmUp.h"
+
+static bool s_warmedUp = false;
+
+void warmUpBox2DForThreads()
+{
+    if ( s_warmedUp )
+        return;
+    s_warmedUp = true;
+
+    b2World world( b2Vec2(0,0) );
+
+    b2CircleShape circle;
+    circle.m_radius = 1;
+
+    b2BodyDef bd;
+    bd.type = b2_dynamicBody;
+    world.CreateBody(&bd)->CreateFixture(&circle, 1);
+    bd.position.Set(0.5f, 0);
+    world.CreateBody(&bd)->CreateFixture(&circle, 1);
+
+    // the contact between them is made at the start of the step
+    world.Step(1/60.0f, 1, 1);
+}
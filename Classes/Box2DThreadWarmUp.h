@@ -0,0 +1,27 @@
+//
+//  Box2DThreadWarmUp
+//
+//  Box2D keeps a few things for the whole process instead of in each world,
+//  and fills them in the first time they are needed: the size lookup of
+//  b2BlockAllocator when the first world is made, and the table of contact
+//  types (b2Contact::s_registers) when the first contact is made, which is
+//  in the middle of a step. If that first step happens on two threads at
+//  once they both write the table at the same time.
+//
+//  Call warmUpBox2DForThreads on the main thread before any worlds are
+//  stepped on other threads. It makes a world with two overlapping circles
+//  and steps it once, so everything has been filled in before the threads
+//  start. It only does anything the first time it is called.
+//
+//  This does not help with the counters that Box2D adds to during a step
+//  for its own statistics (b2_gjkCalls, b2_toiCalls, b2_toiMaxIters and so
+//  on). Those are still changed by each thread without any locking, so
+//  their values mean nothing while worlds are stepped in parallel.
+//
+
+#ifndef BOX2D_THREAD_WARM_UP
+#define BOX2D_THREAD_WARM_UP
+
+void warmUpBox2DForThreads();
+
+#endif /* BOX2D_THREAD_WARM_UP */
@@ -0,0 +1,211 @@
+//
+//  Box2DWorldHash
+//
+//  See header file for description.
+//
+
+#include <string.h>
+#include "Box2DWorldHash.h"
+
+using namespace std;
+
+static const b2WorldHashValue HASH_SEED = 0xCBF29CE484222325ULL;
+static const unsigned int HASH_REMOVED = 0xDEADB0D7;   // in place of a body or joint that has been removed
+
+// Each 32 bit word is multiplied into the hash, and the high bits are folded
+// back down so that every bit of the word affects every bit of the hash.
+static inline void mixWord(b2WorldHashValue& h, unsigned int w)
+{
+    h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 29;
+}
+
+static inline void mixFloat(b2WorldHashValue& h, float f)
+{
+    unsigned int bits;
+    memcpy(&bits, &f, sizeof(bits));
+    mixWord(h, bits);
+}
+
+static inline b2WorldHashValue finish(b2WorldHashValue h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline void mixBody(b2WorldHashValue& h, const b2Body* body)
+{
+    if ( !body ) {
+        mixWord(h, HASH_REMOVED);
+        return;
+    }
+    const b2Vec2& position = body->GetPosition();
+    const b2Vec2& velocity = body->GetLinearVelocity();
+    mixFloat(h, position.x);
+    mixFloat(h, position.y);
+    mixFloat(h, body->GetAngle());
+    mixFloat(h, velocity.x);
+    mixFloat(h, velocity.y);
+    mixFloat(h, body->GetAngularVelocity());
+    mixWord(h, (body->IsAwake() ? 1 : 0) | (body->IsActive() ? 2 : 0));
+}
+
+static inline void mixJoint(b2WorldHashValue& h, const b2Joint* joint)
+{
+    if ( !joint ) {
+        mixWord(h, HASH_REMOVED);
+        return;
+    }
+    // with an inverse time step of 1 these are just the stored impulses
+    b2Vec2 force = joint->GetReactionForce(1);
+    mixFloat(h, force.x);
+    mixFloat(h, force.y);
+    mixFloat(h, joint->GetReactionTorque(1));
+    mixWord(h, joint->IsActive() ? 1 : 0);
+}
+
+
+
+
+Box2DWorldHash::Box2DWorldHash()
+{
+    m_runningHash = HASH_SEED;
+    m_stepCount = 0;
+}
+
+void Box2DWorldHash::setOrder(const vector<b2Body*>& bodies, const vector<b2Joint*>& joints)
+{
+    m_bodies.clear();
+    m_joints.clear();
+    m_bodyIndexes.clear();
+    m_jointIndexes.clear();
+    for (int i = 0; i < (int)bodies.size(); i++)
+        addBody(bodies[i]);
+    for (int i = 0; i < (int)joints.size(); i++)
+        addJoint(joints[i]);
+}
+
+void Box2DWorldHash::addBody(b2Body* body)
+{
+    m_bodyIndexes[body] = (int)m_bodies.size();
+    m_bodies.push_back(body);
+}
+
+void Box2DWorldHash::removeBody(b2Body* body)
+{
+    map<b2Body*, int>::iterator it = m_bodyIndexes.find(body);
+    if ( it == m_bodyIndexes.end() )
+        return;
+    m_bodies[it->second] = NULL;
+    m_bodyIndexes.erase(it);
+
+    // Box2D destroys the joints on a body along with it
+    for (b2JointEdge* je = body->GetJointList(); je; je = je->next)
+        removeJoint(je->joint);
+}
+
+void Box2DWorldHash::addJoint(b2Joint* joint)
+{
+    m_jointIndexes[joint] = (int)m_joints.size();
+    m_joints.push_back(joint);
+}
+
+void Box2DWorldHash::removeJoint(b2Joint* joint)
+{
+    map<b2Joint*, int>::iterator it = m_jointIndexes.find(joint);
+    if ( it == m_jointIndexes.end() )
+        return;
+    m_joints[it->second] = NULL;
+    m_jointIndexes.erase(it);
+}
+
+b2WorldHashValue Box2DWorldHash::hashWorld() const
+{
+    b2WorldHashValue h = HASH_SEED;
+    mixWord(h, (unsigned int)m_bodies.size());
+    for (int i = 0; i < (int)m_bodies.size(); i++)
+        mixBody(h, m_bodies[i]);
+    mixWord(h, (unsigned int)m_joints.size());
+    for (int i = 0; i < (int)m_joints.size(); i++)
+        mixJoint(h, m_joints[i]);
+    return finish(h);
+}
+
+b2WorldHashValue Box2DWorldHash::hashBody(int index) const
+{
+    b2WorldHashValue h = HASH_SEED;
+    mixBody(h, m_bodies[index]);
+    return finish(h);
+}
+
+b2WorldHashValue Box2DWorldHash::hashBodies(int first, int count) const
+{
+    int end = b2Min(first + count, (int)m_bodies.size());
+    b2WorldHashValue h = HASH_SEED;
+    for (int i = first; i < end; i++)
+        mixBody(h, m_bodies[i]);
+    return finish(h);
+}
+
+// The index of each body is included too, so that the same bodies have to be in
+// the region in both runs for the hashes to match.
+b2WorldHashValue Box2DWorldHash::hashRegion(const b2AABB& region) const
+{
+    b2WorldHashValue h = HASH_SEED;
+    for (int i = 0; i < (int)m_bodies.size(); i++) {
+        const b2Body* body = m_bodies[i];
+        if ( !body )
+            continue;
+        const b2Vec2& p = body->GetPosition();
+        if ( p.x < region.lowerBound.x || p.y < region.lowerBound.y || p.x > region.upperBound.x || p.y > region.upperBound.y )
+            continue;
+        mixWord(h, (unsigned int)i);
+        mixBody(h, body);
+    }
+    return finish(h);
+}
+
+void Box2DWorldHash::hashEachBody(vector<b2WorldHashValue>& hashes) const
+{
+    hashes.resize(m_bodies.size());
+    for (int i = 0; i < (int)m_bodies.size(); i++)
+        hashes[i] = hashBody(i);
+}
+
+void Box2DWorldHash::hashGroupsOfBodies(int groupSize, vector<b2WorldHashValue>& hashes) const
+{
+    if ( groupSize < 1 )
+        groupSize = 1;
+    hashes.clear();
+    for (int first = 0; first < (int)m_bodies.size(); first += groupSize)
+        hashes.push_back( hashBodies(first, groupSize) );
+}
+
+b2WorldHashValue Box2DWorldHash::step()
+{
+    b2WorldHashValue h = hashWorld();
+    mixWord(m_runningHash, (unsigned int)h);
+    mixWord(m_runningHash, (unsigned int)(h >> 32));
+    m_stepCount++;
+    return h;
+}
+
+void Box2DWorldHash::resetRunningHash()
+{
+    m_runningHash = HASH_SEED;
+    m_stepCount = 0;
+}
+
+int Box2DWorldHash::findFirstDifference(const vector<b2WorldHashValue>& a, const vector<b2WorldHashValue>& b)
+{
+    int n = (int)b2Min(a.size(), b.size());
+    for (int i = 0; i < n; i++) {
+        if ( a[i] != b[i] )
+            return i;
+    }
+    if ( a.size() != b.size() )
+        return n;
+    return -1;
+}
@@ -0,0 +1,88 @@
+//
+//  Box2DWorldHash
+//
+//  Boils the state of a world down to one 64 bit number, to check that two
+//  runs of the same simulation (eg. on two devices in a lockstep game) are
+//  still doing exactly the same thing. The raw bits of the floats are used,
+//  so the smallest difference anywhere changes the hash.
+//
+//  For each body: position, angle, velocities, and the awake and active flags.
+//  For each joint: the reaction force and torque (these are the impulses Box2D
+//  carries over from the last step, which tend to differ before anything else
+//  does), and the active flag.
+//
+//  The bodies and joints are hashed in a fixed order, which must be the same in
+//  both runs. The order of the world's own lists would do if both worlds were
+//  made in exactly the same way, but it changes when anything is added, so the
+//  usual thing is to take the file order from b2dJson after loading:
+//
+//      std::vector<b2Body*> bodies;
+//      std::vector<b2Joint*> joints;
+//      json.getAllBodiesInFileOrder(bodies);
+//      json.getAllJointsInCreationOrder(joints);
+//      hash.setOrder(bodies, joints);
+//
+//  Anything created later can be added at the end with addBody/addJoint, and
+//  must be taken out with removeBody/removeJoint before it is destroyed. That
+//  leaves a gap in the order, so the index of everything else stays the same.
+//
+//  When the world hashes differ, the hash of each body (or each group of bodies)
+//  can be compared to find out which ones went first, and hashRegion checks only
+//  the bodies in one part of the world. Joints are only in the world hash.
+//
+//  The rubebatch tool prints the hash of every step of a scene without the app
+//  (rubebatch -hash scene.json 600), in the same format BasicRUBELayer logs
+//  them when hashEachStep is on, so the two can be diffed.
+//
+//  This is a fast mixing hash, meant for finding accidents, not for security.
+//
+
+#ifndef BOX2DWORLDHASH_H
+#define BOX2DWORLDHASH_H
+
+#include <vector>
+#include <map>
+#include <Box2D/Box2D.h>
+
+typedef unsigned long long b2WorldHashValue;
+
+class Box2DWorldHash
+{
+protected:
+    std::vector<b2Body*> m_bodies;          // in hashing order, NULL where a body has been removed
+    std::vector<b2Joint*> m_joints;
+    std::map<b2Body*, int> m_bodyIndexes;   // only needed to remove things
+    std::map<b2Joint*, int> m_jointIndexes;
+    b2WorldHashValue m_runningHash;         // every step's hash folded together
+    int m_stepCount;
+
+public:
+    Box2DWorldHash();
+
+    void setOrder(const std::vector<b2Body*>& bodies, const std::vector<b2Joint*>& joints);
+    void addBody(b2Body* body);
+    void removeBody(b2Body* body);
+    void addJoint(b2Joint* joint);
+    void removeJoint(b2Joint* joint);
+    int getBodyCount() const { return (int)m_bodies.size(); }
+    b2Body* getBody(int index) const { return m_bodies[index]; }
+
+    b2WorldHashValue hashWorld() const;                         // all bodies and joints
+    b2WorldHashValue hashBody(int index) const;                 // one body, by its place in the order
+    b2WorldHashValue hashBodies(int first, int count) const;    // a range of bodies in the order
+    b2WorldHashValue hashRegion(const b2AABB& region) const;    // the bodies with their position inside the region
+    void hashEachBody(std::vector<b2WorldHashValue>& hashes) const;
+    void hashGroupsOfBodies(int groupSize, std::vector<b2WorldHashValue>& hashes) const;
+
+    // Call once after each step. Returns the hash of the world, and also folds it
+    // into a hash of the whole run so far, which can be checked at the end.
+    b2WorldHashValue step();
+    b2WorldHashValue getRunningHash() const { return m_runningHash; }
+    int getStepCount() const { return m_stepCount; }
+    void resetRunningHash();
+
+    // The index of the first hash that differs, or -1 if they are the same
+    static int findFirstDifference(const std::vector<b2WorldHashValue>& a, const std::vector<b2WorldHashValue>& b);
+};
+
+#endif /* BOX2DWORLDHASH_H */
@@ -10,6 +10,7 @@
 #include "rubestuff/b2dJson.h"
 #include "rubestuff/b2dJsonImage.h"
 #include "SimpleAudioEngine.h"
+#include <chrono>
 
 using namespace std;
 using namespace cocos2d;
@@ -18,16 +19,21 @@ using namespace CocosDenshion;
 ButtonRUBELayer::ButtonRUBELayer()
 {
     m_buttonTouch = NULL;
-    m_touchedButton = false;
+    m_touchedButton = NULL;
+}
+
+ButtonRUBELayer::~ButtonRUBELayer()
+{
+    releaseButtons();
 }
 void ButtonRUBELayer::onEnter()
 {
     Layer::onEnter();
 
     auto listener = EventListenerTouchAllAtOnce::create();
-    listener->onTouchesBegan = CC_CALLBACK_2(ButtonRUBELayer::onTouchesBegan, this);
-    listener->onTouchesMoved = CC_CALLBACK_2(ButtonRUBELayer::onTouchesMoved, this);
-    listener->onTouchesEnded = CC_CALLBACK_2(ButtonRUBELayer::onTouchesEnded, this);
+    listener->onTouchesBegan = CC_CALLBACK_2(ButtonRUBELayer::touchesBegan, this);
+    listener->onTouchesMoved = CC_CALLBACK_2(ButtonRUBELayer::touchesMoved, this);
+    listener->onTouchesEnded = CC_CALLBACK_2(ButtonRUBELayer::touchesEnded, this);
     
     _eventDispatcher->addEventListenerWithSceneGraphPriority(listener, this); 
 }
@@ -55,12 +61,15 @@ float ButtonRUBELayer::initialWorldScale()
     return h / 6.4; 
 }
 
-int getAllImagesOnBody( std::vector<b2dJsonImage*>& images, b2Body* b, std::vector<b2dJsonImage*>& result )
+// Debug builds get an extra menu item to run the highlight benchmark on the loaded buttons
+Layer* ButtonRUBELayer::setupMenuLayer()
 {
-    for (int i = 0; i < images.size(); i++)
-        if ( images[i]->body == b )
-            result.push_back(images[i]);
-    return result.size();
+    RUBELayer::setupMenuLayer();
+#if COCOS2D_DEBUG > 0
+    m_menuLayer->addChild( MenuItemFont::create("Highlights", CC_CALLBACK_1(ButtonRUBELayer::runHighlightBenchmark, this)) );
+    m_menuLayer->alignItemsHorizontally();
+#endif
+    return m_menuLayer;
 }
 
 SEL_CallFunc ButtonRUBELayer::getSelectorByName(string name)
@@ -76,11 +85,13 @@ void ButtonRUBELayer::registerSelector(std::string name, cocos2d::SEL_CallFunc s
     m_selectorMap[name] = selector;
 }
 
+// The images are found with the indexes in RUBELayer, so this is linear in the
+// number of fixtures. The -buttons mode of tools/rubebench times the same matching.
 void ButtonRUBELayer::setupButtonActions(b2dJson* json)
 {
-    std::vector<b2dJsonImage*> allImages;
-    json->getAllImages(allImages);
-
+    releaseButtons();
+    TextureCache* textureCache = Director::getInstance()->getTextureCache();
+    
     for (b2Body* b = m_world->GetBodyList(); b; b = b->GetNext()) {
         for (b2Fixture* f = b->GetFixtureList(); f; f = f->GetNext()) {
             
@@ -92,28 +103,30 @@ void ButtonRUBELayer::setupButtonActions(b2dJson* json)
             //bi.sceneClassType = NULL;
             bi.imageFile_normal = "";
             bi.imageFile_hover = "";
+            bi.texture_normal = NULL;
+            bi.texture_hover = NULL;
             bi.highlighted = false;
             bi.sprite = NULL;
             
             //look for all images on this body
-            vector<b2dJsonImage*> imagesOnBody;
-            if ( getAllImagesOnBody(allImages, b, imagesOnBody) > 0 ) {
-                b2dJsonImage* baseImage = imagesOnBody[0];
-                bi.sprite = getAnySpriteOnBody(b);
-                if ( imagesOnBody.size() > 1 && f->GetType() == b2Shape::e_polygon ) {
+            const vector<RUBEImageInfo*>* imagesOnBody = getImageInfosOnBody(b);
+            if ( imagesOnBody ) {
+                RUBEImageInfo* baseImage = (*imagesOnBody)[0];
+                if ( imagesOnBody->size() > 1 && f->GetType() == b2Shape::e_polygon ) {
                     b2PolygonShape* poly = (b2PolygonShape*)f->GetShape();
                     float bestDist = FLT_MAX;
-                    for (int i = 0; i < imagesOnBody.size(); i++) {
-                        float dist = (imagesOnBody[i]->center - poly->m_centroid).Length();
+                    for (int i = 0; i < imagesOnBody->size(); i++) {
+                        RUBEImageInfo* imgInfo = (*imagesOnBody)[i];
+                        float dist = (b2Vec2(imgInfo->center.x, imgInfo->center.y) - poly->m_centroid).Length();
                         if ( dist < bestDist ) {
                             bestDist = dist;
-                            baseImage = imagesOnBody[i];
-                            bi.sprite = getSpriteWithImageName(imagesOnBody[i]->name);
+                            baseImage = imgInfo;
                         }
                     }
                 }
-                string baseImageName = baseImage->name;
-                b2dJsonImage* hoverImage = json->getImageByName(baseImageName + "_hover");
+                bi.sprite = baseImage->sprite;
+                const vector<RUBEImageInfo*>* hoverImages = getImageInfosWithName(baseImage->name + "_hover");
+                RUBEImageInfo* hoverImage = hoverImages ? (*hoverImages)[0] : NULL;
                 bi.imageFile_normal = baseImage->file;
                 memcpy(bi.colorTint_normal, baseImage->colorTint, 4 * sizeof(int));
                 if ( hoverImage ) {
@@ -134,12 +147,47 @@ void ButtonRUBELayer::setupButtonActions(b2dJson* json)
                     CCLOG("Failed to find class for %s", bi.sceneName.c_str());
             }*/
             
-            if ( bi.selector || /*bi.sceneClassType ||*/ !bi.imageFile_hover.empty() )
+            if ( bi.selector || /*bi.sceneClassType ||*/ !bi.imageFile_hover.empty() ) {
+                if ( !bi.imageFile_normal.empty() ) {
+                    bi.texture_normal = textureCache->addImage(bi.imageFile_normal);
+                    CC_SAFE_RETAIN(bi.texture_normal);
+                }
+                if ( !bi.imageFile_hover.empty() ) {
+                    bi.texture_hover = textureCache->addImage(bi.imageFile_hover);
+                    CC_SAFE_RETAIN(bi.texture_hover);
+                }
+                m_buttonIndexes[f] = m_buttons.size();
+                for (int c = 0; c < f->GetShape()->GetChildCount(); c++) {
+                    b2AABB aabb;
+                    f->GetShape()->ComputeAABB(&aabb, b->GetTransform(), c);
+                    _buttonProxy bp;
+                    bp.proxyId = m_buttonTree.CreateProxy(aabb, (void*)(intptr_t)m_buttonProxies.size());
+                    bp.buttonIndex = m_buttons.size();
+                    bp.childIndex = c;
+                    m_buttonProxies.push_back(bp);
+                }
                 m_buttons.push_back(bi);
+            }
         }
     }
 }
 
+// Forgets all the buttons and lets go of their textures
+void ButtonRUBELayer::releaseButtons()
+{
+    for (int i = 0; i < m_buttons.size(); i++) {
+        CC_SAFE_RELEASE(m_buttons[i].texture_normal);
+        CC_SAFE_RELEASE(m_buttons[i].texture_hover);
+    }
+    m_buttons.clear();
+    m_buttonIndexes.clear();
+    for (int i = 0; i < (int)m_buttonProxies.size(); i++)
+        m_buttonTree.DestroyProxy(m_buttonProxies[i].proxyId);
+    m_buttonProxies.clear();
+    m_buttonTouch = NULL;
+    m_touchedButton = NULL;
+}
+
 void ButtonRUBELayer::afterLoadProcessing(b2dJson* json)
 {
     RUBELayer::afterLoadProcessing(json);
@@ -156,12 +204,67 @@ void ButtonRUBELayer::draw()
 
 _buttonInfo* ButtonRUBELayer::getButtonInfo(b2Fixture* fixture)
 {
-    for (int i = 0; i < m_buttons.size(); i++) {
-        _buttonInfo& bi = m_buttons[i];
-        if (fixture == bi.fixture)
-            return &bi;
+    unordered_map<b2Fixture*, int>::iterator it = m_buttonIndexes.find(fixture);
+    if ( it == m_buttonIndexes.end() )
+        return NULL;
+    return &m_buttons[it->second];
+}
+
+// Called by m_buttonTree for each button AABB that the touch point is in
+class ButtonTreeQueryCallback
+{
+public:
+    const b2DynamicTree* m_tree;
+    const vector<_buttonProxy>* m_proxies;
+    vector<_buttonInfo>* m_buttons;
+    b2Vec2 m_point;
+    _buttonInfo* m_button;
+
+    bool QueryCallback(int32 proxyId)
+    {
+        const _buttonProxy& bp = (*m_proxies)[ (intptr_t)m_tree->GetUserData(proxyId) ];
+        _buttonInfo* bi = &(*m_buttons)[bp.buttonIndex];
+        if ( !bi->fixture->GetBody()->IsActive() || !bi->fixture->TestPoint(m_point) )
+            return true; //keep going
+        m_button = bi;
+        return false;
     }
-    return NULL;
+};
+
+// Queries a tree that holds only the button fixtures, so the rest of the world is
+// never looked at, and a button under some other fixture can still be pressed.
+// Buttons on bodies that are not static are brought up to date first, which does
+// not change the tree unless they have moved out of their fattened AABB.
+_buttonInfo* ButtonRUBELayer::getTouchedButton(Touch* touch)
+{
+    if ( m_buttonProxies.empty() )
+        return NULL;
+    
+    for (int i = 0; i < (int)m_buttonProxies.size(); i++) {
+        const _buttonProxy& bp = m_buttonProxies[i];
+        b2Fixture* f = m_buttons[bp.buttonIndex].fixture;
+        b2Body* b = f->GetBody();
+        if ( b->GetType() == b2_staticBody )
+            continue;
+        b2AABB aabb;
+        f->GetShape()->ComputeAABB(&aabb, b->GetTransform(), bp.childIndex);
+        m_buttonTree.MoveProxy(bp.proxyId, aabb, b2Vec2(0,0));
+    }
+    
+    CCPoint screenPos = touch->getLocationInView();
+    b2Vec2 worldPos = screenToWorld(screenPos);
+    
+    ButtonTreeQueryCallback callback;
+    callback.m_tree = &m_buttonTree;
+    callback.m_proxies = &m_buttonProxies;
+    callback.m_buttons = &m_buttons;
+    callback.m_point = worldPos;
+    callback.m_button = NULL;
+    b2AABB aabb;
+    aabb.lowerBound = worldPos;
+    aabb.upperBound = worldPos;
+    m_buttonTree.Query(&callback, aabb);
+    return callback.m_button;
 }
 
 void ButtonRUBELayer::setButtonHighlighted(_buttonInfo* bi, bool tf)
@@ -180,22 +283,47 @@ void ButtonRUBELayer::setButtonHighlighted(_buttonInfo* bi, bool tf)
     if ( !bi->sprite )
         return;
     
-    if ( tf && !bi->imageFile_hover.empty() ) {
-        bi->sprite->setTexture( Sprite::create(bi->imageFile_hover.c_str())->getTexture() );
+    if ( tf && bi->texture_hover ) {
+        bi->sprite->setTexture( bi->texture_hover );
         bi->sprite->setColor( ccc3(bi->colorTint_hover[0], bi->colorTint_hover[1], bi->colorTint_hover[2]) );
         bi->sprite->setOpacity(bi->colorTint_hover[3]);
     }
-    else if ( !tf && !bi->imageFile_normal.empty() ) {
-        bi->sprite->setTexture( Sprite::create(bi->imageFile_normal.c_str())->getTexture() );
+    else if ( !tf && bi->texture_normal ) {
+        bi->sprite->setTexture( bi->texture_normal );
         bi->sprite->setColor( ccc3(bi->colorTint_normal[0], bi->colorTint_normal[1], bi->colorTint_normal[2]) );
         bi->sprite->setOpacity(bi->colorTint_normal[3]);
     }
 }
 
+// Run from the "Highlights" menu item in debug builds. The state is left as it was
+// found, with every button not highlighted.
+void ButtonRUBELayer::benchmarkButtonHighlights(int frames)
+{
+    int count = b2Min((int)m_buttons.size(), 1000);
+    if ( count == 0 || frames < 1 )
+        return;
+    
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+        bool tf = (frame % 2) == 0;
+        for (int i = 0; i < count; i++)
+            setButtonHighlighted(&m_buttons[i], tf);
+    }
+    for (int i = 0; i < count; i++)
+        setButtonHighlighted(&m_buttons[i], false);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    
+    CCLOG("Toggled %d buttons for %d frames: %.3f ms per frame", count, frames, elapsed.count() / frames);
+}
+
+void ButtonRUBELayer::runHighlightBenchmark(Object* sender)
+{
+    benchmarkButtonHighlights(60);
+}
+
 void ButtonRUBELayer::doButtonTouch(Touch* touch)
 {
-    b2Fixture* f = getTouchedFixture(touch);
-    _buttonInfo* bi = getButtonInfo(f);
+    _buttonInfo* bi = getTouchedButton(touch);
     if ( bi && bi == m_touchedButton && allowButtonPresses() ) {
         //CCLOG("Detected touch on button fixture %08X", bi->fixture);
         if ( bi->selector ) {
@@ -217,8 +345,7 @@ void ButtonRUBELayer::onTouchesBegan(const std::vector<Touch*>& touches, Event*
 
     if ( ! m_touchedButton ) {
         m_buttonTouch = touch;
-        b2Fixture* f = getTouchedFixture(touch);
-        m_touchedButton = getButtonInfo(f);
+        m_touchedButton = getTouchedButton(touch);
         if ( m_touchedButton )
             setButtonHighlighted(m_touchedButton, true);
         
@@ -235,8 +362,7 @@ void ButtonRUBELayer::onTouchesMoved(const std::vector<Touch*>& touches, Event*
     
     if ( touch == m_buttonTouch ) {
         if ( m_touchedButton ) {
-            b2Fixture* f = getTouchedFixture(touch);
-            _buttonInfo* bi = getButtonInfo(f);
+            _buttonInfo* bi = getTouchedButton(touch);
             
             setButtonHighlighted(m_touchedButton, (bi == m_touchedButton));
         }
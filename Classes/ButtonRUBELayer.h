@@ -37,15 +37,27 @@ struct _buttonInfo {
     std::string imageFile_hover;
     int colorTint_normal[4];
     int colorTint_hover[4];
+    cocos2d::Texture2D* texture_normal;     // looked up once in setupButtonActions and retained, so changing
+    cocos2d::Texture2D* texture_hover;      // the highlight does not need to go through the texture cache
     bool highlighted;
     cocos2d::Sprite* sprite;
 };
 
+// One child of a button fixture in the button tree (chain shapes have several)
+struct _buttonProxy {
+    int proxyId;
+    int buttonIndex;
+    int childIndex;
+};
+
 class ButtonRUBELayer : public RUBELayer
 {
 protected:
     std::string m_filename;
-    std::vector<_buttonInfo> m_buttons;
+    std::vector<_buttonInfo> m_buttons;                 // only added to in setupButtonActions, so pointers into this stay good until the next load
+    std::unordered_map<b2Fixture*, int> m_buttonIndexes; // the index in m_buttons of the button for each fixture
+    b2DynamicTree m_buttonTree;                         // the AABBs of the button fixtures and nothing else, for finding the touched one
+    std::vector<_buttonProxy> m_buttonProxies;          // the user data of each proxy in m_buttonTree is its index in here
     
     cocos2d::Touch* m_buttonTouch;
     _buttonInfo* m_touchedButton;
@@ -55,20 +67,27 @@ protected:
     
     cocos2d::SEL_CallFunc getSelectorByName(std::string name);
     void registerSelector(std::string name, cocos2d::SEL_CallFunc selector);
+    
+    void benchmarkButtonHighlights(int frames);                 // toggles up to 1000 buttons per frame and logs the time per frame
+    void runHighlightBenchmark(cocos2d::Object* sender);        // for the "Highlights" menu item in debug builds
 
 public:
     ButtonRUBELayer();
+    virtual ~ButtonRUBELayer();
     virtual void onEnter();  
     virtual std::string getFilename();
     virtual cocos2d::CCPoint initialWorldOffset();
     virtual float initialWorldScale();
+    virtual cocos2d::Layer* setupMenuLayer();
     
     virtual void afterLoadProcessing(b2dJson* json);
     
     virtual void draw();
     
     void setupButtonActions(b2dJson* json);    
+    void releaseButtons();
     _buttonInfo* getButtonInfo(b2Fixture* fixture);
+    _buttonInfo* getTouchedButton(cocos2d::Touch* touch);   // like getTouchedFixture, but only looks at the button fixtures (through m_buttonTree)
     
     void setButtonHighlighted(_buttonInfo* bi, bool tf);
     void doButtonTouch(cocos2d::Touch* touch);
@@ -40,6 +40,9 @@ Scene* MenuScreenRUBELayer::scene()
     MenuScreenRUBELayer* layer = new MenuScreenRUBELayer();    
     layer->init();// do things that require virtual functions (can't do in constructor)
     scene->addChild(layer);
+#if COCOS2D_DEBUG > 0
+    scene->addChild(layer->setupMenuLayer());     // for the "Highlights" item, see ButtonRUBELayer::setupMenuLayer
+#endif
     layer->release();
     
     return scene;
@@ -9,6 +9,8 @@
 #include "PinballRUBELayer.h"
 #include "rubestuff/b2dJson.h"
 #include "QueryCallbacks.h"
+#include "Box2DContactDispatcher.h"
+#include "RUBECollisionMatrix.h"
 
 using namespace std;
 USING_NS_CC;
@@ -34,10 +36,11 @@ void PinballRUBELayer::onEnter()
 {
     Layer::onEnter();
 	 
+    // the base class wrappers record the touches (see recordInput) before passing them on
     auto listener = EventListenerTouchAllAtOnce::create();
-    listener->onTouchesBegan = CC_CALLBACK_2(PinballRUBELayer::onTouchesBegan, this);
+    listener->onTouchesBegan = CC_CALLBACK_2(BasicRUBELayer::touchesBegan, this);
    
-    listener->onTouchesEnded = CC_CALLBACK_2(PinballRUBELayer::onTouchesEnded, this);
+    listener->onTouchesEnded = CC_CALLBACK_2(BasicRUBELayer::touchesEnded, this);
     
     _eventDispatcher->addEventListenerWithSceneGraphPriority(listener, this); 
 }
@@ -86,12 +89,14 @@ enum {
     
     PFT_MAX
 };
-const char* fixtureNames[] = {
-    "level1",
-    "level2",
-    "ball",
-    "drop",
-    "gutter"
+
+// the fixtures in the scene with these names are given the tags
+static const RUBEContactTag pinballContactTags[] = {
+    { "level1", PFT_LEVEL1 },
+    { "level2", PFT_LEVEL2 },
+    { "ball",   PFT_BALL },
+    { "drop",   PFT_DROP },
+    { "gutter", PFT_GUTTER }
 };
 
 // This is called after the Box2D world has been loaded, and while the b2dJson information
@@ -123,34 +128,6 @@ void PinballRUBELayer::afterLoadProcessing(b2dJson* json)
             m_ballSprite = imgInfo->sprite;
     }
     
-    // look for fixtures that will be used in the collision callback, and
-    // give them a 'tag' by setting their user data. Usually, the user data
-    // would be a pointer to some type of object or structure with more
-    // information (see the PlanetCute demo for an example) but for this
-    // case we can simply set the user data to a plain old integer to denote
-    // the type of each fixture.
-    int numFixtureNames = sizeof(fixtureNames) / sizeof(char*);
-    for (int i = 0; i < numFixtureNames; i++) {
-        
-        // get a list of fixtures with this name
-        vector<b2Fixture*> switchFixtures;
-        json->getFixturesByName(fixtureNames[i], switchFixtures);
-        
-        // set the 'tag' of all fixtures - note that this will give fixtures on
-        // level1 and level2 tags of 1 and 2 respectively.
-        for (int k = 0; k < switchFixtures.size(); k++)
-            switchFixtures[k]->SetUserData((void*)(i+1));
-    }
-    
-    // create a contact listener and let the Box2D world know about it
-    m_contactListener = new PinballContactListener();
-    m_world->SetContactListener( m_contactListener );
-    
-    // set the initial states for the contact listener info
-    m_contactListener->m_needToSetLevel = 0;
-    m_contactListener->m_needToHaltVelocity = false;
-    m_contactListener->m_needToResetGame = false;
-    
     // set initial flipper states to off
     m_leftFlipperTouch = NULL;
     m_rightFlipperTouch = NULL;
@@ -158,6 +135,15 @@ void PinballRUBELayer::afterLoadProcessing(b2dJson* json)
 }
 
 
+// Look for fixtures that we want to know about collisions for, and give them
+// a tag so that the contact events will record them (see useContactEvents).
+// Fixtures without a tag are ignored.
+void PinballRUBELayer::tagContactFixtures(b2dJson* json)
+{
+    tagFixtures(json, pinballContactTags, sizeof(pinballContactTags) / sizeof(pinballContactTags[0]));
+}
+
+
 // This method should undo anything that was done by afterLoadProcessing, and make sure
 // to call the superclass method so it can do the same
 void PinballRUBELayer::clear()
@@ -170,17 +156,30 @@ void PinballRUBELayer::clear()
     
     m_leftFlipperTouch = NULL;
     m_rightFlipperTouch = NULL;
-	 
-	//delete m_contactListener;
-	 
     
     RUBELayer::clear();
 }
 
 
-// after every physics step, we need to check if the collision listener detected
-// a collision that we should do something about. This info will be stored in the
-// collision listener class itself
+// The flipper touches are recorded, so that a game can be played back with the Replay
+// button to check that it comes out exactly the same (see BasicRUBELayer::replayInput)
+bool PinballRUBELayer::recordInput()
+{
+    return true;
+}
+
+
+// The world will record contacts between fixtures given a tag in tagContactFixtures,
+// for the update method to go through after each step
+bool PinballRUBELayer::useContactEvents()
+{
+    return true;
+}
+
+
+// after every physics step, we need to check if any collisions happened that
+// we should do something about. These are recorded by the contact events, and
+// are dealt with here in the order they happened.
 void PinballRUBELayer::update(float dt)
 {
     //superclass will Step the physics world
@@ -188,31 +187,81 @@ void PinballRUBELayer::update(float dt)
     
     // adjust the motor speed of the flippers according to whether the player
     // is touching them or not. 
-    float leftFlippersMotorSpeed = m_leftFlipperTouch ? 20 : -10;
-    float rightFlippersMotorSpeed = m_rightFlipperTouch ? -20 : 10;
-    for (int i = 0; i < m_leftFlipperJoints.size(); i++)
-        ((b2RevoluteJoint*)m_leftFlipperJoints[i])->SetMotorSpeed( leftFlippersMotorSpeed );
-    for (int i = 0; i < m_rightFlipperJoints.size(); i++)
-        ((b2RevoluteJoint*)m_rightFlipperJoints[i])->SetMotorSpeed( rightFlippersMotorSpeed );
-    
-    // if the table needs to be reset, place the ball at the starting position
-    if ( m_contactListener->m_needToResetGame )
-        m_ballFixture->GetBody()->SetTransform(m_ballStartPosition, 0);    
+    {
+        RUBE_PROFILE_SCOPE(PS_GAME);
+        float leftFlippersMotorSpeed = m_leftFlipperTouch ? 20 : -10;
+        float rightFlippersMotorSpeed = m_rightFlipperTouch ? -20 : 10;
+        for (int i = 0; i < m_leftFlipperJoints.size(); i++)
+            ((b2RevoluteJoint*)m_leftFlipperJoints[i])->SetMotorSpeed( leftFlippersMotorSpeed );
+        for (int i = 0; i < m_rightFlipperJoints.size(); i++)
+            ((b2RevoluteJoint*)m_rightFlipperJoints[i])->SetMotorSpeed( rightFlippersMotorSpeed );
+    }
     
-    // if the ball should be halted, simply set its velocity to zero
-    if ( m_contactListener->m_needToHaltVelocity )
-        m_ballFixture->GetBody()->SetLinearVelocity(b2Vec2(0,0));
+    if ( !m_contactEvents )
+        return;
     
-    // if the ball touched a level-switch sensor, update the filter mask bits
-    // for the ball fixture according to the level it just entered
-    if ( m_contactListener->m_needToSetLevel ) {
+    RUBE_PROFILE_SCOPE(PS_CONTACTS);
+    
+    // each event goes straight to the function for its pair of tags
+    typedef Box2DContactDispatcher<PinballRUBELayer> PinballDispatcher;
+    static const PinballDispatcher::Rule rules[] = {
+        { CE_BEGIN, PFT_BALL, PFT_LEVEL1, &PinballRUBELayer::ballTouchedLevel1 },
+        { CE_BEGIN, PFT_BALL, PFT_LEVEL2, &PinballRUBELayer::ballTouchedLevel2 },
+        { CE_BEGIN, PFT_BALL, PFT_DROP,   &PinballRUBELayer::ballTouchedDrop },
+        { CE_BEGIN, PFT_BALL, PFT_GUTTER, &PinballRUBELayer::ballTouchedGutter },
+    };
+    static const PinballDispatcher dispatcher(rules, sizeof(rules) / sizeof(rules[0]), PFT_MAX);
+    dispatcher.dispatch(this, m_contactEvents);
+}
+
+
+// the ball touched a level-switch sensor
+void PinballRUBELayer::ballTouchedLevel1(Box2DContactEvent& e)
+{
+    setBallLevel(1);
+}
+
+void PinballRUBELayer::ballTouchedLevel2(Box2DContactEvent& e)
+{
+    setBallLevel(2);
+}
+
+
+// the ball touched the vertical drop at the end of an upper-level chute, so halt it
+// momentarily so it looks like it dropped vertically
+void PinballRUBELayer::ballTouchedDrop(Box2DContactEvent& e)
+{
+    m_ballFixture->GetBody()->SetLinearVelocity(b2Vec2(0,0));
+    setBallLevel(1);
+}
+
 
+// the ball touched the gutter at the bottom of the table, so place the ball at the
+// starting position
+void PinballRUBELayer::ballTouchedGutter(Box2DContactEvent& e)
+{
+    m_ballFixture->GetBody()->SetTransform(m_ballStartPosition, 0);
+    m_ballFixture->GetBody()->SetLinearVelocity(b2Vec2(0,0));
+    setBallLevel(2);
+}
+
+
+// Updates the filter mask bits for the ball fixture according to the level it just entered
+void PinballRUBELayer::setBallLevel(int level)
+{
+    if ( m_collisionMatrix ) {
+        // if the scene was given a collision matrix (see RUBECollisionMatrix.h), it should
+        // have a group for the ball on each level, and the ball just moves to the right one
+        if ( ! m_collisionMatrix->setFixtureGroup(m_ballFixture, level == 1 ? "ballLevel1" : "ballLevel2") )
+            CCLOG("Collision matrix has no group for the ball on level %d", level);
+    }
+    else {
         // get the current filter
         b2Filter filter = m_ballFixture->GetFilterData();
         
         // update just the mask bits (the 4 here is to make sure the ball always
         // collides with the level-switch sensors
-        filter.maskBits = 4 | m_contactListener->m_needToSetLevel;
+        filter.maskBits = 4 | level;
         
         // set the updated filter in the fixture, and refilter (the refilter may
         // be necessary in cases where the ball is already touching something that
@@ -221,19 +270,14 @@ void PinballRUBELayer::update(float dt)
         m_ballFixture->Refilter();
     }
     
-    // if the level was switched, we should also reorder the ball sprite to
-    // make it appear to go under the upper level parts of the table
+    // we should also reorder the ball sprite to make it appear to go under
+    // the upper level parts of the table
     if ( m_ballSprite ) {
-        if ( m_contactListener->m_needToSetLevel == 1 )
+        if ( level == 1 )
             reorderChild(m_ballSprite, 15);
-        if ( m_contactListener->m_needToSetLevel == 2 )
+        if ( level == 2 )
             reorderChild(m_ballSprite, 25);
     }
-
-    // reset all the info in the collision listener
-    m_contactListener->m_needToResetGame = false;
-    m_contactListener->m_needToHaltVelocity = false;
-    m_contactListener->m_needToSetLevel = 0;
 }
 
 
@@ -297,63 +341,3 @@ void PinballRUBELayer::onTouchesEnded(const std::vector<Touch*>& touches, Event*
             m_rightFlipperTouch = NULL;
     }
 }
-
-
-
-
-
-
-//-------------- Contact listener class ------------------------
-
-// This function will be called by Box2D during the Step function. We can
-// use the info in the contact to see which two fixtures collided, but we
-// cannot fiddle with the Box2D world inside the contact listener.
-//
-// Instead, we just record what needs to be done after the Step has finished,
-// and the PinballRUBELayer class will deal with it (in the tick method).
-//
-void PinballContactListener::BeginContact(b2Contact* contact)
-{
-    // we know that fixture datas are just integers
-    int tagA = (int)contact->GetFixtureA()->GetUserData();
-    int tagB = (int)contact->GetFixtureB()->GetUserData();
-    
-    // both fixtures should have a tag otherwise we don't care about them
-    if ( tagA == 0 || tagB == 0 )
-        return;
-    
-    
-    // the repetitive and error-prone nature of these comparisons leads me to
-    // make a macro to keep it easier to read...
-#define COMPARETAGS( tag1, tag2 ) \
-    ( (tagA == tag1 && tagB == tag2) || (tagA == tag2 && tagB == tag1) )
-    
-    
-    // check if the ball touched a level-switch sensor
-    if ( COMPARETAGS(PFT_BALL, PFT_LEVEL1) )
-        m_needToSetLevel = 1;
-    if ( COMPARETAGS(PFT_BALL, PFT_LEVEL2) )
-        m_needToSetLevel = 2;
-    
-    // check if the ball touched the vertical drop at the end of an upper-level chute
-    if ( COMPARETAGS(PFT_BALL, PFT_DROP) ) {
-        m_needToHaltVelocity = true;
-        m_needToSetLevel = 1;
-    }
-    
-    // check if the ball touched the gutter at the bottom of the table
-    if ( COMPARETAGS(PFT_BALL, PFT_GUTTER) ) {
-        m_needToHaltVelocity = true;
-        m_needToResetGame = true;
-        m_needToSetLevel = 2;
-    }
-}
-
-
-
-
-
-
-
-
-
@@ -5,7 +5,7 @@
 //
 //  Extends RUBELayer to demonstrate how specific items in
 //  the RUBE scene can be obtained and controlled. Also shows
-//  simple use of a contact listener to detect collisions.
+//  simple use of contact events to detect collisions.
 //
 //  To be more specific, we want to obtain these items after loading:
 //   - flipper joints
@@ -50,28 +50,6 @@
 #include "rubestuff/b2dJson.h"
 
 
-// The BeginContact function in this class will be called by Box2D during
-// the Step function. We can use the info in the contact to see which two
-// fixtures collided, but we cannot fiddle with the Box2D world inside the
-// contact listener because it gets grumpy if fiddled with while busy.
-//
-// However, the layer holds a reference to this contact listener, so we
-// can update some variables to let the layer know something needs to be
-// done after the physics Step has completed (in the tick method). The
-// three 'needTo...' variables here are used to relay this information.
-class PinballContactListener : public b2ContactListener
-{
-public:
-	virtual void BeginContact(b2Contact* contact);      // called by Box2D during the Step function when two fixtures begin touching
-    
-    int m_needToSetLevel;                               // when the ball touches a level-switch sensor, this will be set to the level to switch to, otherwise it will be zero
-    bool m_needToHaltVelocity;                          // when the ball touches the end of one of the upper level tracks, this will be set to true, so we know to momentarily halt it (so it looks like it dropped vertically)
-    bool m_needToResetGame;                             // when the ball touches the gutter fixture at the bottom of the table, this will be set to true
-    
-};
-
-//-----------------------
-
 
 class PinballRUBELayer : public RUBELayer
 {
@@ -90,8 +68,6 @@ protected:
     
     cocos2d::Sprite* m_ballSprite;                        // need this to reorder the ball sprite when the ball changes levels, to make it look like it is going underneath the upper level
     
-    PinballContactListener* m_contactListener;              // lets us know when two fixtures touched
-    
 public:
     static cocos2d::Scene* scene();                       // returns a scene that contains this as the only child
     virtual void onEnter();  
@@ -100,7 +76,16 @@ public:
     virtual float initialWorldScale();                      // overrides base class
     
     virtual void afterLoadProcessing(b2dJson* json);        // overrides base class
+    virtual void tagContactFixtures(b2dJson* json);         // overrides base class
     virtual void clear();                                   // overrides base class
+    virtual bool useContactEvents();                        // overrides base class
+    virtual bool recordInput();                             // overrides base class
+    
+    void setBallLevel(int level);                           // changes which level of the table the ball collides with
+    void ballTouchedLevel1(struct Box2DContactEvent& e);    // these are called for the contact events after each step
+    void ballTouchedLevel2(struct Box2DContactEvent& e);
+    void ballTouchedDrop(struct Box2DContactEvent& e);
+    void ballTouchedGutter(struct Box2DContactEvent& e);
     
     virtual void update(float dt);                          // standard Cocos2d function
     virtual void draw();                                    // standard Cocos2d function
@@ -10,6 +10,7 @@
 #include "PlanetCuteRUBELayer.h"
 #include "SimpleAudioEngine.h"
 #include "UIControlsRUBELayer.h"
+#include "Box2DContactEvents.h"
 
 using namespace std;
 using namespace cocos2d;
@@ -91,20 +92,19 @@ void PlanetCuteRUBELayer::afterLoadProcessing(b2dJson* json)
         // set some basic properties of the FixtureUserData
         fud->fixtureType = FT_PICKUP;
         fud->body = f->GetBody();
-        fud->originalPosition = f->GetBody()->GetPosition();
 
         // use the custom properties given to the fixture in the RUBE scene
         fud->pickupType = (_pickupType)json->getCustomInt(f, "pickuptype", PT_GEM);
-        fud->bounceSpeedH = json->getCustomFloat(f, "horizontalbouncespeed");
-        fud->bounceSpeedV = json->getCustomFloat(f, "verticalbouncespeed");
-        fud->bounceWidth  = json->getCustomFloat(f, "bouncewidth");
-        fud->bounceHeight = json->getCustomFloat(f, "bounceheight");
         
-        // these "bounce deltas" are just a number given to sin when wobbling
-        // the pickups. Each pickup has its own value to stop them from looking
-        // like they are moving in unison.
-        fud->bounceDeltaH = CCRANDOM_0_1() * M_PI_2;
-        fud->bounceDeltaV = CCRANDOM_0_1() * M_PI_2;
+        // The pickup wobbles around where it was placed in the scene. The starting
+        // phases are just a number given to sin, and each pickup has its own random
+        // ones to stop them from looking like they are moving in unison.
+        m_pickupAnimator.addOscillator( fud->body, fud->body->GetPosition(),
+                                        json->getCustomFloat(f, "horizontalbouncespeed"),
+                                        json->getCustomFloat(f, "verticalbouncespeed"),
+                                        json->getCustomFloat(f, "bouncewidth"),
+                                        json->getCustomFloat(f, "bounceheight"),
+                                        CCRANDOM_0_1() * M_PI_2, CCRANDOM_0_1() * M_PI_2 );
     }
     
     // find the imageInfos for the text instruction images. Sprites 2 and 3 are
@@ -126,13 +126,6 @@ void PlanetCuteRUBELayer::afterLoadProcessing(b2dJson* json)
         }
     }
     
-    // Create a contact listener and let the Box2D world know about it.
-    m_contactListener = new PlanetCuteContactListener();
-    m_world->SetContactListener( m_contactListener );
-
-    // Give the listener a reference to this class, to use in the callback
-    m_contactListener->m_layer = this;
-
     // set the movement control touches to nil initially
     m_leftTouch = NULL;
     m_rightTouch = NULL;
@@ -146,6 +139,23 @@ void PlanetCuteRUBELayer::afterLoadProcessing(b2dJson* json)
 }
 
 
+// Tag the pickups and the player fixtures for the contact events. The player
+// body is looked up again, in case a hot reload has made it over.
+void PlanetCuteRUBELayer::tagContactFixtures(b2dJson* json)
+{
+    std::vector<b2Fixture*> pickupFixtures;
+    json->getFixturesByName("pickup", pickupFixtures);
+    for (int i = 0; i < pickupFixtures.size(); i++)
+        m_contactEvents->setTag( pickupFixtures[i], PCT_PICKUP );
+    
+    b2Fixture* footSensorFixture = json->getFixtureByName("footsensor");
+    if ( b2Body* playerBody = json->getBodyByName("player") ) {
+        for (b2Fixture* f = playerBody->GetFixtureList(); f; f = f->GetNext())
+            m_contactEvents->setTag( f, f == footSensorFixture ? PCT_FOOT : PCT_PLAYER );
+    }
+}
+
+
 // This method should undo anything that was done by afterLoadProcessing, and make sure
 // to call the superclass method so it can do the same
 void PlanetCuteRUBELayer::clear()
@@ -157,24 +167,97 @@ void PlanetCuteRUBELayer::clear()
     m_playerBody = NULL;
     m_footSensorFixture = NULL;
     
-    //delete m_contactListener;
-    
     for (set<PlanetCuteFixtureUserData*>::iterator it = m_allPickups.begin(); it != m_allPickups.end(); ++it)
         delete *it;
     m_allPickups.clear();
+    m_pickupAnimator.clear();
         
     RUBELayer::clear();
 }
 
 
-// after every physics step, we need to check if the collision listener detected
-// a collision that we should do something about. This info will be stored in the
-// m_pickupsToProcess set
+// The world will record contacts between fixtures given a tag in tagContactFixtures,
+// for the update method to go through after each step
+bool PlanetCuteRUBELayer::useContactEvents()
+{
+    return true;
+}
+
+
+// The bodies far from the camera are switched off, so the level can be made much
+// bigger without the physics taking any longer.
+bool PlanetCuteRUBELayer::manageBodyActivation()
+{
+    return true;
+}
+
+
+// The contacts are only recorded during the step and gone through in update, so the
+// world can be stepped on another core (eg. with the UIControls layer over the top)
+bool PlanetCuteRUBELayer::stepInParallel()
+{
+    return true;
+}
+
+
+// The view is centered on the camera, which the layer position is set from at the
+// end of update. Using the camera directly means this is already right for the
+// next step, before the layer has been moved.
+b2AABB PlanetCuteRUBELayer::getVisibleRegion()
+{
+    Size s = Director::getInstance()->getWinSize();
+    b2Vec2 halfSize( 0.5f * s.width / getScale(), 0.5f * s.height / getScale() );
+    b2AABB visibleRegion;
+    visibleRegion.lowerBound = m_cameraCenter - halfSize;
+    visibleRegion.upperBound = m_cameraCenter + halfSize;
+    return visibleRegion;
+}
+
+
+// Goes through the contacts recorded since last time. The fixtures of a CE_END event
+// may have been destroyed, so only the tags are looked at for those.
+void PlanetCuteRUBELayer::processContactEvents()
+{
+    RUBE_PROFILE_SCOPE(PS_CONTACTS);
+    Box2DContactEvent e;
+    while ( m_contactEvents->popEvent(e) ) {
+        
+        // keep count of how many things the foot sensor is touching
+        if ( e.matchTags(PCT_FOOT, CE_ANY_TAG) ) {
+            if ( e.type == CE_BEGIN )
+                m_numFootContacts++;
+            else if ( e.type == CE_END )
+                m_numFootContacts--;
+            //CCLOG("Num foot contacts: %d", m_numFootContacts);
+        }
+        
+        // the player touched a pickup (the set makes sure it is only removed once, if
+        // the player touched it with more than one fixture in the same step)
+        if ( e.type == CE_BEGIN && (e.matchTags(PCT_PICKUP, PCT_PLAYER) || e.matchTags(PCT_PICKUP, PCT_FOOT)) ) {
+            PlanetCuteFixtureUserData* fud = (PlanetCuteFixtureUserData*)e.userDataA;
+            if ( m_pickupsToProcess.insert(fud).second )
+                queueBodyForRemoval(fud->body);
+        }
+    }
+}
+
+
+// after every physics step, we need to check if the contact events show a
+// collision that we should do something about. The touched pickups will be
+// put in the m_pickupsToProcess set
 void PlanetCuteRUBELayer::update(float dt)
 {
     // superclass will Step the physics world
     RUBELayer::update(dt);
     
+    // remove the touched pickups right away, and go through the events again to
+    // count the foot contacts that ended because of that
+    processContactEvents();
+    removeQueuedBodies();
+    processContactEvents();
+
+    RUBE_PROFILE_SCOPE(PS_GAME);
+
     // loop over the list of pickups that were touched
     for (set<PlanetCuteFixtureUserData*>::iterator it = m_pickupsToProcess.begin(); it != m_pickupsToProcess.end(); ++it) {
         PlanetCuteFixtureUserData* fud = *it;
@@ -189,8 +272,9 @@ void PlanetCuteRUBELayer::update(float dt)
                 m_instructionsSprite3->sprite->setOpacity(255);
         }
         
-        // clean up all references to the pickup that was collected
-        removeBodyFromWorld(fud->body);
+        // clean up all references to the pickup that was collected (the body itself was
+        // queued for removal when going through the contact events, and is already gone)
+        m_pickupAnimator.removeBody(fud->body);
         m_allPickups.erase(fud);
         delete fud;
         
@@ -200,14 +284,9 @@ void PlanetCuteRUBELayer::update(float dt)
     // after processing all the pickups in the loop above, we need to clear the list
     m_pickupsToProcess.clear();
     
-    // make the pickups wobble around
-    for (set<PlanetCuteFixtureUserData*>::iterator it = m_allPickups.begin(); it != m_allPickups.end(); ++it) {
-        PlanetCuteFixtureUserData* fud = *it;
-        fud->bounceDeltaH += fud->bounceSpeedH;
-        fud->bounceDeltaV += fud->bounceSpeedV;
-        b2Vec2 pos = fud->originalPosition + b2Vec2( fud->bounceWidth * sin(fud->bounceDeltaH), fud->bounceHeight * sin(fud->bounceDeltaV) );
-        fud->body->SetTransform( pos, 0 );
-    }
+    // make the pickups wobble around during the next step (the same fixed time step
+    // that the superclass uses)
+    m_pickupAnimator.step(1/60.0);
     
     // decrement the jump timer - if this gets to zero the player can jump again
     m_jumpTimeout--;
@@ -321,55 +400,3 @@ void PlanetCuteRUBELayer::onTouchesEnded(const std::vector<Touch*>& touches, Eve
             m_rightTouch = NULL;
     }
 }
-
-
-
-
-
-//-------------- Contact listener ------------------------
-
-void PlanetCuteContactListener::BeginContact(b2Contact* contact)
-{
-    PlanetCuteRUBELayer* layer = (PlanetCuteRUBELayer*)m_layer;
-    b2Fixture* fA = contact->GetFixtureA();
-    b2Fixture* fB = contact->GetFixtureB();
-    
-    if ( fA == layer->m_footSensorFixture || fB == layer->m_footSensorFixture ) 
-        layer->m_numFootContacts++;
-    //CCLOG("Num foot contacts: %d", layer->m_numFootContacts);
-    
-    PlanetCuteFixtureUserData* fudA = (PlanetCuteFixtureUserData*)fA->GetUserData();
-    PlanetCuteFixtureUserData* fudB = (PlanetCuteFixtureUserData*)fB->GetUserData();
-    
-    if ( fudA && fudA->fixtureType == FT_PICKUP && fB->GetBody() == layer->m_playerBody ) 
-        layer->m_pickupsToProcess.insert(fudA);
-    if ( fudB && fudB->fixtureType == FT_PICKUP && fA->GetBody() == layer->m_playerBody ) 
-        layer->m_pickupsToProcess.insert(fudB);
-}
-
-void PlanetCuteContactListener::EndContact(b2Contact* contact)
-{
-    PlanetCuteRUBELayer* layer = (PlanetCuteRUBELayer*)m_layer;
-    b2Fixture* fA = contact->GetFixtureA();
-    b2Fixture* fB = contact->GetFixtureB();
-    
-    if ( fA == layer->m_footSensorFixture || fB == layer->m_footSensorFixture )
-        layer->m_numFootContacts--;
-    //CCLOG("Num foot contacts: %d", layer->m_numFootContacts);
-}
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
@@ -18,7 +18,7 @@
 //
 //  The pickups in the game have their category set from a custom
 //  property given to them in RUBE, and are wobbled around according to
-//  some custom properties as well.
+//  some custom properties as well (see Box2DKinematicAnimator.h).
 //
 
 #ifndef PLANET_CUTE_RUBE_LAYER
@@ -26,6 +26,7 @@
 
 #include "RUBELayer.h"
 #include "rubestuff/b2dJson.h"
+#include "Box2DKinematicAnimator.h"
 
 // broad categories to organize fixtures into
 enum _fixtureType {
@@ -68,33 +69,15 @@ struct PlanetCuteFixtureUserData
     _fixtureType fixtureType;
     _pickupType pickupType;
     b2Body* body;
-        
-    b2Vec2 originalPosition;
-    float bounceDeltaH;
-    float bounceDeltaV;
-    float bounceSpeedH;
-    float bounceSpeedV;
-    float bounceWidth;
-    float bounceHeight;
 };
 
 //--------------------------------------
 
-// The BeginContact function in this class will be called by Box2D during
-// the Step function. We can use the info in the contact to see which two
-// fixtures collided, but we cannot fiddle with the Box2D world inside the
-// contact listener because it gets grumpy if fiddled with while busy.
-//
-// Instead, this class holds a reference to the main layer, which it will
-// use to update some variables to let the layer know something needs to be
-// done after the physics Step has completed (in the tick method).
-class PlanetCuteContactListener : public b2ContactListener
-{
-public:
-	virtual void BeginContact(b2Contact* contact);      // called by Box2D during the Step function when two fixtures begin touching
-	virtual void EndContact(b2Contact* contact);        // called by Box2D during the Step function when two fixtures finish touching
-    
-    class PlanetCuteRUBELayer* m_layer;
+// tags given to fixtures so that the contact events record them (see Box2DContactEvents.h)
+enum _contactTag {
+    PCT_PLAYER = 1,
+    PCT_FOOT,
+    PCT_PICKUP
 };
 
 //-----------------------
@@ -105,8 +88,6 @@ protected:
     int m_jumpTimeout;                                  // decremented every tick, and set to a positive value when jumping. It's ok to jump if
                                                         //     this is <= 0 (this is to prevent repeated jumps while the foot sensor is still touching the ground)
     
-    PlanetCuteContactListener* m_contactListener;       // lets us know when two fixtures touched
-    
     cocos2d::Touch* m_leftTouch;                      // used to keep track of when the user touched the left side of the screen (if this is nil, the left side is not touched)
     cocos2d::Touch* m_rightTouch;                     // used to keep track of when the user touched the right side of the screen (if this is nil, the right side is not touched)
     
@@ -123,9 +104,10 @@ public:
     b2Fixture* m_footSensorFixture;                             // a small sensor fixture attached to the bottom of the player body to detect when it's standing on something
     int m_numFootContacts;                                      // the current number of other fixtures touching the foot sensor. If this is > 0 the character is standing on something
     
-    std::set<PlanetCuteFixtureUserData*> m_allPickups;          // a array containing every pickup in the scene. This is used to loop through every tick and make them wobble around.
-    std::set<PlanetCuteFixtureUserData*> m_pickupsToProcess;    // The contact listener will put some pickups in this set when the player touches them. After the Step has finished, the
-                                                                //       layer will look in this list and process any pickups (remove them from world, play sound, count score etc).
+    std::set<PlanetCuteFixtureUserData*> m_allPickups;          // a array containing every pickup in the scene, to delete the user data when clearing the scene.
+    Box2DKinematicAnimator m_pickupAnimator;                    // wobbles the pickups around by setting their velocity every tick
+    std::set<PlanetCuteFixtureUserData*> m_pickupsToProcess;    // Pickups the player touched are put in this set while going through the contact events after the Step, and the
+                                                                //       layer will then look in this list and process them (remove them from world, play sound, count score etc).
                                                                 //       This is made a set instead of an array because a set prevents duplicate objects from being added. Sometimes
                                                                 //       a pickup can collide with more than one other fixture in the same time step (eg. the player and the foot sensor)
                                                                 //       and looping through an array with duplicates would result in removing the same body from the scene twice -> crash.
@@ -138,7 +120,13 @@ public:
     virtual float initialWorldScale();                      // overrides base class
     
     virtual void afterLoadProcessing(b2dJson* json);        // overrides base class
+    virtual void tagContactFixtures(b2dJson* json);         // overrides base class
     virtual void clear();                                   // overrides base class
+    virtual bool useContactEvents();                        // overrides base class
+    void processContactEvents();                            // counts the foot contacts and finds the pickups that were touched
+    virtual bool manageBodyActivation();                    // overrides base class
+    virtual bool stepInParallel();                          // overrides base class
+    virtual b2AABB getVisibleRegion();                      // overrides base class
     
     virtual void update(float dt);                          // standard Cocos2d function
     
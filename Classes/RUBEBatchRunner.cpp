@@ -0,0 +1,377 @@
+//
+//  RUBEBatchRunner
+//
+//  See header file for description.
+//
+
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include "RUBEBatchRunner.h"
+#include "rubestuff/b2dJson.h"
+#include "rubestuff/b2dJsonFileView.h"
+#include "Box2DThreadWarmUp.h"
+
+using namespace std;
+
+RUBEContactTimeMetric::RUBEContactTimeMetric(const string& fixtureName, const string& otherFixtureName, float timeStep)
+{
+    m_fixtureName = fixtureName;
+    m_otherFixtureName = otherFixtureName;
+    m_timeStep = timeStep;
+    m_result = -1;
+}
+
+RUBEBatchMetric* RUBEContactTimeMetric::clone() const
+{
+    return new RUBEContactTimeMetric(m_fixtureName, m_otherFixtureName, m_timeStep);
+}
+
+string RUBEContactTimeMetric::getName() const
+{
+    return m_fixtureName + " touches " + m_otherFixtureName;
+}
+
+void RUBEContactTimeMetric::begin(b2World* world, b2dJson& json)
+{
+    json.getFixturesByName(m_fixtureName, m_fixtures);
+    vector<b2Fixture*> others;
+    json.getFixturesByName(m_otherFixtureName, others);
+    m_otherFixtures.insert(others.begin(), others.end());
+}
+
+// Only the contacts of the bodies with the first fixtures are looked at, instead
+// of every contact in the world
+bool RUBEContactTimeMetric::afterStep(b2World* world, int step)
+{
+    for (int i = 0; i < (int)m_fixtures.size(); i++) {
+        b2Fixture* fixture = m_fixtures[i];
+        for (b2ContactEdge* ce = fixture->GetBody()->GetContactList(); ce; ce = ce->next) {
+            b2Contact* contact = ce->contact;
+            if ( !contact->IsTouching() )
+                continue;
+            b2Fixture* fA = contact->GetFixtureA();
+            b2Fixture* fB = contact->GetFixtureB();
+            if ( (fA == fixture && m_otherFixtures.count(fB)) || (fB == fixture && m_otherFixtures.count(fA)) ) {
+                m_result = (step + 1) * m_timeStep;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+
+
+RUBEBatchRunner::RUBEBatchRunner()
+{
+    m_stepCount = 600;
+    m_timeStep = 1/60.0f;
+    m_velocityIterations = 8;
+    m_positionIterations = 3;
+    m_stolenCount = 0;
+    m_totalTime = 0;
+}
+
+RUBEBatchRunner::~RUBEBatchRunner()
+{
+    for (int i = 0; i < (int)m_metrics.size(); i++)
+        delete m_metrics[i];
+}
+
+bool RUBEBatchRunner::loadScene(const string& filename, string& errorMsg)
+{
+    b2dJsonFileView file;
+    if ( ! file.open(filename, errorMsg) )
+        return false;
+
+    Json::Value scene;
+    Json::Reader reader;
+    if ( ! reader.parse(file.data(), file.data() + file.size(), scene, false) ) {
+        errorMsg = string("Failed to parse JSON:\n") + reader.getFormatedErrorMessages();
+        return false;
+    }
+    m_scene.swap(scene);
+    return true;
+}
+
+void RUBEBatchRunner::addParameter(int type, const string& name, const float* values, int valueCount)
+{
+    RUBEBatchParameter parameter;
+    parameter.type = type;
+    parameter.name = name;
+    parameter.values.assign(values, values + valueCount);
+    m_parameters.push_back(parameter);
+}
+
+void RUBEBatchRunner::addMetric(RUBEBatchMetric* metric)
+{
+    m_metrics.push_back(metric);
+}
+
+int RUBEBatchRunner::getRunCount() const
+{
+    int count = 1;
+    for (int i = 0; i < (int)m_parameters.size(); i++)
+        count *= (int)m_parameters[i].values.size();
+    return count;
+}
+
+// The run number is made of one digit for each parameter, with the first
+// parameter changing the fastest
+float RUBEBatchRunner::getParameterValue(int run, int parameter) const
+{
+    for (int i = 0; i < parameter; i++)
+        run /= (int)m_parameters[i].values.size();
+    const vector<float>& values = m_parameters[parameter].values;
+    return values[run % values.size()];
+}
+
+// Making one world here first finds any names that are not in the scene before
+// starting. This is also where Box2D is warmed up, on the calling thread, so that
+// the tables it fills in the first time a contact is made in a step (see
+// Box2DThreadWarmUp) are not written by several threads at once.
+bool RUBEBatchRunner::checkParameterNames(string& errorMsg)
+{
+    warmUpBox2DForThreads();
+    
+    b2dJson json;
+    b2World* world = json.readFromValue(m_scene);
+    if ( !world ) {
+        errorMsg = "Could not make a world from the scene";
+        return false;
+    }
+
+    bool ok = true;
+    for (int i = 0; i < (int)m_parameters.size() && ok; i++) {
+        const RUBEBatchParameter& p = m_parameters[i];
+        vector<b2Fixture*> fixtures;
+        vector<b2Joint*> joints;
+        if ( p.values.empty() ) {
+            errorMsg = "No values given for parameter " + p.name;
+            ok = false;
+        }
+        else if ( (p.type == BP_FRICTION || p.type == BP_RESTITUTION) && json.getFixturesByName(p.name, fixtures) == 0 ) {
+            errorMsg = "No fixtures named " + p.name + " in the scene";
+            ok = false;
+        }
+        else if ( p.type == BP_MOTOR_SPEED && json.getJointsByName(p.name, joints) == 0 ) {
+            errorMsg = "No joints named " + p.name + " in the scene";
+            ok = false;
+        }
+    }
+
+    delete world;
+    return ok;
+}
+
+void RUBEBatchRunner::applyParameters(int run, b2World* world, b2dJson& json)
+{
+    for (int i = 0; i < (int)m_parameters.size(); i++) {
+        const RUBEBatchParameter& p = m_parameters[i];
+        float value = getParameterValue(run, i);
+
+        if ( p.type == BP_GRAVITY_X || p.type == BP_GRAVITY_Y ) {
+            b2Vec2 gravity = world->GetGravity();
+            if ( p.type == BP_GRAVITY_X )
+                gravity.x = value;
+            else
+                gravity.y = value;
+            world->SetGravity(gravity);
+        }
+        else if ( p.type == BP_FRICTION || p.type == BP_RESTITUTION ) {
+            // there are no contacts yet, so nothing needs to be told about the change
+            vector<b2Fixture*> fixtures;
+            json.getFixturesByName(p.name, fixtures);
+            for (int k = 0; k < (int)fixtures.size(); k++) {
+                if ( p.type == BP_FRICTION )
+                    fixtures[k]->SetFriction(value);
+                else
+                    fixtures[k]->SetRestitution(value);
+            }
+        }
+        else if ( p.type == BP_MOTOR_SPEED ) {
+            vector<b2Joint*> joints;
+            json.getJointsByName(p.name, joints);
+            for (int k = 0; k < (int)joints.size(); k++) {
+                switch ( joints[k]->GetType() ) {
+                    case e_revoluteJoint:  ((b2RevoluteJoint*)joints[k])->SetMotorSpeed(value); break;
+                    case e_prismaticJoint: ((b2PrismaticJoint*)joints[k])->SetMotorSpeed(value); break;
+                    case e_wheelJoint:     ((b2WheelJoint*)joints[k])->SetMotorSpeed(value); break;
+                    default: break;
+                }
+            }
+        }
+    }
+}
+
+void RUBEBatchRunner::doRun(int run)
+{
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    b2dJson json;
+    b2World* world = json.readFromValue(m_scene);
+    applyParameters(run, world, json);
+
+    vector<RUBEBatchMetric*> metrics;
+    for (int i = 0; i < (int)m_metrics.size(); i++) {
+        metrics.push_back( m_metrics[i]->clone() );
+        metrics.back()->begin(world, json);
+    }
+
+    int step = 0;
+    while ( step < m_stepCount ) {
+        world->Step(m_timeStep, m_velocityIterations, m_positionIterations);
+        bool allDone = !metrics.empty();
+        for (int i = 0; i < (int)metrics.size(); i++) {
+            if ( !metrics[i]->afterStep(world, step) )
+                allDone = false;
+        }
+        step++;
+        if ( allDone )
+            break;
+    }
+
+    for (int i = 0; i < (int)metrics.size(); i++) {
+        m_results[run * metrics.size() + i] = metrics[i]->getResult();
+        delete metrics[i];
+    }
+    delete world;
+
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    m_stepsTaken[run] = step;
+    m_runTimes[run] = elapsed.count();
+}
+
+// A thread takes its own runs from the back of its queue, and when that is empty
+// it takes them from the front of the others', which is the work they would have
+// got to last
+bool RUBEBatchRunner::takeRun(int thread, int& run)
+{
+    {
+        WorkQueue* own = m_queues[thread];
+        std::lock_guard<std::mutex> lock(own->mutex);
+        if ( !own->runs.empty() ) {
+            run = own->runs.back();
+            own->runs.pop_back();
+            return true;
+        }
+    }
+    for (int i = 1; i < (int)m_queues.size(); i++) {
+        WorkQueue* other = m_queues[(thread + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(other->mutex);
+        if ( !other->runs.empty() ) {
+            run = other->runs.front();
+            other->runs.pop_front();
+            m_stolenCount++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void RUBEBatchRunner::threadLoop(int thread)
+{
+    int run;
+    while ( takeRun(thread, run) )
+        doRun(run);
+}
+
+bool RUBEBatchRunner::run(string& errorMsg, int numThreads)
+{
+    if ( ! checkParameterNames(errorMsg) )
+        return false;
+
+    int runCount = getRunCount();
+    if ( numThreads <= 0 )
+        numThreads = b2Max(1, (int)std::thread::hardware_concurrency());
+    numThreads = b2Min(numThreads, runCount);
+
+    m_results.assign(runCount * m_metrics.size(), 0);
+    m_stepsTaken.assign(runCount, 0);
+    m_runTimes.assign(runCount, 0);
+    m_stolenCount = 0;
+
+    // each thread starts with an even share of the runs, in one block
+    for (int t = 0; t < numThreads; t++) {
+        WorkQueue* queue = new WorkQueue();
+        int first = (int)((long long)runCount * t / numThreads);
+        int last = (int)((long long)runCount * (t + 1) / numThreads);
+        for (int r = last - 1; r >= first; r--)
+            queue->runs.push_back(r);   // backwards, so the block is done in order
+        m_queues.push_back(queue);
+    }
+
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    vector<std::thread> threads;
+    for (int t = 1; t < numThreads; t++)
+        threads.push_back( std::thread(&RUBEBatchRunner::threadLoop, this, t) );
+    threadLoop(0);
+    for (int i = 0; i < (int)threads.size(); i++)
+        threads[i].join();
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    m_totalTime = elapsed.count();
+
+    for (int i = 0; i < (int)m_queues.size(); i++)
+        delete m_queues[i];
+    m_queues.clear();
+    return true;
+}
+
+static const char* parameterTypeName(int type)
+{
+    switch ( type ) {
+        case BP_GRAVITY_X:   return "gravityX";
+        case BP_GRAVITY_Y:   return "gravityY";
+        case BP_FRICTION:    return "friction";
+        case BP_RESTITUTION: return "restitution";
+        case BP_MOTOR_SPEED: return "motorSpeed";
+    }
+    return "unknown";
+}
+
+int RUBEBatchRunner::getParameterTypeByName(const string& name)
+{
+    for (int type = BP_GRAVITY_X; type <= BP_MOTOR_SPEED; type++) {
+        if ( name == parameterTypeName(type) )
+            return type;
+    }
+    return -1;
+}
+
+// Headings are quoted, since the metric names can have anything in them
+bool RUBEBatchRunner::writeCSV(const string& filename, string& errorMsg) const
+{
+    FILE* f = fopen(filename.c_str(), "w");
+    if ( !f ) {
+        errorMsg = "Could not open " + filename + " for writing";
+        return false;
+    }
+
+    for (int i = 0; i < (int)m_parameters.size(); i++) {
+        const RUBEBatchParameter& p = m_parameters[i];
+        if ( p.type == BP_GRAVITY_X || p.type == BP_GRAVITY_Y )
+            fprintf(f, "\"%s\",", parameterTypeName(p.type));
+        else
+            fprintf(f, "\"%s %s\",", parameterTypeName(p.type), p.name.c_str());
+    }
+    for (int i = 0; i < (int)m_metrics.size(); i++)
+        fprintf(f, "\"%s\",", m_metrics[i]->getName().c_str());
+    fprintf(f, "\"steps\",\"ms\"\n");
+
+    for (int run = 0; run < (int)m_stepsTaken.size(); run++) {
+        for (int i = 0; i < (int)m_parameters.size(); i++)
+            fprintf(f, "%g,", getParameterValue(run, i));
+        for (int i = 0; i < (int)m_metrics.size(); i++)
+            fprintf(f, "%g,", getResult(run, i));
+        fprintf(f, "%d,%.3f\n", m_stepsTaken[run], m_runTimes[run]);
+    }
+
+    bool ok = !ferror(f);
+    if ( fclose(f) != 0 )
+        ok = false;
+    if ( !ok )
+        errorMsg = "Failed to write " + filename;
+    return ok;
+}
@@ -0,0 +1,173 @@
+//
+//  RUBEBatchRunner
+//
+//  Runs a RUBE scene many times without showing anything, once for every
+//  combination of a set of parameter values, and measures how each run
+//  turned out. This is for tuning a level (eg. how often the ball of a
+//  pinball table goes down the gutter in the first ten seconds, as the
+//  restitution of the bumpers and the speed of a motor are changed) by
+//  trying thousands of variations, which would take far too long to play
+//  through by hand. Nothing from Cocos2d is used, so this can be built
+//  into a command line tool as well as the app.
+//
+//  The parameters that can be changed are the gravity, the friction or
+//  restitution of all the fixtures with a given name, and the motor speed
+//  of all the joints with a given name. Each one is given a list of values
+//  to try, and every combination of them is run, so eg. five restitutions
+//  and four motor speeds make twenty runs.
+//
+//  The measurements are made by RUBEBatchMetric subclasses. Each run gets
+//  its own copy of every metric, which is called after each step and can
+//  stop the run early once all of them have what they need. One metric is
+//  given here, RUBEContactTimeMetric, which measures how long it takes
+//  until two fixtures touch.
+//
+//      RUBEBatchRunner runner;
+//      if ( runner.loadScene("pinball.json", errMsg) ) {
+//          float restitutions[] = { 0.5f, 0.7f, 0.9f };
+//          runner.addParameter(BP_RESTITUTION, "bumper", restitutions, 3);
+//          runner.addMetric( new RUBEContactTimeMetric("ball", "gutter") );
+//          runner.setStepCount(600);
+//          if ( runner.run(errMsg) )
+//              runner.writeCSV("results.csv", errMsg);
+//      }
+//
+//  The file is only parsed once, and the parsed scene is kept as the
+//  blueprint for each run to make its world from. Only the making of the
+//  world and the steps are done for each run.
+//
+//  The runs are spread over one thread per core, with the calling thread
+//  taking a share too. Each thread starts with its own block of runs, and
+//  one that finishes early takes runs from the other end of another
+//  thread's block, so they all finish at about the same time even when
+//  some runs stop much earlier than others. Box2D gives exactly the same
+//  result for the same world no matter which thread steps it, so the
+//  results don't depend on how the runs were shared out.
+//
+//  The CSV file has one line for each run, with the parameter values,
+//  then the metric results, then the number of steps and the time taken.
+//
+//  The rubebatch command line tool (tools/rubebatch) runs a sweep like the
+//  one above without the app, eg.
+//
+//      rubebatch pinball.json 600 results.csv -p restitution:bumper=0.5,0.7,0.9
+//                -m contact:ball,gutter
+//
+
+#ifndef RUBE_BATCH_RUNNER
+#define RUBE_BATCH_RUNNER
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <set>
+#include <Box2D/Box2D.h>
+#include "rubestuff/json/json.h"
+
+class b2dJson;
+
+enum _batchParameterType {
+    BP_GRAVITY_X,
+    BP_GRAVITY_Y,
+    BP_FRICTION,            // of the fixtures with the name given
+    BP_RESTITUTION,         // of the fixtures with the name given
+    BP_MOTOR_SPEED          // of the revolute, prismatic and wheel joints with the name given
+};
+
+struct RUBEBatchParameter {
+    int type;               // one of _batchParameterType
+    std::string name;       // not used for the gravity
+    std::vector<float> values;
+};
+
+// Measures one thing about a run. Subclasses must be able to make a copy of
+// themselves in the state they were given to addMetric, for each run to use.
+class RUBEBatchMetric
+{
+public:
+    virtual ~RUBEBatchMetric() {}
+    virtual RUBEBatchMetric* clone() const = 0;
+    virtual std::string getName() const = 0;                    // the heading of the column in the CSV file
+    virtual void begin(b2World* world, b2dJson& json) {}        // the world as it was loaded, with the parameters set
+    virtual bool afterStep(b2World* world, int step) { return false; }  // return true if the rest of the run makes no difference
+    virtual float getResult() const = 0;
+};
+
+// The time in seconds until any fixture with the first name touches any fixture
+// with the second name, or -1 if they never did.
+class RUBEContactTimeMetric : public RUBEBatchMetric
+{
+protected:
+    std::string m_fixtureName;
+    std::string m_otherFixtureName;
+    std::vector<b2Fixture*> m_fixtures;
+    std::set<b2Fixture*> m_otherFixtures;
+    float m_timeStep;
+    float m_result;
+
+public:
+    RUBEContactTimeMetric(const std::string& fixtureName, const std::string& otherFixtureName, float timeStep = 1/60.0f);
+    virtual RUBEBatchMetric* clone() const;
+    virtual std::string getName() const;
+    virtual void begin(b2World* world, b2dJson& json);
+    virtual bool afterStep(b2World* world, int step);
+    virtual float getResult() const { return m_result; }
+};
+
+class RUBEBatchRunner
+{
+protected:
+    // the runs waiting for one thread, which others can take from when they run out
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<int> runs;
+    };
+
+    Json::Value m_scene;                        // the blueprint each run makes its world from
+    std::vector<RUBEBatchParameter> m_parameters;
+    std::vector<RUBEBatchMetric*> m_metrics;    // owned by this, never stepped themselves, only cloned
+    int m_stepCount;
+    float m_timeStep;
+    int m_velocityIterations;
+    int m_positionIterations;
+
+    std::vector<float> m_results;               // every metric of the first run, then every metric of the next run...
+    std::vector<int> m_stepsTaken;              // for each run
+    std::vector<float> m_runTimes;              // milliseconds for each run, including making the world
+    std::vector<WorkQueue*> m_queues;           // one for each thread
+    std::atomic<int> m_stolenCount;             // runs that were done by a thread other than the one they were given to
+    float m_totalTime;
+
+    bool checkParameterNames(std::string& errorMsg);
+    void applyParameters(int run, b2World* world, b2dJson& json);
+    void doRun(int run);
+    bool takeRun(int thread, int& run);
+    void threadLoop(int thread);
+
+public:
+    RUBEBatchRunner();
+    ~RUBEBatchRunner();
+
+    bool loadScene(const std::string& filename, std::string& errorMsg);
+    void addParameter(int type, const std::string& name, const float* values, int valueCount);
+    void addMetric(RUBEBatchMetric* metric);    // this will delete it
+    void setStepCount(int steps) { m_stepCount = steps; }
+    void setTimeStep(float timeStep) { m_timeStep = timeStep; }
+    void setIterations(int velocityIterations, int positionIterations) { m_velocityIterations = velocityIterations; m_positionIterations = positionIterations; }
+
+    bool run(std::string& errorMsg, int numThreads = 0);    // 0 for one thread per core
+    bool writeCSV(const std::string& filename, std::string& errorMsg) const;
+
+    static int getParameterTypeByName(const std::string& name);     // the names used in the CSV headings, or -1
+
+    int getRunCount() const;
+    float getParameterValue(int run, int parameter) const;
+    float getResult(int run, int metric) const { return m_results[run * m_metrics.size() + metric]; }
+    int getStepsTaken(int run) const { return m_stepsTaken[run]; }
+    float getTotalTime() const { return m_totalTime; }
+    int getStolenCount() const { return m_stolenCount; }
+};
+
+#endif /* RUBE_BATCH_RUNNER */
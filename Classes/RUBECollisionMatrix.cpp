@@ -0,0 +1,191 @@
+//
+//  RUBECollisionMatrix
+//
+//  See header file for description.
+//
+
+#include "RUBECollisionMatrix.h"
+#include "rubestuff/b2dJson.h"
+
+using namespace std;
+
+static const int MAX_FILTER_BIT_GROUPS = 16;
+
+static string trim(const string& s)
+{
+    size_t first = s.find_first_not_of(" \t\r\n");
+    if ( first == string::npos )
+        return "";
+    size_t last = s.find_last_not_of(" \t\r\n");
+    return s.substr(first, last - first + 1);
+}
+
+static void split(const string& s, char separator, vector<string>& parts)
+{
+    parts.clear();
+    size_t start = 0;
+    while ( true ) {
+        size_t end = s.find(separator, start);
+        parts.push_back( trim(s.substr(start, end == string::npos ? string::npos : end - start)) );
+        if ( end == string::npos )
+            break;
+        start = end + 1;
+    }
+}
+
+
+
+
+RUBECollisionMatrix::RUBECollisionMatrix()
+{
+    m_useFilterBits = true;
+}
+
+int RUBECollisionMatrix::addGroup(const string& name)
+{
+    map<string, int>::iterator it = m_groupIndexes.find(name);
+    if ( it != m_groupIndexes.end() )
+        return it->second;
+    int index = (int)m_groupNames.size();
+    m_groupNames.push_back(name);
+    m_groupIndexes[name] = index;
+    return index;
+}
+
+int RUBECollisionMatrix::getGroupIndex(const string& name) const
+{
+    map<string, int>::const_iterator it = m_groupIndexes.find(name);
+    return it == m_groupIndexes.end() ? -1 : it->second;
+}
+
+// The groups must all have been added before this is called
+bool RUBECollisionMatrix::parse(const string& matrix, string& errorMsg)
+{
+    int n = (int)m_groupNames.size();
+    m_collides.assign(n * n, false);
+
+    vector<string> rules, others;
+    split(matrix, ';', rules);
+    for (int i = 0; i < (int)rules.size(); i++) {
+        if ( rules[i].empty() )
+            continue;
+        size_t colon = rules[i].find(':');
+        if ( colon == string::npos ) {
+            errorMsg = "Collision matrix rule has no ':' in \"" + rules[i] + "\"";
+            return false;
+        }
+        if ( rules[i].find(':', colon + 1) != string::npos ) {
+            errorMsg = "Collision matrix rule has more than one ':' in \"" + rules[i] + "\"";
+            return false;
+        }
+        int group = getGroupIndex( trim(rules[i].substr(0, colon)) );
+        if ( group < 0 ) {
+            errorMsg = "Collision matrix rule has no group before the ':' in \"" + rules[i] + "\"";
+            return false;
+        }
+        split(rules[i].substr(colon + 1), ',', others);
+        for (int k = 0; k < (int)others.size(); k++) {
+            if ( others[k].empty() )
+                continue;
+            for (int other = 0; other < n; other++) {
+                if ( others[k] == "*" || m_groupNames[other] == others[k] ) {
+                    m_collides[group * n + other] = true;
+                    m_collides[other * n + group] = true;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool RUBECollisionMatrix::load(b2dJson* json, b2World* world, string& errorMsg)
+{
+    errorMsg = "";
+    string matrix = json->getCustomString(world, "collisionMatrix", "");
+    if ( trim(matrix).empty() )
+        return false;
+
+    m_groupNames.clear();
+    m_groupIndexes.clear();
+
+    // every group named by a fixture or in the matrix, in a fixed order
+    vector<b2Fixture*> fixtures;
+    vector<int> fixtureGroups;
+    for (b2Body* b = world->GetBodyList(); b; b = b->GetNext()) {
+        for (b2Fixture* f = b->GetFixtureList(); f; f = f->GetNext()) {
+            fixtures.push_back(f);
+            fixtureGroups.push_back( addGroup(json->getCustomString(f, "collisionGroup", "default")) );
+        }
+    }
+    vector<string> rules, names;
+    split(matrix, ';', rules);
+    for (int i = 0; i < (int)rules.size(); i++) {
+        split(rules[i], ':', names);
+        for (int k = 0; k < (int)names.size(); k++) {
+            vector<string> others;
+            split(names[k], ',', others);
+            for (int j = 0; j < (int)others.size(); j++) {
+                if ( !others[j].empty() && others[j] != "*" )
+                    addGroup(others[j]);
+            }
+        }
+    }
+
+    if ( !parse(matrix, errorMsg) ) {
+        m_groupNames.clear();
+        m_groupIndexes.clear();
+        m_collides.clear();
+        return false;
+    }
+
+    m_useFilterBits = m_groupNames.size() <= MAX_FILTER_BIT_GROUPS;
+    for (int i = 0; i < (int)fixtures.size(); i++)
+        setFilter(fixtures[i], fixtureGroups[i]);
+    if ( !m_useFilterBits )
+        world->SetContactFilter(this);
+    return true;
+}
+
+// The filter settings of the fixtures are left as they are
+void RUBECollisionMatrix::uninstall(b2World* world)
+{
+    if ( !m_useFilterBits )
+        world->SetContactFilter(&b2_defaultFilter);
+}
+
+void RUBECollisionMatrix::setFilter(b2Fixture* fixture, int group)
+{
+    b2Filter filter = fixture->GetFilterData();
+    if ( m_useFilterBits ) {
+        int n = (int)m_groupNames.size();
+        filter.categoryBits = 1 << group;
+        filter.maskBits = 0;
+        for (int other = 0; other < n; other++) {
+            if ( m_collides[group * n + other] )
+                filter.maskBits |= 1 << other;
+        }
+        filter.groupIndex = 0;
+    }
+    else
+        filter.groupIndex = (int16)group;
+    fixture->SetFilterData(filter);
+}
+
+bool RUBECollisionMatrix::setFixtureGroup(b2Fixture* fixture, const string& group)
+{
+    int index = getGroupIndex(group);
+    if ( index < 0 )
+        return false;
+    setFilter(fixture, index);
+    return true;
+}
+
+bool RUBECollisionMatrix::ShouldCollide(b2Fixture* fixtureA, b2Fixture* fixtureB)
+{
+    int n = (int)m_groupNames.size();
+    int groupA = fixtureA->GetFilterData().groupIndex;
+    int groupB = fixtureB->GetFilterData().groupIndex;
+    if ( groupA < 0 || groupA >= n || groupB < 0 || groupB >= n )
+        return b2ContactFilter::ShouldCollide(fixtureA, fixtureB);
+    return m_collides[groupA * n + groupB];
+}
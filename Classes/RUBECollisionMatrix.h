@@ -0,0 +1,76 @@
+//
+//  RUBECollisionMatrix
+//
+//  Sets up which fixtures can collide with which, from custom properties
+//  in the RUBE scene, so that Box2D never makes contacts for pairs that
+//  can't matter. This is easier to keep track of than setting category
+//  and mask bits by hand on every fixture.
+//
+//  Give fixtures a custom string property called "collisionGroup" with
+//  the name of their group. Fixtures without one are in the group called
+//  "default". Then give the world a custom string property called
+//  "collisionMatrix" which says which groups collide, like this:
+//
+//      ball: lower, sensor;  debris: default;  player: *
+//
+//  Each rule lists the groups that the first group collides with, and
+//  works both ways (debris and default collide with each other). The *
+//  means every group. Any two groups that are not paired up by a rule
+//  do not collide at all. If the world has no collisionMatrix property,
+//  nothing is changed and the filter settings from RUBE are used as is.
+//
+//  With up to 16 groups, each group is given one of the category bits
+//  and the mask bits are worked out from the matrix, so Box2D does all
+//  the work itself. With more groups than that, the group number is put
+//  in the groupIndex of the fixture filter and this class is installed
+//  as the contact filter of the world, to look the pair up in the table.
+//  Either way the check happens before the contact is created.
+//
+//  Fixtures can be moved to another group while the game is running with
+//  setFixtureGroup (eg. the pinball moving between levels of the table).
+//  Fixtures created after loading (eg. by tile streaming) are not given
+//  a group by this, so call setFixtureGroup for those as well.
+//
+
+#ifndef RUBE_COLLISION_MATRIX
+#define RUBE_COLLISION_MATRIX
+
+#include <string>
+#include <vector>
+#include <map>
+#include <Box2D/Box2D.h>
+
+class b2dJson;
+
+class RUBECollisionMatrix : public b2ContactFilter
+{
+protected:
+    std::vector<std::string> m_groupNames;
+    std::map<std::string, int> m_groupIndexes;
+    std::vector<bool> m_collides;           // groups x groups, true if the pair collides
+    bool m_useFilterBits;                   // true if there are few enough groups for the category and mask bits
+
+    int addGroup(const std::string& name);
+    bool parse(const std::string& matrix, std::string& errorMsg);
+    void setFilter(b2Fixture* fixture, int group);
+
+public:
+    RUBECollisionMatrix();
+
+    // Reads the matrix from the world property and the groups from the fixtures.
+    // Returns false if the world has no matrix or it could not be understood.
+    bool load(b2dJson* json, b2World* world, std::string& errorMsg);
+    void uninstall(b2World* world);                             // call before deleting this if the world will carry on
+
+    int getGroupCount() const { return (int)m_groupNames.size(); }
+    int getGroupIndex(const std::string& name) const;          // -1 if there is no such group
+    bool shouldGroupsCollide(int group1, int group2) const { return m_collides[group1 * m_groupNames.size() + group2]; }
+    bool usesFilterBits() const { return m_useFilterBits; }
+
+    bool setFixtureGroup(b2Fixture* fixture, const std::string& group);    // returns false if there is no such group
+
+    // b2ContactFilter, only used when there are more than 16 groups
+    virtual bool ShouldCollide(b2Fixture* fixtureA, b2Fixture* fixtureB);
+};
+
+#endif /* RUBE_COLLISION_MATRIX */
@@ -0,0 +1,209 @@
+//
+//  RUBEFrameProfiler
+//
+//  See header file for description.
+//
+
+#include "RUBEFrameProfiler.h"
+
+#if RUBE_FRAME_PROFILER
+
+#include <cstdio>
+#include <thread>
+#include <algorithm>
+
+using namespace std;
+USING_NS_CC;
+
+RUBEFrameProfiler* RUBEFrameProfiler::s_instance = NULL;
+
+RUBEFrameProfiler* RUBEFrameProfiler::getInstance()
+{
+    if ( !s_instance ) {
+        s_instance = new RUBEFrameProfiler(1 << 16, 300);
+        // before the RUBEWorldScheduler (-1) and the layers (0), so each frame is finished before the next one starts
+        Director::getInstance()->getScheduler()->scheduleUpdateForTarget(s_instance, -2, false);
+    }
+    return s_instance;
+}
+
+RUBEFrameProfiler::RUBEFrameProfiler(int eventCapacity, int frameCapacity)
+{
+    unsigned int size = 16;
+    while ( size < (unsigned int)eventCapacity )
+        size *= 2;
+    m_events.resize(size);
+    m_eventMask = size - 1;
+    m_head = 0;
+    m_frameStart = 0;
+
+    m_frameCapacity = frameCapacity;
+    m_frameTotals.assign(frameCapacity * PS_MAX, 0);
+    m_frame = 0;
+
+    m_startTime = std::chrono::steady_clock::now();
+}
+
+long long RUBEFrameProfiler::now() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_startTime).count();
+}
+
+void RUBEFrameProfiler::record(int section, long long start, long long end)
+{
+    RUBEProfileEvent& e = m_events[ m_head.fetch_add(1, memory_order_relaxed) & m_eventMask ];
+    e.section = section;
+    e.frame = m_frame;
+    e.thread = (int)(std::hash<std::thread::id>()(std::this_thread::get_id()) & 0x7fffffff);
+    e.start = start;
+    e.duration = (float)(end - start);
+}
+
+// Box2D only says how long each part of the step took, not when. They are done
+// one after the other in this order, so they are placed end to end, finishing
+// when the step did.
+void RUBEFrameProfiler::recordWorldStep(const b2Profile& profile)
+{
+    long long end = now();
+    long long t = end - (long long)(profile.step * 1000);
+    long long collideEnd = t + (long long)(profile.collide * 1000);
+    long long solveEnd = collideEnd + (long long)(profile.solve * 1000);
+    long long toiEnd = solveEnd + (long long)(profile.solveTOI * 1000);
+    record(PS_COLLIDE, t, collideEnd);
+    record(PS_SOLVE, collideEnd, solveEnd);
+    record(PS_SOLVE_TOI, solveEnd, toiEnd);
+}
+
+// If there were more events in the frame than the ring buffer holds, only the
+// latest ones are still there to be added up
+void RUBEFrameProfiler::update(float dt)
+{
+    unsigned int head = m_head.load(memory_order_acquire);
+    unsigned int first = head - m_frameStart > m_eventMask + 1 ? head - (m_eventMask + 1) : m_frameStart;
+
+    float* totals = &m_frameTotals[ (m_frame % m_frameCapacity) * PS_MAX ];
+    for (int s = 0; s < PS_MAX; s++)
+        totals[s] = 0;
+    for (unsigned int i = first; i != head; i++) {
+        const RUBEProfileEvent& e = m_events[i & m_eventMask];
+        totals[e.section] += e.duration * 0.001f;
+    }
+
+    m_frameStart = head;
+    m_frame++;
+}
+
+int RUBEFrameProfiler::getFrameCount() const
+{
+    return std::min(m_frame, m_frameCapacity);
+}
+
+float RUBEFrameProfiler::getFrameTotal(int framesAgo, int section) const
+{
+    int frame = m_frame - 1 - framesAgo;
+    return m_frameTotals[ (frame % m_frameCapacity) * PS_MAX + section ];
+}
+
+void RUBEFrameProfiler::getPercentiles(int section, float& p50, float& p99) const
+{
+    int count = getFrameCount();
+    if ( count == 0 ) {
+        p50 = p99 = 0;
+        return;
+    }
+    vector<float> values(count);
+    for (int i = 0; i < count; i++)
+        values[i] = getFrameTotal(i, section);
+    std::sort(values.begin(), values.end());
+    p50 = values[ (count - 1) / 2 ];
+    p99 = values[ (count - 1) * 99 / 100 ];
+}
+
+string RUBEFrameProfiler::getSummary() const
+{
+    string summary;
+    char line[128];
+    for (int s = 0; s < PS_MAX; s++) {
+        float p50, p99;
+        getPercentiles(s, p50, p99);
+        if ( p99 <= 0 )
+            continue;
+        snprintf(line, sizeof(line), "%-10s p50 %6.2f  p99 %6.2f ms\n", getSectionName(s), p50, p99);
+        summary += line;
+    }
+    return summary;
+}
+
+const char* RUBEFrameProfiler::getSectionName(int section)
+{
+    switch ( section ) {
+        case PS_PHYSICS:   return "physics";
+        case PS_STEP:      return "step";
+        case PS_COLLIDE:   return "collide";
+        case PS_SOLVE:     return "solve";
+        case PS_SOLVE_TOI: return "solveTOI";
+        case PS_IMAGES:    return "images";
+        case PS_CONTACTS:  return "contacts";
+        case PS_GAME:      return "game";
+        case PS_DRAW:      return "draw";
+    }
+    return "unknown";
+}
+
+// One line for each frame kept, oldest first
+bool RUBEFrameProfiler::writeCSV(const string& filename, string& errorMsg) const
+{
+    FILE* f = fopen(filename.c_str(), "w");
+    if ( !f ) {
+        errorMsg = "Could not open " + filename + " for writing";
+        return false;
+    }
+
+    fprintf(f, "frame");
+    for (int s = 0; s < PS_MAX; s++)
+        fprintf(f, ",%s", getSectionName(s));
+    fprintf(f, "\n");
+    for (int i = getFrameCount() - 1; i >= 0; i--) {
+        fprintf(f, "%d", m_frame - 1 - i);
+        for (int s = 0; s < PS_MAX; s++)
+            fprintf(f, ",%.3f", getFrameTotal(i, s));
+        fprintf(f, "\n");
+    }
+
+    bool ok = !ferror(f);
+    if ( fclose(f) != 0 )
+        ok = false;
+    if ( !ok )
+        errorMsg = "Failed to write " + filename;
+    return ok;
+}
+
+// Every event still in the ring buffer, as "complete" events of the Chrome trace
+// event format, with the frame number as an argument
+bool RUBEFrameProfiler::writeChromeTrace(const string& filename, string& errorMsg) const
+{
+    FILE* f = fopen(filename.c_str(), "w");
+    if ( !f ) {
+        errorMsg = "Could not open " + filename + " for writing";
+        return false;
+    }
+
+    unsigned int head = m_head.load(memory_order_acquire);
+    unsigned int first = head > m_eventMask + 1 ? head - (m_eventMask + 1) : 0;
+    fprintf(f, "{\"traceEvents\":[\n");
+    for (unsigned int i = first; i != head; i++) {
+        const RUBEProfileEvent& e = m_events[i & m_eventMask];
+        fprintf(f, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%.1f,\"pid\":1,\"tid\":%d,\"args\":{\"frame\":%d}}%s\n",
+                getSectionName(e.section), e.start, e.duration, e.thread, e.frame, i + 1 != head ? "," : "");
+    }
+    fprintf(f, "],\"displayTimeUnit\":\"ms\"}\n");
+
+    bool ok = !ferror(f);
+    if ( fclose(f) != 0 )
+        ok = false;
+    if ( !ok )
+        errorMsg = "Failed to write " + filename;
+    return ok;
+}
+
+#endif // RUBE_FRAME_PROFILER
@@ -0,0 +1,130 @@
+//
+//  RUBEFrameProfiler
+//
+//  Times the parts of each frame (the physics step and the breakdown of it
+//  that Box2D keeps in b2Profile, moving the images, going through the
+//  contacts, the game logic, and drawing) to find out where the time goes,
+//  which the frame rate shown by Cocos2d can't tell.
+//
+//  This is only built in when RUBE_FRAME_PROFILER is defined as 1 for the
+//  whole project. Otherwise the RUBE_PROFILE macros are empty and there is
+//  nothing left of it at all.
+//
+//  The code to be timed is marked with RUBE_PROFILE_SCOPE(section), which
+//  times from there to the end of the enclosing block. Each timing goes
+//  into a ring buffer of the latest events, taking its place with a single
+//  atomic add, so the threads of RUBEWorldScheduler can record their steps
+//  at the same time as each other without any locking.
+//
+//  Once per frame, before anything else is updated, the events of the last
+//  frame are added up for each section and kept for the last several
+//  seconds worth of frames. From these the median and 99th percentile of
+//  each section can be shown while running (see the "Stats" button added
+//  by BasicRUBELayer::setupMenuLayer), and saved as a CSV file with one
+//  line for each frame. The events themselves can be saved in the Chrome
+//  trace format, to look through frame by frame in chrome://tracing.
+//
+//  The saving and the frame totals must be done on the main thread, at a
+//  time when the worlds are not being stepped.
+//
+
+#ifndef RUBE_FRAME_PROFILER_H
+#define RUBE_FRAME_PROFILER_H
+
+#ifndef RUBE_FRAME_PROFILER
+#define RUBE_FRAME_PROFILER 0
+#endif
+
+enum _profileSection {
+    PS_PHYSICS,             // all of BasicRUBELayer::update, including the step
+    PS_STEP,                // b2World::Step
+    PS_COLLIDE,             // the parts of the step, from b2Profile
+    PS_SOLVE,
+    PS_SOLVE_TOI,
+    PS_IMAGES,              // RUBELayer::setImagePositionsFromPhysicsBodies
+    PS_CONTACTS,            // going through the contact events
+    PS_GAME,                // the game logic in the layer update
+    PS_DRAW,
+    PS_MAX
+};
+
+#if RUBE_FRAME_PROFILER
+
+#include "cocos2d.h"
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <Box2D/Box2D.h>
+
+struct RUBEProfileEvent {
+    int section;
+    int frame;
+    int thread;             // a number for the thread, the same for all its events
+    long long start;        // microseconds since the profiler was made
+    float duration;         // microseconds
+};
+
+class RUBEFrameProfiler : public cocos2d::Object
+{
+protected:
+    static RUBEFrameProfiler* s_instance;
+
+    std::vector<RUBEProfileEvent> m_events;
+    unsigned int m_eventMask;               // the capacity is a power of two, so this finds the slot
+    std::atomic<unsigned int> m_head;       // events ever recorded
+    unsigned int m_frameStart;              // the first event of the current frame
+
+    std::vector<float> m_frameTotals;       // milliseconds, PS_MAX for each of the last several frames
+    int m_frameCapacity;
+    int m_frame;                            // frames ever finished
+
+    std::chrono::steady_clock::time_point m_startTime;
+
+    RUBEFrameProfiler(int eventCapacity, int frameCapacity);
+
+public:
+    static RUBEFrameProfiler* getInstance();    // made and scheduled when first needed, which must be on the main thread
+
+    long long now() const;
+    void record(int section, long long start, long long end);   // can be called from any thread
+    void recordWorldStep(const b2Profile& profile);             // right after b2World::Step
+
+    virtual void update(float dt);              // called by the Cocos2d scheduler, finishes the last frame
+
+    int getFrameCount() const;                  // frames kept, up to the capacity
+    float getFrameTotal(int framesAgo, int section) const;
+    void getPercentiles(int section, float& p50, float& p99) const;
+    std::string getSummary() const;             // one line for each section that took any time
+
+    bool writeCSV(const std::string& filename, std::string& errorMsg) const;
+    bool writeChromeTrace(const std::string& filename, std::string& errorMsg) const;
+
+    static const char* getSectionName(int section);
+};
+
+// Records the time from where this is made until the end of the block
+class RUBEProfileScope
+{
+    int m_section;
+    long long m_start;
+public:
+    RUBEProfileScope(int section) : m_section(section) { m_start = RUBEFrameProfiler::getInstance()->now(); }
+    ~RUBEProfileScope() { RUBEFrameProfiler* p = RUBEFrameProfiler::getInstance(); p->record(m_section, m_start, p->now()); }
+};
+
+#define RUBE_PROFILE_CONCAT2(a, b) a##b
+#define RUBE_PROFILE_CONCAT(a, b) RUBE_PROFILE_CONCAT2(a, b)
+#define RUBE_PROFILE_INIT() RUBEFrameProfiler::getInstance()
+#define RUBE_PROFILE_SCOPE(section) RUBEProfileScope RUBE_PROFILE_CONCAT(rubeProfileScope, __LINE__)(section)
+#define RUBE_PROFILE_WORLD_STEP(world) RUBEFrameProfiler::getInstance()->recordWorldStep( (world)->GetProfile() )
+
+#else
+
+#define RUBE_PROFILE_INIT()
+#define RUBE_PROFILE_SCOPE(section)
+#define RUBE_PROFILE_WORLD_STEP(world)
+
+#endif // RUBE_FRAME_PROFILER
+
+#endif /* RUBE_FRAME_PROFILER_H */
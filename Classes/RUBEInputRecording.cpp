@@ -0,0 +1,116 @@
+//
+//  RUBEInputRecording
+//
+//  See header file for description.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "RUBEInputRecording.h"
+
+using namespace std;
+
+static const int INPUT_RECORDING_VERSION = 1;
+
+static unsigned int floatBits(float f)
+{
+    unsigned int bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static float bitsToFloat(unsigned int bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+RUBEInputRecording::RUBEInputRecording()
+{
+    clear();
+}
+
+void RUBEInputRecording::clear()
+{
+    sceneFilename = "";
+    windowWidth = 0;
+    windowHeight = 0;
+    randomSeed = 0;
+    stepCount = 0;
+    runningHash = 0;
+    events.clear();
+}
+
+bool RUBEInputRecording::save(const string& filename, string& errorMsg) const
+{
+    FILE* f = fopen(filename.c_str(), "w");
+    if ( !f ) {
+        errorMsg = "Could not open " + filename + " for writing";
+        return false;
+    }
+
+    fprintf(f, "rubeinput %d\n", INPUT_RECORDING_VERSION);
+    fprintf(f, "scene %s\n", sceneFilename.c_str());
+    fprintf(f, "window %08X %08X\n", floatBits(windowWidth), floatBits(windowHeight));
+    fprintf(f, "seed %u\n", randomSeed);
+    fprintf(f, "steps %d\n", stepCount);
+    fprintf(f, "hash %016llX\n", runningHash);
+    fprintf(f, "events %d\n", (int)events.size());
+    for (int i = 0; i < (int)events.size(); i++) {
+        const RUBEInputEvent& e = events[i];
+        fprintf(f, "%d %d %d %d %08X %08X\n", e.step, e.batch, e.phase, e.touchId, floatBits(e.x), floatBits(e.y));
+    }
+
+    bool ok = !ferror(f);
+    if ( fclose(f) != 0 )
+        ok = false;
+    if ( !ok )
+        errorMsg = "Failed to write " + filename;
+    return ok;
+}
+
+bool RUBEInputRecording::load(const string& filename, string& errorMsg)
+{
+    clear();
+
+    FILE* f = fopen(filename.c_str(), "r");
+    if ( !f ) {
+        errorMsg = "Could not open " + filename;
+        return false;
+    }
+
+    int version = 0;
+    char scene[1024];
+    unsigned int widthBits, heightBits;
+    int numEvents = 0;
+    bool ok = fscanf(f, "rubeinput %d\n", &version) == 1 && version == INPUT_RECORDING_VERSION &&
+              fscanf(f, "scene %1023[^\n]\n", scene) == 1 &&
+              fscanf(f, "window %X %X\n", &widthBits, &heightBits) == 2 &&
+              fscanf(f, "seed %u\n", &randomSeed) == 1 &&
+              fscanf(f, "steps %d\n", &stepCount) == 1 &&
+              fscanf(f, "hash %llX\n", &runningHash) == 1 &&
+              fscanf(f, "events %d\n", &numEvents) == 1 && numEvents >= 0;
+
+    if ( ok ) {
+        sceneFilename = scene;
+        windowWidth = bitsToFloat(widthBits);
+        windowHeight = bitsToFloat(heightBits);
+
+        events.resize(numEvents);
+        for (int i = 0; i < numEvents && ok; i++) {
+            RUBEInputEvent& e = events[i];
+            unsigned int xBits, yBits;
+            ok = fscanf(f, "%d %d %d %d %X %X", &e.step, &e.batch, &e.phase, &e.touchId, &xBits, &yBits) == 6;
+            e.x = bitsToFloat(xBits);
+            e.y = bitsToFloat(yBits);
+        }
+    }
+    fclose(f);
+
+    if ( !ok ) {
+        clear();
+        errorMsg = filename + " is not a valid input recording";
+    }
+    return ok;
+}
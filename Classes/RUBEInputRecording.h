@@ -0,0 +1,63 @@
+//
+//  RUBEInputRecording
+//
+//  Holds the touches made while a RUBE layer was running, and the step
+//  at which each one arrived, so that the same session can be played
+//  through again later. See BasicRUBELayer::recordInput and replayInput.
+//
+//  The touches are kept in screen coordinates, exactly as the layer was
+//  given them. The layers turn them into world coordinates themselves,
+//  using a view that pinch zooming can change, so playing back the screen
+//  positions repeats the same calculations and gets the same world
+//  positions to the last bit. For this to work the replay must be done
+//  with the same window size, which is saved as well.
+//
+//  Also saved are the seed for rand() (the PlanetCute demo uses it when
+//  loading), and the hash of every step of the run, to tell whether the
+//  replay came out exactly the same.
+//
+//  The file is plain text, with the floats written as their raw bits in
+//  hex so nothing is lost.
+//
+
+#ifndef RUBE_INPUT_RECORDING
+#define RUBE_INPUT_RECORDING
+
+#include <string>
+#include <vector>
+
+enum _inputPhase {
+    IP_BEGAN,
+    IP_MOVED,
+    IP_ENDED,
+    IP_CANCELLED
+};
+
+struct RUBEInputEvent {
+    int step;               // the number of steps done before this touch arrived
+    int batch;              // touches given to the layer in the same call have the same batch
+    int phase;              // one of _inputPhase
+    int touchId;
+    float x;                // location in view, as given by Touch::getLocationInView
+    float y;
+};
+
+class RUBEInputRecording
+{
+public:
+    std::string sceneFilename;
+    float windowWidth;
+    float windowHeight;
+    unsigned int randomSeed;
+    int stepCount;                          // how many steps the recording ran for
+    unsigned long long runningHash;         // Box2DWorldHash::getRunningHash after the last step
+    std::vector<RUBEInputEvent> events;     // in the order they arrived
+
+    RUBEInputRecording();
+    void clear();
+
+    bool save(const std::string& filename, std::string& errorMsg) const;
+    bool load(const std::string& filename, std::string& errorMsg);
+};
+
+#endif /* RUBE_INPUT_RECORDING */
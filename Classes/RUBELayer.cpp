@@ -9,11 +9,30 @@
 #include "RUBELayer.h"
 #include "rubestuff/b2dJson.h"
 #include "rubestuff/b2dJsonImage.h"
+#include "rubestuff/b2dJsonHotReload.h"
+#include "Box2DReplay.h"
+#include "Box2DWorldHash.h"
+#include "Box2DActivationManager.h"
+
+#include <algorithm>
 
 using namespace std;
 using namespace cocos2d;
 
 
+RUBELayer::RUBELayer()
+{
+    m_replayPlayer = NULL;
+}
+
+RUBELayer::~RUBELayer()
+{
+    // the base class destructor only calls its own clear
+    if ( m_replayPlayer )
+        delete m_replayPlayer;
+}
+
+
 // Standard Cocos2d method, simply returns a scene with an instance of this class as a child
 Scene* RUBELayer::scene()
 {
@@ -76,46 +95,180 @@ void RUBELayer::afterLoadProcessing(b2dJson* json)
     json->getAllImages(b2dImages);
         
     // loop through the vector, create Sprites for each image and store them in m_imageInfos
+    // (in render order, because cocos2d draws children with the same z order in the order they were added)
+    std::map<b2dJsonImage*, RUBEImageInfo*> createdImageInfos;
+    for (int i = 0; i < b2dImages.size(); i++)
+        createdImageInfos[b2dImages[i]] = createImageInfo(b2dImages[i]);
+    
+    // remember them in file order as well, for hot reloading
+    b2dImages.clear();
+    json->getAllImagesInFileOrder(b2dImages);
+    m_imageInfosInFileOrder.clear();
+    for (int i = 0; i < b2dImages.size(); i++)
+        m_imageInfosInFileOrder.push_back( createdImageInfos[b2dImages[i]] );
+    
+    // bodies with a "prefab" custom property are templates for spawnBody
+    std::vector<b2Body*> bodies;
+    json->getAllBodiesInFileOrder(bodies);
+    for (int i = 0; i < bodies.size(); i++) {
+        if ( json->hasCustomString(bodies[i], "prefab") )
+            registerPrefab( json->getCustomString(bodies[i], "prefab"), bodies[i] );
+    }
+    
+    // start the images at their current positions on the physics bodies
+    setImagePositionsFromPhysicsBodies();
+}
+
+
+// Creates a sprite for one image of the scene, and adds it to the layer and to m_imageInfos
+RUBEImageInfo* RUBELayer::createImageInfo(b2dJsonImage* img)
+{
+    CCLOG("Loading image: %s", img->file.c_str());
+    
+    // try to load the sprite image, and ignore if it fails
+    Sprite* sprite = new Sprite();
+    sprite->initWithFile(img->file.c_str());
+    if ( ! sprite )
+        return NULL;
+    
+    // add the sprite to this layer
+    addChild(sprite);
+    
+    // create an info structure to hold the info for this image (body and position etc)
+    RUBEImageInfo* imgInfo = new RUBEImageInfo;
+    imgInfo->sprite = sprite;
+    imgInfo->file = img->file;
+    setImageInfo(imgInfo, img);
+    
+    // add the info for this image to the list
+    addImageInfo(imgInfo);
+    return imgInfo;
+}
+
+
+// Adds the info to m_imageInfos and to the indexes by body and by name
+void RUBELayer::addImageInfo(RUBEImageInfo* imgInfo)
+{
+    m_imageInfos.insert(imgInfo);
+    indexImageInfo(imgInfo);
+}
+
+
+// Takes the info out of m_imageInfos and the indexes, but leaves the sprite alone
+void RUBELayer::forgetImageInfo(RUBEImageInfo* imgInfo)
+{
+    if ( m_imageInfos.erase(imgInfo) )
+        unindexImageInfo(imgInfo);
+}
+
+
+void RUBELayer::indexImageInfo(RUBEImageInfo* imgInfo)
+{
+    if ( imgInfo->body )
+        m_imageInfosByBody[imgInfo->body].push_back(imgInfo);
+    m_imageInfosByName[imgInfo->name].push_back(imgInfo);
+}
+
+
+static void removeFromImageIndex(std::vector<RUBEImageInfo*>& infos, RUBEImageInfo* imgInfo)
+{
+    infos.erase( std::remove(infos.begin(), infos.end(), imgInfo), infos.end() );
+}
+
+void RUBELayer::unindexImageInfo(RUBEImageInfo* imgInfo)
+{
+    if ( imgInfo->body ) {
+        unordered_map<b2Body*, vector<RUBEImageInfo*> >::iterator it = m_imageInfosByBody.find(imgInfo->body);
+        if ( it != m_imageInfosByBody.end() ) {
+            removeFromImageIndex(it->second, imgInfo);
+            if ( it->second.empty() )
+                m_imageInfosByBody.erase(it);
+        }
+    }
+    unordered_map<string, vector<RUBEImageInfo*> >::iterator it = m_imageInfosByName.find(imgInfo->name);
+    if ( it != m_imageInfosByName.end() ) {
+        removeFromImageIndex(it->second, imgInfo);
+        if ( it->second.empty() )
+            m_imageInfosByName.erase(it);
+    }
+}
+
+
+// Copies everything except the file from the image to the info, and sets the
+// sprite properties that will not change during simulation
+void RUBELayer::setImageInfo(RUBEImageInfo* imgInfo, b2dJsonImage* img)
+{
+    Sprite* sprite = imgInfo->sprite;
+    
+    // set the render order
+    reorderChild(sprite, img->renderOrder); //watch out - RUBE render order is float but cocos2d uses integer (why not float?)
+    
+    // these will not change during simulation so we can set them now
+    sprite->setFlipX(img->flip);
+    sprite->setColor(ccc3(img->colorTint[0], img->colorTint[1], img->colorTint[2]));
+    sprite->setOpacity(img->colorTint[3]);
+    sprite->setScale(img->scale / sprite->getContentSize().height);
+    
+    // the body and name may be different after a hot reload
+    bool indexed = m_imageInfos.count(imgInfo) > 0;
+    if ( indexed )
+        unindexImageInfo(imgInfo);
+    imgInfo->name = img->name;
+    imgInfo->body = img->body;
+    if ( indexed )
+        indexImageInfo(imgInfo);
+    imgInfo->scale = img->scale;
+    imgInfo->aspectScale = img->aspectScale;
+    imgInfo->angle = img->angle;
+    imgInfo->center = CCPointMake(img->center.x, img->center.y);
+    imgInfo->opacity = img->opacity;
+    imgInfo->flip = img->flip;
+    for (int n = 0; n < 4; n++)
+        imgInfo->colorTint[n] = img->colorTint[n];
+}
+
+
+// Called when the scene file has changed and been applied to the world again. The
+// sprites of images that have not changed are kept as they are, and those that have
+// changed but still use the same file are updated, so only new image files are loaded.
+void RUBELayer::afterHotReload(b2dJson* json, const b2dJsonReloadInfo& info)
+{
+    std::vector<b2dJsonImage*> b2dImages;
+    json->getAllImagesInFileOrder(b2dImages);
+    
+    std::vector<RUBEImageInfo*> newImageInfos;
+    std::set<RUBEImageInfo*> usedImageInfos;
     for (int i = 0; i < b2dImages.size(); i++) {
         b2dJsonImage* img = b2dImages[i];
         
-        CCLOG("Loading image: %s", img->file.c_str());
-        
-        // try to load the sprite image, and ignore if it fails
-        Sprite* sprite = new Sprite();
-        sprite->initWithFile(img->file.c_str());
-        if ( ! sprite )
-            continue;
-        
-        // add the sprite to this layer and set the render order
-        addChild(sprite);
-        reorderChild(sprite, img->renderOrder); //watch out - RUBE render order is float but cocos2d uses integer (why not float?)
-        
-        // these will not change during simulation so we can set them now
-        sprite->setFlipX(img->flip);
-        sprite->setColor(ccc3(img->colorTint[0], img->colorTint[1], img->colorTint[2]));
-        sprite->setOpacity(img->colorTint[3]);
-        sprite->setScale(img->scale / sprite->getContentSize().height);
+        // the info for the same image in the old scene, unless it has been removed since
+        RUBEImageInfo* imgInfo = NULL;
+        int source = info.imageSources[i];
+        if ( source >= 0 && source < m_imageInfosInFileOrder.size() )
+            imgInfo = m_imageInfosInFileOrder[source];
+        if ( imgInfo && m_imageInfos.find(imgInfo) == m_imageInfos.end() )
+            imgInfo = NULL;
         
-        // create an info structure to hold the info for this image (body and position etc)
-        RUBEImageInfo* imgInfo = new RUBEImageInfo;
-        imgInfo->sprite = sprite;
-        imgInfo->name = img->name;
-        imgInfo->body = img->body;
-        imgInfo->scale = img->scale;
-        imgInfo->aspectScale = img->aspectScale;
-        imgInfo->angle = img->angle;
-        imgInfo->center = CCPointMake(img->center.x, img->center.y);
-        imgInfo->opacity = img->opacity;
-        imgInfo->flip = img->flip;
-        for (int n = 0; n < 4; n++)
-            imgInfo->colorTint[n] = img->colorTint[n];
+        if ( imgInfo && imgInfo->file == img->file ) {
+            if ( info.imagesChanged[i] )
+                setImageInfo(imgInfo, img);
+        }
+        else
+            imgInfo = createImageInfo(img);
         
-        // add the info for this image to the list
-        m_imageInfos.insert(imgInfo);
+        newImageInfos.push_back(imgInfo);
+        usedImageInfos.insert(imgInfo);
     }
     
-    // start the images at their current positions on the physics bodies
+    // anything left over is no longer in the scene
+    for (int i = 0; i < m_imageInfosInFileOrder.size(); i++) {
+        RUBEImageInfo* imgInfo = m_imageInfosInFileOrder[i];
+        if ( imgInfo && !usedImageInfos.count(imgInfo) && m_imageInfos.count(imgInfo) )
+            removeImageFromWorld(imgInfo);
+    }
+    
+    m_imageInfosInFileOrder.swap(newImageInfos);
+    
     setImagePositionsFromPhysicsBodies();
 }
 
@@ -128,17 +281,62 @@ void RUBELayer::clear()
         RUBEImageInfo* imgInfo = *it;
         removeChild(imgInfo->sprite, true);
     }
+    m_imageInfos.clear();
+    m_imageInfosInFileOrder.clear();
+    m_imageInfosByBody.clear();
+    m_imageInfosByName.clear();
+    
+    // the bodies and sprites have gone with the world and the image infos
+    if ( !m_bodyPool.getPrefabs().empty() )
+        logPrefabStats();
+    m_bodyPool.clear();
+    m_prefabTemplateImages.clear();
+    m_queuedBodies.clear();
+    m_queuedBodySet.clear();
+    
+    playReplay(NULL);
     
     BasicRUBELayer::clear();
 }
 
 
+// Called by the tile streamer when all of a tile is in the world. The images are
+// made the same way as in afterLoadProcessing, so they are drawn in render order
+// among themselves, but on top of everything that was there before the tile.
+void RUBELayer::tileCreated(int tileIndex, b2dJson* json)
+{
+    std::vector<b2dJsonImage*> b2dImages;
+    json->getAllImages(b2dImages);
+    for (int i = 0; i < b2dImages.size(); i++) {
+        RUBEImageInfo* imgInfo = createImageInfo(b2dImages[i]);
+        if ( imgInfo && imgInfo->body )
+            setImagePosition(imgInfo, imgInfo->body->GetPosition(), imgInfo->body->GetAngle());
+    }
+}
+
+
+// Called by the tile streamer just before the bodies of a tile are destroyed
+void RUBELayer::tileRemoving(int tileIndex, const std::vector<b2Body*>& bodies)
+{
+    for (int i = 0; i < bodies.size(); i++)
+        removeImagesOnBody(bodies[i]);
+}
+
+
 // Standard Cocos2d method. Call the super class to step the physics world, and then
 // move the images to match the physics body positions
 void RUBELayer::update(float dt)
 {
+    // while playing a replay the world is left as it is
+    if ( m_replayPlayer ) {
+        m_replayPlayer->nextFrame();
+        setImagePositionsFromReplay();
+        return;
+    }
+    
     //superclass will Step the physics world
     BasicRUBELayer::update(dt);
+    removeQueuedBodies();
     setImagePositionsFromPhysicsBodies();
 }
 
@@ -146,21 +344,77 @@ void RUBELayer::update(float dt)
 // Move all the images to where the physics engine says they should be
 void RUBELayer::setImagePositionsFromPhysicsBodies()
 {
+    RUBE_PROFILE_SCOPE(PS_IMAGES);
     for (set<RUBEImageInfo*>::iterator it = m_imageInfos.begin(); it != m_imageInfos.end(); ++it) {
         RUBEImageInfo* imgInfo = *it;
-        CCPoint pos = imgInfo->center;
-        float angle = -imgInfo->angle;
-        if ( imgInfo->body ) {            
-            //need to rotate image local center by body angle
-            b2Vec2 localPos( pos.x, pos.y );
-            b2Rot rot( imgInfo->body->GetAngle() );
-            localPos = b2Mul(rot, localPos) + imgInfo->body->GetPosition();
-            pos.x = localPos.x;
-            pos.y = localPos.y;
-            angle += -imgInfo->body->GetAngle();
+        if ( imgInfo->body )
+            setImagePosition( imgInfo, imgInfo->body->GetPosition(), imgInfo->body->GetAngle() );
+        else
+            setImagePosition( imgInfo, b2Vec2(0,0), 0 );
+    }
+}
+
+
+// Places the image relative to its body, which is at the given position and angle
+void RUBELayer::setImagePosition(RUBEImageInfo* imgInfo, const b2Vec2& bodyPosition, float bodyAngle)
+{
+    CCPoint pos = imgInfo->center;
+    float angle = -imgInfo->angle;
+    if ( imgInfo->body ) {
+        //need to rotate image local center by body angle
+        b2Vec2 localPos( pos.x, pos.y );
+        b2Rot rot( bodyAngle );
+        localPos = b2Mul(rot, localPos) + bodyPosition;
+        pos.x = localPos.x;
+        pos.y = localPos.y;
+        angle += -bodyAngle;
+    }
+    imgInfo->sprite->setRotation( CC_RADIANS_TO_DEGREES(angle) );
+    imgInfo->sprite->setPosition( pos );
+}
+
+
+// Starts playing back a recording made by a layer with the same scene (see
+// BasicRUBELayer::recordReplay). This must be done before any bodies are added to
+// or removed from the world after loading, so that they are numbered the same way
+// as when the recording began. The world is not stepped while the replay plays, and
+// the debug draw will show the bodies where they were when it started.
+void RUBELayer::playReplay(Box2DReplayPlayer* player)
+{
+    if ( m_replayPlayer )
+        delete m_replayPlayer;
+    m_replayPlayer = player;
+    
+    m_replayBodyIds.clear();
+    if ( !m_replayPlayer || !m_world )
+        return;
+    
+    int id = 0;
+    for (b2Body* body = m_world->GetBodyList(); body; body = body->GetNext())
+        m_replayBodyIds[body] = id++;
+}
+
+
+// Move all the images to where their bodies were in the current frame of the replay.
+// Images on bodies that had been destroyed by then are hidden.
+void RUBELayer::setImagePositionsFromReplay()
+{
+    for (set<RUBEImageInfo*>::iterator it = m_imageInfos.begin(); it != m_imageInfos.end(); ++it) {
+        RUBEImageInfo* imgInfo = *it;
+        if ( !imgInfo->body ) {
+            setImagePosition( imgInfo, b2Vec2(0,0), 0 );
+            continue;
         }
-        imgInfo->sprite->setRotation( CC_RADIANS_TO_DEGREES(angle) );
-        imgInfo->sprite->setPosition( pos );
+        
+        map<b2Body*, int>::iterator idIt = m_replayBodyIds.find(imgInfo->body);
+        if ( idIt == m_replayBodyIds.end() )
+            continue;
+        
+        int id = idIt->second;
+        bool present = m_replayPlayer->isPresent(id);
+        imgInfo->sprite->setVisible(present);
+        if ( present )
+            setImagePosition( imgInfo, m_replayPlayer->getPosition(id), m_replayPlayer->getAngle(id) );
     }
 }
 
@@ -168,22 +422,87 @@ void RUBELayer::setImagePositionsFromPhysicsBodies()
 // Remove one body and any images is had attached to it from the layer
 void RUBELayer::removeBodyFromWorld(b2Body* body)
 {
-    //destroy the body in the physics world
-    m_world->DestroyBody( body );
+    vector<b2Body*> bodies(1, body);
+    removeBodiesFromWorld(bodies);
+}
+
+
+// Remove several bodies and their images
+void RUBELayer::removeBodiesFromWorld(const std::vector<b2Body*>& bodies)
+{
+    for (int i = 0; i < bodies.size(); i++) {
+        b2Body* body = bodies[i];
+        
+        //the hash and the activation manager would look at the destroyed body otherwise
+        if ( m_worldHash )
+            m_worldHash->removeBody( body );
+        if ( m_activationManager )
+            m_activationManager->removeBody( body );
+        
+        //forget about it if it was a copy of a prefab
+        m_bodyPool.forgetBody( body );
+        
+        //destroy the body in the physics world
+        m_world->DestroyBody( body );
+        
+        //remove all sprites that were attached to the body we just deleted, and their infos
+        removeImagesOnBody( body );
+    }
     
-    //go through the image info array and remove all sprites that were attached to the body we just deleted
+    //a mouse joint on any of them went too
+    forgetMouseJointIfDestroyed();
+}
+
+
+void RUBELayer::removeImagesOnBody(b2Body* body)
+{
+    unordered_map<b2Body*, vector<RUBEImageInfo*> >::iterator it = m_imageInfosByBody.find(body);
+    if ( it == m_imageInfosByBody.end() )
+        return;
     vector<RUBEImageInfo*> imagesToRemove;
-    for (set<RUBEImageInfo*>::iterator it = m_imageInfos.begin(); it != m_imageInfos.end(); ++it) {
-        RUBEImageInfo* imgInfo = *it;
-        if ( imgInfo->body == body ) {
-            removeChild(imgInfo->sprite, true);
-            imagesToRemove.push_back(imgInfo);
-        }
+    imagesToRemove.swap(it->second);
+    m_imageInfosByBody.erase(it);
+    for (int k = 0; k < imagesToRemove.size(); k++) {
+        RUBEImageInfo* imgInfo = imagesToRemove[k];
+        removeChild(imgInfo->sprite, true);
+        imgInfo->body = NULL; //already out of the body index
+        forgetImageInfo(imgInfo);
+    }
+}
+
+
+// Asks for the body to be removed after the current step has finished, or at the
+// end of the next one if the world is not being stepped at the moment. This is
+// safe to call from anywhere, including contact listener callbacks, and asking
+// for the same body more than once is fine. Bodies from spawnBody are parked
+// instead of being destroyed. The body must not be destroyed in any other way
+// while it is in the queue.
+void RUBELayer::queueBodyForRemoval(b2Body* body)
+{
+    if ( m_queuedBodySet.insert(body).second )
+        m_queuedBodies.push_back(body);
+}
+
+
+// Called after each step to remove everything in the queue in one go, in the order
+// the bodies were queued.
+void RUBELayer::removeQueuedBodies()
+{
+    if ( m_queuedBodies.empty() )
+        return;
+    
+    vector<b2Body*> bodiesToDestroy;
+    for (int i = 0; i < m_queuedBodies.size(); i++) {
+        b2Body* body = m_queuedBodies[i];
+        if ( m_bodyPool.getPrefabOfBody(body) )
+            recycleBody(body);
+        else
+            bodiesToDestroy.push_back(body);
     }
+    m_queuedBodies.clear();
+    m_queuedBodySet.clear();
     
-    //also remove the infos for those images from the image info array
-    for (int i = 0; i < imagesToRemove.size(); i++)
-        m_imageInfos.erase( imagesToRemove[i] );
+    removeBodiesFromWorld(bodiesToDestroy);
 }
 
 
@@ -191,31 +510,131 @@ void RUBELayer::removeBodyFromWorld(b2Body* body)
 void RUBELayer::removeImageFromWorld(RUBEImageInfo* imgInfo)
 {
     removeChild(imgInfo->sprite, true);
-    m_imageInfos.erase(imgInfo);
+    forgetImageInfo(imgInfo);
 }
 
 Sprite* RUBELayer::getAnySpriteOnBody(b2Body* body)
 {
-    for (set<RUBEImageInfo*>::iterator it = m_imageInfos.begin(); it != m_imageInfos.end(); ++it) {
-        RUBEImageInfo* imgInfo = *it;
-        if ( imgInfo->body == body )
-            return imgInfo->sprite;
-    }
-    return NULL;
+    const vector<RUBEImageInfo*>* infos = getImageInfosOnBody(body);
+    return infos ? infos->front()->sprite : NULL;
 }
 
 Sprite* RUBELayer::getSpriteWithImageName(std::string name)
 {
-    for (set<RUBEImageInfo*>::iterator it = m_imageInfos.begin(); it != m_imageInfos.end(); ++it) {
-        RUBEImageInfo* imgInfo = *it;
-        if ( imgInfo->name == name )
-            return imgInfo->sprite;
+    const vector<RUBEImageInfo*>* infos = getImageInfosWithName(name);
+    return infos ? infos->front()->sprite : NULL;
+}
+
+// The infos of the images on the body, in the order they were added, or NULL if there are none
+const std::vector<RUBEImageInfo*>* RUBELayer::getImageInfosOnBody(b2Body* body)
+{
+    unordered_map<b2Body*, vector<RUBEImageInfo*> >::iterator it = m_imageInfosByBody.find(body);
+    return it == m_imageInfosByBody.end() ? NULL : &it->second;
+}
+
+// The infos of the images with this name, in the order they were added, or NULL if there are none
+const std::vector<RUBEImageInfo*>* RUBELayer::getImageInfosWithName(const std::string& name)
+{
+    unordered_map<string, vector<RUBEImageInfo*> >::iterator it = m_imageInfosByName.find(name);
+    return it == m_imageInfosByName.end() ? NULL : &it->second;
+}
+
+
+// Makes the body a template that copies can be spawned from. The body is taken out
+// of the simulation and its images are hidden, but they stay in the layer so that
+// the sprite properties can be copied from them.
+Box2DPrefab* RUBELayer::registerPrefab(std::string name, b2Body* templateBody)
+{
+    Box2DPrefab* prefab = m_bodyPool.registerPrefab(name, templateBody);
+    
+    vector<RUBEImageInfo*>& templateImages = m_prefabTemplateImages[prefab];
+    templateImages.clear();
+    if ( const vector<RUBEImageInfo*>* infos = getImageInfosOnBody(templateBody) )
+        templateImages = *infos;
+    for (int i = 0; i < templateImages.size(); i++)
+        templateImages[i]->sprite->setVisible(false);
+    
+    return prefab;
+}
+
+
+// Makes copies of the template images for a new copy of the body, hidden until
+// spawnBody shows them.
+void RUBELayer::createPrefabImages(Box2DPrefab* prefab, b2Body* body)
+{
+    const vector<RUBEImageInfo*>& templateImages = m_prefabTemplateImages[prefab];
+    for (int i = 0; i < templateImages.size(); i++) {
+        RUBEImageInfo* templateInfo = templateImages[i];
+        
+        Sprite* sprite = Sprite::create(templateInfo->file.c_str()); // autoreleased, so the layer is the only owner
+        if ( !sprite )
+            continue;
+        addChild(sprite, templateInfo->sprite->getZOrder());
+        sprite->setFlipX(templateInfo->flip);
+        sprite->setColor(ccc3(templateInfo->colorTint[0], templateInfo->colorTint[1], templateInfo->colorTint[2]));
+        sprite->setOpacity(templateInfo->colorTint[3]);
+        sprite->setScale(templateInfo->sprite->getScale());
+        sprite->setVisible(false);
+        
+        RUBEImageInfo* imgInfo = new RUBEImageInfo(*templateInfo);
+        imgInfo->sprite = sprite;
+        imgInfo->body = body;
+        addImageInfo(imgInfo);
     }
-    return NULL;
 }
 
 
+void RUBELayer::showSpawnedBodyImages(b2Body* body, bool show)
+{
+    const vector<RUBEImageInfo*>* images = getImageInfosOnBody(body);
+    if ( !images )
+        return;
+    for (int i = 0; i < images->size(); i++) {
+        RUBEImageInfo* imgInfo = (*images)[i];
+        imgInfo->sprite->setVisible(show);
+        if ( show )
+            setImagePosition( imgInfo, body->GetPosition(), body->GetAngle() );
+    }
+}
 
 
+// Gives out a copy of the prefab at the given place and speed, reusing a parked one
+// (and its images) if there is one.
+b2Body* RUBELayer::spawnBody(std::string prefabName, b2Vec2 position, float angle, b2Vec2 velocity, float angularVelocity)
+{
+    Box2DPrefab* prefab = m_bodyPool.getPrefab(prefabName);
+    if ( !prefab || !m_world ) {
+        CCLOG("No prefab called %s", prefabName.c_str());
+        return NULL;
+    }
+    
+    bool madeNewCopy;
+    b2Body* body = m_bodyPool.spawnBody(prefab, position, angle, velocity, angularVelocity, &madeNewCopy);
+    if ( madeNewCopy )
+        createPrefabImages(prefab, body);
+    showSpawnedBodyImages(body, true);
+    
+    return body;
+}
+
+
+// Call this instead of removeBodyFromWorld for bodies that may have come from spawnBody.
+// Like removeBodyFromWorld, this must not be called during the world step.
+void RUBELayer::recycleBody(b2Body* body)
+{
+    if ( !m_bodyPool.parkBody(body) ) {
+        removeBodyFromWorld(body);
+        return;
+    }
+    showSpawnedBodyImages(body, false);
+}
 
 
+void RUBELayer::logPrefabStats()
+{
+    const map<string, Box2DPrefab*>& prefabs = m_bodyPool.getPrefabs();
+    for (map<string, Box2DPrefab*>::const_iterator it = prefabs.begin(); it != prefabs.end(); ++it) {
+        Box2DPrefab* prefab = it->second;
+        CCLOG("Prefab %s: %d hits, %d misses, %d parked", prefab->name.c_str(), prefab->hits, prefab->misses, (int)prefab->parkedBodies.size());
+    }
+}
@@ -10,7 +10,12 @@
 #ifndef RUBE_LAYER
 #define RUBE_LAYER
 
+#include <unordered_map>
 #include "BasicRUBELayer.h"
+#include "Box2DBodyPool.h"
+
+class b2dJsonImage;
+class Box2DReplayPlayer;
 
 //
 //  RUBEImageInfo
@@ -25,7 +30,8 @@
 struct RUBEImageInfo {
     
     cocos2d::Sprite* sprite;      // the image
-    std::string name;               // the file the image was loaded from
+    std::string name;               // the name of the image in the RUBE scene
+    std::string file;               // the file the image was loaded from
     class b2Body* body;             // the body this image is attached to (can be NULL)
     float scale;                    // a scale of 1 means the image is 1 physics unit high
     float aspectScale;              // modify the natural aspect of the image
@@ -37,6 +43,22 @@ struct RUBEImageInfo {
     
 };
 
+//
+//  Prefabs
+//
+//  A body in the scene that copies can be made of while the game is
+//  running, eg. bullets or debris. Give a body a custom string property
+//  called "prefab" in RUBE and it will be set up as one, with the value
+//  of the property as its name. The body itself is only a template: it
+//  is taken out of the simulation and its images are hidden.
+//
+//  The bodies are looked after by a Box2DBodyPool, which parks copies
+//  that are no longer needed instead of destroying them. The layer hides
+//  the sprites of parked copies, and shows them again when they are given
+//  out by the next spawn. Only the body, its fixtures and its images are
+//  copied, not joints.
+//
+
 //-------------------------
 
 class RUBELayer : public BasicRUBELayer
@@ -44,8 +66,31 @@ class RUBELayer : public BasicRUBELayer
 protected:
     std::set<RUBEImageInfo*> m_imageInfos;                  // holds some information about images in the scene, most importantly the
                                                             //     body they are attached to and their position relative to that body
+    std::vector<RUBEImageInfo*> m_imageInfosInFileOrder;    // the same, in the order of the scene file, to match them up after a hot reload
+    Box2DReplayPlayer* m_replayPlayer;                      // moves the images instead of the physics, NULL if not playing a replay
+    std::map<b2Body*, int> m_replayBodyIds;                 // the id of each body in the replay, numbered as Box2DReplayRecorder does
+    Box2DBodyPool m_bodyPool;                               // the prefabs, and the copies of them that are in use or parked
+    std::map<Box2DPrefab*, std::vector<RUBEImageInfo*> > m_prefabTemplateImages; // hidden, only used to make copies
+    std::unordered_map<b2Body*, std::vector<RUBEImageInfo*> > m_imageInfosByBody;     // the same infos as m_imageInfos, by the body they are on
+    std::unordered_map<std::string, std::vector<RUBEImageInfo*> > m_imageInfosByName; // ... and by their name (kept up to date by addImageInfo and forgetImageInfo)
+    std::vector<b2Body*> m_queuedBodies;                    // to be removed after the step, in the order they were asked for
+    std::set<b2Body*> m_queuedBodySet;                      // the same, to ignore a body that is asked for twice
+    
+    RUBEImageInfo* createImageInfo(b2dJsonImage* img);      // makes a sprite for the image and adds it to the layer
+    void addImageInfo(RUBEImageInfo* imgInfo);              // adds to m_imageInfos and the indexes
+    void forgetImageInfo(RUBEImageInfo* imgInfo);           // removes from m_imageInfos and the indexes
+    void indexImageInfo(RUBEImageInfo* imgInfo);
+    void unindexImageInfo(RUBEImageInfo* imgInfo);
+    void setImageInfo(RUBEImageInfo* imgInfo, b2dJsonImage* img); // sets the sprite properties and body position from the image
+    void setImagePosition(RUBEImageInfo* imgInfo, const b2Vec2& bodyPosition, float bodyAngle); // places the sprite relative to where its body is
+    void removeImagesOnBody(b2Body* body);                  // removes the sprites of the body and forgets their infos
+    void createPrefabImages(Box2DPrefab* prefab, b2Body* body); // makes hidden copies of the template images for a new copy of the body
+    void showSpawnedBodyImages(b2Body* body, bool show);    // makes the images of a spawned body visible, or hides them
     
 public:
+    RUBELayer();
+    virtual ~RUBELayer();
+    
     static cocos2d::Scene* scene();                       // returns a scene that contains a RUBELayer as a child
     
     virtual std::string getFilename();                      // overrides base class
@@ -53,17 +98,32 @@ public:
     virtual float initialWorldScale();                      // overrides base class
     
     virtual void afterLoadProcessing(b2dJson* json);        // overrides base class
+    virtual void afterHotReload(b2dJson* json, const b2dJsonReloadInfo& info); // overrides base class
     virtual void clear();                                   // overrides base class
+    virtual void tileCreated(int tileIndex, b2dJson* json); // overrides base class, makes the sprites for the images of a streamed tile
+    virtual void tileRemoving(int tileIndex, const std::vector<b2Body*>& bodies); // overrides base class, takes them away again
     
     void setImagePositionsFromPhysicsBodies();              // called every frame to move the images to the correct position when bodies move
+    void playReplay(Box2DReplayPlayer* player);             // stops stepping the world and moves the images as recorded instead (takes ownership, NULL to stop)
+    void setImagePositionsFromReplay();                     // called every frame instead of the above while playing a replay
     
     virtual void update(float dt);                          // standard Cocos2d function
     
     void removeBodyFromWorld(b2Body* body);                 // removes a body and its images from the layer
+    void removeBodiesFromWorld(const std::vector<b2Body*>& bodies); // the same for several bodies at once
+    void queueBodyForRemoval(b2Body* body);                 // removes the body after the step, can be called from contact listeners
+    void removeQueuedBodies();                              // called after each step
     void removeImageFromWorld(RUBEImageInfo* imgInfo);      // removes an image from the layer
     
+    Box2DPrefab* registerPrefab(std::string name, b2Body* templateBody); // makes the body a template for spawnBody (bodies with a "prefab" custom property are done on loading)
+    b2Body* spawnBody(std::string prefabName, b2Vec2 position, float angle, b2Vec2 velocity = b2Vec2(0,0), float angularVelocity = 0); // returns NULL if there is no such prefab
+    void recycleBody(b2Body* body);                         // parks a body from spawnBody to be used again, or removes any other body from the world
+    void logPrefabStats();                                  // hits and misses of each prefab
+    
     cocos2d::Sprite* getAnySpriteOnBody(b2Body* body);            // returns the first sprite found attached to the given body, or nil if there are none
     cocos2d::Sprite* getSpriteWithImageName(std::string name);    // returns the first sprite found with the give name (as named in the RUBE scene) or nil if there is none
+    const std::vector<RUBEImageInfo*>* getImageInfosOnBody(b2Body* body);               // all the images on the body, or NULL if there are none
+    const std::vector<RUBEImageInfo*>* getImageInfosWithName(const std::string& name);  // all the images with the name, or NULL if there are none
 
 };
 
@@ -0,0 +1,174 @@
+//
+//  RUBEWorldScheduler
+//
+//  See header file for description.
+//
+
+#include <chrono>
+#include <algorithm>
+#include "RUBEWorldScheduler.h"
+#include "BasicRUBELayer.h"
+#include "RUBEFrameProfiler.h"
+#include "Box2DThreadWarmUp.h"
+
+using namespace std;
+USING_NS_CC;
+
+RUBEWorldScheduler* RUBEWorldScheduler::s_instance = NULL;
+
+RUBEWorldScheduler* RUBEWorldScheduler::getInstance()
+{
+    if ( !s_instance ) {
+        // this is on the main thread, before any of the threads are started
+        warmUpBox2DForThreads();
+        s_instance = new RUBEWorldScheduler();
+        // the layers use priority zero, so this goes before all of them
+        Director::getInstance()->getScheduler()->scheduleUpdateForTarget(s_instance, -1, false);
+    }
+    return s_instance;
+}
+
+RUBEWorldScheduler::RUBEWorldScheduler()
+{
+    m_generation = 0;
+    m_unfinished = 0;
+    m_busyThreads = 0;
+    m_quit = false;
+    m_nextLayer = 0;
+    m_lastFrameTime = 0;
+    m_totalFrameTime = 0;
+    m_frameCount = 0;
+    m_worldStepCount = 0;
+}
+
+RUBEWorldScheduler::~RUBEWorldScheduler()
+{
+    stopThreads();
+}
+
+void RUBEWorldScheduler::addLayer(BasicRUBELayer* layer)
+{
+    if ( std::find(m_layers.begin(), m_layers.end(), layer) != m_layers.end() )
+        return;
+    m_layers.push_back(layer);
+
+    // the main thread steps one of the worlds itself
+    int cores = (int)std::thread::hardware_concurrency();
+    startThreads( std::min( std::max(cores, 1) - 1, (int)m_layers.size() - 1 ) );
+}
+
+void RUBEWorldScheduler::removeLayer(BasicRUBELayer* layer)
+{
+    m_layers.erase( std::remove(m_layers.begin(), m_layers.end(), layer), m_layers.end() );
+    if ( !m_layers.empty() )
+        return;
+
+    if ( m_frameCount > 0 )
+        CCLOG("World scheduler: %.3f ms per frame to step %.1f worlds on average, with %d threads",
+              m_totalFrameTime / m_frameCount, m_worldStepCount / (double)m_frameCount, (int)m_threads.size() + 1);
+    stopThreads();
+
+    // the Cocos2d scheduler holds on to this until it has finished with it
+    Director::getInstance()->getScheduler()->unscheduleUpdateForTarget(this);
+    s_instance = NULL;
+    release();
+}
+
+void RUBEWorldScheduler::startThreads(int count)
+{
+    while ( (int)m_threads.size() < count )
+        m_threads.push_back( std::thread(&RUBEWorldScheduler::threadLoop, this) );
+}
+
+void RUBEWorldScheduler::stopThreads()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_workReady.notify_all();
+    for (int i = 0; i < (int)m_threads.size(); i++)
+        m_threads[i].join();
+    m_threads.clear();
+    m_quit = false;
+}
+
+void RUBEWorldScheduler::threadLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    int seenGeneration = m_generation;
+    while ( true ) {
+        // A thread that wakes up too late to help with a frame goes back to sleep
+        // without touching anything. Being counted in m_busyThreads while still
+        // holding the lock makes sure the main thread waits for the others.
+        while ( !m_quit && (m_generation == seenGeneration || m_unfinished == 0) ) {
+            seenGeneration = m_generation;
+            m_workReady.wait(lock);
+        }
+        if ( m_quit )
+            return;
+        seenGeneration = m_generation;
+        m_busyThreads++;
+
+        lock.unlock();
+        stepWorlds();
+        lock.lock();
+
+        if ( --m_busyThreads == 0 && m_unfinished == 0 )
+            m_workDone.notify_one();
+    }
+}
+
+// Each thread (including the main one) keeps taking the next world that nobody
+// has started on, until there are none left.
+void RUBEWorldScheduler::stepWorlds()
+{
+    int i;
+    while ( (i = m_nextLayer++) < (int)m_stepping.size() ) {
+        m_stepping[i]->stepWorld();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if ( --m_unfinished == 0 && m_busyThreads == 0 )
+            m_workDone.notify_one();
+    }
+}
+
+void RUBEWorldScheduler::update(float dt)
+{
+    // layers that are not on screen yet, or are on their way out, are left alone like
+    // they would be if they were being updated by the Cocos2d scheduler themselves
+    m_stepping.clear();
+    for (int i = 0; i < (int)m_layers.size(); i++) {
+        if ( m_layers[i]->isRunning() )
+            m_stepping.push_back(m_layers[i]);
+    }
+    if ( m_stepping.empty() )
+        return;
+
+    RUBE_PROFILE_SCOPE(PS_PHYSICS);
+    for (int i = 0; i < (int)m_stepping.size(); i++)
+        m_stepping[i]->beforeStep();
+
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_unfinished = (int)m_stepping.size();
+        m_nextLayer = 0;
+        m_generation++;
+    }
+    m_workReady.notify_all();
+    stepWorlds();
+    {
+        // the threads must also be out of stepWorlds before m_stepping can be changed again
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while ( m_unfinished > 0 || m_busyThreads > 0 )
+            m_workDone.wait(lock);
+    }
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    m_lastFrameTime = elapsed.count();
+    m_totalFrameTime += m_lastFrameTime;
+    m_frameCount++;
+    m_worldStepCount += m_stepping.size();
+
+    for (int i = 0; i < (int)m_stepping.size(); i++)
+        m_stepping[i]->afterStep();
+}
@@ -0,0 +1,103 @@
+//
+//  RUBEWorldScheduler
+//
+//  Steps the worlds of several RUBE layers at the same time, one on each
+//  core. Without this, each layer steps its own world in its update, one
+//  after the other on the main thread, so two layers stacked in the same
+//  scene (eg. the UIControls layer over the PlanetCute layer) or several
+//  copies of a level side by side take the time of all their steps added
+//  together.
+//
+//  A layer is added when its world is loaded, if stepInParallel returns
+//  true (see BasicRUBELayer). Once per frame, before any of the layers
+//  are updated, this goes through three stages:
+//   - beforeStep for every layer, on the main thread
+//   - stepWorld for every layer, spread over a pool of threads (the main
+//     thread takes a share too), waiting until all of them are finished
+//   - afterStep for every layer, on the main thread
+//  After that the layer updates run as usual and find the world already
+//  stepped, so they move the images and do the game logic exactly as they
+//  would have done before.
+//
+//  The main thread waits while the worlds are being stepped, so nothing
+//  else in the app runs at the same time as a step. The whole step runs
+//  on another thread, including the callbacks that Box2D makes during it
+//  (the contact listener and contact filter), and the steps of different
+//  worlds overlap. So that the worlds share nothing that is written while
+//  stepping, the tables Box2D keeps for the whole process are filled in
+//  (see Box2DThreadWarmUp) before any threads are started. Box2D's own
+//  statistics counters (b2_gjkCalls etc.) are still written by all the
+//  threads, so don't rely on them with this.
+//
+//  A layer is only added if its world uses the contact listener and
+//  contact filter that BasicRUBELayer set up for it (Box2DContactEvents
+//  and RUBECollisionMatrix, or the Box2D defaults), which leave the events
+//  for the layer to go through on the main thread in its update. Any other
+//  listener or filter keeps the layer stepping in its own update. Anything
+//  else that the world calls, like the destruction listener and the debug
+//  draw, is only called from the main thread anyway.
+//
+//  The time taken by each world is measured by its Box2DIterationController,
+//  and the time taken to step all of them together is kept here.
+//
+//  There are never more threads than cores, or than worlds to step. The
+//  threads are stopped and this is deleted when the last layer is removed.
+//
+
+#ifndef RUBE_WORLD_SCHEDULER
+#define RUBE_WORLD_SCHEDULER
+
+#include "cocos2d.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class BasicRUBELayer;
+
+class RUBEWorldScheduler : public cocos2d::Object
+{
+protected:
+    static RUBEWorldScheduler* s_instance;
+
+    std::vector<BasicRUBELayer*> m_layers;
+    std::vector<BasicRUBELayer*> m_stepping;    // the layers being stepped in this frame
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;                     // guards everything below, except m_nextLayer
+    std::condition_variable m_workReady;    // wakes the threads when the frame's steps can start
+    std::condition_variable m_workDone;     // wakes the main thread when they are all finished
+    int m_generation;                       // goes up by one for each frame's steps
+    int m_unfinished;                       // worlds not finished stepping in this frame
+    int m_busyThreads;                      // threads that have woken up for this frame and not gone back to sleep
+    bool m_quit;
+    std::atomic<int> m_nextLayer;           // the next one to be taken by whichever thread gets to it first
+
+    float m_lastFrameTime;                  // milliseconds to step all the worlds in the last frame
+    double m_totalFrameTime;
+    int m_frameCount;
+    long long m_worldStepCount;
+
+    RUBEWorldScheduler();
+    virtual ~RUBEWorldScheduler();
+
+    void startThreads(int count);
+    void stopThreads();
+    void threadLoop();
+    void stepWorlds();
+
+public:
+    static RUBEWorldScheduler* getInstance();   // made when first needed
+
+    void addLayer(BasicRUBELayer* layer);
+    void removeLayer(BasicRUBELayer* layer);    // deletes this when it was the last one
+
+    virtual void update(float dt);              // called by the Cocos2d scheduler every frame, before the layers
+
+    int getLayerCount() const { return (int)m_layers.size(); }
+    int getThreadCount() const { return (int)m_threads.size(); }
+    float getLastFrameTime() const { return m_lastFrameTime; }
+};
+
+#endif /* RUBE_WORLD_SCHEDULER */
@@ -72,10 +72,20 @@ void UIControlsRUBELayer::afterLoadProcessing(b2dJson* json)
 }
 
 
+// Nothing is called during the step, so the world can be stepped on another core
+// when this layer is put over a game layer that does the same
+bool UIControlsRUBELayer::stepInParallel()
+{
+    return true;
+}
+
+
 void UIControlsRUBELayer::update(float dt)
 {
     ButtonRUBELayer::update(dt);
     
+    RUBE_PROFILE_SCOPE(PS_GAME);
+    
     // Log movements of the dial
     if ( m_dialJoint ) {
         float currentDialValue = m_dialJoint->GetJointAngle();
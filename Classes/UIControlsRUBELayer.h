@@ -30,6 +30,7 @@ public:
     virtual std::string getFilename();
     
     virtual void afterLoadProcessing(b2dJson* json);
+    virtual bool stepInParallel();
     
     virtual void update(float dt);
     
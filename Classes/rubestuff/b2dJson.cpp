@@ -18,9 +18,14 @@
 
 #include <istream>
 #include <fstream>
+#include <string.h>
+#include <atomic>
 #include "b2dJson.h"
 #include "json/json.h"
 #include "b2dJsonImage.h"
+#include "b2dJsonWriteBuffer.h"
+#include "b2dJsonFileView.h"
+#include "b2dJsonThreadPool.h"
 
 using namespace std;
 
@@ -55,8 +60,13 @@ std::string b2dJson::writeToString(b2World* world)
     if (!world)
         return std::string();
 
-    Json::StyledWriter writer;
-    return writer.write( b2j(world) );
+    b2dJsonWriteBuffer out(4096 + 1024 * world->GetBodyCount());
+    b2jStream(world, out);
+    out.str() += '\n';
+
+    std::string str;
+    str.swap( out.str() );
+    return str;
 }
 
 bool b2dJson::writeToFile(b2World* world, const char* filename)
@@ -71,8 +81,10 @@ bool b2dJson::writeToFile(b2World* world, const char* filename)
         return false;
     }
 
-    Json::StyledStreamWriter writer("   ");
-    writer.write( ofs, b2j(world) );
+    b2dJsonWriteBuffer out(4096 + 1024 * world->GetBodyCount());
+    b2jStream(world, out);
+    out.str() += '\n';
+    ofs.write( out.str().data(), out.str().size() );
 
     ofs.close();
 
@@ -529,6 +541,541 @@ Json::Value b2dJson::b2j(b2dJsonImage *image)
     return imageValue;
 }
 
+// The b2jStream functions below write out the same values as the b2j functions
+// above, in the same order, but straight into a text buffer. Saving a large
+// world this way avoids building (and then walking) a Json::Value for every
+// body, fixture and vertex. Any change to what b2j writes needs to be made in
+// both places.
+
+void b2dJson::b2jStream(b2World* world, b2dJsonWriteBuffer& out)
+{
+    m_bodyToIndexMap.clear();
+    m_jointToIndexMap.clear();
+
+    out.beginObject();
+
+    vecToStream("gravity", world->GetGravity(), out);
+    out.key("allowSleep");
+    out.boolValue(world->GetAllowSleeping());
+    out.key("autoClearForces");
+    out.boolValue(world->GetAutoClearForces());
+    out.key("warmStarting");
+    out.boolValue(world->GetWarmStarting());
+    out.key("continuousPhysics");
+    out.boolValue(world->GetContinuousPhysics());
+    out.key("subStepping");
+    out.boolValue(world->GetSubStepping());
+
+    int i = 0;
+    if ( world->GetBodyList() ) {
+        out.key("body");
+        out.beginArray(true);
+        for (b2Body* body = world->GetBodyList(); body; body = body->GetNext()) {
+            m_bodyToIndexMap[body] = i;
+            b2jStream(body, out);
+            i++;
+        }
+        out.endArray();
+    }
+
+    //need two passes for joints because gear joints reference other joints
+    i = 0;
+    if ( world->GetJointList() ) {
+        out.key("joint");
+        out.beginArray(true);
+        for (b2Joint* joint = world->GetJointList(); joint; joint = joint->GetNext()) {
+            if ( joint->GetType() == e_gearJoint )
+                continue;
+            b2jStream(joint, out);
+            m_jointToIndexMap[joint] = i;
+            i++;
+        }
+        for (b2Joint* joint = world->GetJointList(); joint; joint = joint->GetNext()) {
+            if ( joint->GetType() != e_gearJoint )
+                continue;
+            b2jStream(joint, out);
+            m_jointToIndexMap[joint] = i;
+            i++;
+        }
+        out.endArray();
+    }
+
+    if ( ! m_imageToNameMap.empty() ) {
+        out.key("image");
+        out.beginArray(true);
+        std::map<b2dJsonImage*,string>::iterator it = m_imageToNameMap.begin();
+        std::map<b2dJsonImage*,string>::iterator end = m_imageToNameMap.end();
+        while (it != end) {
+            b2jStream(it->first, out);
+            ++it;
+        }
+        out.endArray();
+    }
+
+    writeCustomPropertiesToStream(NULL, out);
+
+    out.endObject();
+
+    m_bodyToIndexMap.clear();
+    m_jointToIndexMap.clear();
+}
+
+void b2dJson::b2jStream(b2Body* body, b2dJsonWriteBuffer& out)
+{
+    out.beginObject();
+
+    string bodyName = getBodyName(body);
+    if ( bodyName != "" ) {
+        out.key("name");
+        out.stringValue(bodyName);
+    }
+
+    out.key("type");
+    out.intValue(body->GetType());
+    switch( body->GetType() )
+    {
+    case b2_staticBody:
+        out.commentOnSameLine("//static");
+        break;
+    case b2_dynamicBody:
+        out.commentOnSameLine("//dynamic");
+        break;
+    case b2_kinematicBody:
+        out.commentOnSameLine("//kinematic");
+        break;
+    }
+
+    vecToStream("position", body->GetPosition(), out);
+    floatToStream("angle", body->GetAngle(), out);
+
+    vecToStream("linearVelocity", body->GetLinearVelocity(), out);
+    floatToStream("angularVelocity", body->GetAngularVelocity(), out);
+
+    if ( body->GetLinearDamping() != 0 )
+        floatToStream("linearDamping", body->GetLinearDamping(), out);
+    if ( body->GetAngularDamping() != 0 )
+        floatToStream("angularDamping", body->GetAngularDamping(), out);
+    if ( body->GetGravityScale() != 1 )
+        floatToStream("gravityScale", body->GetGravityScale(), out);
+
+    if ( body->IsBullet() ) {
+        out.key("bullet");
+        out.boolValue(true);
+    }
+    if ( ! body->IsSleepingAllowed() ) {
+        out.key("allowSleep");
+        out.boolValue(false);
+    }
+    if ( body->IsAwake() ) {
+        out.key("awake");
+        out.boolValue(true);
+    }
+    if ( ! body->IsActive() ) {
+        out.key("active");
+        out.boolValue(false);
+    }
+    if ( body->IsFixedRotation() ) {
+        out.key("fixedRotation");
+        out.boolValue(true);
+    }
+
+    b2MassData massData;
+    body->GetMassData(&massData);
+    if ( massData.mass != 0 )
+        floatToStream("massData-mass", massData.mass, out);
+    if ( massData.center.x != 0 || massData.center.y != 0 )
+        vecToStream("massData-center", massData.center, out);
+    if ( massData.I != 0 )
+        floatToStream("massData-I", massData.I, out);
+
+    if ( body->GetFixtureList() ) {
+        out.key("fixture");
+        out.beginArray(true);
+        for (b2Fixture* fixture = body->GetFixtureList(); fixture; fixture = fixture->GetNext())
+            b2jStream(fixture, out);
+        out.endArray();
+    }
+
+    writeCustomPropertiesToStream(body, out);
+
+    out.endObject();
+}
+
+void b2dJson::b2jStream(b2Fixture* fixture, b2dJsonWriteBuffer& out)
+{
+    out.beginObject();
+
+    string fixtureName = getFixtureName(fixture);
+    if ( fixtureName != "" ) {
+        out.key("name");
+        out.stringValue(fixtureName);
+    }
+
+    if ( fixture->GetRestitution() != 0 )
+        floatToStream("restitution", fixture->GetRestitution(), out);
+    if ( fixture->GetFriction() != 0 )
+        floatToStream("friction", fixture->GetFriction(), out);
+    if ( fixture->GetDensity() != 0 )
+        floatToStream("density", fixture->GetDensity(), out);
+    if ( fixture->IsSensor() ) {
+        out.key("sensor");
+        out.boolValue(true);
+    }
+
+    b2Filter filter = fixture->GetFilterData();
+    if ( filter.categoryBits != 0x0001 ) {
+        out.key("filter-categoryBits");
+        out.intValue(filter.categoryBits);
+    }
+    if ( filter.maskBits != 0xffff ) {
+        out.key("filter-maskBits");
+        out.intValue(filter.maskBits);
+    }
+    if ( filter.groupIndex != 0 ) {
+        out.key("filter-groupIndex");
+        out.intValue(filter.groupIndex);
+    }
+
+    b2Shape* shape = fixture->GetShape();
+    switch (shape->GetType())
+    {
+    case b2Shape::e_circle:
+        {
+            b2CircleShape* circle = (b2CircleShape*)shape;
+            out.key("circle");
+            out.beginObject();
+            floatToStream("radius", circle->m_radius, out);
+            vecToStream("center", circle->m_p, out);
+            out.endObject();
+        }
+        break;
+    case b2Shape::e_edge:
+        {
+            b2EdgeShape* edge = (b2EdgeShape*)shape;
+            out.key("edge");
+            out.beginObject();
+            vecToStream("vertex1", edge->m_vertex1, out);
+            vecToStream("vertex2", edge->m_vertex2, out);
+            if ( edge->m_hasVertex0 ) {
+                out.key("hasVertex0");
+                out.boolValue(true);
+            }
+            if ( edge->m_hasVertex3 ) {
+                out.key("hasVertex3");
+                out.boolValue(true);
+            }
+            if ( edge->m_hasVertex0 )
+                vecToStream("vertex0", edge->m_vertex0, out);
+            if ( edge->m_hasVertex3 )
+                vecToStream("vertex3", edge->m_vertex3, out);
+            out.endObject();
+        }
+        break;
+    case b2Shape::e_chain:
+        {
+            b2ChainShape* chain = (b2ChainShape*)shape;
+            out.key("chain");
+            out.beginObject();
+            vecArrayToStream("vertices", chain->m_vertices, chain->m_count, out);
+            if ( chain->m_hasPrevVertex ) {
+                out.key("hasPrevVertex");
+                out.boolValue(true);
+            }
+            if ( chain->m_hasNextVertex ) {
+                out.key("hasNextVertex");
+                out.boolValue(true);
+            }
+            if ( chain->m_hasPrevVertex )
+                vecToStream("prevVertex", chain->m_prevVertex, out);
+            if ( chain->m_hasNextVertex )
+                vecToStream("nextVertex", chain->m_nextVertex, out);
+            out.endObject();
+        }
+        break;
+    case b2Shape::e_polygon:
+        {
+            b2PolygonShape* poly = (b2PolygonShape*)shape;
+            int32 vertexCount = poly->GetVertexCount();
+            b2Assert(vertexCount <= b2_maxPolygonVertices);
+            out.key("polygon");
+            out.beginObject();
+            vecArrayToStream("vertices", poly->m_vertices, vertexCount, out);
+            out.endObject();
+        }
+        break;
+    default:
+        std::cout << "Unknown shape type : " << shape->GetType() << std::endl;
+    }
+
+    writeCustomPropertiesToStream(fixture, out);
+
+    out.endObject();
+}
+
+void b2dJson::b2jStream(b2Joint* joint, b2dJsonWriteBuffer& out)
+{
+    out.beginObject();
+
+    int bodyIndexA = lookupBodyIndex( joint->GetBodyA() );
+    int bodyIndexB = lookupBodyIndex( joint->GetBodyB() );
+    out.key("bodyA");
+    out.intValue(bodyIndexA);
+    out.key("bodyB");
+    out.intValue(bodyIndexB);
+    if ( joint->GetCollideConnected() ) {
+        out.key("collideConnected");
+        out.boolValue(true);
+    }
+
+    string jointName = getJointName(joint);
+    if ( jointName != "" ) {
+        out.key("name");
+        out.stringValue(jointName);
+    }
+
+    b2Body* bodyA = joint->GetBodyA();
+    b2Body* bodyB = joint->GetBodyB();
+
+    switch ( joint->GetType() )
+    {
+    case e_revoluteJoint:
+        {
+            out.key("type");
+            out.stringValue("revolute");
+
+            b2RevoluteJoint* revoluteJoint = (b2RevoluteJoint*)joint;
+            vecToStream("anchorA", bodyA->GetLocalPoint(revoluteJoint->GetAnchorA()), out);
+            vecToStream("anchorB", bodyB->GetLocalPoint(revoluteJoint->GetAnchorB()), out);
+            floatToStream("refAngle", bodyB->GetAngle() - bodyA->GetAngle() - revoluteJoint->GetJointAngle(), out);
+            floatToStream("jointSpeed", revoluteJoint->GetJointSpeed(), out);
+            out.key("enableLimit");
+            out.boolValue(revoluteJoint->IsLimitEnabled());
+            floatToStream("lowerLimit", revoluteJoint->GetLowerLimit(), out);
+            floatToStream("upperLimit", revoluteJoint->GetUpperLimit(), out);
+            out.key("enableMotor");
+            out.boolValue(revoluteJoint->IsMotorEnabled());
+            floatToStream("motorSpeed", revoluteJoint->GetMotorSpeed(), out);
+            floatToStream("maxMotorTorque", revoluteJoint->GetMaxMotorTorque(), out);
+        }
+        break;
+    case e_prismaticJoint:
+        {
+            out.key("type");
+            out.stringValue("prismatic");
+
+            b2PrismaticJoint* prismaticJoint = (b2PrismaticJoint*)joint;
+            vecToStream("anchorA", bodyA->GetLocalPoint(prismaticJoint->GetAnchorA()), out);
+            vecToStream("anchorB", bodyB->GetLocalPoint(prismaticJoint->GetAnchorB()), out);
+            vecToStream("localAxisA", prismaticJoint->GetLocalAxisA(), out);
+            floatToStream("refAngle", prismaticJoint->GetReferenceAngle(), out);
+            out.key("enableLimit");
+            out.boolValue(prismaticJoint->IsLimitEnabled());
+            floatToStream("lowerLimit", prismaticJoint->GetLowerLimit(), out);
+            floatToStream("upperLimit", prismaticJoint->GetUpperLimit(), out);
+            out.key("enableMotor");
+            out.boolValue(prismaticJoint->IsMotorEnabled());
+            floatToStream("maxMotorForce", prismaticJoint->GetMaxMotorForce(), out);
+            floatToStream("motorSpeed", prismaticJoint->GetMotorSpeed(), out);
+        }
+        break;
+    case e_distanceJoint:
+        {
+            out.key("type");
+            out.stringValue("distance");
+
+            b2DistanceJoint* distanceJoint = (b2DistanceJoint*)joint;
+            vecToStream("anchorA", bodyA->GetLocalPoint(distanceJoint->GetAnchorA()), out);
+            vecToStream("anchorB", bodyB->GetLocalPoint(distanceJoint->GetAnchorB()), out);
+            floatToStream("length", distanceJoint->GetLength(), out);
+            floatToStream("frequency", distanceJoint->GetFrequency(), out);
+            floatToStream("dampingRatio", distanceJoint->GetDampingRatio(), out);
+        }
+        break;
+    case e_pulleyJoint:
+        {
+            out.key("type");
+            out.stringValue("pulley");
+
+            b2PulleyJoint* pulleyJoint = (b2PulleyJoint*)joint;
+            vecToStream("groundAnchorA", pulleyJoint->GetGroundAnchorA(), out);
+            vecToStream("groundAnchorB", pulleyJoint->GetGroundAnchorB(), out);
+            vecToStream("anchorA", bodyA->GetLocalPoint(pulleyJoint->GetAnchorA()), out);
+            vecToStream("anchorB", bodyB->GetLocalPoint(pulleyJoint->GetAnchorB()), out);
+            floatToStream("lengthA", (pulleyJoint->GetGroundAnchorA() - pulleyJoint->GetAnchorA()).Length(), out);
+            floatToStream("lengthB", (pulleyJoint->GetGroundAnchorB() - pulleyJoint->GetAnchorB()).Length(), out);
+            floatToStream("ratio", pulleyJoint->GetRatio(), out);
+        }
+        break;
+    case e_mouseJoint:
+        {
+            out.key("type");
+            out.stringValue("mouse");
+
+            b2MouseJoint* mouseJoint = (b2MouseJoint*)joint;
+            vecToStream("target", mouseJoint->GetTarget(), out);
+            vecToStream("anchorB", mouseJoint->GetAnchorB(), out);
+            floatToStream("maxForce", mouseJoint->GetMaxForce(), out);
+            floatToStream("frequency", mouseJoint->GetFrequency(), out);
+            floatToStream("dampingRatio", mouseJoint->GetDampingRatio(), out);
+        }
+        break;
+    case e_gearJoint:
+        {
+            out.key("type");
+            out.stringValue("gear");
+
+            b2GearJoint* gearJoint = (b2GearJoint*)joint;
+            int jointIndex1 = lookupJointIndex( gearJoint->GetJoint1() );
+            int jointIndex2 = lookupJointIndex( gearJoint->GetJoint2() );
+            out.key("joint1");
+            out.intValue(jointIndex1);
+            out.key("joint2");
+            out.intValue(jointIndex2);
+            out.key("ratio");
+            out.decimalFloatValue(gearJoint->GetRatio());
+        }
+        break;
+    case e_wheelJoint:
+        {
+            out.key("type");
+            out.stringValue("wheel");
+
+            b2WheelJoint* wheelJoint = (b2WheelJoint*)joint;
+            vecToStream("anchorA", bodyA->GetLocalPoint(wheelJoint->GetAnchorA()), out);
+            vecToStream("anchorB", bodyB->GetLocalPoint(wheelJoint->GetAnchorB()), out);
+            vecToStream("localAxisA", wheelJoint->GetLocalAxisA(), out);
+            out.key("enableMotor");
+            out.boolValue(wheelJoint->IsMotorEnabled());
+            floatToStream("motorSpeed", wheelJoint->GetMotorSpeed(), out);
+            floatToStream("maxMotorTorque", wheelJoint->GetMaxMotorTorque(), out);
+            floatToStream("springFrequency", wheelJoint->GetSpringFrequencyHz(), out);
+            floatToStream("springDampingRatio", wheelJoint->GetSpringDampingRatio(), out);
+        }
+        break;
+    case e_motorJoint:
+        {
+            out.key("type");
+            out.stringValue("motor");
+
+            b2MotorJoint* motorJoint = (b2MotorJoint*)joint;
+            vecToStream("anchorA", bodyA->GetLocalPoint(motorJoint->GetAnchorA()), out);
+            vecToStream("anchorB", bodyB->GetLocalPoint(motorJoint->GetAnchorB()), out);
+            floatToStream("refAngle", motorJoint->GetAngularOffset(), out);
+            floatToStream("maxForce", motorJoint->GetMaxForce(), out);
+            floatToStream("maxTorque", motorJoint->GetMaxTorque(), out);
+        }
+        break;
+    case e_weldJoint:
+        {
+            out.key("type");
+            out.stringValue("weld");
+
+            b2WeldJoint* weldJoint = (b2WeldJoint*)joint;
+            vecToStream("anchorA", bodyA->GetLocalPoint(weldJoint->GetAnchorA()), out);
+            vecToStream("anchorB", bodyB->GetLocalPoint(weldJoint->GetAnchorB()), out);
+            floatToStream("refAngle", weldJoint->GetReferenceAngle(), out);
+            floatToStream("frequency", weldJoint->GetFrequency(), out);
+            floatToStream("dampingRatio", weldJoint->GetDampingRatio(), out);
+        }
+        break;
+    case e_frictionJoint:
+        {
+            out.key("type");
+            out.stringValue("friction");
+
+            b2FrictionJoint* frictionJoint = (b2FrictionJoint*)joint;
+            vecToStream("anchorA", bodyA->GetLocalPoint(frictionJoint->GetAnchorA()), out);
+            vecToStream("anchorB", bodyB->GetLocalPoint(frictionJoint->GetAnchorB()), out);
+            floatToStream("maxForce", frictionJoint->GetMaxForce(), out);
+            floatToStream("maxTorque", frictionJoint->GetMaxTorque(), out);
+        }
+        break;
+    case e_ropeJoint:
+        {
+            out.key("type");
+            out.stringValue("rope");
+
+            b2RopeJoint* ropeJoint = (b2RopeJoint*)joint;
+            vecToStream("anchorA", bodyA->GetLocalPoint(ropeJoint->GetAnchorA()), out);
+            vecToStream("anchorB", bodyB->GetLocalPoint(ropeJoint->GetAnchorB()), out);
+            floatToStream("maxLength", ropeJoint->GetMaxLength(), out);
+        }
+        break;
+    case e_unknownJoint:
+    default:
+        std::cout << "Unknown joint type not stored in snapshot : " << joint->GetType() << std::endl;
+    }
+
+    writeCustomPropertiesToStream(joint, out);
+
+    out.endObject();
+}
+
+void b2dJson::b2jStream(b2dJsonImage* image, b2dJsonWriteBuffer& out)
+{
+    out.beginObject();
+
+    out.key("body");
+    if ( image->body )
+        out.intValue( lookupBodyIndex( image->body ) );
+    else
+        out.intValue(-1);
+
+    if ( image->name != "" ) {
+        out.key("name");
+        out.stringValue(image->name);
+    }
+    if ( image->file != "" ) {
+        out.key("file");
+        out.stringValue(image->file);
+    }
+
+    vecToStream("center", image->center, out);
+    floatToStream("angle", image->angle, out);
+    floatToStream("scale", image->scale, out);
+    floatToStream("aspectScale", image->aspectScale, out);
+    if ( image->flip ) {
+        out.key("flip");
+        out.boolValue(true);
+    }
+    floatToStream("opacity", image->opacity, out);
+    out.key("filter");
+    out.intValue(image->filter);
+    floatToStream("renderOrder", image->renderOrder, out);
+
+    bool defaultColorTint = true;
+    for (int i = 0; i < 4; i++) {
+        if ( image->colorTint[i] != 255 ) {
+            defaultColorTint = false;
+            break;
+        }
+    }
+
+    if ( !defaultColorTint ) {
+        out.key("colorTint");
+        out.beginArray();
+        for (int i = 0; i < 4; i++)
+            out.intValue(image->colorTint[i]);
+        out.endArray();
+    }
+
+    vecArrayToStream("corners", image->corners, 4, out);
+
+    floatArrayToStream("glVertexPointer", image->points, 2*image->numPoints, out);
+    floatArrayToStream("glTexCoordPointer", image->uvCoords, 2*image->numPoints, out);
+    if ( image->numIndices > 0 ) {
+        out.key("glDrawElements");
+        out.beginArray();
+        for (int i = 0; i < image->numIndices; i++)
+            out.intValue(image->indices[i]);
+        out.endArray();
+    }
+
+    writeCustomPropertiesToStream(image, out);
+
+    out.endObject();
+}
+
 void b2dJson::setBodyName(b2Body* body, const char* name)
 {
     m_bodyToNameMap[body] = name;
@@ -754,17 +1301,56 @@ Json::Value b2dJson::writeCustomPropertiesToJson(void* item)
     return customPropertiesValue;
 }
 
+void b2dJson::writeCustomPropertiesToStream(void* item, b2dJsonWriteBuffer& out)
+{
+    b2dJsonCustomProperties* props = getCustomPropertiesForItem(item, false);
+    if ( !props )
+        return;
+    if ( props->m_customPropertyMap_int.empty() && props->m_customPropertyMap_float.empty() &&
+         props->m_customPropertyMap_string.empty() && props->m_customPropertyMap_b2Vec2.empty() &&
+         props->m_customPropertyMap_bool.empty() )
+        return;
+
+    out.key("customProperties");
+    out.beginArray(true);
+
+#define STREAM_CUSTOM_PROPERTY_VALUE(theName,theType,writeValue)\
+    for (std::map<string,theType>::iterator it = props->m_customPropertyMap_##theType.begin(); it != props->m_customPropertyMap_##theType.end(); ++it) {\
+        out.beginObject();\
+        out.key("name");\
+        out.stringValue(it->first);\
+        out.key(""#theName);\
+        out.writeValue(it->second);\
+        out.endObject();\
+    }
+
+    STREAM_CUSTOM_PROPERTY_VALUE(int,int,intValue)
+    STREAM_CUSTOM_PROPERTY_VALUE(float,float,decimalFloatValue)
+    STREAM_CUSTOM_PROPERTY_VALUE(string,string,stringValue)
+    STREAM_CUSTOM_PROPERTY_VALUE(bool,bool,boolValue)
+
+    for (std::map<string,b2Vec2>::iterator it = props->m_customPropertyMap_b2Vec2.begin(); it != props->m_customPropertyMap_b2Vec2.end(); ++it) {
+        out.beginObject();
+        out.key("name");
+        out.stringValue(it->first);
+        vecToStream("vec2", it->second, out);
+        out.endObject();
+    }
+
+    out.endArray();
+}
+
 #define IMPLEMENT_READ_CUSTOM_PROPERTIES_FROM_JSON(b2Type)\
-void b2dJson::readCustomPropertiesFromJson(b2Type* item, Json::Value value)\
+void b2dJson::readCustomPropertiesFromJson(b2Type* item, const Json::Value& value)\
 {\
     if ( ! item )\
         return;\
     if ( ! value.isMember("customProperties") )\
         return;\
 \
-    int i = 0;\
-    Json::Value propValue = value["customProperties"][i++];\
-    while ( !propValue.isNull() ) {\
+    const Json::Value& customPropertiesValue = value["customProperties"];\
+    for (int i = 0; !customPropertiesValue[i].isNull(); i++) {\
+        const Json::Value& propValue = customPropertiesValue[i];\
         string propertyName = propValue.get("name", "").asString();\
 \
         if ( propValue.isMember("int") ) {\
@@ -787,8 +1373,6 @@ void b2dJson::readCustomPropertiesFromJson(b2Type* item, Json::Value value)\
             bool val = propValue.get("bool", 0).asBool();\
             setCustomBool(item, propertyName, val);\
         }\
-\
-        propValue = value["customProperties"][i++];\
     }\
 }
 
@@ -876,6 +1460,75 @@ inline void b2dJson::vecToJson(const char* name, b2Vec2 vec, Json::Value& value,
     }
 }
 
+void b2dJson::floatValueToStream(float f, b2dJsonWriteBuffer& out)
+{
+    //cut down on file space for common values
+    if ( f == 0 )
+        out.intValue(0);
+    else if ( f == 1 )
+        out.intValue(1);
+    else {
+        if ( m_useHumanReadableFloats )
+            out.decimalFloatValue(f);
+        else
+            out.hexFloatValue(f);
+    }
+}
+
+void b2dJson::floatToStream(const char* name, float f, b2dJsonWriteBuffer& out)
+{
+    out.key(name);
+    floatValueToStream(f, out);
+}
+
+void b2dJson::vecToStream(const char* name, b2Vec2 vec, b2dJsonWriteBuffer& out)
+{
+    out.key(name);
+    if ( vec.x == 0 && vec.y == 0 )
+        out.intValue(0);//cut down on file space for common values
+    else {
+        out.beginObject();
+        floatToStream("x", vec.x, out);
+        floatToStream("y", vec.y, out);
+        out.endObject();
+    }
+}
+
+// Indexed form, ie. what vecToJson gives when called for each index in turn:
+// an object holding one array of all the x values and one of all the y values
+void b2dJson::vecArrayToStream(const char* name, const b2Vec2* vecs, int count, b2dJsonWriteBuffer& out)
+{
+    if ( count < 1 )
+        return;
+
+    out.key(name);
+    out.beginObject();
+    out.key("x");
+    out.beginArray();
+    for (int i = 0; i < count; i++)
+        floatValueToStream(vecs[i].x, out);
+    out.endArray();
+    out.key("y");
+    out.beginArray();
+    for (int i = 0; i < count; i++)
+        floatValueToStream(vecs[i].y, out);
+    out.endArray();
+    out.endObject();
+}
+
+void b2dJson::floatArrayToStream(const char* name, const float* floats, int count, b2dJsonWriteBuffer& out)
+{
+    if ( count < 1 )
+        return;
+
+    out.key(name);
+    out.beginArray();
+    for (int i = 0; i < count; i++)
+        floatValueToStream(floats[i], out);
+    out.endArray();
+}
+
+
 
 
 
@@ -906,18 +1559,24 @@ void b2dJson::clear()
     m_imageToNameMap.clear();
 }
 
-b2World *b2dJson::readFromValue(Json::Value worldValue)
+b2World *b2dJson::readFromValue(const Json::Value& worldValue)
 {
     clear();
 
     return j2b2World(worldValue);
 }
 
-b2World* b2dJson::readFromString(std::string str, std::string& errorMsg)
+b2World* b2dJson::readFromString(const std::string& str, std::string& errorMsg)
+{
+    return readFromMemory(str.data(), str.size(), errorMsg);
+}
+
+b2World* b2dJson::readFromMemory(const char* data, size_t length, std::string& errorMsg)
 {
     Json::Value worldValue;
     Json::Reader reader;
-    if ( ! reader.parse(str, worldValue) )
+    //the std::string version of parse would copy the whole document first
+    if ( ! reader.parse(data, data + length, worldValue, false) ) //comments are never needed when reading
     {
         //std::cout  << "Failed to parse string\n" << reader.getFormattedErrorMessages();
         errorMsg = string("Failed to parse JSON:\n") + reader.getFormatedErrorMessages();
@@ -932,41 +1591,358 @@ b2World* b2dJson::readFromFile(const char* filename, std::string& errorMsg)
     if (!filename)
         return NULL;
 
-    std::ifstream ifs;
-    ifs.open(filename, std::ios::in);
-    if (!ifs) {
-        //std::cout << "Could not open file " << filename << " for reading\n";
-        errorMsg = string("Could not open file '") + string(filename) + string("' for reading");
+    b2dJsonFileView file;
+    if ( ! file.open(filename, errorMsg) )
         return NULL;
-    }
 
     Json::Value worldValue;
     Json::Reader reader;
-    if ( ! reader.parse(ifs, worldValue) )
+    if ( ! reader.parse(file.data(), file.data() + file.size(), worldValue, false) )
     {
         //std::cout  << "Failed to parse " << filename << std::endl << reader.getFormattedErrorMessages();
         errorMsg = string("Failed to parse '") + string(filename) + string("' : ") + reader.getFormatedErrorMessages();
-        ifs.close();
         return NULL;
     }
-    ifs.close();
+
+    //the text is not needed any more once the tree is built
+    file.close();
 
     return j2b2World(worldValue);
 }
 
-b2World* b2dJson::j2b2World(Json::Value worldValue)
+//////// parallel reading
+
+// A piece of the input text, usually one complete JSON value
+struct b2dJsonTextRange {
+    const char* begin;
+    const char* end;
+};
+
+struct b2dJsonTextMember {
+    std::string name;
+    b2dJsonTextRange value;
+};
+
+// Skips whitespace and comments (StyledWriter puts "//static" etc. after body types)
+static const char* skipJsonSpace(const char* p, const char* end)
 {
-    m_bodies.clear();
+    while ( p < end ) {
+        if ( *p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' )
+            p++;
+        else if ( *p == '/' && p + 1 < end && p[1] == '/' ) {
+            p = (const char*)memchr(p, '\n', end - p);
+            if ( !p )
+                return end;
+        }
+        else if ( *p == '/' && p + 1 < end && p[1] == '*' ) {
+            p += 2;
+            while ( p + 1 < end && !(p[0] == '*' && p[1] == '/') )
+                p++;
+            p = (p + 1 < end) ? p + 2 : end;
+        }
+        else
+            break;
+    }
+    return p;
+}
 
-    b2World* world = new b2World( jsonToVec("gravity", worldValue) );    
-    world->SetAllowSleeping( worldValue["allowSleep"].asBool() );
+// Returns the position just after the closing quote of the string starting at p
+static const char* skipJsonString(const char* p, const char* end)
+{
+    for (p++; p < end; p++) {
+        p = (const char*)memchr(p, '"', end - p);
+        if ( !p )
+            return NULL;
+        //count the backslashes in front, an even number means this one is not escaped
+        const char* q = p;
+        while ( q[-1] == '\\' )
+            q--;
+        if ( ((p - q) & 1) == 0 )
+            return p + 1;
+    }
+    return NULL;
+}
 
-    world->SetAutoClearForces( worldValue["autoClearForces"].asBool() );
-    world->SetWarmStarting( worldValue["warmStarting"].asBool() );
-    world->SetContinuousPhysics( worldValue["continuousPhysics"].asBool() );
-    world->SetSubStepping( worldValue["subStepping"].asBool() );
+// The characters that skipJsonValue needs to stop at
+struct b2dJsonStructuralChars {
+    bool chars[256];
+    b2dJsonStructuralChars() {
+        memset(chars, 0, sizeof(chars));
+        const char* structural = "\"{}[]/";
+        for (const char* c = structural; *c; c++)
+            chars[(unsigned char)*c] = true;
+    }
+    bool operator[](unsigned char c) const { return chars[c]; }
+};
+static const b2dJsonStructuralChars isJsonStructuralChar;
+
+// Returns the position just after the value starting at p, or NULL if it runs
+// off the end. This only matches up brackets and skips over strings and
+// comments, it is up to jsoncpp to check that the value really is valid.
+static const char* skipJsonValue(const char* p, const char* end)
+{
+    if ( p >= end )
+        return NULL;
+    if ( *p == '"' )
+        return skipJsonString(p, end);
+    if ( *p != '{' && *p != '[' ) {
+        //number, true, false or null
+        while ( p < end && *p != ',' && *p != '}' && *p != ']' && *p != '/' &&
+                *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r' )
+            p++;
+        return p;
+    }
 
-    readCustomPropertiesFromJson(world, worldValue);
+    int depth = 0;
+    while ( p < end ) {
+        //most of the text is names, numbers and hex floats, get past those quickly
+        while ( p < end && !isJsonStructuralChar[(unsigned char)*p] )
+            p++;
+        if ( p >= end )
+            break;
+
+        char c = *p;
+        if ( c == '"' ) {
+            p = skipJsonString(p, end);
+            if ( !p )
+                return NULL;
+            continue;
+        }
+        if ( c == '/' ) {
+            const char* afterComment = skipJsonSpace(p, end);
+            p = (afterComment > p) ? afterComment : p + 1;
+            continue;
+        }
+        if ( c == '{' || c == '[' )
+            depth++;
+        else if ( (c == '}' || c == ']') && --depth == 0 )
+            return p + 1;
+        p++;
+    }
+    return NULL;
+}
+
+// Finds the extent of each member value of the object starting at p
+static bool splitJsonObject(const char* p, const char* end, std::vector<b2dJsonTextMember>& members)
+{
+    if ( p >= end || *p != '{' )
+        return false;
+    p = skipJsonSpace(p + 1, end);
+    if ( p < end && *p == '}' )
+        return true;
+
+    while ( p < end ) {
+        if ( *p != '"' )
+            return false;
+        const char* nameEnd = skipJsonString(p, end);
+        if ( !nameEnd )
+            return false;
+        b2dJsonTextMember member;
+        member.name.assign(p + 1, nameEnd - 1);
+
+        p = skipJsonSpace(nameEnd, end);
+        if ( p >= end || *p != ':' )
+            return false;
+        p = skipJsonSpace(p + 1, end);
+        member.value.begin = p;
+        member.value.end = p = skipJsonValue(p, end);
+        if ( !p )
+            return false;
+        members.push_back(member);
+
+        p = skipJsonSpace(p, end);
+        if ( p < end && *p == '}' )
+            return true;
+        if ( p >= end || *p != ',' )
+            return false;
+        p = skipJsonSpace(p + 1, end);
+    }
+    return false;
+}
+
+// Finds the extent of each element of the array starting at p
+static bool splitJsonArray(const char* p, const char* end, std::vector<b2dJsonTextRange>& elements)
+{
+    if ( p >= end || *p != '[' )
+        return false;
+    p = skipJsonSpace(p + 1, end);
+    if ( p < end && *p == ']' )
+        return true;
+
+    while ( p < end ) {
+        b2dJsonTextRange element;
+        element.begin = p;
+        element.end = p = skipJsonValue(p, end);
+        if ( !p )
+            return false;
+        elements.push_back(element);
+
+        p = skipJsonSpace(p, end);
+        if ( p < end && *p == ']' )
+            return true;
+        if ( p >= end || *p != ',' )
+            return false;
+        p = skipJsonSpace(p + 1, end);
+    }
+    return false;
+}
+
+enum _b2dJsonSection {
+    JS_BODY,
+    JS_JOINT,
+    JS_IMAGE,
+
+    JS_MAX
+};
+
+static const char* b2dJsonSectionNames[JS_MAX] = { "body", "joint", "image" };
+
+// A run of consecutive elements from one of the sections, for one thread to do
+struct b2dJsonParseJob {
+    int section;
+    int first;
+    int last;
+    std::string error;
+};
+
+struct b2dJsonParallelParse {
+    std::vector<b2dJsonTextRange> elements[JS_MAX];
+    std::vector<Json::Value> values[JS_MAX];
+    std::vector<b2dJsonBodyDef*> bodyDefs;
+    std::vector<b2dJsonParseJob> jobs;
+    std::atomic<int> nextJob;
+};
+
+// Run on each of the threads from b2dJsonThreadPool
+static void parseJsonSectionsWorker(void* data)
+{
+    b2dJsonParallelParse* parse = (b2dJsonParallelParse*)data;
+    Json::Reader reader;
+    while ( true ) {
+        int jobIndex = parse->nextJob++;
+        if ( jobIndex >= (int)parse->jobs.size() )
+            break;
+
+        b2dJsonParseJob& job = parse->jobs[jobIndex];
+        for (int i = job.first; i < job.last; i++) {
+            const b2dJsonTextRange& element = parse->elements[job.section][i];
+            Json::Value& value = parse->values[job.section][i];
+            if ( ! reader.parse(element.begin, element.end, value, false) ) {
+                job.error = reader.getFormatedErrorMessages();
+                break;
+            }
+            if ( job.section == JS_BODY ) {
+                parse->bodyDefs[i] = new b2dJsonBodyDef;
+                b2dJson::j2b2BodyDef(value, *parse->bodyDefs[i]);
+            }
+        }
+    }
+}
+
+b2World* b2dJson::readFromStringInParallel(const std::string& str, std::string& errorMsg, int numThreads)
+{
+    return readFromMemoryInParallel(str.data(), str.size(), errorMsg, numThreads);
+}
+
+b2World* b2dJson::readFromMemoryInParallel(const char* data, size_t length, std::string& errorMsg, int numThreads)
+{
+    const char* begin = data;
+    const char* end = data + length;
+
+    //the quick structural scan only finds where each value starts and ends,
+    //so anything it can't make sense of is left for the normal path to report
+    std::vector<b2dJsonTextMember> members;
+    if ( ! splitJsonObject(skipJsonSpace(begin, end), end, members) )
+        return readFromMemory(data, length, errorMsg);
+
+    b2dJsonParallelParse parse;
+    Json::Value worldValue;
+    Json::Reader reader;
+    for (int i = 0; i < (int)members.size(); i++) {
+        const b2dJsonTextMember& member = members[i];
+        int section = 0;
+        while ( section < JS_MAX && member.name != b2dJsonSectionNames[section] )
+            section++;
+        if ( section < JS_MAX ) {
+            if ( ! splitJsonArray(member.value.begin, member.value.end, parse.elements[section]) )
+                return readFromMemory(data, length, errorMsg);
+            worldValue[member.name] = Json::Value(Json::arrayValue);
+            continue;
+        }
+        //the other members of the world are all small, parse them here
+        if ( ! reader.parse(member.value.begin, member.value.end, worldValue[member.name], false) )
+            return readFromMemory(data, length, errorMsg);
+    }
+
+    if ( numThreads < 1 )
+        numThreads = b2dJsonThreadPool::getMaxThreads();
+    numThreads = b2Clamp(numThreads, 1, 8);
+
+    //several chunks of bodies per thread so they even out if some are slower,
+    //and the joints and images as one job each
+    int numBodies = (int)parse.elements[JS_BODY].size();
+    int bodiesPerJob = b2Max(16, numBodies / (4 * numThreads));
+    for (int section = 0; section < JS_MAX; section++) {
+        int count = (int)parse.elements[section].size();
+        parse.values[section].resize(count);
+        int jobSize = (section == JS_BODY) ? bodiesPerJob : count;
+        for (int first = 0; first < count; first += jobSize) {
+            b2dJsonParseJob job;
+            job.section = section;
+            job.first = first;
+            job.last = b2Min(first + jobSize, count);
+            parse.jobs.push_back(job);
+        }
+    }
+    parse.bodyDefs.resize(numBodies, NULL);
+    parse.nextJob = 0;
+
+    numThreads = b2Min(numThreads, (int)parse.jobs.size());
+    b2dJsonThreadPool::getInstance().run(parseJsonSectionsWorker, &parse, numThreads);
+
+    b2World* world = NULL;
+    bool failed = false;
+    for (int i = 0; i < (int)parse.jobs.size() && !failed; i++) {
+        if ( parse.jobs[i].error != "" ) {
+            errorMsg = string("Failed to parse JSON:\n") + parse.jobs[i].error;
+            failed = true;
+        }
+    }
+
+    if ( !failed ) {
+        //swapping the parsed values into place is cheap, nothing is copied
+        for (int section = 0; section < JS_MAX; section++) {
+            int count = (int)parse.values[section].size();
+            if ( count == 0 )
+                continue;
+            Json::Value& sectionValue = worldValue[b2dJsonSectionNames[section]];
+            sectionValue.resize(count);
+            for (int i = 0; i < count; i++)
+                sectionValue[i].swap( parse.values[section][i] );
+        }
+
+        world = j2b2World(worldValue, &parse.bodyDefs);
+    }
+
+    for (int i = 0; i < numBodies; i++)
+        delete parse.bodyDefs[i];
+
+    return world;
+}
+
+b2World* b2dJson::j2b2World(const Json::Value& worldValue)
+{
+    return j2b2World(worldValue, NULL);
+}
+
+// If bodyDefs is given, it holds the already decoded bodies in the same order
+// as the "body" array of the world value.
+b2World* b2dJson::j2b2World(const Json::Value& worldValue, const std::vector<b2dJsonBodyDef*>* bodyDefs)
+{
+    m_bodies.clear();
+
+    b2World* world = new b2World( jsonToVec("gravity", worldValue) );    
+    j2b2WorldSettings(world, worldValue);
 
     //bool recreationMayDiffer = false; //hahaha
     //if ( ! world->GetAutoClearForces() ) { std::cout << "Note: world is not set to auto clear forces.\n"; recreationMayDiffer = true; }
@@ -979,165 +1955,266 @@ b2World* b2dJson::j2b2World(Json::Value worldValue)
     //if ( recreationMayDiffer )
     //    std::cout << "Recreated behaviour may differ from original.\n";
 
-    int i = 0;
-    Json::Value bodyValue = worldValue["body"][i];
-    while ( !bodyValue.isNull() ) {
-        b2Body* body = j2b2Body(world, bodyValue);
+    //the arrays are walked by const reference, stopping at the first null
+    //entry. The const operator[] never inserts into the document.
+    const Json::Value& bodyValues = worldValue["body"];
+    for (int i = 0; !bodyValues[i].isNull(); i++) {
+        const Json::Value& bodyValue = bodyValues[i];
+        b2Body* body = bodyDefs ? j2b2Body(world, *(*bodyDefs)[i], bodyValue) : j2b2Body(world, bodyValue);
         readCustomPropertiesFromJson(body, bodyValue);
-        m_bodies.push_back(body);
-        m_indexToBodyMap[i] = body;
-
-        i++;
-        bodyValue = worldValue["body"][i];
+        addExistingBody(body);
     }
 
+    addJoints(world, worldValue["joint"]);
+
+    const Json::Value& imageValues = worldValue["image"];
+    for (int i = 0; !imageValues[i].isNull(); i++)
+        addImage(imageValues[i]);
+
+    return world;
+}
+
+void b2dJson::j2b2WorldSettings(b2World* world, const Json::Value& worldValue)
+{
+    world->SetGravity( jsonToVec("gravity", worldValue) );
+    world->SetAllowSleeping( worldValue["allowSleep"].asBool() );
+
+    world->SetAutoClearForces( worldValue["autoClearForces"].asBool() );
+    world->SetWarmStarting( worldValue["warmStarting"].asBool() );
+    world->SetContinuousPhysics( worldValue["continuousPhysics"].asBool() );
+    world->SetSubStepping( worldValue["subStepping"].asBool() );
+
+    readCustomPropertiesFromJson(world, worldValue);
+}
+
+b2Body* b2dJson::addBody(b2World* world, const b2dJsonBodyDef& bodyDef, const Json::Value& bodyValue)
+{
+    b2Body* body = j2b2Body(world, bodyDef, bodyValue);
+    readCustomPropertiesFromJson(body, bodyValue);
+    addExistingBody(body);
+    return body;
+}
+
+void b2dJson::addExistingBody(b2Body* body)
+{
+    m_indexToBodyMap[(int)m_bodies.size()] = body;
+    m_bodies.push_back(body);
+}
+
+void b2dJson::addJoints(b2World* world, const Json::Value& jointValues)
+{
     //need two passes for joints because gear joints reference other joints
-    i = 0;
-    Json::Value jointValue = worldValue["joint"][i++];
-    while ( !jointValue.isNull() ) {
-        if ( jointValue["type"].asString() != "gear" ) {
-            b2Joint* joint = j2b2Joint(world, jointValue);
-            readCustomPropertiesFromJson(joint, jointValue);
-            m_joints.push_back(joint);
-        }
-        jointValue = worldValue["joint"][i++];
+    for (int i = 0; !jointValues[i].isNull(); i++) {
+        const Json::Value& jointValue = jointValues[i];
+        if ( jointValue["type"].asString() != "gear" )
+            addJoint(world, jointValue);
     }
-    i = 0;
-    jointValue = worldValue["joint"][i++];
-    while ( !jointValue.isNull() ) {
-        if ( jointValue["type"].asString() == "gear" ) {
-            b2Joint* joint = j2b2Joint(world, jointValue);
-            readCustomPropertiesFromJson(joint, jointValue);
-            m_joints.push_back(joint);
-        }
-        jointValue = worldValue["joint"][i++];
+    for (int i = 0; !jointValues[i].isNull(); i++) {
+        const Json::Value& jointValue = jointValues[i];
+        if ( jointValue["type"].asString() == "gear" )
+            addJoint(world, jointValue);
     }
+}
 
-    i = 0;
-    Json::Value imageValue = worldValue["image"][i++];
-    while ( !imageValue.isNull() ) {
-        b2dJsonImage* img = j2b2dJsonImage(imageValue);
-        readCustomPropertiesFromJson(img, imageValue);
-        m_images.push_back(img);
-        addImage(img);
-
-        imageValue = worldValue["image"][i++];
-    }
+b2Joint* b2dJson::addJoint(b2World* world, const Json::Value& jointValue)
+{
+    b2Joint* joint = j2b2Joint(world, jointValue);
+    readCustomPropertiesFromJson(joint, jointValue);
+    m_joints.push_back(joint);
+    return joint;
+}
 
-    return world;
+b2dJsonImage* b2dJson::addImage(const Json::Value& imageValue)
+{
+    b2dJsonImage* img = j2b2dJsonImage(imageValue);
+    readCustomPropertiesFromJson(img, imageValue);
+    m_images.push_back(img);
+    addImage(img);
+    return img;
 }
 
-b2Body* b2dJson::j2b2Body(b2World* world, Json::Value bodyValue)
+void b2dJson::addExistingBody(b2Body* body, const b2dJsonBodyDef& bodyDef, const Json::Value& bodyValue)
 {
-    b2Body* body = NULL;
+    addExistingBody(body);
 
-    b2BodyDef bodyDef;
+    if ( bodyDef.name != "" )
+        setBodyName(body, bodyDef.name.c_str());
+    readCustomPropertiesFromJson(body, bodyValue);
 
-    bodyDef.type = (b2BodyType)bodyValue["type"].asInt();
-    bodyDef.position = jsonToVec("position", bodyValue);
-    bodyDef.angle = jsonToFloat("angle", bodyValue );
-    bodyDef.linearVelocity = jsonToVec("linearVelocity", bodyValue);
-    bodyDef.angularVelocity = jsonToFloat("angularVelocity", bodyValue);
-    bodyDef.linearDamping = jsonToFloat("linearDamping", bodyValue, -1, 0);
-    bodyDef.angularDamping = jsonToFloat("angularDamping", bodyValue, -1, 0);
-    bodyDef.gravityScale = jsonToFloat("gravityScale", bodyValue, -1, 1);
+    //the fixtures were created in file order, skipping those with no shape,
+    //and Box2D keeps them with the most recently created first
+    std::vector<b2Fixture*> fixtures;
+    for (b2Fixture* fixture = body->GetFixtureList(); fixture; fixture = fixture->GetNext())
+        fixtures.push_back(fixture);
 
-    bodyDef.allowSleep = bodyValue.get("allowSleep",true).asBool();
-    bodyDef.awake = bodyValue.get("awake", false).asBool();
-    bodyDef.fixedRotation = bodyValue.get("fixedRotation",false).asBool();
-    bodyDef.bullet = bodyValue.get("bullet",false).asBool();
-    bodyDef.active = bodyValue.get("active",true).asBool();
+    const Json::Value& fixtureValues = bodyValue["fixture"];
+    int next = (int)fixtures.size() - 1;
+    for (int i = 0; i < (int)bodyDef.fixtures.size() && next >= 0; i++) {
+        const b2dJsonFixtureDef* fixtureDef = bodyDef.fixtures[i];
+        if ( !fixtureDef || !fixtureDef->fixtureDef.shape )
+            continue;
+        b2Fixture* fixture = fixtures[next--];
+        if ( fixtureDef->name != "" )
+            setFixtureName(fixture, fixtureDef->name.c_str());
+        readCustomPropertiesFromJson(fixture, fixtureValues[i]);
+    }
+}
 
-    body = world->CreateBody(&bodyDef);
+void b2dJson::addExistingJoint(b2Joint* joint, const Json::Value& jointValue)
+{
+    string name = jointValue.get("name","").asString();
+    if ( name != "" )
+        setJointName(joint, name.c_str());
+    readCustomPropertiesFromJson(joint, jointValue);
+    m_joints.push_back(joint);
+}
 
-    string bodyName = bodyValue.get("name","").asString();
-    if ( bodyName != "" ) {
-        //printf("Found named body: %s\n",bodyName.c_str());
-        setBodyName(body, bodyName.c_str());
-    }
+b2Body* b2dJson::j2b2Body(b2World* world, const Json::Value& bodyValue)
+{
+    b2dJsonBodyDef bodyDef;
+    j2b2BodyDef(bodyValue, bodyDef);
+    return j2b2Body(world, bodyDef, bodyValue);
+}
 
-    int i = 0;
-    Json::Value fixtureValue = bodyValue["fixture"][i++];
-    while ( !fixtureValue.isNull() ) {
-        b2Fixture* fixture = j2b2Fixture(body, fixtureValue);
-        readCustomPropertiesFromJson(fixture, fixtureValue);
+// Creates a body that was decoded by j2b2BodyDef. The value is still needed for
+// the custom properties of the fixtures.
+b2Body* b2dJson::j2b2Body(b2World* world, const b2dJsonBodyDef& bodyDef, const Json::Value& bodyValue)
+{
+    b2Body* body = world->CreateBody(&bodyDef.bodyDef);
+
+    if ( bodyDef.name != "" ) {
+        //printf("Found named body: %s\n",bodyDef.name.c_str());
+        setBodyName(body, bodyDef.name.c_str());
+    }
 
-        fixtureValue = bodyValue["fixture"][i++];
+    const Json::Value& fixtureValues = bodyValue["fixture"];
+    for (int i = 0; i < (int)bodyDef.fixtures.size(); i++) {
+        b2Fixture* fixture = j2b2Fixture(body, *bodyDef.fixtures[i]);
+        readCustomPropertiesFromJson(fixture, fixtureValues[i]);
     }
 
     //may be necessary if user has overridden mass characteristics
-    b2MassData massData;
-    massData.mass = jsonToFloat("massData-mass", bodyValue);
-    massData.center = jsonToVec("massData-center", bodyValue);
-    massData.I = jsonToFloat("massData-I", bodyValue);
-    body->SetMassData(&massData);
+    body->SetMassData(&bodyDef.massData);
 
     return body;
 }
 
-b2Fixture* b2dJson::j2b2Fixture(b2Body* body, Json::Value fixtureValue)
+b2Fixture* b2dJson::j2b2Fixture(b2Body* body, const Json::Value& fixtureValue)
+{
+    b2dJsonFixtureDef* fixtureDef = j2b2FixtureDef(fixtureValue);
+    if ( !fixtureDef )
+        return NULL;
+
+    b2Fixture* fixture = j2b2Fixture(body, *fixtureDef);
+    delete fixtureDef;
+    return fixture;
+}
+
+b2Fixture* b2dJson::j2b2Fixture(b2Body* body, const b2dJsonFixtureDef& fixtureDef)
 {
     b2Fixture* fixture = NULL;
 
-    b2FixtureDef fixtureDef;
-    fixtureDef.restitution = jsonToFloat("restitution", fixtureValue);
-    fixtureDef.friction = jsonToFloat("friction", fixtureValue);
-    fixtureDef.density = jsonToFloat("density", fixtureValue);
-    fixtureDef.isSensor = fixtureValue.get("sensor",false).asBool();
+    if ( fixtureDef.fixtureDef.shape )
+        fixture = body->CreateFixture(&fixtureDef.fixtureDef);
+
+    if ( fixture && fixtureDef.name != "" ) {
+        setFixtureName(fixture, fixtureDef.name.c_str());
+    }
 
-    fixtureDef.filter.categoryBits = fixtureValue.get("filter-categoryBits",0x0001).asInt();
-    fixtureDef.filter.maskBits = fixtureValue.get("filter-maskBits",0xffff).asInt();
-    fixtureDef.filter.groupIndex = fixtureValue.get("filter-groupIndex",0).asInt();
+    return fixture;
+}
 
+// Decodes everything needed to create a body, without touching a world or any
+// of the members of this class, so it is safe to call from any thread.
+void b2dJson::j2b2BodyDef(const Json::Value& bodyValue, b2dJsonBodyDef& bodyDef)
+{
+    b2BodyDef& def = bodyDef.bodyDef;
+
+    def.type = (b2BodyType)bodyValue["type"].asInt();
+    def.position = jsonToVec("position", bodyValue);
+    def.angle = jsonToFloat("angle", bodyValue );
+    def.linearVelocity = jsonToVec("linearVelocity", bodyValue);
+    def.angularVelocity = jsonToFloat("angularVelocity", bodyValue);
+    def.linearDamping = jsonToFloat("linearDamping", bodyValue, -1, 0);
+    def.angularDamping = jsonToFloat("angularDamping", bodyValue, -1, 0);
+    def.gravityScale = jsonToFloat("gravityScale", bodyValue, -1, 1);
+
+    def.allowSleep = bodyValue.get("allowSleep",true).asBool();
+    def.awake = bodyValue.get("awake", false).asBool();
+    def.fixedRotation = bodyValue.get("fixedRotation",false).asBool();
+    def.bullet = bodyValue.get("bullet",false).asBool();
+    def.active = bodyValue.get("active",true).asBool();
+
+    bodyDef.name = bodyValue.get("name","").asString();
+
+    const Json::Value& fixtureValues = bodyValue["fixture"];
+    for (int i = 0; !fixtureValues[i].isNull(); i++)
+        bodyDef.fixtures.push_back( j2b2FixtureDef(fixtureValues[i]) );
+
+    bodyDef.massData.mass = jsonToFloat("massData-mass", bodyValue);
+    bodyDef.massData.center = jsonToVec("massData-center", bodyValue);
+    bodyDef.massData.I = jsonToFloat("massData-I", bodyValue);
+}
+
+// Decodes a fixture and its shape. Like j2b2BodyDef this is safe to call from
+// any thread. The shape is left NULL for fixtures that should not be created.
+b2dJsonFixtureDef* b2dJson::j2b2FixtureDef(const Json::Value& fixtureValue)
+{
     if ( fixtureValue.isNull() )
         return NULL;
 
+    b2dJsonFixtureDef* fixtureDef = new b2dJsonFixtureDef;
+    b2FixtureDef& def = fixtureDef->fixtureDef;
+
+    def.restitution = jsonToFloat("restitution", fixtureValue);
+    def.friction = jsonToFloat("friction", fixtureValue);
+    def.density = jsonToFloat("density", fixtureValue);
+    def.isSensor = fixtureValue.get("sensor",false).asBool();
+
+    def.filter.categoryBits = fixtureValue.get("filter-categoryBits",0x0001).asInt();
+    def.filter.maskBits = fixtureValue.get("filter-maskBits",0xffff).asInt();
+    def.filter.groupIndex = fixtureValue.get("filter-groupIndex",0).asInt();
+
     if ( !fixtureValue["circle"].isNull() ) {
-        b2CircleShape circleShape;
-        circleShape.m_radius = jsonToFloat("radius", fixtureValue["circle"]);
-        circleShape.m_p = jsonToVec("center", fixtureValue["circle"]);
-        fixtureDef.shape = &circleShape;
-        fixture = body->CreateFixture(&fixtureDef);
+        b2CircleShape* circleShape = new b2CircleShape;
+        circleShape->m_radius = jsonToFloat("radius", fixtureValue["circle"]);
+        circleShape->m_p = jsonToVec("center", fixtureValue["circle"]);
+        def.shape = circleShape;
     }
     else if ( !fixtureValue["edge"].isNull() ) {
-        b2EdgeShape edgeShape;
-        edgeShape.m_vertex1 = jsonToVec("vertex1", fixtureValue["edge"]);
-        edgeShape.m_vertex2 = jsonToVec("vertex2", fixtureValue["edge"]);
-        edgeShape.m_hasVertex0 = fixtureValue["edge"].get("hasVertex0",false).asBool();
-        edgeShape.m_hasVertex3 = fixtureValue["edge"].get("hasVertex3",false).asBool();
-        if ( edgeShape.m_hasVertex0 )
-            edgeShape.m_vertex0 = jsonToVec("vertex0", fixtureValue["edge"]);
-        if ( edgeShape.m_hasVertex3 )
-            edgeShape.m_vertex3 = jsonToVec("vertex3", fixtureValue["edge"]);
-        fixtureDef.shape = &edgeShape;
-        fixture = body->CreateFixture(&fixtureDef);
+        b2EdgeShape* edgeShape = new b2EdgeShape;
+        edgeShape->m_vertex1 = jsonToVec("vertex1", fixtureValue["edge"]);
+        edgeShape->m_vertex2 = jsonToVec("vertex2", fixtureValue["edge"]);
+        edgeShape->m_hasVertex0 = fixtureValue["edge"].get("hasVertex0",false).asBool();
+        edgeShape->m_hasVertex3 = fixtureValue["edge"].get("hasVertex3",false).asBool();
+        if ( edgeShape->m_hasVertex0 )
+            edgeShape->m_vertex0 = jsonToVec("vertex0", fixtureValue["edge"]);
+        if ( edgeShape->m_hasVertex3 )
+            edgeShape->m_vertex3 = jsonToVec("vertex3", fixtureValue["edge"]);
+        def.shape = edgeShape;
     }
     else if ( !fixtureValue["loop"].isNull() ) { //support old format (r197)
-        b2ChainShape chainShape;
+        b2ChainShape* chainShape = new b2ChainShape;
         int numVertices = fixtureValue["loop"]["vertices"]["x"].size();
         b2Vec2* vertices = new b2Vec2[numVertices];
-        for (int i = 0; i < numVertices; i++)
-            vertices[i] = jsonToVec("vertices", fixtureValue["loop"], i);
-        chainShape.CreateLoop(vertices, numVertices);
-        fixtureDef.shape = &chainShape;
-        fixture = body->CreateFixture(&fixtureDef);
+        jsonToVecArray("vertices", fixtureValue["loop"], vertices, numVertices);
+        chainShape->CreateLoop(vertices, numVertices);
+        def.shape = chainShape;
         delete[] vertices;
     }
     else if ( !fixtureValue["chain"].isNull() ) {
-        b2ChainShape chainShape;
+        b2ChainShape* chainShape = new b2ChainShape;
         int numVertices = fixtureValue["chain"]["vertices"]["x"].size();
         b2Vec2* vertices = new b2Vec2[numVertices];
-        for (int i = 0; i < numVertices; i++)
-            vertices[i] = jsonToVec("vertices", fixtureValue["chain"], i);
-        chainShape.CreateChain(vertices, numVertices);
-        chainShape.m_hasPrevVertex = fixtureValue["chain"].get("hasPrevVertex",false).asBool();
-        chainShape.m_hasNextVertex = fixtureValue["chain"].get("hasNextVertex",false).asBool();
-        if ( chainShape.m_hasPrevVertex )
-            chainShape.m_prevVertex = jsonToVec("prevVertex", fixtureValue["chain"]);
-        if ( chainShape.m_hasNextVertex )
-            chainShape.m_nextVertex = jsonToVec("nextVertex", fixtureValue["chain"]);
-        fixtureDef.shape = &chainShape;
-        fixture = body->CreateFixture(&fixtureDef);
+        jsonToVecArray("vertices", fixtureValue["chain"], vertices, numVertices);
+        chainShape->CreateChain(vertices, numVertices);
+        chainShape->m_hasPrevVertex = fixtureValue["chain"].get("hasPrevVertex",false).asBool();
+        chainShape->m_hasNextVertex = fixtureValue["chain"].get("hasNextVertex",false).asBool();
+        if ( chainShape->m_hasPrevVertex )
+            chainShape->m_prevVertex = jsonToVec("prevVertex", fixtureValue["chain"]);
+        if ( chainShape->m_hasNextVertex )
+            chainShape->m_nextVertex = jsonToVec("nextVertex", fixtureValue["chain"]);
+        def.shape = chainShape;
         delete[] vertices;
     }
     else if ( !fixtureValue["polygon"].isNull() ) {
@@ -1151,31 +2228,25 @@ b2Fixture* b2dJson::j2b2Fixture(b2Body* body, Json::Value fixtureValue)
         }
         else if ( numVertices == 2 ) {
             std::cout << "Creating edge shape instead of polygon with two vertices.\n";
-            b2EdgeShape edgeShape;
-            edgeShape.m_vertex1 = jsonToVec("vertices", fixtureValue["polygon"], 0);
-            edgeShape.m_vertex2 = jsonToVec("vertices", fixtureValue["polygon"], 1);
-            fixtureDef.shape = &edgeShape;
-            fixture = body->CreateFixture(&fixtureDef);
+            b2EdgeShape* edgeShape = new b2EdgeShape;
+            edgeShape->m_vertex1 = jsonToVec("vertices", fixtureValue["polygon"], 0);
+            edgeShape->m_vertex2 = jsonToVec("vertices", fixtureValue["polygon"], 1);
+            def.shape = edgeShape;
         }
         else {
-            b2PolygonShape polygonShape;
-            for (int i = 0; i < numVertices; i++)
-                vertices[i] = jsonToVec("vertices", fixtureValue["polygon"], i);
-            polygonShape.Set(vertices, numVertices);
-            fixtureDef.shape = &polygonShape;
-            fixture = body->CreateFixture(&fixtureDef);
+            b2PolygonShape* polygonShape = new b2PolygonShape;
+            jsonToVecArray("vertices", fixtureValue["polygon"], vertices, numVertices);
+            polygonShape->Set(vertices, numVertices);
+            def.shape = polygonShape;
         }
     }
 
-    string fixtureName = fixtureValue.get("name","").asString();
-    if ( fixtureName != "" ) {
-        setFixtureName(fixture, fixtureName.c_str());
-    }
+    fixtureDef->name = fixtureValue.get("name","").asString();
 
-    return fixture;
+    return fixtureDef;
 }
 
-b2Joint* b2dJson::j2b2Joint(b2World* world, Json::Value jointValue)
+b2Joint* b2dJson::j2b2Joint(b2World* world, const Json::Value& jointValue)
 {
     b2Joint* joint = NULL;
 
@@ -1336,7 +2407,7 @@ b2Joint* b2dJson::j2b2Joint(b2World* world, Json::Value jointValue)
     return joint;
 }
 
-b2dJsonImage* b2dJson::j2b2dJsonImage(Json::Value imageValue)
+b2dJsonImage* b2dJson::j2b2dJsonImage(const Json::Value& imageValue)
 {
     b2dJsonImage* img = new b2dJsonImage();
 
@@ -1380,10 +2451,8 @@ b2dJsonImage* b2dJson::j2b2dJsonImage(Json::Value imageValue)
         img->numPoints = numFloats / 2;
         img->points = new float[numFloats];
         img->uvCoords = new float[numFloats];
-        for (int i = 0; i < numFloats; i++) {
-            img->points[i] = jsonToFloat("glVertexPointer", imageValue, i);
-            img->uvCoords[i] = jsonToFloat("glTexCoordPointer", imageValue, i);
-        }
+        jsonToFloatArray(imageValue["glVertexPointer"], img->points, numFloats);
+        jsonToFloatArray(imageValue["glTexCoordPointer"], img->uvCoords, numFloats);
     }
 
     if ( imageValue["glDrawElements"].isArray() ) {
@@ -1396,69 +2465,113 @@ b2dJsonImage* b2dJson::j2b2dJsonImage(Json::Value imageValue)
     return img;
 }
 
-float b2dJson::jsonToFloat(const char* name, Json::Value& value, int index, float defaultValue)
+float b2dJson::jsonToFloat(const char* name, const Json::Value& value, int index, float defaultValue)
 {
     if ( ! value.isMember(name) )
         return defaultValue;
 
-    if ( index > -1 ) {
-        if ( value[name][index].isNull() )
-            return defaultValue;
-        else if ( value[name][index].isInt() )
-            return value[name][index].asInt();//usually 0 or 1
-        else if ( value[name][index].isString() )
-            return hexToFloat( value[name][index].asString() );
-        else
-            return value[name][index].asFloat();
-    }
-    else {
-        if ( value[name].isNull() )
-            return defaultValue;
-        else if ( value[name].isInt() )
-            return value[name].asInt();//usually 0 or 1
-        else if ( value[name].isString() )
-            return hexToFloat( value[name].asString() );
-        else
-            return value[name].asFloat();
-    }
+    const Json::Value& floatValue = (index > -1) ? value[name][index] : value[name];
+    if ( floatValue.isNull() )
+        return defaultValue;
+    else if ( floatValue.isInt() )
+        return floatValue.asInt();//usually 0 or 1
+    else if ( floatValue.isString() )
+        return hexToFloat( floatValue.asCString() );
+    else
+        return floatValue.asFloat();
 }
 
-b2Vec2 b2dJson::jsonToVec(const char* name, Json::Value& value, int index, b2Vec2 defaultValue)
+b2Vec2 b2dJson::jsonToVec(const char* name, const Json::Value& value, int index, b2Vec2 defaultValue)
 {
     b2Vec2 vec = defaultValue;
 
     if ( ! value.isMember(name) )
         return defaultValue;
 
+    const Json::Value& vecValue = value[name];
+
     if (index > -1) {
 
-        if ( value[name]["x"][index].isInt() ) //usually 0 or 1
-            vec.x = value[name]["x"][index].asInt();
-        else if ( value[name]["x"][index].isString() )
-            vec.x = hexToFloat(value[name]["x"][index].asString());
+        const Json::Value& xValue = vecValue["x"][index];
+        if ( xValue.isInt() ) //usually 0 or 1
+            vec.x = xValue.asInt();
+        else if ( xValue.isString() )
+            vec.x = hexToFloat(xValue.asCString());
         else
-            vec.x = value[name]["x"][index].asFloat();
+            vec.x = xValue.asFloat();
 
-        if ( value[name]["y"][index].isInt() ) //usually 0 or 1
-            vec.y = value[name]["y"][index].asInt();
-        else if ( value[name]["y"][index].isString() )
-            vec.y = hexToFloat(value[name]["y"][index].asString());
+        const Json::Value& yValue = vecValue["y"][index];
+        if ( yValue.isInt() ) //usually 0 or 1
+            vec.y = yValue.asInt();
+        else if ( yValue.isString() )
+            vec.y = hexToFloat(yValue.asCString());
         else
-            vec.y = value[name]["y"][index].asFloat();
+            vec.y = yValue.asFloat();
     }
     else {
 
-        if ( value[name].isInt() ) //zero vector
+        if ( vecValue.isInt() ) //zero vector
             vec.Set(0,0);
         else {
-            vec.x = jsonToFloat("x", value[name]);
-            vec.y = jsonToFloat("y", value[name]);
+            vec.x = jsonToFloat("x", vecValue);
+            vec.y = jsonToFloat("y", vecValue);
         }
     }
 
     return vec;
 }
 
+// Decodes count consecutive entries of a JSON array into floats, writing every
+// stride'th float of the output. Hex strings are gathered up and decoded in
+// batches with hexToFloats, everything else is handled like jsonToFloat does.
+void b2dJson::jsonToFloatArray(const Json::Value& arrayValue, float* floats, int count, int stride)
+{
+    const int batchSize = 64;
+    const char* hexStrings[batchSize];
+    float* targets[batchSize];
+    float decoded[batchSize];
+    int numPending = 0;
+
+    for (int i = 0; i < count; i++) {
+        const Json::Value& floatValue = arrayValue[i];
+        float* target = floats + i * stride;
+        if ( floatValue.isString() ) {
+            hexStrings[numPending] = floatValue.asCString();
+            targets[numPending] = target;
+            if ( ++numPending == batchSize ) {
+                hexToFloats(hexStrings, decoded, numPending);
+                for (int k = 0; k < numPending; k++)
+                    *targets[k] = decoded[k];
+                numPending = 0;
+            }
+        }
+        else if ( floatValue.isNull() )
+            *target = 0;
+        else if ( floatValue.isInt() )
+            *target = floatValue.asInt();//usually 0 or 1
+        else
+            *target = floatValue.asFloat();
+    }
+
+    hexToFloats(hexStrings, decoded, numPending);
+    for (int k = 0; k < numPending; k++)
+        *targets[k] = decoded[k];
+}
+
+// Bulk version of jsonToVec for the indexed case, eg. polygon and chain vertices
+void b2dJson::jsonToVecArray(const char* name, const Json::Value& value, b2Vec2* vecs, int count)
+{
+    if ( ! value.isMember(name) ) {
+        for (int i = 0; i < count; i++)
+            vecs[i].SetZero();
+        return;
+    }
+
+    const Json::Value& vecValue = value[name];
+    jsonToFloatArray(vecValue["x"], &vecs[0].x, count, 2);
+    jsonToFloatArray(vecValue["y"], &vecs[0].y, count, 2);
+}
+
 
 
 
@@ -1479,38 +2592,126 @@ b2Vec2 b2dJson::jsonToVec(const char* name, Json::Value& value, int index, b2Vec
 
 std::string b2dJson::floatToHex(float f)
 {
-    char buf[16];
-    //sprintf(buf, "%08X", *((int*)(&f)) ); dereferencing type-punned pointer will break strict-aliasing rules
-    int* i = (int*)(&f);
-    sprintf(buf, "%08X", *i );
-    return std::string(buf);
+    char buf[8];
+    b2dJsonWriteBuffer::floatToHex(f, buf);
+    return std::string(buf, 8);
 }
 
 float b2dJson::hexToFloat(std::string str)
 {
-    int strLen = 8;//32 bit float
-    unsigned char bytes[4];
-    int bptr = (strLen / 2) - 1;
-
-    for (int i = 0; i < strLen; i++){
-        unsigned char   c;
-        c = str[i];
-        if (c > '9') c -= 7;
-        c <<= 4;
-        bytes[bptr] = c;
+    return hexToFloat(str.c_str());
+}
 
-        ++i;
-        c = str[i];
-        if (c > '9') c -= 7;
-        c -= '0';
-        bytes[bptr] |= c;
+// The decoders below all give exactly the same bits as the original per-character
+// version: each character has 7 subtracted if it is above '9', then the first of
+// each pair becomes the high nibble and the second (minus '0') is OR'd in as the
+// low nibble. The first pair of characters is the most significant byte.
 
-        --bptr;
+static inline unsigned int hexCharsToBits(const char* str)
+{
+    unsigned int bits = 0;
+    for (int i = 0; i < 8; i += 2) {
+        unsigned char hi = str[i];
+        unsigned char lo = str[i+1];
+        hi -= (hi > '9') * 7;
+        lo -= (lo > '9') * 7;
+        bits = (bits << 8) | (unsigned char)((unsigned char)(hi << 4) | (unsigned char)(lo - '0'));
     }
+    return bits;
+}
+
+static inline float bitsToFloat(unsigned int bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Hex strings are exactly 8 characters, but don't read past the end of a shorter one
+static inline const char* paddedHexChars(const char* str, char* buf)
+{
+    if ( memchr(str, 0, 8) == NULL )
+        return str;
+    strncpy(buf, str, 8);
+    return buf;
+}
+
+float b2dJson::hexToFloat(const char* str)
+{
+    char buf[8];
+    return bitsToFloat( hexCharsToBits( paddedHexChars(str, buf) ) );
+}
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+static inline unsigned int byteSwap32(unsigned int x)
+{
+    return (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+}
+
+// Decodes two hex strings at once, one in each 64-bit half of the register
+static inline void hexCharsToBits2(const char* str0, const char* str1, unsigned int* bits)
+{
+    __m128i chars = _mm_unpacklo_epi64( _mm_loadl_epi64((const __m128i*)str0), _mm_loadl_epi64((const __m128i*)str1) );
+
+    // SSE2 only has a signed byte compare, so flip the sign bits to compare unsigned
+    const __m128i signBits = _mm_set1_epi8((char)0x80);
+    __m128i aboveNine = _mm_cmpgt_epi8( _mm_xor_si128(chars, signBits), _mm_xor_si128(_mm_set1_epi8('9'), signBits) );
+    chars = _mm_sub_epi8( chars, _mm_and_si128(aboveNine, _mm_set1_epi8(7)) );
+
+    // even bytes hold the high nibbles, odd bytes are shifted down onto them as the low nibbles
+    __m128i hi = _mm_slli_epi16(chars, 4);
+    __m128i lo = _mm_srli_si128( _mm_sub_epi8(chars, _mm_set1_epi8('0')), 1 );
+    __m128i bytes = _mm_and_si128( _mm_or_si128(hi, lo), _mm_set1_epi16(0x00ff) );
+    bytes = _mm_packus_epi16(bytes, bytes);
 
-    //return *((float*)bytes); dereferencing type-punned pointer will break strict-aliasing rules
-    float* f = (float*)bytes;
-    return *f;
+    bits[0] = byteSwap32( _mm_cvtsi128_si32(bytes) );
+    bits[1] = byteSwap32( _mm_cvtsi128_si32(_mm_srli_si128(bytes, 4)) );
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+// Decodes two hex strings at once, one in each 64-bit half of the register
+static inline void hexCharsToBits2(const char* str0, const char* str1, unsigned int* bits)
+{
+    uint8x16_t chars = vcombine_u8( vld1_u8((const uint8_t*)str0), vld1_u8((const uint8_t*)str1) );
+    chars = vsubq_u8( chars, vandq_u8(vcgtq_u8(chars, vdupq_n_u8('9')), vdupq_n_u8(7)) );
+
+    uint8x16_t hi = vshlq_n_u8(chars, 4);
+    uint8x16_t lo = vsubq_u8(chars, vdupq_n_u8('0'));
+    uint8x8_t bytes = vorr_u8( vget_low_u8(vuzpq_u8(hi, hi).val[0]), vget_low_u8(vuzpq_u8(lo, lo).val[1]) );
+
+    vst1_u32( bits, vreinterpret_u32_u8(vrev32_u8(bytes)) );
+}
+
+#else
+
+static inline void hexCharsToBits2(const char* str0, const char* str1, unsigned int* bits)
+{
+    bits[0] = hexCharsToBits(str0);
+    bits[1] = hexCharsToBits(str1);
+}
+
+#endif
+
+// Decodes a batch of hex strings, as found in the vertex and image mesh arrays
+void b2dJson::hexToFloats(const char* const* hexStrings, float* floats, int count)
+{
+    char buf0[8], buf1[8];
+    unsigned int bits[2];
+
+    int i = 0;
+    for (; i + 1 < count; i += 2) {
+        hexCharsToBits2( paddedHexChars(hexStrings[i], buf0), paddedHexChars(hexStrings[i+1], buf1), bits );
+        floats[i] = bitsToFloat(bits[0]);
+        floats[i+1] = bitsToFloat(bits[1]);
+    }
+    if ( i < count )
+        floats[i] = hexToFloat(hexStrings[i]);
 }
 
 b2Body* b2dJson::lookupBodyFromIndex( unsigned int index )
@@ -1630,6 +2831,24 @@ int b2dJson::getAllImages(vector<b2dJsonImage*> &images)
     return images.size();
 }
 
+int b2dJson::getAllBodiesInFileOrder(vector<b2Body*> &bodies)
+{
+    bodies.insert( bodies.end(), m_bodies.begin(), m_bodies.end() );
+    return bodies.size();
+}
+
+int b2dJson::getAllJointsInCreationOrder(vector<b2Joint*> &joints)
+{
+    joints.insert( joints.end(), m_joints.begin(), m_joints.end() );
+    return joints.size();
+}
+
+int b2dJson::getAllImagesInFileOrder(vector<b2dJsonImage*> &images)
+{
+    images.insert( images.end(), m_images.begin(), m_images.end() );
+    return images.size();
+}
+
 
 b2Body* b2dJson::getBodyByName(string name)
 {
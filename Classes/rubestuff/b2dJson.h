@@ -23,10 +23,12 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 #include <Box2D/Box2D.h>
 #include "json/json.h"
 
 class b2dJsonImage;
+class b2dJsonWriteBuffer;
 class EditorDocument;
 
 class b2dJsonCustomProperties {
@@ -38,6 +40,40 @@ public:
     std::map<std::string, bool> m_customPropertyMap_bool;
 };
 
+// A fixture decoded from JSON but not yet created on a body. Owns its shape,
+// which is NULL if the fixture should be skipped.
+class b2dJsonFixtureDef {
+public:
+    b2FixtureDef fixtureDef;
+    std::string name;
+
+    b2dJsonFixtureDef() {}
+    ~b2dJsonFixtureDef() { delete fixtureDef.shape; }
+private:
+    b2dJsonFixtureDef(const b2dJsonFixtureDef&);
+    b2dJsonFixtureDef& operator=(const b2dJsonFixtureDef&);
+};
+
+// A body and its fixtures decoded from JSON but not yet created in a world.
+// Decoding is where most of the time goes when loading (hex floats, polygon
+// hulls) and needs nothing but the JSON value, so it can be done on any thread.
+class b2dJsonBodyDef {
+public:
+    b2BodyDef bodyDef;
+    b2MassData massData;
+    std::string name;
+    std::vector<b2dJsonFixtureDef*> fixtures;
+
+    b2dJsonBodyDef() {}
+    ~b2dJsonBodyDef() {
+        for (int i = 0; i < (int)fixtures.size(); i++)
+            delete fixtures[i];
+    }
+private:
+    b2dJsonBodyDef(const b2dJsonBodyDef&);
+    b2dJsonBodyDef& operator=(const b2dJsonBodyDef&);
+};
+
 class b2dJson
 {
 protected:
@@ -87,6 +123,14 @@ public:
     Json::Value b2j(b2Joint* joint);
     Json::Value b2j(b2dJsonImage* image);
 
+    //same output as the b2j functions, but written straight into the buffer
+    //as text without building a Json::Value tree (used by writeToString/File)
+    void b2jStream(b2World* world, b2dJsonWriteBuffer& out);
+    void b2jStream(b2Body* body, b2dJsonWriteBuffer& out);
+    void b2jStream(b2Fixture* fixture, b2dJsonWriteBuffer& out);
+    void b2jStream(b2Joint* joint, b2dJsonWriteBuffer& out);
+    void b2jStream(b2dJsonImage* image, b2dJsonWriteBuffer& out);
+
     void setBodyName(b2Body* body, const char* name);
     void setFixtureName(b2Fixture* fixture, const char* name);
     void setJointName(b2Joint* joint, const char* name);
@@ -95,15 +139,51 @@ public:
     void addImage(b2dJsonImage* image);
 
     //reading functions
-    b2World* readFromValue(Json::Value worldValue);
-    b2World* readFromString(std::string str, std::string& errorMsg);
+    b2World* readFromValue(const Json::Value& worldValue);
+    b2World* readFromString(const std::string& str, std::string& errorMsg);
+    b2World* readFromMemory(const char* data, size_t length, std::string& errorMsg); //parses the text where it is, without taking a copy
     b2World* readFromFile(const char* filename, std::string& errorMsg);
 
-    b2World* j2b2World(Json::Value worldValue);
-    b2Body* j2b2Body(b2World* world, Json::Value bodyValue);
-    b2Fixture* j2b2Fixture(b2Body* body, Json::Value fixtureValue);
-    b2Joint* j2b2Joint(b2World* world, Json::Value jointValue);
-    b2dJsonImage* j2b2dJsonImage(Json::Value imageValue);
+    //gives the same world as readFromString, but the body, joint and image arrays
+    //are parsed on several threads (from b2dJsonThreadPool), and the bodies decoded
+    //there too. Only the creation of the bodies and joints is done in order on the
+    //calling thread. Use 0 threads for one per core (up to 8).
+    b2World* readFromStringInParallel(const std::string& str, std::string& errorMsg, int numThreads = 0);
+    b2World* readFromMemoryInParallel(const char* data, size_t length, std::string& errorMsg, int numThreads = 0);
+
+    //these all take the value by const reference, so the scene tree is only
+    //walked and never copied (copying a Json::Value duplicates its whole subtree)
+    b2World* j2b2World(const Json::Value& worldValue);
+    b2Body* j2b2Body(b2World* world, const Json::Value& bodyValue);
+    b2Fixture* j2b2Fixture(b2Body* body, const Json::Value& fixtureValue);
+    b2Body* j2b2Body(b2World* world, const b2dJsonBodyDef& bodyDef, const Json::Value& bodyValue);
+    b2Fixture* j2b2Fixture(b2Body* body, const b2dJsonFixtureDef& fixtureDef);
+
+    //for building up a world a piece at a time instead of all at once with
+    //j2b2World, eg. when streaming in the tiles of a large level. Bodies are
+    //numbered in the order they are added, and joints refer to them that way.
+    b2Body* addBody(b2World* world, const b2dJsonBodyDef& bodyDef, const Json::Value& bodyValue);
+    void addExistingBody(b2Body* body);
+    void addJoints(b2World* world, const Json::Value& jointValues);
+    b2Joint* addJoint(b2World* world, const Json::Value& jointValue);
+    b2dJsonImage* addImage(const Json::Value& imageValue);
+    void j2b2WorldSettings(b2World* world, const Json::Value& worldValue);
+
+    //for hot reloading, where things that have not changed since the last load are
+    //still in the world and only need their names and custom properties read again.
+    //The fixtures of the body must have been created from the same bodyDef.
+    void addExistingBody(b2Body* body, const b2dJsonBodyDef& bodyDef, const Json::Value& bodyValue);
+    void addExistingJoint(b2Joint* joint, const Json::Value& jointValue);
+
+    //these two only decode, without creating anything or changing this object,
+    //so they can be called from any thread
+    static void j2b2BodyDef(const Json::Value& bodyValue, b2dJsonBodyDef& bodyDef);
+    static b2dJsonFixtureDef* j2b2FixtureDef(const Json::Value& fixtureValue);
+
+    //these record what they make in the maps of this object, so they must only be
+    //called from one thread at a time
+    b2Joint* j2b2Joint(b2World* world, const Json::Value& jointValue);
+    b2dJsonImage* j2b2dJsonImage(const Json::Value& imageValue);
 
     int getBodiesByName(std::string name, std::vector<b2Body*>& bodies);
     int getFixturesByName(std::string name, std::vector<b2Fixture*>& fixtures);
@@ -112,6 +192,12 @@ public:
 
     int getAllImages(std::vector<b2dJsonImage*>& images);
 
+    //in the order they were read, instead of by render order as above. Joints
+    //are in the order they were created, which is gear joints last.
+    int getAllBodiesInFileOrder(std::vector<b2Body*>& bodies);
+    int getAllJointsInCreationOrder(std::vector<b2Joint*>& joints);
+    int getAllImagesInFileOrder(std::vector<b2dJsonImage*>& images);
+
     b2Body* getBodyByName(std::string name);
     b2Fixture* getFixtureByName(std::string name);
     b2Joint* getJointByName(std::string name);
@@ -200,22 +286,34 @@ protected:
     void vecToJson(const char* name, float v, Json::Value& value, int index = -1);
     void vecToJson(const char* name, b2Vec2 vec, Json::Value& value, int index = -1);
     void floatToJson(const char* name, float f, Json::Value& value);
+    void floatToStream(const char* name, float f, b2dJsonWriteBuffer& out);
+    void floatValueToStream(float f, b2dJsonWriteBuffer& out);
+    void vecToStream(const char* name, b2Vec2 vec, b2dJsonWriteBuffer& out);
+    void vecArrayToStream(const char* name, const b2Vec2* vecs, int count, b2dJsonWriteBuffer& out);
+    void floatArrayToStream(const char* name, const float* floats, int count, b2dJsonWriteBuffer& out);
     b2Body* lookupBodyFromIndex( unsigned int index );
     int lookupBodyIndex( b2Body* body );
     int lookupJointIndex( b2Joint* joint );
 
     Json::Value writeCustomPropertiesToJson(void* item);
-    void readCustomPropertiesFromJson(b2Body* item, Json::Value value);
-    void readCustomPropertiesFromJson(b2Fixture* item, Json::Value value);
-    void readCustomPropertiesFromJson(b2Joint* item, Json::Value value);
-    void readCustomPropertiesFromJson(b2dJsonImage* item, Json::Value value);
-    void readCustomPropertiesFromJson(b2World* item, Json::Value value);
+    void writeCustomPropertiesToStream(void* item, b2dJsonWriteBuffer& out);
+    void readCustomPropertiesFromJson(b2Body* item, const Json::Value& value);
+    void readCustomPropertiesFromJson(b2Fixture* item, const Json::Value& value);
+    void readCustomPropertiesFromJson(b2Joint* item, const Json::Value& value);
+    void readCustomPropertiesFromJson(b2dJsonImage* item, const Json::Value& value);
+    void readCustomPropertiesFromJson(b2World* item, const Json::Value& value);
+
+    b2World* j2b2World(const Json::Value& worldValue, const std::vector<b2dJsonBodyDef*>* bodyDefs);
 
     //static helpers
     static std::string floatToHex(float f);
     static float hexToFloat(std::string str);
-    static float jsonToFloat(const char* name, Json::Value& value, int index = -1, float defaultValue = 0);
-    static b2Vec2 jsonToVec(const char* name, Json::Value& value, int index = -1, b2Vec2 defaultValue = b2Vec2(0,0));
+    static float hexToFloat(const char* str);
+    static void hexToFloats(const char* const* hexStrings, float* floats, int count);
+    static float jsonToFloat(const char* name, const Json::Value& value, int index = -1, float defaultValue = 0);
+    static b2Vec2 jsonToVec(const char* name, const Json::Value& value, int index = -1, b2Vec2 defaultValue = b2Vec2(0,0));
+    static void jsonToFloatArray(const Json::Value& arrayValue, float* floats, int count, int stride = 1);
+    static void jsonToVecArray(const char* name, const Json::Value& value, b2Vec2* vecs, int count);
 };
 
 #endif // B2DJSON_H
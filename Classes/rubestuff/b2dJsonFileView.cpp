@@ -0,0 +1,121 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "b2dJsonFileView.h"
+
+#if !defined(_WIN32)
+#define B2DJSON_USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+b2dJsonFileView::b2dJsonFileView()
+{
+    m_data = NULL;
+    m_size = 0;
+    m_mapped = false;
+}
+
+b2dJsonFileView::~b2dJsonFileView()
+{
+    close();
+}
+
+bool b2dJsonFileView::open(const string& filename, string& errorMsg)
+{
+    close();
+
+#ifdef B2DJSON_USE_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if ( fd >= 0 ) {
+        struct stat st;
+        if ( fstat(fd, &st) == 0 && S_ISREG(st.st_mode) ) {
+            if ( st.st_size == 0 ) {
+                //can't map nothing, but it's not an error to open an empty file
+                ::close(fd);
+                m_data = "";
+                return true;
+            }
+            void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if ( p != MAP_FAILED ) {
+                //the parser goes straight through from start to end
+                madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+                ::close(fd);
+                m_data = (const char*)p;
+                m_size = (size_t)st.st_size;
+                m_mapped = true;
+                return true;
+            }
+        }
+        ::close(fd);
+    }
+    //try reading it instead, some file systems can't be mapped
+#endif
+
+    FILE* f = fopen(filename.c_str(), "rb");
+    if ( !f ) {
+        errorMsg = string("Could not open file '") + filename + string("' for reading");
+        return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if ( length < 0 ) {
+        fclose(f);
+        errorMsg = string("Could not read file '") + filename + string("'");
+        return false;
+    }
+
+    char* buffer = (char*)malloc(length > 0 ? (size_t)length : 1);
+    if ( !buffer || fread(buffer, 1, (size_t)length, f) != (size_t)length ) {
+        free(buffer);
+        fclose(f);
+        errorMsg = string("Could not read file '") + filename + string("'");
+        return false;
+    }
+    fclose(f);
+
+    if ( length == 0 ) {
+        free(buffer);
+        m_data = "";
+        return true;
+    }
+    m_data = buffer;
+    m_size = (size_t)length;
+    return true;
+}
+
+void b2dJsonFileView::close()
+{
+#ifdef B2DJSON_USE_MMAP
+    if ( m_mapped )
+        munmap((void*)m_data, m_size);
+    else
+#endif
+    if ( m_size > 0 )
+        free((void*)m_data);
+
+    m_data = NULL;
+    m_size = 0;
+    m_mapped = false;
+}
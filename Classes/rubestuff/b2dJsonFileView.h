@@ -0,0 +1,50 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2DJSONFILEVIEW_H
+#define B2DJSONFILEVIEW_H
+
+#include <string>
+#include <stddef.h>
+
+// Read-only access to the whole contents of a file, for handing straight to the
+// JSON parser without copying it into a std::string first. Where possible the
+// file is memory mapped, so its pages come from the OS file cache and nothing
+// is allocated for it at all. Otherwise it is read into a single buffer.
+// Either way the contents stay valid until close() or the destructor.
+
+class b2dJsonFileView
+{
+protected:
+    const char* m_data;
+    size_t m_size;
+    bool m_mapped;                      // whether m_data is a mapping, or a buffer from malloc
+
+    b2dJsonFileView(const b2dJsonFileView&);
+    b2dJsonFileView& operator=(const b2dJsonFileView&);
+
+public:
+    b2dJsonFileView();
+    ~b2dJsonFileView();
+
+    bool open(const std::string& filename, std::string& errorMsg);
+    void close();
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
+
+#endif // B2DJSONFILEVIEW_H
@@ -0,0 +1,121 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <string.h>
+#include <sys/stat.h>
+#include "b2dJsonFileWatcher.h"
+
+#if defined(__linux__)
+#define B2DJSON_USE_INOTIFY
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+using namespace std;
+
+b2dJsonFileWatcher::b2dJsonFileWatcher()
+{
+    m_inotifyFd = -1;
+    m_watch = -1;
+    m_lastModified = 0;
+}
+
+b2dJsonFileWatcher::~b2dJsonFileWatcher()
+{
+    stop();
+}
+
+time_t b2dJsonFileWatcher::getModifiedTime()
+{
+    struct stat st;
+    if ( stat(m_filename.c_str(), &st) != 0 )
+        return 0;
+    return st.st_mtime;
+}
+
+bool b2dJsonFileWatcher::watch(const string& filename, string& errorMsg)
+{
+    stop();
+
+    m_filename = filename;
+    size_t slash = filename.find_last_of("/\\");
+    string directory = (slash == string::npos) ? string(".") : filename.substr(0, slash + 1);
+    m_name = (slash == string::npos) ? filename : filename.substr(slash + 1);
+
+    m_lastModified = getModifiedTime();
+    if ( m_lastModified == 0 ) {
+        errorMsg = string("Could not watch '") + filename + string("', it is not a file");
+        return false;
+    }
+
+#ifdef B2DJSON_USE_INOTIFY
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ( m_inotifyFd >= 0 ) {
+        m_watch = inotify_add_watch(m_inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if ( m_watch < 0 ) {
+            close(m_inotifyFd);
+            m_inotifyFd = -1;
+        }
+    }
+    //if that didn't work, checking the modification time will have to do
+#endif
+
+    return true;
+}
+
+void b2dJsonFileWatcher::stop()
+{
+#ifdef B2DJSON_USE_INOTIFY
+    if ( m_inotifyFd >= 0 )
+        close(m_inotifyFd); //removes the watch as well
+#endif
+    m_inotifyFd = -1;
+    m_watch = -1;
+    m_filename.clear();
+}
+
+bool b2dJsonFileWatcher::hasChanged()
+{
+    if ( m_filename.empty() )
+        return false;
+
+#ifdef B2DJSON_USE_INOTIFY
+    if ( m_inotifyFd >= 0 ) {
+        //events for everything in the directory, only some of which are for this file
+        bool changed = false;
+        char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+        while ( true ) {
+            ssize_t length = read(m_inotifyFd, buffer, sizeof(buffer));
+            if ( length <= 0 )
+                break; //EAGAIN, nothing more to read
+            for (char* p = buffer; p < buffer + length; ) {
+                struct inotify_event* event = (struct inotify_event*)p;
+                if ( event->len > 0 && m_name == event->name )
+                    changed = true;
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        return changed;
+    }
+#endif
+
+    time_t modified = getModifiedTime();
+    if ( modified == 0 || modified == m_lastModified )
+        return false; //a missing file is most likely part way through being replaced
+    m_lastModified = modified;
+    return true;
+}
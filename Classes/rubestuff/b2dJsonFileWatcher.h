@@ -0,0 +1,51 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2DJSONFILEWATCHER_H
+#define B2DJSONFILEWATCHER_H
+
+#include <string>
+#include <time.h>
+
+// Tells when a file has been written to, eg. when a scene is exported again
+// from RUBE while the game is running. On Linux (and Android) this uses inotify
+// on the directory, which also catches editors that save by writing a new file
+// and renaming it over the old one. Elsewhere the modification time of the file
+// is checked instead.
+
+class b2dJsonFileWatcher
+{
+protected:
+    std::string m_filename;
+    std::string m_name;                 // the part after the directory
+    int m_inotifyFd;                    // -1 if not using inotify
+    int m_watch;
+    time_t m_lastModified;
+
+    time_t getModifiedTime();
+
+public:
+    b2dJsonFileWatcher();
+    ~b2dJsonFileWatcher();
+
+    bool watch(const std::string& filename, std::string& errorMsg);
+    void stop();
+
+    // Does not block. Returns true once for any number of writes since the last call.
+    bool hasChanged();
+};
+
+#endif // B2DJSONFILEWATCHER_H
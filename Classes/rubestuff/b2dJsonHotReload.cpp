@@ -0,0 +1,360 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <map>
+#include <set>
+#include <chrono>
+#include "b2dJsonHotReload.h"
+#include "b2dJson.h"
+
+using namespace std;
+
+typedef std::pair<std::string,int> itemKey;
+
+// The key of each item is its name, and how many items before it had the same
+// name, so the third unnamed body is ("",2)
+static void makeItemKeys(const Json::Value& items, std::vector<itemKey>& keys)
+{
+    std::map<std::string,int> counts;
+    for (int i = 0; !items[i].isNull(); i++) {
+        string name = items[i].get("name","").asString();
+        keys.push_back( itemKey(name, counts[name]++) );
+    }
+}
+
+// For each item in newItems, the index of the matching item in oldItems, or -1
+static void matchItems(const Json::Value& oldItems, const Json::Value& newItems, std::vector<int>& sources)
+{
+    std::vector<itemKey> oldKeys;
+    std::vector<itemKey> newKeys;
+    makeItemKeys(oldItems, oldKeys);
+    makeItemKeys(newItems, newKeys);
+
+    std::map<itemKey,int> lookup;
+    for (int i = 0; i < (int)oldKeys.size(); i++)
+        lookup[ oldKeys[i] ] = i;
+
+    sources.resize(newKeys.size());
+    for (int i = 0; i < (int)newKeys.size(); i++) {
+        std::map<itemKey,int>::iterator it = lookup.find( newKeys[i] );
+        sources[i] = (it == lookup.end()) ? -1 : it->second;
+    }
+}
+
+static bool isIgnored(const string& name, const char* const* ignored)
+{
+    for (int i = 0; ignored[i]; i++) {
+        if ( name == ignored[i] )
+            return true;
+    }
+    return false;
+}
+
+// Compares two objects, apart from the named members (which are indexes into
+// other arrays, and need to be compared by what they refer to instead)
+static bool equalExcept(const Json::Value& a, const Json::Value& b, const char* const* ignored)
+{
+    Json::Value::Members members = a.getMemberNames();
+    for (int i = 0; i < (int)members.size(); i++) {
+        if ( !isIgnored(members[i], ignored) && !(a[members[i]] == b[members[i]]) )
+            return false;
+    }
+    members = b.getMemberNames();
+    for (int i = 0; i < (int)members.size(); i++) {
+        if ( !isIgnored(members[i], ignored) && !a.isMember(members[i]) )
+            return false;
+    }
+    return true;
+}
+
+// Gear joints are created after all the other joints, and refer to those by
+// the order they were created in (see b2dJson::addJoints)
+static void jointCreationOrder(const Json::Value& jointValues, std::vector<int>& order)
+{
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; !jointValues[i].isNull(); i++) {
+            bool isGear = jointValues[i]["type"].asString() == "gear";
+            if ( isGear == (pass == 1) )
+                order.push_back(i);
+        }
+    }
+}
+
+static const char* s_jointIndexMembers[] = { "bodyA", "bodyB", "joint1", "joint2", NULL };
+static const char* s_imageIndexMembers[] = { "body", NULL };
+
+
+
+
+b2dJsonHotReload::b2dJsonHotReload()
+{
+    m_destructionListener = NULL;
+}
+
+b2World* b2dJsonHotReload::load(const char* data, size_t length, b2dJson& json, string& errorMsg)
+{
+    Json::Value scene;
+    Json::Reader reader;
+    if ( ! reader.parse(data, data + length, scene, false) )
+    {
+        errorMsg = string("Failed to parse JSON:\n") + reader.getFormatedErrorMessages();
+        return NULL;
+    }
+    m_scene.swap(scene);
+
+    b2World* world = json.readFromValue(m_scene);
+    rememberObjects(json);
+    return world;
+}
+
+void b2dJsonHotReload::rememberObjects(b2dJson& json)
+{
+    m_bodies.clear();
+    json.getAllBodiesInFileOrder(m_bodies);
+
+    std::vector<b2Joint*> jointsInCreationOrder;
+    json.getAllJointsInCreationOrder(jointsInCreationOrder);
+    std::vector<int> order;
+    jointCreationOrder(m_scene["joint"], order);
+    m_joints.assign(order.size(), NULL);
+    for (int k = 0; k < (int)order.size() && k < (int)jointsInCreationOrder.size(); k++)
+        m_joints[ order[k] ] = jointsInCreationOrder[k];
+}
+
+// Sets the properties of the body that are different in the new value. Leaving
+// the others alone means that eg. a body keeps moving from wherever it is now
+// when only its damping was changed.
+void b2dJsonHotReload::updateBody(b2Body* body, const Json::Value& oldValue, const Json::Value& newValue, const b2dJsonBodyDef& bodyDef)
+{
+#define CHANGED(member) !(oldValue[member] == newValue[member])
+    const b2BodyDef& def = bodyDef.bodyDef;
+
+    bool needMassData = false;
+    if ( CHANGED("type") ) {
+        body->SetType(def.type);
+        needMassData = true;
+    }
+
+    if ( CHANGED("fixture") ) {
+        while ( b2Fixture* fixture = body->GetFixtureList() ) {
+            if ( m_destructionListener )
+                m_destructionListener->SayGoodbye(fixture);
+            body->DestroyFixture(fixture);
+        }
+        for (int i = 0; i < (int)bodyDef.fixtures.size(); i++) {
+            const b2dJsonFixtureDef* fixtureDef = bodyDef.fixtures[i];
+            if ( fixtureDef && fixtureDef->fixtureDef.shape )
+                body->CreateFixture(&fixtureDef->fixtureDef);
+        }
+        needMassData = true;
+    }
+
+    if ( needMassData || CHANGED("massData-mass") || CHANGED("massData-center") || CHANGED("massData-I") )
+        body->SetMassData(&bodyDef.massData);
+
+    bool positionChanged = CHANGED("position");
+    bool angleChanged = CHANGED("angle");
+    if ( positionChanged || angleChanged )
+        body->SetTransform( positionChanged ? def.position : body->GetPosition(), angleChanged ? def.angle : body->GetAngle() );
+
+    if ( CHANGED("linearVelocity") )    body->SetLinearVelocity(def.linearVelocity);
+    if ( CHANGED("angularVelocity") )   body->SetAngularVelocity(def.angularVelocity);
+    if ( CHANGED("linearDamping") )     body->SetLinearDamping(def.linearDamping);
+    if ( CHANGED("angularDamping") )    body->SetAngularDamping(def.angularDamping);
+    if ( CHANGED("gravityScale") )      body->SetGravityScale(def.gravityScale);
+    if ( CHANGED("allowSleep") )        body->SetSleepingAllowed(def.allowSleep);
+    if ( CHANGED("fixedRotation") )     body->SetFixedRotation(def.fixedRotation);
+    if ( CHANGED("bullet") )            body->SetBullet(def.bullet);
+    if ( CHANGED("active") )            body->SetActive(def.active);
+
+    //whatever changed should be seen straight away
+    body->SetAwake(true);
+#undef CHANGED
+}
+
+bool b2dJsonHotReload::reload(b2World* world, const char* data, size_t length, b2dJson& json, b2dJsonReloadInfo& info, string& errorMsg)
+{
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    Json::Value scene;
+    Json::Reader reader;
+    if ( ! reader.parse(data, data + length, scene, false) )
+    {
+        errorMsg = string("Failed to parse JSON:\n") + reader.getFormatedErrorMessages();
+        return false;
+    }
+
+    info.bodiesKept = info.bodiesUpdated = info.bodiesCreated = info.bodiesDestroyed = 0;
+    info.jointsKept = info.jointsCreated = info.jointsDestroyed = 0;
+    info.imageSources.clear();
+    info.imagesChanged.clear();
+
+    //the game may have destroyed some things since the last load, and those
+    //are treated as if they were not in the old scene
+    std::set<b2Body*> liveBodies;
+    for (b2Body* body = world->GetBodyList(); body; body = body->GetNext())
+        liveBodies.insert(body);
+    std::set<b2Joint*> liveJoints;
+    for (b2Joint* joint = world->GetJointList(); joint; joint = joint->GetNext())
+        liveJoints.insert(joint);
+
+    //match up bodies
+    const Json::Value& oldBodyValues = m_scene["body"];
+    const Json::Value& newBodyValues = scene["body"];
+    std::vector<int> bodySources;
+    matchItems(oldBodyValues, newBodyValues, bodySources);
+
+    int numNewBodies = (int)bodySources.size();
+    std::vector<b2Body*> newBodies(numNewBodies, NULL); //only known for matched bodies until they are created
+    std::vector<bool> oldBodyKept(m_bodies.size(), false);
+    for (int i = 0; i < numNewBodies; i++) {
+        int source = bodySources[i];
+        if ( source < 0 || source >= (int)m_bodies.size() || !liveBodies.count(m_bodies[source]) )
+            continue;
+        newBodies[i] = m_bodies[source];
+        oldBodyKept[source] = true;
+    }
+
+    //match up joints. A joint is kept if it is the same apart from the indexes,
+    //and those still refer to the same bodies and joints as before.
+    const Json::Value& oldJointValues = m_scene["joint"];
+    const Json::Value& newJointValues = scene["joint"];
+    std::vector<int> jointSources;
+    matchItems(oldJointValues, newJointValues, jointSources);
+    std::vector<int> order;
+    jointCreationOrder(newJointValues, order);
+
+    int numNewJoints = (int)order.size();
+    std::vector<b2Joint*> keptJoints(numNewJoints, NULL); //by creation order
+    std::vector<bool> oldJointKept(m_joints.size(), false);
+    for (int k = 0; k < numNewJoints; k++) {
+        const Json::Value& jointValue = newJointValues[ order[k] ];
+        int source = jointSources[ order[k] ];
+        if ( source < 0 || source >= (int)m_joints.size() || !liveJoints.count(m_joints[source]) )
+            continue;
+        if ( !equalExcept(oldJointValues[source], jointValue, s_jointIndexMembers) )
+            continue;
+
+        b2Joint* oldJoint = m_joints[source];
+        int bodyIndexA = jointValue["bodyA"].asInt();
+        int bodyIndexB = jointValue["bodyB"].asInt();
+        if ( bodyIndexA < 0 || bodyIndexA >= numNewBodies || newBodies[bodyIndexA] != oldJoint->GetBodyA() ||
+             bodyIndexB < 0 || bodyIndexB >= numNewBodies || newBodies[bodyIndexB] != oldJoint->GetBodyB() )
+            continue;
+
+        if ( oldJoint->GetType() == e_gearJoint ) {
+            b2GearJoint* gearJoint = (b2GearJoint*)oldJoint;
+            int jointIndex1 = jointValue["joint1"].asInt();
+            int jointIndex2 = jointValue["joint2"].asInt();
+            if ( jointIndex1 < 0 || jointIndex1 >= k || keptJoints[jointIndex1] != gearJoint->GetJoint1() ||
+                 jointIndex2 < 0 || jointIndex2 >= k || keptJoints[jointIndex2] != gearJoint->GetJoint2() )
+                continue;
+        }
+
+        keptJoints[k] = oldJoint;
+        oldJointKept[source] = true;
+    }
+
+    //take out the old joints that are not kept, gear joints before the joints they use
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < (int)m_joints.size(); i++) {
+            b2Joint* joint = m_joints[i];
+            if ( oldJointKept[i] || !liveJoints.count(joint) )
+                continue;
+            if ( (joint->GetType() == e_gearJoint) != (pass == 0) )
+                continue;
+            world->DestroyJoint(joint);
+            liveJoints.erase(joint);
+            info.jointsDestroyed++;
+        }
+    }
+
+    //work out how the images relate to the old ones while the old bodies are still known
+    const Json::Value& oldImageValues = m_scene["image"];
+    const Json::Value& newImageValues = scene["image"];
+    matchItems(oldImageValues, newImageValues, info.imageSources);
+    for (int i = 0; i < (int)info.imageSources.size(); i++) {
+        int source = info.imageSources[i];
+        bool changed = true;
+        if ( source >= 0 && equalExcept(oldImageValues[source], newImageValues[i], s_imageIndexMembers) ) {
+            int oldBodyIndex = oldImageValues[source].get("body", -1).asInt();
+            int newBodyIndex = newImageValues[i].get("body", -1).asInt();
+            b2Body* oldBody = (oldBodyIndex >= 0 && oldBodyIndex < (int)m_bodies.size()) ? m_bodies[oldBodyIndex] : NULL;
+            b2Body* newBody = (newBodyIndex >= 0 && newBodyIndex < numNewBodies) ? newBodies[newBodyIndex] : NULL;
+            changed = (oldBody != newBody) || (newBodyIndex >= 0 && !newBody);
+        }
+        info.imagesChanged.push_back(changed);
+    }
+
+    //take out the old bodies that are not kept (along with anything still attached to them)
+    for (int i = 0; i < (int)m_bodies.size(); i++) {
+        if ( !oldBodyKept[i] && liveBodies.count(m_bodies[i]) ) {
+            world->DestroyBody(m_bodies[i]);
+            info.bodiesDestroyed++;
+        }
+    }
+
+    json.j2b2WorldSettings(world, scene);
+
+    //bodies in file order, so that json numbers them the same way as the file does
+    for (int i = 0; i < numNewBodies; i++) {
+        const Json::Value& bodyValue = newBodyValues[i];
+        b2dJsonBodyDef bodyDef;
+        b2dJson::j2b2BodyDef(bodyValue, bodyDef);
+        if ( newBodies[i] ) {
+            const Json::Value& oldValue = oldBodyValues[ bodySources[i] ];
+            if ( oldValue == bodyValue )
+                info.bodiesKept++;
+            else {
+                updateBody(newBodies[i], oldValue, bodyValue, bodyDef);
+                info.bodiesUpdated++;
+            }
+            json.addExistingBody(newBodies[i], bodyDef, bodyValue);
+        }
+        else {
+            newBodies[i] = json.addBody(world, bodyDef, bodyValue);
+            info.bodiesCreated++;
+        }
+    }
+
+    //joints in creation order, so gear joints can find the joints they use
+    std::vector<b2Joint*> newJoints(numNewJoints, NULL); //by file order
+    for (int k = 0; k < numNewJoints; k++) {
+        const Json::Value& jointValue = newJointValues[ order[k] ];
+        if ( keptJoints[k] ) {
+            json.addExistingJoint(keptJoints[k], jointValue);
+            newJoints[ order[k] ] = keptJoints[k];
+            info.jointsKept++;
+        }
+        else {
+            newJoints[ order[k] ] = json.addJoint(world, jointValue);
+            if ( newJoints[ order[k] ] )
+                info.jointsCreated++;
+        }
+    }
+
+    for (int i = 0; !newImageValues[i].isNull(); i++)
+        json.addImage(newImageValues[i]);
+
+    m_scene.swap(scene);
+    m_bodies.swap(newBodies);
+    m_joints.swap(newJoints);
+
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    info.milliseconds = elapsed.count();
+
+    return true;
+}
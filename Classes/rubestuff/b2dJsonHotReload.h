@@ -0,0 +1,88 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2DJSONHOTRELOAD_H
+#define B2DJSONHOTRELOAD_H
+
+#include <string>
+#include <vector>
+#include <Box2D/Box2D.h>
+#include "json/json.h"
+
+class b2dJson;
+class b2dJsonBodyDef;
+
+// What happened during a hot reload. Images are not created in the world, so
+// instead of changing them this says how each image of the new scene relates
+// to the old one, and leaves it to the caller to update its sprites to match.
+struct b2dJsonReloadInfo {
+    int bodiesKept;                         // unchanged, left exactly as they were
+    int bodiesUpdated;                      // still the same b2Body, with changed properties or fixtures
+    int bodiesCreated;
+    int bodiesDestroyed;
+    int jointsKept;
+    int jointsCreated;                      // including those remade because they changed
+    int jointsDestroyed;
+    std::vector<int> imageSources;          // for each image in the new scene, its index in the old scene or -1 if it is new
+    std::vector<bool> imagesChanged;        // for each image in the new scene, false if it is exactly as it was
+    float milliseconds;                     // time taken to parse the file and update the world
+};
+
+// Applies a re-exported RUBE scene to a world that was loaded from an earlier
+// version of it, changing only what is different, so that the game state of
+// everything else is kept. Bodies, joints and images are matched up by name,
+// and by their order among those with the same name (which is how unnamed
+// items are matched too).
+//
+// For a body that has changed, only the properties that differ are set, so eg.
+// changing the friction of a fixture does not put the body back where it was
+// in the scene. If any of its fixtures changed they are all destroyed and made
+// again. Changed joints are destroyed and made again.
+//
+// Anything else added to the world by the game is left alone, but joints to a
+// body that is no longer in the scene will be destroyed along with that body.
+//
+// b2Body::DestroyFixture does not tell the destruction listener of the world,
+// so anything keyed by fixture (eg. contact event tags) would be left holding
+// the fixtures of changed bodies after they are gone. Give the same listener
+// to setDestructionListener and it will be told about those too.
+
+class b2dJsonHotReload
+{
+protected:
+    Json::Value m_scene;                    // the scene as it was last loaded
+    std::vector<b2Body*> m_bodies;          // index in m_scene -> body in the world
+    std::vector<b2Joint*> m_joints;         // index in m_scene -> joint in the world (NULL if it could not be made)
+    b2DestructionListener* m_destructionListener; // told about fixtures destroyed by updateBody, NULL if not used
+
+    void rememberObjects(b2dJson& json);
+    void updateBody(b2Body* body, const Json::Value& oldValue, const Json::Value& newValue, const b2dJsonBodyDef& bodyDef);
+
+public:
+    b2dJsonHotReload();
+
+    void setDestructionListener(b2DestructionListener* listener) { m_destructionListener = listener; }
+
+    // Same as b2dJson::readFromMemory, but keeps the parsed scene to compare with later
+    b2World* load(const char* data, size_t length, b2dJson& json, std::string& errorMsg);
+
+    // Updates the world to match the new version of the scene. If this returns
+    // false the file could not be parsed, and nothing was changed. Otherwise json
+    // holds all the items of the new scene, as if it had just been loaded.
+    bool reload(b2World* world, const char* data, size_t length, b2dJson& json, b2dJsonReloadInfo& info, std::string& errorMsg);
+};
+
+#endif // B2DJSONHOTRELOAD_H
@@ -0,0 +1,110 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "b2dJsonThreadPool.h"
+
+// Made before main, so that getInstance needs no locking (function statics are
+// not made thread safely by every compiler this is built with)
+static b2dJsonThreadPool s_threadPool;
+
+b2dJsonThreadPool& b2dJsonThreadPool::getInstance()
+{
+    return s_threadPool;
+}
+
+b2dJsonThreadPool::b2dJsonThreadPool()
+{
+    m_func = NULL;
+    m_data = NULL;
+    m_wanted = 0;
+    m_unfinished = 0;
+    m_quit = false;
+}
+
+b2dJsonThreadPool::~b2dJsonThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_workReady.notify_all();
+    for (int i = 0; i < (int)m_threads.size(); i++)
+        m_threads[i].join();
+}
+
+int b2dJsonThreadPool::getMaxThreads()
+{
+    int numThreads = (int)std::thread::hardware_concurrency();
+    if ( numThreads < 1 )
+        return 1;
+    return numThreads < 8 ? numThreads : 8;
+}
+
+// A thread only joins in while m_wanted says more are needed, so when run asks
+// for fewer threads than there are, the others sleep through it untouched.
+void b2dJsonThreadPool::threadLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while ( true ) {
+        while ( !m_quit && m_wanted == 0 )
+            m_workReady.wait(lock);
+        if ( m_quit )
+            return;
+        m_wanted--;
+        void (*func)(void*) = m_func;
+        void* data = m_data;
+
+        lock.unlock();
+        func(data);
+        lock.lock();
+
+        if ( --m_unfinished == 0 )
+            m_workDone.notify_one();
+    }
+}
+
+void b2dJsonThreadPool::run(void (*func)(void*), void* data, int numThreads)
+{
+    std::lock_guard<std::mutex> runLock(m_runMutex);
+
+    int maxThreads = getMaxThreads();
+    if ( numThreads > maxThreads )
+        numThreads = maxThreads;
+    if ( numThreads <= 1 ) {
+        func(data);
+        return;
+    }
+
+    // the caller is one of the threads, the pool provides the rest
+    int poolThreads = numThreads - 1;
+    while ( (int)m_threads.size() < poolThreads )
+        m_threads.push_back( std::thread(&b2dJsonThreadPool::threadLoop, this) );
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_func = func;
+        m_data = data;
+        m_wanted = poolThreads;
+        m_unfinished = poolThreads;
+    }
+    m_workReady.notify_all();
+    func(data);
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while ( m_unfinished > 0 )
+            m_workDone.wait(lock);
+    }
+}
@@ -0,0 +1,63 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2DJSONTHREADPOOL_H
+#define B2DJSONTHREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// The threads that b2dJson::readFromMemoryInParallel shares its work out to.
+// There is one pool for the whole program, and its threads are started the
+// first time they are needed and then kept waiting for the next load, so
+// loading many files in parallel does not start new threads for every one.
+//
+// run() calls the same function on several threads at once, including the
+// one that called run, and returns when all of them have returned. The
+// function is expected to share out the work itself, eg. by taking the next
+// job from an atomic counter until there are none left. Loads started on
+// different threads at the same time take turns at using the pool.
+
+class b2dJsonThreadPool
+{
+protected:
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_runMutex;                  // held for the whole of run(), so only one caller uses the threads at a time
+    std::mutex m_mutex;                     // guards everything below
+    std::condition_variable m_workReady;    // wakes the threads when there is a function to call
+    std::condition_variable m_workDone;     // wakes the caller of run() when they have all finished
+    void (*m_func)(void*);
+    void* m_data;
+    int m_wanted;                           // pool threads still to join in with the current run
+    int m_unfinished;                       // pool threads that joined in and have not finished yet
+    bool m_quit;
+
+    void threadLoop();
+
+public:
+    b2dJsonThreadPool();
+    ~b2dJsonThreadPool();                   // waits for the threads to finish
+
+    static b2dJsonThreadPool& getInstance();
+
+    static int getMaxThreads();             // one per core, up to 8, counting the caller of run()
+    void run(void (*func)(void*), void* data, int numThreads);
+};
+
+#endif // B2DJSONTHREADPOOL_H
@@ -0,0 +1,552 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include <map>
+#include <iostream>
+#include <fstream>
+#include "b2dJsonTiles.h"
+#include "b2dJson.h"
+#include "b2dJsonFileView.h"
+
+using namespace std;
+
+// helper functions
+
+static string directoryOf(const string& filename)
+{
+    size_t slash = filename.find_last_of("/\\");
+    return (slash == string::npos) ? string() : filename.substr(0, slash + 1);
+}
+
+static bool writeJsonFile(const Json::Value& value, const string& filename, string& errorMsg)
+{
+    std::ofstream ofs;
+    ofs.open(filename.c_str(), std::ios::out);
+    if (!ofs) {
+        errorMsg = string("Could not open file '") + filename + string("' for writing");
+        return false;
+    }
+
+    Json::StyledStreamWriter writer("   ");
+    writer.write( ofs, value );
+    ofs.close();
+    return true;
+}
+
+static Json::Value aabbToJson(const b2AABB& aabb)
+{
+    Json::Value aabbValue;
+    aabbValue["lowerBound"]["x"] = aabb.lowerBound.x;
+    aabbValue["lowerBound"]["y"] = aabb.lowerBound.y;
+    aabbValue["upperBound"]["x"] = aabb.upperBound.x;
+    aabbValue["upperBound"]["y"] = aabb.upperBound.y;
+    return aabbValue;
+}
+
+static b2AABB jsonToAABB(const Json::Value& aabbValue)
+{
+    b2AABB aabb;
+    aabb.lowerBound.Set( aabbValue["lowerBound"]["x"].asFloat(), aabbValue["lowerBound"]["y"].asFloat() );
+    aabb.upperBound.Set( aabbValue["upperBound"]["x"].asFloat(), aabbValue["upperBound"]["y"].asFloat() );
+    return aabb;
+}
+
+
+
+
+//////// splitting a scene into tiles
+
+struct _tileBuilder {
+    int x;
+    int y;
+    b2AABB aabb;
+    Json::Value value;
+};
+
+// Bodies go into the tile containing their origin, and the tile's extent grows
+// to cover all of their fixtures, so a long piece of terrain is loaded as soon
+// as any part of it comes into view. Joints between two bodies in the same tile
+// go in that tile, other joints are kept in the index with the tile of each body.
+// Gear joints must have everything they use in one tile, nothing is written
+// if any of them don't.
+bool b2dJsonTiles::splitWorld(const Json::Value& worldValue, float tileSize, const string& basename, string& errorMsg)
+{
+    if ( tileSize <= 0 ) {
+        errorMsg = "Tile size must be greater than zero";
+        return false;
+    }
+
+    std::vector<_tileBuilder*> tiles;
+    std::map< std::pair<int,int>, int > tileLookup;
+
+    const Json::Value& bodyValues = worldValue["body"];
+    int numBodies = bodyValues.size();
+    std::vector<int> bodyTile(numBodies);
+    std::vector<int> bodyIndexInTile(numBodies);
+    for (int i = 0; i < numBodies; i++) {
+        const Json::Value& bodyValue = bodyValues[i];
+        b2dJsonBodyDef bodyDef;
+        b2dJson::j2b2BodyDef(bodyValue, bodyDef);
+
+        b2Transform xf(bodyDef.bodyDef.position, b2Rot(bodyDef.bodyDef.angle));
+        b2AABB bodyAABB;
+        bodyAABB.lowerBound = bodyAABB.upperBound = xf.p;
+        for (int f = 0; f < (int)bodyDef.fixtures.size(); f++) {
+            const b2Shape* shape = bodyDef.fixtures[f]->fixtureDef.shape;
+            if ( !shape )
+                continue;
+            for (int child = 0; child < shape->GetChildCount(); child++) {
+                b2AABB childAABB;
+                shape->ComputeAABB(&childAABB, xf, child);
+                bodyAABB.Combine(childAABB);
+            }
+        }
+
+        std::pair<int,int> tileCoords( (int)floorf(xf.p.x / tileSize), (int)floorf(xf.p.y / tileSize) );
+        std::map< std::pair<int,int>, int >::iterator it = tileLookup.find(tileCoords);
+        int tileIndex;
+        if ( it == tileLookup.end() ) {
+            tileIndex = (int)tiles.size();
+            tileLookup[tileCoords] = tileIndex;
+            _tileBuilder* tile = new _tileBuilder;
+            tile->x = tileCoords.first;
+            tile->y = tileCoords.second;
+            tile->aabb = bodyAABB;
+            tiles.push_back(tile);
+        }
+        else {
+            tileIndex = it->second;
+            tiles[tileIndex]->aabb.Combine(bodyAABB);
+        }
+
+        bodyTile[i] = tileIndex;
+        bodyIndexInTile[i] = tiles[tileIndex]->value["body"].size();
+        tiles[tileIndex]->value["body"].append(bodyValue);
+    }
+
+    //gear joints refer to other joints by the order they are created in, which
+    //is all the other joints first and then the gear joints (see j2b2World)
+    const Json::Value& jointValues = worldValue["joint"];
+    int numJoints = jointValues.size();
+    std::vector<int> creationOrder;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < numJoints; i++) {
+            bool isGear = jointValues[i]["type"].asString() == "gear";
+            if ( isGear == (pass == 1) )
+                creationOrder.push_back(i);
+        }
+    }
+
+    Json::Value crossTileJointValues(Json::arrayValue);
+    std::vector<int> jointTile(numJoints, -1);          //by creation order
+    std::vector<int> jointIndexInTile(numJoints, -1);   //by creation order
+    for (int k = 0; k < numJoints; k++) {
+        const Json::Value& jointValue = jointValues[ creationOrder[k] ];
+        int bodyA = jointValue["bodyA"].asInt();
+        int bodyB = jointValue["bodyB"].asInt();
+        if ( bodyA < 0 || bodyA >= numBodies || bodyB < 0 || bodyB >= numBodies ) {
+            std::cout << "Leaving out joint " << creationOrder[k] << ", it refers to a body that does not exist\n";
+            continue;
+        }
+
+        Json::Value tileJointValue = jointValue;
+        tileJointValue["bodyA"] = bodyIndexInTile[bodyA];
+        tileJointValue["bodyB"] = bodyIndexInTile[bodyB];
+        int tileIndex = bodyTile[bodyA];
+
+        if ( jointValue["type"].asString() == "gear" ) {
+            int joint1 = jointValue["joint1"].asInt();
+            int joint2 = jointValue["joint2"].asInt();
+            if ( bodyTile[bodyB] != tileIndex ||
+                 joint1 < 0 || joint1 >= numJoints || jointTile[joint1] != tileIndex ||
+                 joint2 < 0 || joint2 >= numJoints || jointTile[joint2] != tileIndex ) {
+                char msg[128];
+                sprintf(msg, "Gear joint %d uses bodies or joints in more than one tile, try a bigger tile size", creationOrder[k]);
+                errorMsg = msg;
+                for (int i = 0; i < (int)tiles.size(); i++)
+                    delete tiles[i];
+                return false;
+            }
+            tileJointValue["joint1"] = jointIndexInTile[joint1];
+            tileJointValue["joint2"] = jointIndexInTile[joint2];
+        }
+
+        if ( bodyTile[bodyB] == tileIndex ) {
+            jointTile[k] = tileIndex;
+            jointIndexInTile[k] = tiles[tileIndex]->value["joint"].size();
+            tiles[tileIndex]->value["joint"].append(tileJointValue);
+        }
+        else {
+            tileJointValue["tileA"] = tileIndex;
+            tileJointValue["tileB"] = bodyTile[bodyB];
+            crossTileJointValues.append(tileJointValue);
+        }
+    }
+
+    //the base file keeps the world settings and any images not on a body
+    Json::Value baseValue = worldValue;
+    baseValue.removeMember("body");
+    baseValue.removeMember("joint");
+    baseValue.removeMember("image");
+
+    const Json::Value& imageValues = worldValue["image"];
+    for (int i = 0; !imageValues[i].isNull(); i++) {
+        const Json::Value& imageValue = imageValues[i];
+        int body = imageValue.get("body", -1).asInt();
+        if ( body >= 0 && body < numBodies ) {
+            Json::Value tileImageValue = imageValue;
+            tileImageValue["body"] = bodyIndexInTile[body];
+            tiles[ bodyTile[body] ]->value["image"].append(tileImageValue);
+        }
+        else
+            baseValue["image"].append(imageValue);
+    }
+
+    string directory = directoryOf(basename);
+    string name = basename.substr(directory.length());
+
+    bool ok = writeJsonFile(baseValue, basename + ".json", errorMsg);
+
+    Json::Value indexValue;
+    indexValue["tileSize"] = tileSize;
+    for (int i = 0; i < (int)tiles.size() && ok; i++) {
+        char suffix[64];
+        sprintf(suffix, ".tile_%d_%d.json", tiles[i]->x, tiles[i]->y);
+        string tileFilename = name + suffix;
+
+        Json::Value& tileIndexValue = indexValue["tile"][i];
+        tileIndexValue["file"] = tileFilename;
+        tileIndexValue["x"] = tiles[i]->x;
+        tileIndexValue["y"] = tiles[i]->y;
+        tileIndexValue["aabb"] = aabbToJson(tiles[i]->aabb);
+
+        ok = writeJsonFile(tiles[i]->value, directory + tileFilename, errorMsg);
+    }
+    indexValue["crossTileJoint"] = crossTileJointValues;
+
+    if ( ok )
+        ok = writeJsonFile(indexValue, basename + ".tiles.json", errorMsg);
+
+    for (int i = 0; i < (int)tiles.size(); i++)
+        delete tiles[i];
+
+    return ok;
+}
+
+
+
+
+//////// streaming tiles in and out of a world
+
+b2dJsonTileStreamer::b2dJsonTileStreamer(b2World* world)
+{
+    m_world = world;
+    m_listener = NULL;
+    m_loadMargin = 10;
+    m_unloadMargin = 20;
+    m_bodiesPerUpdate = 50;
+    m_stopLoader = false;
+}
+
+b2dJsonTileStreamer::~b2dJsonTileStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopLoader = true;
+    }
+    m_condition.notify_all();
+    if ( m_loaderThread.joinable() )
+        m_loaderThread.join();
+
+    for (int i = 0; i < (int)m_tiles.size(); i++) {
+        discardLoadedData(m_tiles[i]);
+        delete m_tiles[i].json;
+    }
+}
+
+bool b2dJsonTileStreamer::open(const string& indexFilename, string& errorMsg)
+{
+    if ( m_loaderThread.joinable() ) {
+        errorMsg = "Tile streamer is already open";
+        return false;
+    }
+
+    b2dJsonFileView file;
+    if ( !file.open(indexFilename, errorMsg) )
+        return false;
+
+    Json::Value indexValue;
+    Json::Reader reader;
+    if ( ! reader.parse(file.data(), file.data() + file.size(), indexValue, false) ) {
+        errorMsg = string("Failed to parse '") + indexFilename + string("' : ") + reader.getFormatedErrorMessages();
+        return false;
+    }
+
+    m_directory = directoryOf(indexFilename);
+
+    const Json::Value& tileValues = indexValue["tile"];
+    m_tiles.resize(tileValues.size());
+    for (int i = 0; i < (int)m_tiles.size(); i++) {
+        _tileInfo& tile = m_tiles[i];
+        tile.filename = m_directory + tileValues[i]["file"].asString();
+        tile.aabb = jsonToAABB(tileValues[i]["aabb"]);
+        tile.state = TS_UNLOADED;
+        tile.wanted = false;
+        tile.json = NULL;
+    }
+
+    const Json::Value& crossTileJointValues = indexValue["crossTileJoint"];
+    for (int i = 0; !crossTileJointValues[i].isNull(); i++) {
+        _crossTileJoint crossTileJoint;
+        crossTileJoint.tileA = crossTileJointValues[i]["tileA"].asInt();
+        crossTileJoint.tileB = crossTileJointValues[i]["tileB"].asInt();
+        crossTileJoint.value = crossTileJointValues[i];
+        crossTileJoint.created = false;
+        if ( crossTileJoint.tileA < 0 || crossTileJoint.tileA >= (int)m_tiles.size() ||
+             crossTileJoint.tileB < 0 || crossTileJoint.tileB >= (int)m_tiles.size() )
+            continue;
+        m_crossTileJoints.push_back(crossTileJoint);
+    }
+
+    m_loaderThread = std::thread(&b2dJsonTileStreamer::loaderThreadMain, this);
+
+    return true;
+}
+
+void b2dJsonTileStreamer::loaderThreadMain()
+{
+    while ( true ) {
+        int tileIndex;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while ( !m_stopLoader && m_loadQueue.empty() )
+                m_condition.wait(lock);
+            if ( m_stopLoader )
+                return;
+            tileIndex = m_loadQueue.front();
+            m_loadQueue.pop_front();
+        }
+
+        loadTile(m_tiles[tileIndex]);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_loadedQueue.push_back(tileIndex);
+    }
+}
+
+// Runs on the loader thread. Only touches the parts of the tile that the main
+// thread leaves alone until the tile has been handed back.
+void b2dJsonTileStreamer::loadTile(_tileInfo& tile)
+{
+    b2dJsonFileView file;
+    if ( !file.open(tile.filename, tile.error) )
+        return;
+
+    Json::Reader reader;
+    if ( ! reader.parse(file.data(), file.data() + file.size(), tile.value, false) ) {
+        tile.error = string("Failed to parse '") + tile.filename + string("' : ") + reader.getFormatedErrorMessages();
+        return;
+    }
+
+    const Json::Value& bodyValues = tile.value["body"];
+    for (int i = 0; !bodyValues[i].isNull(); i++) {
+        b2dJsonBodyDef* bodyDef = new b2dJsonBodyDef;
+        b2dJson::j2b2BodyDef(bodyValues[i], *bodyDef);
+        tile.bodyDefs.push_back(bodyDef);
+    }
+}
+
+void b2dJsonTileStreamer::discardLoadedData(_tileInfo& tile)
+{
+    for (int i = 0; i < (int)tile.bodyDefs.size(); i++)
+        delete tile.bodyDefs[i];
+    tile.bodyDefs.clear();
+    tile.value = Json::Value();
+    tile.error.clear();
+}
+
+void b2dJsonTileStreamer::unloadTile(int tileIndex)
+{
+    _tileInfo& tile = m_tiles[tileIndex];
+
+    if ( m_listener && tile.state == TS_LIVE )
+        m_listener->tileRemoving(tileIndex, tile.bodies);
+
+    //these go when the bodies are destroyed
+    for (int i = 0; i < (int)m_crossTileJoints.size(); i++) {
+        _crossTileJoint& crossTileJoint = m_crossTileJoints[i];
+        if ( crossTileJoint.tileA == tileIndex || crossTileJoint.tileB == tileIndex )
+            crossTileJoint.created = false;
+    }
+
+    for (int i = 0; i < (int)tile.bodies.size(); i++)
+        m_world->DestroyBody(tile.bodies[i]);
+    tile.bodies.clear();
+
+    delete tile.json;
+    tile.json = NULL;
+    discardLoadedData(tile);
+    tile.state = TS_UNLOADED;
+}
+
+void b2dJsonTileStreamer::createCrossTileJoints(int tileIndex)
+{
+    for (int i = 0; i < (int)m_crossTileJoints.size(); i++) {
+        _crossTileJoint& crossTileJoint = m_crossTileJoints[i];
+        if ( crossTileJoint.created )
+            continue;
+        if ( crossTileJoint.tileA != tileIndex && crossTileJoint.tileB != tileIndex )
+            continue;
+
+        _tileInfo& tileA = m_tiles[crossTileJoint.tileA];
+        _tileInfo& tileB = m_tiles[crossTileJoint.tileB];
+        if ( tileA.state != TS_LIVE || tileB.state != TS_LIVE )
+            continue;
+
+        int bodyA = crossTileJoint.value["bodyA"].asInt();
+        int bodyB = crossTileJoint.value["bodyB"].asInt();
+        if ( bodyA < 0 || bodyA >= (int)tileA.bodies.size() || bodyB < 0 || bodyB >= (int)tileB.bodies.size() )
+            continue;
+
+        //a b2dJson that knows only these two bodies, as body 0 and body 1
+        b2dJson json;
+        json.addExistingBody(tileA.bodies[bodyA]);
+        json.addExistingBody(tileB.bodies[bodyB]);
+
+        Json::Value jointValue = crossTileJoint.value;
+        jointValue["bodyA"] = 0;
+        jointValue["bodyB"] = 1;
+        json.addJoint(m_world, jointValue);
+
+        crossTileJoint.created = true;
+    }
+}
+
+int b2dJsonTileStreamer::update(const b2AABB& visibleRegion)
+{
+    b2AABB loadRegion;
+    loadRegion.lowerBound = visibleRegion.lowerBound - b2Vec2(m_loadMargin, m_loadMargin);
+    loadRegion.upperBound = visibleRegion.upperBound + b2Vec2(m_loadMargin, m_loadMargin);
+    b2AABB unloadRegion;
+    unloadRegion.lowerBound = visibleRegion.lowerBound - b2Vec2(m_unloadMargin, m_unloadMargin);
+    unloadRegion.upperBound = visibleRegion.upperBound + b2Vec2(m_unloadMargin, m_unloadMargin);
+
+    //between the two margins tiles stay as they are, so moving back and forth
+    //over a tile edge doesn't keep loading and unloading it
+    int numUnloaded = 0;
+    std::vector<int> tilesToQueue;
+    for (int i = 0; i < (int)m_tiles.size(); i++) {
+        _tileInfo& tile = m_tiles[i];
+        if ( b2TestOverlap(tile.aabb, loadRegion) ) {
+            tile.wanted = true;
+            if ( tile.state == TS_UNLOADED ) {
+                tile.state = TS_QUEUED;
+                tilesToQueue.push_back(i);
+            }
+        }
+        else if ( !b2TestOverlap(tile.aabb, unloadRegion) ) {
+            tile.wanted = false;
+            if ( tile.state == TS_DECODED || tile.state == TS_LIVE ) {
+                unloadTile(i);
+                numUnloaded++;
+            }
+        }
+    }
+
+    std::vector<int> loadedTiles;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (int i = 0; i < (int)tilesToQueue.size(); i++)
+            m_loadQueue.push_back(tilesToQueue[i]);
+        loadedTiles.swap(m_loadedQueue);
+    }
+    if ( !tilesToQueue.empty() )
+        m_condition.notify_one();
+
+    for (int i = 0; i < (int)loadedTiles.size(); i++) {
+        _tileInfo& tile = m_tiles[ loadedTiles[i] ];
+        if ( tile.error != "" ) {
+            std::cout << tile.error << std::endl;
+            discardLoadedData(tile);
+            tile.state = TS_FAILED;
+        }
+        else if ( !tile.wanted ) {
+            discardLoadedData(tile);
+            tile.state = TS_UNLOADED;
+        }
+        else {
+            tile.state = TS_DECODED;
+            tile.json = new b2dJson();
+            m_tilesToCreate.push_back( loadedTiles[i] );
+        }
+    }
+
+    //create bodies up to the budget, carrying on with the same tile next time
+    int budget = m_bodiesPerUpdate;
+    while ( budget > 0 && !m_tilesToCreate.empty() ) {
+        int tileIndex = m_tilesToCreate.front();
+        _tileInfo& tile = m_tiles[tileIndex];
+        if ( tile.state != TS_DECODED ) {
+            //unloaded again before it was finished
+            m_tilesToCreate.pop_front();
+            continue;
+        }
+
+        const Json::Value& bodyValues = tile.value["body"];
+        while ( budget > 0 && tile.bodies.size() < tile.bodyDefs.size() ) {
+            int i = (int)tile.bodies.size();
+            tile.bodies.push_back( tile.json->addBody(m_world, *tile.bodyDefs[i], bodyValues[i]) );
+            budget--;
+        }
+        if ( tile.bodies.size() < tile.bodyDefs.size() )
+            break;
+
+        tile.json->addJoints(m_world, tile.value["joint"]);
+        const Json::Value& imageValues = tile.value["image"];
+        for (int i = 0; !imageValues[i].isNull(); i++)
+            tile.json->addImage(imageValues[i]);
+        discardLoadedData(tile);
+        tile.state = TS_LIVE;
+        m_tilesToCreate.pop_front();
+
+        createCrossTileJoints(tileIndex);
+        if ( m_listener )
+            m_listener->tileCreated(tileIndex, tile.json);
+    }
+
+    return numUnloaded;
+}
+
+void b2dJsonTileStreamer::unloadAll()
+{
+    for (int i = 0; i < (int)m_tiles.size(); i++) {
+        m_tiles[i].wanted = false;
+        if ( m_tiles[i].state == TS_DECODED || m_tiles[i].state == TS_LIVE )
+            unloadTile(i);
+    }
+}
+
+int b2dJsonTileStreamer::getNumLiveTiles()
+{
+    int count = 0;
+    for (int i = 0; i < (int)m_tiles.size(); i++) {
+        if ( m_tiles[i].state == TS_LIVE )
+            count++;
+    }
+    return count;
+}
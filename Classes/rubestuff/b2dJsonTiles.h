@@ -0,0 +1,145 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2DJSONTILES_H
+#define B2DJSONTILES_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <Box2D/Box2D.h>
+#include "json/json.h"
+
+class b2dJson;
+class b2dJsonBodyDef;
+
+// Support for levels that are too big to load all at once. A RUBE scene is
+// split up ahead of time into square tiles by splitWorld, which writes:
+//
+//   name.json             the world settings and anything not on a body, loaded as normal
+//   name.tile_X_Y.json    one ordinary RUBE scene per tile, holding the bodies whose
+//                         origin is inside that tile, and the joints between them
+//   name.tiles.json       the index: the extent of each tile, and the joints that
+//                         connect bodies in two different tiles
+//
+// At runtime a b2dJsonTileStreamer adds the tiles around the visible region to
+// the world, and takes them out again when the view has moved far enough away.
+// Files are read and decoded on a background thread, and only a limited number
+// of bodies is created in the world per update so there are no big hitches.
+//
+// Images on bodies go into the tile of the body. They are read into the b2dJson
+// of the tile when it goes live, and a b2dJsonTileListener is told about it, to
+// make sprites for them. The listener is also told before the bodies of a tile
+// are destroyed, so the sprites can be taken away again.
+//
+// Gear joints whose bodies and joints are not all in the same tile can't be
+// streamed, and splitWorld fails with an error if there are any.
+//
+// splitWorld can be run on a scene with the rubesplit command line tool
+// (tools/rubesplit).
+
+class b2dJsonTileListener
+{
+public:
+    virtual ~b2dJsonTileListener() {}
+    virtual void tileCreated(int tileIndex, b2dJson* json) {}                           // the bodies, joints and images of the tile are all in the json
+    virtual void tileRemoving(int tileIndex, const std::vector<b2Body*>& bodies) {}     // the bodies are destroyed right after this
+};
+
+class b2dJsonTiles
+{
+public:
+    static bool splitWorld(const Json::Value& worldValue, float tileSize, const std::string& basename, std::string& errorMsg);
+};
+
+class b2dJsonTileStreamer
+{
+protected:
+    enum _tileState {
+        TS_UNLOADED,
+        TS_QUEUED,      // waiting for or being read by the loader thread
+        TS_DECODED,     // read and decoded, bodies are being created
+        TS_LIVE,        // everything is in the world
+        TS_FAILED       // could not be read, will not be tried again
+    };
+
+    struct _tileInfo {
+        std::string filename;
+        b2AABB aabb;                            // extent of the fixtures in this tile
+        int state;
+        bool wanted;                            // false if it should be thrown away once loaded
+
+        // written by the loader thread, only read after it has handed the tile back
+        Json::Value value;
+        std::vector<b2dJsonBodyDef*> bodyDefs;
+        std::string error;
+
+        b2dJson* json;                          // names and custom properties of the things in this tile
+        std::vector<b2Body*> bodies;            // bodies created so far, in file order
+    };
+
+    struct _crossTileJoint {
+        int tileA;
+        int tileB;
+        Json::Value value;                      // with bodyA/bodyB as indexes into the bodies of each tile
+        bool created;                           // Box2D destroys it along with either body, no need to keep a pointer
+    };
+
+    b2World* m_world;
+    b2dJsonTileListener* m_listener;
+    std::string m_directory;                    // the tile files are found relative to the index file
+    std::vector<_tileInfo> m_tiles;
+    std::vector<_crossTileJoint> m_crossTileJoints;
+    std::deque<int> m_tilesToCreate;            // decoded tiles, in the order they came back
+    float m_loadMargin;
+    float m_unloadMargin;
+    int m_bodiesPerUpdate;
+
+    std::thread m_loaderThread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<int> m_loadQueue;                // guarded by m_mutex
+    std::vector<int> m_loadedQueue;             // guarded by m_mutex
+    bool m_stopLoader;                          // guarded by m_mutex
+
+    void loaderThreadMain();
+    void loadTile(_tileInfo& tile);
+    void discardLoadedData(_tileInfo& tile);
+    void unloadTile(int tileIndex);
+    void createCrossTileJoints(int tileIndex);
+
+public:
+    b2dJsonTileStreamer(b2World* world);
+    virtual ~b2dJsonTileStreamer();            // stops the loader thread, but leaves any bodies in the world
+
+    bool open(const std::string& indexFilename, std::string& errorMsg);
+    void setListener(b2dJsonTileListener* listener) { m_listener = listener; }
+
+    // Call each frame, outside of the world step. Tiles overlapping the region
+    // (grown by the load margin) are loaded, tiles further away than the unload
+    // margin are removed. Returns the number of tiles removed from the world.
+    int update(const b2AABB& visibleRegion);
+    void unloadAll();
+
+    void setMargins(float loadMargin, float unloadMargin) { m_loadMargin = loadMargin; m_unloadMargin = unloadMargin; }
+    void setBodiesPerUpdate(int n) { m_bodiesPerUpdate = n; }
+    int getNumLiveTiles();
+};
+
+#endif // B2DJSONTILES_H
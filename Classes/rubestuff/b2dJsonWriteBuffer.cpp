@@ -0,0 +1,352 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "b2dJsonWriteBuffer.h"
+
+static const char* s_indentSpaces = "                                                                                                ";
+
+b2dJsonWriteBuffer::b2dJsonWriteBuffer(size_t initialCapacity)
+{
+    m_buffer.reserve(initialCapacity);
+    m_depth = 0;
+    m_pendingComment = NULL;
+}
+
+void b2dJsonWriteBuffer::newLine()
+{
+    m_buffer += '\n';
+    int indent = 3 * m_depth;
+    while ( indent > 0 ) {
+        int n = indent < 96 ? indent : 96;
+        m_buffer.append(s_indentSpaces, n);
+        indent -= n;
+    }
+}
+
+void b2dJsonWriteBuffer::flushComment()
+{
+    if ( m_pendingComment ) {
+        m_buffer += ' ';
+        m_buffer += m_pendingComment;
+        m_pendingComment = NULL;
+    }
+}
+
+// Writes whatever separator is needed before the next item of an array. Inside
+// an object this has already been done by key(), and at the top level there is
+// only one value anyway.
+void b2dJsonWriteBuffer::beforeValue()
+{
+    if ( m_depth == 0 || !m_isArray[m_depth-1] )
+        return;
+
+    int d = m_depth - 1;
+    if ( m_multiLine[d] ) {
+        if ( !m_empty[d] )
+            m_buffer += ',';
+        flushComment();
+        newLine();
+    }
+    else
+        m_buffer += m_empty[d] ? " " : ", ";
+    m_empty[d] = false;
+}
+
+void b2dJsonWriteBuffer::beginObject()
+{
+    beforeValue();
+    m_buffer += '{';
+    m_isArray[m_depth] = false;
+    m_multiLine[m_depth] = true;
+    m_empty[m_depth] = true;
+    m_depth++;
+}
+
+void b2dJsonWriteBuffer::endObject()
+{
+    flushComment();
+    m_depth--;
+    if ( !m_empty[m_depth] )
+        newLine();
+    m_buffer += '}';
+}
+
+void b2dJsonWriteBuffer::beginArray(bool multiLine)
+{
+    beforeValue();
+    m_buffer += '[';
+    m_isArray[m_depth] = true;
+    m_multiLine[m_depth] = multiLine;
+    m_empty[m_depth] = true;
+    m_depth++;
+}
+
+void b2dJsonWriteBuffer::endArray()
+{
+    m_depth--;
+    if ( m_multiLine[m_depth] ) {
+        flushComment();
+        if ( !m_empty[m_depth] )
+            newLine();
+    }
+    else if ( !m_empty[m_depth] )
+        m_buffer += ' ';
+    m_buffer += ']';
+}
+
+void b2dJsonWriteBuffer::key(const char* name)
+{
+    int d = m_depth - 1;
+    if ( !m_empty[d] )
+        m_buffer += ',';
+    flushComment();
+    newLine();
+    m_empty[d] = false;
+
+    appendQuoted(name, strlen(name));
+    m_buffer.append(" : ", 3);
+}
+
+void b2dJsonWriteBuffer::intValue(int v)
+{
+    beforeValue();
+
+    char buf[16];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+    unsigned int u = v < 0 ? 0u - (unsigned int)v : (unsigned int)v;
+    do {
+        *--p = (char)('0' + u % 10);
+        u /= 10;
+    } while ( u );
+    if ( v < 0 )
+        *--p = '-';
+    m_buffer.append(p, end - p);
+}
+
+void b2dJsonWriteBuffer::boolValue(bool v)
+{
+    beforeValue();
+    if ( v )
+        m_buffer.append("true", 4);
+    else
+        m_buffer.append("false", 5);
+}
+
+void b2dJsonWriteBuffer::stringValue(const std::string& str)
+{
+    beforeValue();
+    appendQuoted(str.c_str(), str.length());
+}
+
+void b2dJsonWriteBuffer::hexFloatValue(float f)
+{
+    beforeValue();
+    char buf[10];
+    buf[0] = '"';
+    floatToHex(f, buf + 1);
+    buf[9] = '"';
+    m_buffer.append(buf, 10);
+}
+
+void b2dJsonWriteBuffer::decimalFloatValue(float f)
+{
+    beforeValue();
+    char buf[32];
+    int length = floatToDecimal(f, buf);
+    m_buffer.append(buf, length);
+}
+
+// The comment goes after the current value, on the same line. It is written
+// once the next comma (if any) is known, so the output reads "value, //comment"
+// as it did with StyledWriter.
+void b2dJsonWriteBuffer::commentOnSameLine(const char* comment)
+{
+    m_pendingComment = comment;
+}
+
+// Same escaping as jsoncpp's valueToQuotedString, but most names need none of
+// it so they are copied across in one go.
+void b2dJsonWriteBuffer::appendQuoted(const char* str, size_t length)
+{
+    m_buffer += '"';
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)str[i];
+        if ( c >= 0x20 && c != '"' && c != '\\' )
+            continue;
+
+        m_buffer.append(str + start, i - start);
+        start = i + 1;
+        switch ( c ) {
+        case '"':  m_buffer.append("\\\"", 2); break;
+        case '\\': m_buffer.append("\\\\", 2); break;
+        case '\b': m_buffer.append("\\b", 2); break;
+        case '\f': m_buffer.append("\\f", 2); break;
+        case '\n': m_buffer.append("\\n", 2); break;
+        case '\r': m_buffer.append("\\r", 2); break;
+        case '\t': m_buffer.append("\\t", 2); break;
+        default:
+            {
+                char buf[8];
+                sprintf(buf, "\\u%04X", c);
+                m_buffer.append(buf, 6);
+            }
+        }
+    }
+    m_buffer.append(str + start, length - start);
+    m_buffer += '"';
+}
+
+// Writes the 8 upper case hex characters of the float's bit pattern, exactly as
+// sprintf("%08X") did. Each nibble is first spread out into its own byte of a
+// 64 bit word, then all eight are turned into characters at once: adding 6
+// carries into bit 4 for exactly the nibbles above 9, and those get the extra
+// 7 that takes them from ':' up to 'A'. No branches and no table lookups.
+void b2dJsonWriteBuffer::floatToHex(float f, char* buf)
+{
+    unsigned int bits;
+    memcpy(&bits, &f, sizeof(bits));
+
+    unsigned long long v = bits;
+    v = ((v & 0xFFFF0000ULL) << 16) | (v & 0x0000FFFFULL);
+    v = ((v & 0x0000FF000000FF00ULL) << 8) | (v & 0x000000FF000000FFULL);
+    v = ((v & 0x00F000F000F000F0ULL) << 4) | (v & 0x000F000F000F000FULL);
+
+    unsigned long long above9 = ((v + 0x0606060606060606ULL) >> 4) & 0x0101010101010101ULL;
+    v += 0x3030303030303030ULL + above9 * 7;
+
+    //most significant nibble first
+    for (int i = 0; i < 8; i++)
+        buf[i] = (char)(v >> (56 - 8 * i));
+}
+
+static const double s_powersOf10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Whether digits * 10^exponent reads back as f. Both operands are exact doubles
+// in this range, so the one multiply or divide is correctly rounded - the same
+// double that strtod would give for the text - and then cast down to a float
+// the way jsonToFloat does it.
+static inline bool decimalReadsBackAs(unsigned int digits, int exponent, float f)
+{
+    if ( exponent >= 0 && exponent <= 22 )
+        return (float)(digits * s_powersOf10[exponent]) == f;
+    if ( exponent < 0 && exponent >= -22 )
+        return (float)(digits / s_powersOf10[-exponent]) == f;
+
+    char buf[32];
+    sprintf(buf, "%ue%d", digits, exponent);
+    return (float)strtod(buf, NULL) == f;
+}
+
+// Writes the shortest decimal that reads back as the same float, and returns its
+// length. Nine significant digits are always enough for a float, so these are
+// generated once and then cut down to 1, 2, 3... digits until one of them reads
+// back correctly. Numbers with a decimal exponent from -5 to 9 are written out
+// in full, others as eg. "1.5e-07".
+int b2dJsonWriteBuffer::floatToDecimal(float f, char* buf)
+{
+    if ( f != f || f - f != 0 )
+        return sprintf(buf, "%g", (double)f); //nan and inf are not valid JSON anyway
+
+    //"d.dddddddde+x", after the sign
+    char sci[32];
+    sprintf(sci, "%.8e", fabs((double)f));
+    unsigned int nineDigits = sci[0] - '0';
+    for (int i = 2; i < 10; i++)
+        nineDigits = nineDigits * 10 + (sci[i] - '0');
+    int exponent = atoi(sci + 11);
+
+    float absf = fabs(f);
+    if ( absf == 0 ) {
+        buf[0] = '0';
+        buf[1] = 0;
+        return 1;
+    }
+
+    unsigned int digits = nineDigits;
+    int numDigits = 9;
+    for (int n = 1; n < 9 && numDigits == 9; n++) {
+        //the nearest n digit value first, then the one on the other side of f
+        unsigned int divisor = (unsigned int)s_powersOf10[9 - n];
+        unsigned int truncated = nineDigits / divisor;
+        bool roundUp = nineDigits % divisor >= divisor / 2;
+        for (int attempt = 0; attempt < 2; attempt++) {
+            unsigned int candidate = truncated + ((roundUp != (attempt == 1)) ? 1 : 0);
+            int candidateExponent = exponent;
+            if ( candidate == (unsigned int)s_powersOf10[n] ) { //rounded up to an extra digit, eg. 9.99 -> 10.0
+                candidate /= 10;
+                candidateExponent++;
+            }
+            if ( candidate > 0 && decimalReadsBackAs(candidate, candidateExponent - (n - 1), absf) ) {
+                digits = candidate;
+                numDigits = n;
+                exponent = candidateExponent;
+                break;
+            }
+        }
+    }
+
+    //trailing zeros can only come from the full nine digits
+    while ( numDigits > 1 && digits % 10 == 0 ) {
+        digits /= 10;
+        numDigits--;
+    }
+
+    char digitChars[16];
+    for (int i = numDigits - 1; i >= 0; i--) {
+        digitChars[i] = (char)('0' + digits % 10);
+        digits /= 10;
+    }
+
+    char* p = buf;
+    if ( f < 0 )
+        *p++ = '-';
+
+    if ( exponent < -5 || exponent > 9 ) {
+        *p++ = digitChars[0];
+        if ( numDigits > 1 ) {
+            *p++ = '.';
+            memcpy(p, digitChars + 1, numDigits - 1);
+            p += numDigits - 1;
+        }
+        p += sprintf(p, "e%+03d", exponent);
+    }
+    else if ( exponent < 0 ) {
+        *p++ = '0';
+        *p++ = '.';
+        for (int i = -1; i > exponent; i--)
+            *p++ = '0';
+        memcpy(p, digitChars, numDigits);
+        p += numDigits;
+    }
+    else {
+        for (int i = 0; i < numDigits || i <= exponent; i++) {
+            if ( i == exponent + 1 )
+                *p++ = '.';
+            *p++ = i < numDigits ? digitChars[i] : '0';
+        }
+    }
+    *p = 0;
+    return (int)(p - buf);
+}
@@ -0,0 +1,71 @@
+/*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B2DJSONWRITEBUFFER_H
+#define B2DJSONWRITEBUFFER_H
+
+#include <string>
+
+// A growable text buffer that JSON is written into directly, one token at a
+// time, so that b2dJson can save a world without building a Json::Value tree
+// first. The layout follows Json::StyledWriter closely (three space indent,
+// arrays of plain values on one line) so files written either way look alike.
+// There is no validation - the caller is expected to open and close things in
+// the right order, and to call key() before each value inside an object.
+
+class b2dJsonWriteBuffer
+{
+protected:
+    enum { MAX_DEPTH = 32 };
+
+    std::string m_buffer;
+    int m_depth;                        // number of currently open objects/arrays
+    bool m_isArray[MAX_DEPTH];          // whether each open container is an array
+    bool m_multiLine[MAX_DEPTH];        // whether each open container puts one item per line
+    bool m_empty[MAX_DEPTH];            // whether each open container has had nothing written to it yet
+    const char* m_pendingComment;       // written after the comma that follows the current value
+
+    void beforeValue();
+    void flushComment();
+    void newLine();
+    void appendQuoted(const char* str, size_t length);
+
+public:
+    b2dJsonWriteBuffer(size_t initialCapacity = 64 * 1024);
+
+    void beginObject();
+    void endObject();
+    void beginArray(bool multiLine = false);
+    void endArray();
+
+    void key(const char* name);
+
+    void intValue(int v);
+    void boolValue(bool v);
+    void stringValue(const std::string& str);
+    void hexFloatValue(float f);
+    void decimalFloatValue(float f);
+    void commentOnSameLine(const char* comment);
+
+    std::string& str() { return m_buffer; }
+    const std::string& str() const { return m_buffer; }
+
+    //static helpers
+    static void floatToHex(float f, char* buf);
+    static int floatToDecimal(float f, char* buf);
+};
+
+#endif // B2DJSONWRITEBUFFER_H
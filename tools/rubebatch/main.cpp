@@ -0,0 +1,212 @@
+//
+//  rubebatch
+//
+//  Command line tool to run a parameter sweep of a RUBE scene with
+//  RUBEBatchRunner, without the app:
+//
+//      rubebatch <scene.json> <steps> <results.csv> [options]
+//
+//      -p <type>[:<name>]=<value>,<value>,...
+//              a parameter to sweep, where the type is one of gravityX,
+//              gravityY, friction, restitution or motorSpeed, and the name
+//              is the name of the fixtures or joints to change
+//      -m contact:<fixture>,<other fixture>
+//              measure the time until the two fixtures touch
+//      -t <threads>
+//              how many threads to use, the default is one per core
+//
+//  Every combination of the parameter values is run, and the results are
+//  written to the CSV file.
+//
+//      rubebatch -hash <scene.json> <steps>
+//
+//  Loads the scene once, steps it the way BasicRUBELayer does when
+//  hashEachStep is on, and prints the Box2DWorldHash of every step in the
+//  same format the layer logs them. The output of two machines (or of a
+//  build before and after a change) can be diffed to find the first step
+//  where they went apart.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "RUBEBatchRunner.h"
+#include "Box2DWorldHash.h"
+#include "Box2DIterationController.h"
+#include "rubestuff/b2dJson.h"
+
+using namespace std;
+
+static void printUsage()
+{
+    printf("Usage: rubebatch <scene.json> <steps> <results.csv> [options]\n");
+    printf("       rubebatch -hash <scene.json> <steps>\n");
+    printf("  -p <type>[:<name>]=<value>,<value>,...  parameter to sweep (gravityX, gravityY, friction, restitution, motorSpeed)\n");
+    printf("  -m contact:<fixture>,<other fixture>    time until the two fixtures touch\n");
+    printf("  -t <threads>                            threads to use, default is one per core\n");
+}
+
+// eg. "restitution:bumper=0.5,0.7,0.9"
+static bool addParameter(RUBEBatchRunner& runner, const string& arg, string& errorMsg)
+{
+    size_t equals = arg.find('=');
+    if ( equals == string::npos ) {
+        errorMsg = "No values given for parameter " + arg;
+        return false;
+    }
+    string typeAndName = arg.substr(0, equals);
+    string name;
+    size_t colon = typeAndName.find(':');
+    if ( colon != string::npos ) {
+        name = typeAndName.substr(colon + 1);
+        typeAndName = typeAndName.substr(0, colon);
+    }
+    int type = RUBEBatchRunner::getParameterTypeByName(typeAndName);
+    if ( type < 0 ) {
+        errorMsg = "Unknown parameter type " + typeAndName;
+        return false;
+    }
+    if ( name.empty() && type != BP_GRAVITY_X && type != BP_GRAVITY_Y ) {
+        errorMsg = "No fixture or joint name given for parameter " + typeAndName;
+        return false;
+    }
+
+    vector<float> values;
+    const char* p = arg.c_str() + equals + 1;
+    while ( *p ) {
+        char* end;
+        float value = strtof(p, &end);
+        if ( end == p || (*end != ',' && *end != 0) ) {
+            errorMsg = "Bad value list in parameter " + arg;
+            return false;
+        }
+        values.push_back(value);
+        p = *end ? end + 1 : end;
+    }
+    if ( values.empty() ) {
+        errorMsg = "No values given for parameter " + arg;
+        return false;
+    }
+
+    runner.addParameter(type, name, &values[0], (int)values.size());
+    return true;
+}
+
+// eg. "contact:ball,gutter"
+static bool addMetric(RUBEBatchRunner& runner, const string& arg, string& errorMsg)
+{
+    const string contact = "contact:";
+    size_t comma = arg.find(',');
+    if ( arg.compare(0, contact.size(), contact) != 0 || comma == string::npos ) {
+        errorMsg = "Unknown metric " + arg;
+        return false;
+    }
+    string fixtureName = arg.substr(contact.size(), comma - contact.size());
+    string otherFixtureName = arg.substr(comma + 1);
+    runner.addMetric( new RUBEContactTimeMetric(fixtureName, otherFixtureName) );
+    return true;
+}
+
+// Steps the world like BasicRUBELayer does when hashEachStep returns true, so
+// the hashes can be compared with the ones logged by the app
+static int printHashes(const char* sceneFilename, int steps)
+{
+    string errorMsg;
+    b2dJson json;
+    b2World* world = json.readFromFile(sceneFilename, errorMsg);
+    if ( !world ) {
+        fprintf(stderr, "%s\n", errorMsg.c_str());
+        return 1;
+    }
+
+    Box2DIterationController iterationController;
+    iterationController.setLimits( json.getCustomInt(world, "minVelocityIterations", 4),
+                                   json.getCustomInt(world, "maxVelocityIterations", 8),
+                                   json.getCustomInt(world, "minPositionIterations", 2),
+                                   json.getCustomInt(world, "maxPositionIterations", 3) );
+    iterationController.setAdaptive(false);
+
+    vector<b2Body*> bodies;
+    vector<b2Joint*> joints;
+    json.getAllBodiesInFileOrder(bodies);
+    json.getAllJointsInCreationOrder(joints);
+    Box2DWorldHash hash;
+    hash.setOrder(bodies, joints);
+
+    // the layer makes a body for the mouse joint after loading, and hashes that too
+    b2BodyDef bd;
+    hash.addBody( world->CreateBody(&bd) );
+
+    for (int i = 0; i < steps; i++) {
+        iterationController.step(world, 1/60.0);
+        b2WorldHashValue stepHash = hash.step();
+        printf("Step %d hash %016llx\n", hash.getStepCount(), stepHash);
+    }
+    printf("Hash of all %d steps: %016llx\n", hash.getStepCount(), hash.getRunningHash());
+
+    delete world;
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if ( argc == 4 && strcmp(argv[1], "-hash") == 0 ) {
+        int steps = atoi(argv[3]);
+        if ( steps < 1 ) {
+            printUsage();
+            return 1;
+        }
+        return printHashes(argv[2], steps);
+    }
+
+    if ( argc < 4 ) {
+        printUsage();
+        return 1;
+    }
+
+    string sceneFilename = argv[1];
+    int steps = atoi(argv[2]);
+    string csvFilename = argv[3];
+    if ( steps < 1 ) {
+        printUsage();
+        return 1;
+    }
+
+    string errorMsg;
+    RUBEBatchRunner runner;
+    if ( ! runner.loadScene(sceneFilename, errorMsg) ) {
+        fprintf(stderr, "%s\n", errorMsg.c_str());
+        return 1;
+    }
+    runner.setStepCount(steps);
+
+    int numThreads = 0;
+    for (int i = 4; i < argc; i++) {
+        bool ok = true;
+        if ( strcmp(argv[i], "-p") == 0 && i + 1 < argc )
+            ok = addParameter(runner, argv[++i], errorMsg);
+        else if ( strcmp(argv[i], "-m") == 0 && i + 1 < argc )
+            ok = addMetric(runner, argv[++i], errorMsg);
+        else if ( strcmp(argv[i], "-t") == 0 && i + 1 < argc )
+            numThreads = atoi(argv[++i]);
+        else {
+            printUsage();
+            return 1;
+        }
+        if ( !ok ) {
+            fprintf(stderr, "%s\n", errorMsg.c_str());
+            return 1;
+        }
+    }
+
+    if ( ! runner.run(errorMsg, numThreads) || ! runner.writeCSV(csvFilename, errorMsg) ) {
+        fprintf(stderr, "%s\n", errorMsg.c_str());
+        return 1;
+    }
+
+    printf("%d runs of %d steps in %.1f ms (%d taken by another thread), results in %s\n",
+           runner.getRunCount(), steps, runner.getTotalTime(), runner.getStolenCount(), csvFilename.c_str());
+    return 0;
+}
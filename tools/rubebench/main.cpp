@@ -0,0 +1,739 @@
+//  rubebench
+//  ---------
+//
+//  Command line tool with the benchmarks for the b2dJson loader and writer,
+//  and the other parts of the sample that can run without the app:
+//
+//      rubebench -write <bodies>
+//
+//  Makes a world with the given number of bodies (boxes and circles, with a
+//  revolute joint between every tenth pair) and times saving it the three ways
+//  b2dJson can: writeToString, which streams the text straight into a buffer,
+//  writeToValue, which builds the Json::Value tree, and writeToValue followed
+//  by Json::StyledWriter, which is what writeToString used to do. Both the hex
+//  and the human readable float formats are timed. The streamed text is then
+//  parsed and compared with writeToValue, to check they say the same thing.
+//
+//      rubebench -copies <scene.json>
+//
+//  Counts the allocations made while b2dJson builds a world from an already
+//  parsed scene, then does the same again after adding a large member that
+//  b2dJson does not use to the world and to every body, fixture, joint and
+//  image. Copying any of those values would copy the extra member too, so the
+//  two counts are only the same when the scene tree is never copied. The exit
+//  code is 1 if they differ.
+//
+//      rubebench -hex <count>
+//
+//  Decodes this many random hex floats with the per-character decoder that
+//  b2dJson used to have (kept here as the baseline), then with hexToFloat one
+//  at a time, then with hexToFloats in batches (the SSE2 or NEON path where
+//  there is one). Prints the times, and exits with 1 if either of the new ways
+//  gives different bits from the baseline for any of them.
+//
+//      rubebench -parallel <scene.json> [repeats]
+//
+//  Times loading the scene from memory with readFromMemory, and then with
+//  readFromMemoryInParallel on 1, 2, 4 and 8 threads (the best of several
+//  repeats, 5 by default), and prints the speedup of each. Each parallel load
+//  is saved again with writeToString and compared with a save of the normal
+//  load, and the exit code is 1 if any of them differ.
+//
+//      rubebench -churn <count> [scene.json <prefab>]
+//
+//  Spawns this many copies of a prefab and gets rid of them again, in groups
+//  of 100 to look something like a game with lots of short-lived bullets,
+//  first with Box2DBodyPool parking them and then by creating and destroying
+//  every one. The prefab is the body with that "prefab" custom property in the
+//  scene, as RUBELayer finds them, or a small box if no scene is given. This
+//  is only the physics side of what RUBELayer does, without the sprites.
+//
+//      rubebench -buttons <count> [out.json]
+//
+//  Makes a menu scene with this many buttons, each a box fixture with a
+//  "selectorButton" property and a normal and a "_hover" image on its body,
+//  and saves it to out.json if given so the app can load it too. The scene is
+//  loaded back with b2dJson, and then the images of every button are found the
+//  way ButtonRUBELayer::setupButtonActions used to (a scan of all the images
+//  for each fixture, and getImageByName for the hover image), and then with
+//  indexes by body and by name built once, as RUBELayer keeps them now. The
+//  exit code is 1 if the two ways find different images for any button. The
+//  sprites and textures are left out, since they need the app.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <new>
+#include <random>
+#include "rubestuff/b2dJson.h"
+#include "rubestuff/b2dJsonImage.h"
+#include "rubestuff/b2dJsonThreadPool.h"
+#include "Box2DBodyPool.h"
+
+using namespace std;
+
+// Every allocation in the program goes through these, and is counted while
+// s_countAllocations is set. Box2D allocates with b2Alloc (malloc), so this is
+// only what b2dJson, jsoncpp and the standard containers do.
+static bool s_countAllocations = false;
+static unsigned long s_allocationCount = 0;
+
+void* operator new(size_t size)
+{
+    if ( s_countAllocations )
+        s_allocationCount++;
+    void* p = malloc(size ? size : 1);
+    if ( !p )
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) throw()
+{
+    free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+    free(p);
+}
+
+typedef std::chrono::steady_clock benchClock;
+
+static double millisecondsSince(benchClock::time_point startTime)
+{
+    std::chrono::duration<double, std::milli> elapsed = benchClock::now() - startTime;
+    return elapsed.count();
+}
+
+static void printUsage()
+{
+    printf("Usage: rubebench -write <bodies>\n");
+    printf("       rubebench -copies <scene.json>\n");
+    printf("       rubebench -hex <count>\n");
+    printf("       rubebench -parallel <scene.json> [repeats]\n");
+    printf("       rubebench -churn <count> [scene.json <prefab>]\n");
+    printf("       rubebench -buttons <count> [out.json]\n");
+}
+
+// A grid of boxes and circles, which is about what a big level is made of
+static b2World* makeWorld(int numBodies)
+{
+    b2World* world = new b2World(b2Vec2(0,-10));
+    int columns = 1000;
+
+    b2Body* previous = NULL;
+    for (int i = 0; i < numBodies; i++) {
+        b2BodyDef bd;
+        bd.type = (i % 50) == 0 ? b2_staticBody : b2_dynamicBody;
+        bd.position.Set( (i % columns) * 1.25f, (i / columns) * 1.25f );
+        bd.angle = 0.001f * i;
+        b2Body* body = world->CreateBody(&bd);
+
+        b2FixtureDef fd;
+        fd.density = 1;
+        fd.friction = 0.3f;
+        b2PolygonShape box;
+        b2CircleShape circle;
+        if ( i % 3 == 0 ) {
+            circle.m_radius = 0.5f;
+            fd.shape = &circle;
+        }
+        else {
+            box.SetAsBox(0.5f, 0.25f);
+            fd.shape = &box;
+        }
+        body->CreateFixture(&fd);
+
+        if ( previous && (i % 10) == 0 ) {
+            b2RevoluteJointDef jd;
+            jd.Initialize(previous, body, body->GetPosition());
+            world->CreateJoint(&jd);
+        }
+        previous = body;
+    }
+    return world;
+}
+
+static void benchmarkWriting(b2World* world, bool humanReadable)
+{
+    b2dJson json(humanReadable);
+
+    benchClock::time_point startTime = benchClock::now();
+    string streamed = json.writeToString(world);
+    double streamTime = millisecondsSince(startTime);
+
+    startTime = benchClock::now();
+    Json::Value value = json.writeToValue(world);
+    double valueTime = millisecondsSince(startTime);
+
+    startTime = benchClock::now();
+    Json::StyledWriter writer;
+    string styled = writer.write( json.writeToValue(world) );
+    double styledTime = millisecondsSince(startTime);
+
+    double megabytes = streamed.size() / (1024.0 * 1024.0);
+    printf("%s floats, %.1f MB of text\n", humanReadable ? "Human readable" : "Hex", megabytes);
+    printf("  writeToString              %8.1f ms  %6.1f MB/s\n", streamTime, megabytes / (streamTime / 1000));
+    printf("  writeToValue               %8.1f ms\n", valueTime);
+    printf("  writeToValue + StyledWriter%8.1f ms  %6.1f MB/s\n", styledTime, megabytes / (styledTime / 1000));
+
+    // the decimal text is the shortest that reads back as the same float, which is
+    // not always the same double that writeToValue holds, so only hex is compared
+    if ( !humanReadable ) {
+        Json::Value parsed;
+        Json::Reader reader;
+        if ( !reader.parse(streamed, parsed) )
+            printf("  the streamed text could not be parsed: %s\n", reader.getFormatedErrorMessages().c_str());
+        else
+            printf("  streamed text %s writeToValue\n", parsed == value ? "is the same as" : "DIFFERS from");
+    }
+}
+
+static unsigned long countLoadAllocations(const Json::Value& worldValue)
+{
+    b2dJson json;
+    s_allocationCount = 0;
+    s_countAllocations = true;
+    b2World* world = json.readFromValue(worldValue);
+    s_countAllocations = false;
+    delete world;
+    return s_allocationCount;
+}
+
+// A thousand members is far more than any body or fixture has of its own, so
+// one copy of anything that holds it shows up clearly in the count
+static void addPadding(Json::Value& value)
+{
+    Json::Value& padding = value["rubebenchPadding"];
+    for (int i = 0; i < 1000; i++)
+        padding[i] = i;
+}
+
+static void addPaddingToArray(Json::Value& arrayValue)
+{
+    for (int i = 0; i < (int)arrayValue.size(); i++)
+        addPadding(arrayValue[i]);
+}
+
+static int checkLoadCopies(const char* sceneFilename)
+{
+    std::ifstream ifs(sceneFilename, std::ios::in);
+    if ( !ifs ) {
+        fprintf(stderr, "Could not open file %s for reading\n", sceneFilename);
+        return 1;
+    }
+    Json::Value worldValue;
+    Json::Reader reader;
+    if ( !reader.parse(ifs, worldValue) ) {
+        fprintf(stderr, "%s\n", reader.getFormatedErrorMessages().c_str());
+        return 1;
+    }
+
+    Json::Value paddedValue = worldValue;
+    addPadding(paddedValue);
+    addPaddingToArray(paddedValue["body"]);
+    for (int i = 0; i < (int)paddedValue["body"].size(); i++)
+        addPaddingToArray(paddedValue["body"][i]["fixture"]);
+    addPaddingToArray(paddedValue["joint"]);
+    addPaddingToArray(paddedValue["image"]);
+
+    unsigned long allocations = countLoadAllocations(worldValue);
+    unsigned long paddedAllocations = countLoadAllocations(paddedValue);
+    printf("%lu allocations loading the scene, %lu with every item padded\n", allocations, paddedAllocations);
+    if ( allocations != paddedAllocations ) {
+        printf("Some part of the scene tree was copied while loading\n");
+        return 1;
+    }
+    printf("No part of the scene tree was copied while loading\n");
+    return 0;
+}
+
+// The decoder b2dJson had before hexToFloats, character by character from a
+// std::string, which is what the newer ones must match exactly
+static float baselineHexToFloat(std::string str)
+{
+    int strLen = 8;//32 bit float
+    unsigned char bytes[4];
+    int bptr = (strLen / 2) - 1;
+
+    for (int i = 0; i < strLen; i++){
+        unsigned char   c;
+        c = str[i];
+        if (c > '9') c -= 7;
+        c <<= 4;
+        bytes[bptr] = c;
+
+        ++i;
+        c = str[i];
+        if (c > '9') c -= 7;
+        c -= '0';
+        bytes[bptr] |= c;
+
+        --bptr;
+    }
+
+    float f;
+    memcpy(&f, bytes, sizeof(f));
+    return f;
+}
+
+// The decoders are protected helpers of b2dJson
+class HexDecoders : public b2dJson
+{
+public:
+    static float decodeOne(const char* str) { return hexToFloat(str); }
+    static void decodeMany(const char* const* hexStrings, float* floats, int count) { hexToFloats(hexStrings, floats, count); }
+};
+
+static int countMismatches(const vector<float>& expected, const vector<float>& actual, const vector<const char*>& hexStrings, const char* what)
+{
+    int mismatches = 0;
+    for (int i = 0; i < (int)expected.size(); i++) {
+        if ( memcmp(&expected[i], &actual[i], sizeof(float)) != 0 ) {
+            if ( mismatches == 0 )
+                printf("%s gave different bits for %s\n", what, hexStrings[i]);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+// Random bit patterns cover every kind of float, including NaNs and denormals,
+// so the results are compared as bits rather than as floats. Every sixteenth
+// string is in lower case, which RUBE never writes, to check the new decoders
+// get that just as wrong as the old one did.
+static int benchmarkHexDecoding(int count)
+{
+    std::mt19937 random(12345);
+    vector<char> text(count * 9);
+    vector<const char*> hexStrings(count);
+    vector<string> hexStdStrings(count);
+    for (int i = 0; i < count; i++) {
+        unsigned int bits = random();
+        char* str = &text[i * 9];
+        sprintf(str, (i % 16) == 15 ? "%08x" : "%08X", bits);
+        hexStrings[i] = str;
+        hexStdStrings[i] = str;
+    }
+
+    vector<float> baseline(count);
+    vector<float> single(count);
+    vector<float> batched(count);
+
+    benchClock::time_point startTime = benchClock::now();
+    for (int i = 0; i < count; i++)
+        baseline[i] = baselineHexToFloat(hexStdStrings[i]);
+    double baselineTime = millisecondsSince(startTime);
+
+    startTime = benchClock::now();
+    for (int i = 0; i < count; i++)
+        single[i] = HexDecoders::decodeOne(hexStrings[i]);
+    double singleTime = millisecondsSince(startTime);
+
+    startTime = benchClock::now();
+    HexDecoders::decodeMany(&hexStrings[0], &batched[0], count);
+    double batchedTime = millisecondsSince(startTime);
+
+    int singleMismatches = countMismatches(baseline, single, hexStrings, "hexToFloat");
+    int batchedMismatches = countMismatches(baseline, batched, hexStrings, "hexToFloats");
+
+    printf("Decoding %d hex floats\n", count);
+    printf("  baseline per character  %8.2f ms\n", baselineTime);
+    printf("  hexToFloat              %8.2f ms  %d different\n", singleTime, singleMismatches);
+    printf("  hexToFloats             %8.2f ms  %d different\n", batchedTime, batchedMismatches);
+    return (singleMismatches || batchedMismatches) ? 1 : 0;
+}
+
+static bool readWholeFile(const char* filename, string& contents)
+{
+    std::ifstream ifs(filename, std::ios::in | std::ios::binary);
+    if ( !ifs )
+        return false;
+    ifs.seekg(0, std::ios::end);
+    contents.resize( (size_t)ifs.tellg() );
+    ifs.seekg(0, std::ios::beg);
+    if ( !contents.empty() )
+        ifs.read(&contents[0], contents.size());
+    return (bool)ifs;
+}
+
+// Loads the scene and saves it again, giving the best time out of the repeats.
+// numThreads is 0 for the normal readFromMemory.
+static double timeLoading(const string& contents, int numThreads, int repeats, string& saved, string& errorMsg)
+{
+    double bestTime = 0;
+    for (int i = 0; i < repeats; i++) {
+        b2dJson json;
+        benchClock::time_point startTime = benchClock::now();
+        b2World* world;
+        if ( numThreads == 0 )
+            world = json.readFromMemory(contents.data(), contents.size(), errorMsg);
+        else
+            world = json.readFromMemoryInParallel(contents.data(), contents.size(), errorMsg, numThreads);
+        double loadTime = millisecondsSince(startTime);
+        if ( !world )
+            return -1;
+        if ( i == 0 || loadTime < bestTime )
+            bestTime = loadTime;
+        if ( i == 0 )
+            saved = json.writeToString(world);
+        delete world;
+    }
+    return bestTime;
+}
+
+static int benchmarkParallelLoading(const char* sceneFilename, int repeats)
+{
+    string contents;
+    if ( !readWholeFile(sceneFilename, contents) ) {
+        fprintf(stderr, "Could not open file %s for reading\n", sceneFilename);
+        return 1;
+    }
+
+    string errorMsg;
+    string serialSave;
+    double serialTime = timeLoading(contents, 0, repeats, serialSave, errorMsg);
+    if ( serialTime < 0 ) {
+        fprintf(stderr, "%s\n", errorMsg.c_str());
+        return 1;
+    }
+    printf("%.1f MB, best of %d loads, %d cores\n", contents.size() / (1024.0 * 1024.0), repeats, b2dJsonThreadPool::getMaxThreads());
+    printf("  readFromMemory                    %8.1f ms\n", serialTime);
+
+    int differences = 0;
+    const int threadCounts[] = { 1, 2, 4, 8 };
+    for (int i = 0; i < 4; i++) {
+        string parallelSave;
+        double parallelTime = timeLoading(contents, threadCounts[i], repeats, parallelSave, errorMsg);
+        if ( parallelTime < 0 ) {
+            fprintf(stderr, "%s\n", errorMsg.c_str());
+            return 1;
+        }
+        bool same = parallelSave == serialSave;
+        if ( !same )
+            differences++;
+        printf("  readFromMemoryInParallel, %d %s %8.1f ms  %.2fx%s\n", threadCounts[i], threadCounts[i] == 1 ? "thread " : "threads",
+               parallelTime, serialTime / parallelTime, same ? "" : "  DIFFERENT WORLD");
+    }
+    return differences ? 1 : 0;
+}
+
+// The template for the churn when no scene is given
+static b2Body* makeBulletBody(b2World* world)
+{
+    b2BodyDef bd;
+    bd.type = b2_dynamicBody;
+    bd.bullet = true;
+    b2Body* body = world->CreateBody(&bd);
+    b2PolygonShape box;
+    box.SetAsBox(0.1f, 0.05f);
+    body->CreateFixture(&box, 1);
+    return body;
+}
+
+static int benchmarkBodyChurn(int count, const char* sceneFilename, const char* prefabName)
+{
+    string errorMsg;
+    b2dJson json;
+    b2World* world;
+    b2Body* templateBody = NULL;
+    if ( sceneFilename ) {
+        world = json.readFromFile(sceneFilename, errorMsg);
+        if ( !world ) {
+            fprintf(stderr, "%s\n", errorMsg.c_str());
+            return 1;
+        }
+        vector<b2Body*> bodies;
+        json.getAllBodiesInFileOrder(bodies);
+        for (int i = 0; i < (int)bodies.size() && !templateBody; i++) {
+            if ( json.getCustomString(bodies[i], "prefab", "") == prefabName )
+                templateBody = bodies[i];
+        }
+        if ( !templateBody ) {
+            fprintf(stderr, "No body in %s has the prefab property %s\n", sceneFilename, prefabName);
+            delete world;
+            return 1;
+        }
+    }
+    else {
+        world = new b2World(b2Vec2(0,-10));
+        templateBody = makeBulletBody(world);
+        prefabName = "bullet";
+    }
+
+    Box2DBodyPool pool;
+    Box2DPrefab* prefab = pool.registerPrefab(prefabName, templateBody);
+    printf("Churn of %d %s bodies, %d in the world to start with\n", count, prefabName, world->GetBodyCount());
+
+    const int groupSize = 100;
+    vector<b2Body*> group;
+    b2Vec2 position = templateBody->GetPosition();
+
+    benchClock::time_point startTime = benchClock::now();
+    for (int done = 0; done < count; done += groupSize) {
+        group.clear();
+        for (int i = 0; i < groupSize; i++)
+            group.push_back( pool.spawnBody(prefab, position, 0, b2Vec2(0,0), 0) );
+        for (int i = 0; i < groupSize; i++)
+            pool.parkBody( group[i] );
+    }
+    double pooledTime = millisecondsSince(startTime);
+
+    startTime = benchClock::now();
+    for (int done = 0; done < count; done += groupSize) {
+        group.clear();
+        for (int i = 0; i < groupSize; i++) {
+            b2Body* body = Box2DBodyPool::createCopy(templateBody);
+            body->SetTransform(position, 0);
+            body->SetActive(true);
+            group.push_back(body);
+        }
+        for (int i = 0; i < groupSize; i++)
+            world->DestroyBody( group[i] );
+    }
+    double unpooledTime = millisecondsSince(startTime);
+
+    printf("  parked and reused      %8.1f ms  %d hits, %d misses\n", pooledTime, prefab->hits, prefab->misses);
+    printf("  created and destroyed  %8.1f ms\n", unpooledTime);
+
+    pool.clear();
+    delete world;
+    return 0;
+}
+
+// Rows of buttons like the ones in simplemenu.json, with the hover image at
+// the same place as the normal one
+static b2World* makeButtonScene(int count, b2dJson& json)
+{
+    b2World* world = new b2World(b2Vec2(0,0));
+    int columns = 50;
+
+    for (int i = 0; i < count; i++) {
+        char name[32];
+        sprintf(name, "button%d", i);
+
+        b2BodyDef bd;
+        bd.position.Set( (i % columns) * 2.5f, (i / columns) * -1.5f );
+        b2Body* body = world->CreateBody(&bd);
+
+        b2PolygonShape box;
+        box.SetAsBox(1, 0.5f);
+        b2Fixture* fixture = body->CreateFixture(&box, 0);
+        json.setCustomString(fixture, "selectorButton", "doSomething");
+
+        b2dJsonImage* image = new b2dJsonImage();
+        image->name = name;
+        image->file = "button.png";
+        image->body = body;
+        json.addImage(image);
+
+        b2dJsonImage* hoverImage = new b2dJsonImage(image);
+        hoverImage->name = string(name) + "_hover";
+        hoverImage->file = "button_hover.png";
+        json.addImage(hoverImage);
+    }
+    return world;
+}
+
+// The normal and hover images found for one button fixture
+struct ButtonImages {
+    b2dJsonImage* normal;
+    b2dJsonImage* hover;
+};
+
+// Picks the image on the body closest to the fixture, as setupButtonActions does
+static b2dJsonImage* closestImage(const vector<b2dJsonImage*>& imagesOnBody, b2Fixture* f)
+{
+    b2dJsonImage* baseImage = imagesOnBody[0];
+    if ( imagesOnBody.size() > 1 && f->GetType() == b2Shape::e_polygon ) {
+        b2PolygonShape* poly = (b2PolygonShape*)f->GetShape();
+        float bestDist = FLT_MAX;
+        for (int i = 0; i < (int)imagesOnBody.size(); i++) {
+            float dist = (imagesOnBody[i]->center - poly->m_centroid).Length();
+            if ( dist < bestDist ) {
+                bestDist = dist;
+                baseImage = imagesOnBody[i];
+            }
+        }
+    }
+    return baseImage;
+}
+
+static void findButtonImagesByScanning(b2World* world, b2dJson& json, vector<ButtonImages>& result)
+{
+    vector<b2dJsonImage*> allImages;
+    json.getAllImages(allImages);
+
+    for (b2Body* b = world->GetBodyList(); b; b = b->GetNext()) {
+        for (b2Fixture* f = b->GetFixtureList(); f; f = f->GetNext()) {
+            if ( json.getCustomString(f, "selectorButton", "").empty() )
+                continue;
+            vector<b2dJsonImage*> imagesOnBody;
+            for (int i = 0; i < (int)allImages.size(); i++)
+                if ( allImages[i]->body == b )
+                    imagesOnBody.push_back(allImages[i]);
+            ButtonImages bi = { NULL, NULL };
+            if ( !imagesOnBody.empty() ) {
+                bi.normal = closestImage(imagesOnBody, f);
+                bi.hover = json.getImageByName(bi.normal->name + "_hover");
+            }
+            result.push_back(bi);
+        }
+    }
+}
+
+static void findButtonImagesByIndex(b2World* world, b2dJson& json, vector<ButtonImages>& result)
+{
+    vector<b2dJsonImage*> allImages;
+    json.getAllImages(allImages);
+
+    unordered_map<b2Body*, vector<b2dJsonImage*> > imagesByBody;
+    unordered_map<string, vector<b2dJsonImage*> > imagesByName;
+    for (int i = 0; i < (int)allImages.size(); i++) {
+        if ( allImages[i]->body )
+            imagesByBody[allImages[i]->body].push_back(allImages[i]);
+        imagesByName[allImages[i]->name].push_back(allImages[i]);
+    }
+
+    for (b2Body* b = world->GetBodyList(); b; b = b->GetNext()) {
+        for (b2Fixture* f = b->GetFixtureList(); f; f = f->GetNext()) {
+            if ( json.getCustomString(f, "selectorButton", "").empty() )
+                continue;
+            ButtonImages bi = { NULL, NULL };
+            unordered_map<b2Body*, vector<b2dJsonImage*> >::iterator it = imagesByBody.find(b);
+            if ( it != imagesByBody.end() ) {
+                bi.normal = closestImage(it->second, f);
+                unordered_map<string, vector<b2dJsonImage*> >::iterator hoverIt = imagesByName.find(bi.normal->name + "_hover");
+                bi.hover = hoverIt == imagesByName.end() ? NULL : hoverIt->second[0];
+            }
+            result.push_back(bi);
+        }
+    }
+}
+
+static int benchmarkButtonSetup(int count, const char* outFilename)
+{
+    string sceneText;
+    {
+        b2dJson json;
+        b2World* world = makeButtonScene(count, json);
+        sceneText = json.writeToString(world);
+        if ( outFilename && !json.writeToFile(world, outFilename) ) {
+            fprintf(stderr, "Could not write %s\n", outFilename);
+            delete world;
+            return 1;
+        }
+        delete world;
+    }
+
+    b2dJson json;
+    string errorMsg;
+    benchClock::time_point startTime = benchClock::now();
+    b2World* world = json.readFromString(sceneText, errorMsg);
+    double loadTime = millisecondsSince(startTime);
+    if ( !world ) {
+        fprintf(stderr, "%s\n", errorMsg.c_str());
+        return 1;
+    }
+
+    vector<ButtonImages> scanned;
+    startTime = benchClock::now();
+    findButtonImagesByScanning(world, json, scanned);
+    double scanTime = millisecondsSince(startTime);
+
+    vector<ButtonImages> indexed;
+    startTime = benchClock::now();
+    findButtonImagesByIndex(world, json, indexed);
+    double indexTime = millisecondsSince(startTime);
+
+    int differences = 0;
+    int withHover = 0;
+    for (int i = 0; i < (int)scanned.size(); i++) {
+        if ( scanned[i].normal != indexed[i].normal || scanned[i].hover != indexed[i].hover )
+            differences++;
+        if ( indexed[i].hover )
+            withHover++;
+    }
+
+    printf("%d buttons, %d with a hover image\n", (int)indexed.size(), withHover);
+    printf("  load scene             %8.1f ms\n", loadTime);
+    printf("  scan for images        %8.1f ms\n", scanTime);
+    printf("  look up in indexes     %8.1f ms\n", indexTime);
+    if ( differences )
+        printf("%d buttons got different images\n", differences);
+
+    delete world;
+    return differences ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    if ( argc == 3 && strcmp(argv[1], "-write") == 0 ) {
+        int numBodies = atoi(argv[2]);
+        if ( numBodies < 1 ) {
+            printUsage();
+            return 1;
+        }
+        b2World* world = makeWorld(numBodies);
+        printf("%d bodies, %d joints\n", world->GetBodyCount(), world->GetJointCount());
+        benchmarkWriting(world, false);
+        benchmarkWriting(world, true);
+        delete world;
+        return 0;
+    }
+
+    if ( argc == 3 && strcmp(argv[1], "-copies") == 0 )
+        return checkLoadCopies(argv[2]);
+
+    if ( argc == 3 && strcmp(argv[1], "-hex") == 0 ) {
+        int count = atoi(argv[2]);
+        if ( count < 1 ) {
+            printUsage();
+            return 1;
+        }
+        return benchmarkHexDecoding(count);
+    }
+
+    if ( (argc == 3 || argc == 4) && strcmp(argv[1], "-parallel") == 0 ) {
+        int repeats = argc == 4 ? atoi(argv[3]) : 5;
+        if ( repeats < 1 ) {
+            printUsage();
+            return 1;
+        }
+        return benchmarkParallelLoading(argv[2], repeats);
+    }
+
+    if ( (argc == 3 || argc == 5) && strcmp(argv[1], "-churn") == 0 ) {
+        int count = atoi(argv[2]);
+        if ( count < 1 ) {
+            printUsage();
+            return 1;
+        }
+        return benchmarkBodyChurn(count, argc == 5 ? argv[3] : NULL, argc == 5 ? argv[4] : NULL);
+    }
+
+    if ( (argc == 3 || argc == 4) && strcmp(argv[1], "-buttons") == 0 ) {
+        int count = atoi(argv[2]);
+        if ( count < 1 ) {
+            printUsage();
+            return 1;
+        }
+        return benchmarkButtonSetup(count, argc == 4 ? argv[3] : NULL);
+    }
+
+    printUsage();
+    return 1;
+}
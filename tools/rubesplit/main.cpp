@@ -0,0 +1,54 @@
+//
+//  rubesplit
+//
+//  Command line tool to split a large RUBE scene into tiles that can be
+//  streamed in and out of the world while the game is running (see
+//  b2dJsonTiles.h):
+//
+//      rubesplit <scene.json> <tile size> <output basename>
+//
+//  eg. "rubesplit bigLevel.json 50 Resources/bigLevel" writes
+//  Resources/bigLevel.json, Resources/bigLevel.tiles.json and one
+//  Resources/bigLevel.tile_X_Y.json for each tile. Give the layer
+//  "bigLevel.json" from getFilename and "bigLevel.tiles.json" from
+//  getTileIndexFilename.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "rubestuff/b2dJsonTiles.h"
+#include "rubestuff/b2dJsonFileView.h"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+    if ( argc != 4 || atof(argv[2]) <= 0 ) {
+        printf("Usage: rubesplit <scene.json> <tile size> <output basename>\n");
+        return 1;
+    }
+
+    string errorMsg;
+    b2dJsonFileView file;
+    if ( ! file.open(argv[1], errorMsg) ) {
+        fprintf(stderr, "%s\n", errorMsg.c_str());
+        return 1;
+    }
+
+    Json::Value worldValue;
+    Json::Reader reader;
+    if ( ! reader.parse(file.data(), file.data() + file.size(), worldValue, false) ) {
+        fprintf(stderr, "Failed to parse '%s' : %s\n", argv[1], reader.getFormatedErrorMessages().c_str());
+        return 1;
+    }
+
+    if ( ! b2dJsonTiles::splitWorld(worldValue, (float)atof(argv[2]), argv[3], errorMsg) ) {
+        fprintf(stderr, "%s\n", errorMsg.c_str());
+        return 1;
+    }
+
+    const Json::Value& bodies = worldValue["body"];
+    printf("Split %d bodies from %s into tiles, index written to %s.tiles.json\n", (int)bodies.size(), argv[1], argv[3]);
+    return 0;
+}